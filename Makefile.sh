@@ -148,6 +148,20 @@ do
   echo ""
 done
 
+#### Benchmark binaries.
+echo "#### Benchmark ####"
+echo ""
+
+for f in `find benchmark -name *.cpp`
+do
+  filename=$(basename "$f" .cpp)
+  echo "# Program: $f"
+  echo "noinst_PROGRAMS += benchmark/$filename"
+  echo "benchmark_${filename}_SOURCES  = $f"
+  echo "benchmark_${filename}_LDADD    = lib/libDtCraft.la"
+  echo ""
+done
+
 #### Testing binaries.
 echo "#### Unittest ####"
 echo ""
@@ -0,0 +1,540 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright (c) 2018, Tsung-Wei Huang and Martin D. F. Wong,                 *
+ * University of Illinois at Urbana-Champaign (UIUC), IL, USA.                *
+ *                                                                            *
+ * All Rights Reserved.                                                       *
+ *                                                                            *
+ * This program is free software. You can redistribute and/or modify          *
+ * it in accordance with the terms of the accompanying license agreement.     *
+ * See LICENSE in the top-level directory for details.                        *
+ *                                                                            *
+ ******************************************************************************/
+
+// Program: benchmark/reactor
+//
+// Microbenchmarks of the reactor. Every suite runs once per worker count and reports its
+// throughput along with latency histograms (the power-of-two histograms of the reactor
+// instruments). The report is a json document that also records the machine, the demux
+// backend, and the DTC_* environment, so runs of different backends, thread pools, or buffer
+// strategies on the same box can be compared across releases.
+//
+// Usage: reactor [-o file] [-t workers] [-s suites] [-d demux] [-n scale]
+//
+//   -o file    write the json report to the file (default: stdout)
+//   -t list    comma-separated worker counts (default: 0,1,2,4)
+//   -s list    comma-separated suites (default: all)
+//   -d demux   select, epoll, or uring (default: DTC_DEMUX)
+//   -n scale   scale factor of the problem sizes (default: 1.0)
+//
+// Suites:
+//
+//   pingpong   round-trip latency of one byte bounced over make_socket_pair
+//   fanout     one InputStream forwarding messages to many OutputStreams
+//   fanin      many InputStreams forwarding messages to one OutputStream
+//   promise    promise round-trip latency from non-owner threads
+//   timer      timer lateness while the loop is kept busy by io events
+//   insert     insert/remove cost from a non-owner thread, one by one and in batch
+//
+
+#include "report.hpp"
+
+namespace {
+
+using namespace benchmark;
+
+using namespace std::chrono_literals;
+
+using clock_type = std::chrono::steady_clock;
+
+// Struct: Config
+struct Config {
+
+  std::string output;
+  std::vector<unsigned> workers {0, 1, 2, 4};
+  std::vector<std::string> suites {"pingpong", "fanout", "fanin", "promise", "timer", "insert"};
+  dtc::DemuxType demux {dtc::env::demux_type()};
+  double scale {1.0};
+
+  // Scale a problem size.
+  size_t n(size_t base) const {
+    return std::max<size_t>(1, static_cast<size_t>(base * scale));
+  }
+};
+
+// Function: split
+std::vector<std::string> split(const std::string& s) {
+  std::vector<std::string> tokens;
+  std::istringstream iss(s);
+  for(std::string t; std::getline(iss, t, ',');) {
+    if(!t.empty()) tokens.push_back(t);
+  }
+  return tokens;
+}
+
+// Function: to_string
+const char* to_string(dtc::DemuxType t) {
+  switch(t) {
+    case dtc::DemuxType::SELECT: return "select";
+    case dtc::DemuxType::EPOLL:  return "epoll";
+    case dtc::DemuxType::URING:  return "uring";
+  }
+  return "unknown";
+}
+
+// Function: post
+// Write one byte to a device.
+void post(const dtc::Device& d) {
+  char c {0};
+  if(::write(d.fd(), &c, 1) != 1) {
+    throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)), "write failed");
+  }
+}
+
+// Function: pend
+// Consume whatever is pending on a device. Returns false if nothing was there.
+bool pend(const dtc::Device& d) {
+  char buf[64];
+  return ::read(d.fd(), buf, sizeof(buf)) > 0;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Function: pingpong
+// One byte bounces between the two ends of a socket pair. The round trip is two activations.
+dtc::json pingpong(const Config& cfg, unsigned w) {
+
+  const auto N = cfg.n(50000);
+
+  dtc::Reactor R(w, cfg.demux);
+
+  auto [a, b] = dtc::make_socket_pair();
+
+  dtc::Histogram rtt;
+  size_t count {0};
+  auto sent = clock_type::now();
+
+  auto pong = R.insert<dtc::ReadEvent>(b, [] (dtc::Event& e) {
+    if(pend(*e.device())) {
+      post(*e.device());
+    }
+  }).get();
+
+  auto ping = R.insert<dtc::ReadEvent>(a, [&] (dtc::Event& e) {
+    if(!pend(*e.device())) {
+      return dtc::Event::DEFAULT;
+    }
+    auto now = clock_type::now();
+    rtt.insert(now - sent);
+    if(++count == N) {
+      R.remove(pong);
+      return dtc::Event::REMOVE;
+    }
+    sent = now;
+    post(*e.device());
+    return dtc::Event::DEFAULT;
+  }).get();
+
+  auto beg = clock_type::now();
+  sent = beg;
+  post(*ping->device());
+  R.dispatch();
+  auto elapsed = seconds(clock_type::now() - beg);
+
+  return {
+    {"round_trips", count},
+    {"elapsed_s", elapsed},
+    {"round_trips_per_s", count / elapsed},
+    {"rtt", rtt.to_json()}
+  };
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Function: streams
+// Push messages through a tree of streams: the sources are pre-loaded output streams whose
+// input sides forward every message to one of the sinks, and the sinks count what they get.
+// Fan-out is one source to many sinks; fan-in is many sources to one sink. Throughput is
+// measured at the sinks.
+dtc::json streams(const Config& cfg, unsigned w, size_t num_sources, size_t num_sinks) {
+
+  constexpr size_t msg_size = 4096;
+
+  const auto num_msgs = cfg.n(8192) / (num_sources * num_sinks) * (num_sources * num_sinks);
+  const auto msgs_per_source = num_msgs / num_sources;
+  const auto msgs_per_sink = num_msgs / num_sinks;
+
+  dtc::Reactor R(w, cfg.demux);
+
+  std::vector<std::shared_ptr<dtc::OutputStream>> sinks(num_sinks);
+  std::vector<clock_type::time_point> done(num_sinks);
+  std::atomic<size_t> num_bytes {0};
+
+  auto beg = clock_type::now();
+
+  // Sinks.
+  for(size_t i=0; i<num_sinks; ++i) {
+
+    auto [rend, wend] = dtc::make_socket_pair();
+
+    sinks[i] = R.insert<dtc::OutputStream>(wend, [] (dtc::OutputStream& os) {
+      os.osbuf.sync();
+    }).get();
+
+    R.insert<dtc::InputStream>(rend, [&, i, n=size_t{0}] (dtc::InputStream& is) mutable {
+      is.isbuf.sync();
+      for(std::string msg; is(msg) != -1; ) {
+        num_bytes.fetch_add(msg.size(), std::memory_order_relaxed);
+        if(++n == msgs_per_sink) {
+          done[i] = clock_type::now();
+          R.remove(sinks[i]);
+          return dtc::Event::REMOVE;
+        }
+      }
+      return dtc::Event::DEFAULT;
+    });
+  }
+
+  // Sources.
+  for(size_t i=0; i<num_sources; ++i) {
+
+    auto [rend, wend] = dtc::make_socket_pair();
+
+    auto os = R.insert<dtc::OutputStream>(wend, [] (dtc::OutputStream& os) {
+      os.osbuf.sync();
+      return os.osbuf.out_avail() == 0 ? dtc::Event::REMOVE : dtc::Event::DEFAULT;
+    }).get();
+
+    R.insert<dtc::InputStream>(rend, [&, n=size_t{0}] (dtc::InputStream& is) mutable {
+      is.isbuf.sync();
+      for(std::string msg; is(msg) != -1; ) {
+        (*sinks[n % num_sinks])(msg);
+        if(++n == msgs_per_source) {
+          return dtc::Event::REMOVE;
+        }
+      }
+      return dtc::Event::DEFAULT;
+    });
+
+    for(size_t m=0; m<msgs_per_source; ++m) {
+      (*os)(std::string(msg_size, 'x'));
+    }
+  }
+
+  beg = clock_type::now();
+  R.dispatch();
+  auto elapsed = seconds(clock_type::now() - beg);
+
+  dtc::Histogram completion;
+  for(auto t : done) {
+    completion.insert(t - beg);
+  }
+
+  return {
+    {"num_sources", num_sources},
+    {"num_sinks", num_sinks},
+    {"message_bytes", msg_size},
+    {"num_messages", num_msgs},
+    {"num_bytes", num_bytes.load()},
+    {"elapsed_s", elapsed},
+    {"messages_per_s", num_msgs / elapsed},
+    {"mb_per_s", num_bytes.load() / elapsed / 1e6},
+    {"sink_completion", completion.to_json()}
+  };
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Function: promise
+// Non-owner threads (one per worker, at least one) issue promises back to back and wait for
+// each of them.
+dtc::json promise(const Config& cfg, unsigned w) {
+
+  const auto N = cfg.n(20000);
+  const auto num_clients = std::max(w, 1u);
+
+  dtc::Reactor R(w, cfg.demux);
+
+  std::vector<dtc::Histogram> rtts(num_clients);
+  std::vector<std::thread> clients;
+  std::atomic<bool> go {false};
+
+  auto alive = R.insert<dtc::TimeoutEvent>(24h, [] (dtc::Event&) {}).get();
+
+  R.insert<dtc::TimeoutEvent>(0ms, [&] (dtc::Event&) { go = true; });
+
+  for(unsigned c=0; c<num_clients; ++c) {
+    clients.emplace_back([&, c] () {
+      while(!go) std::this_thread::yield();
+      for(size_t i=0; i<N; ++i) {
+        auto beg = clock_type::now();
+        R.promise([] () {}).get();
+        rtts[c].insert(clock_type::now() - beg);
+      }
+    });
+  }
+
+  std::thread coordinator([&] () {
+    for(auto& t : clients) t.join();
+    R.remove(alive);
+  });
+
+  auto beg = clock_type::now();
+  R.dispatch();
+  auto elapsed = seconds(clock_type::now() - beg);
+
+  coordinator.join();
+
+  dtc::Histogram rtt;
+  for(const auto& h : rtts) {
+    rtt += h;
+  }
+
+  return {
+    {"num_clients", num_clients},
+    {"num_promises", rtt.count()},
+    {"elapsed_s", elapsed},
+    {"promises_per_s", rtt.count() / elapsed},
+    {"rtt", rtt.to_json()}
+  };
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Function: timer
+// Timeouts with random delays in [1, 100] ms fire while a few io events keep re-activating
+// themselves. Lateness is the gap between the deadline and the start of the callback.
+dtc::json timer(const Config& cfg, unsigned w) {
+
+  const auto num_timers = cfg.n(2000);
+  const size_t num_loads = 4;
+
+  dtc::Reactor R(w, cfg.demux);
+
+  std::mutex mutex;
+  dtc::Histogram lateness;
+  std::atomic<size_t> num_fired {0};
+  std::atomic<size_t> num_load_activations {0};
+
+  for(size_t i=0; i<num_loads; ++i) {
+    auto n = dtc::make_notifier();
+    R.insert<dtc::ReadEvent>(n, [&] (dtc::Event& e) {
+      uint64_t c;
+      if(::read(e.device()->fd(), &c, sizeof(c)) != sizeof(c)) {
+        return dtc::Event::DEFAULT;
+      }
+      num_load_activations.fetch_add(1, std::memory_order_relaxed);
+      if(num_fired == num_timers) {
+        return dtc::Event::REMOVE;
+      }
+      c = 1;
+      return ::write(e.device()->fd(), &c, sizeof(c)) == sizeof(c) ?
+             dtc::Event::DEFAULT : dtc::Event::REMOVE;
+    });
+    uint64_t c = 1;
+    if(::write(n->fd(), &c, sizeof(c)) != sizeof(c)) {
+      throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)), "write failed");
+    }
+  }
+
+  auto beg = clock_type::now();
+
+  for(size_t i=0; i<num_timers; ++i) {
+    auto d = std::chrono::microseconds(dtc::random<int>(1000, 100000));
+    R.insert<dtc::TimeoutEvent>(d, [&, deadline=beg+d] (dtc::Event&) {
+      auto late = clock_type::now() - deadline;
+      {
+        std::scoped_lock lock(mutex);
+        lateness.insert(late);
+      }
+      ++num_fired;
+    });
+  }
+
+  R.dispatch();
+  auto elapsed = seconds(clock_type::now() - beg);
+
+  return {
+    {"num_timers", num_timers},
+    {"num_load_events", num_loads},
+    {"num_load_activations", num_load_activations.load()},
+    {"elapsed_s", elapsed},
+    {"lateness", lateness.to_json()}
+  };
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Function: insert
+// A non-owner thread inserts and removes events while the loop runs: one event at a time
+// (waiting for each future) and in one batch.
+dtc::json insert(const Config& cfg, unsigned w) {
+
+  const auto N = cfg.n(20000);
+
+  dtc::Reactor R(w, cfg.demux);
+
+  auto device = dtc::make_notifier();
+  auto alive = R.insert<dtc::TimeoutEvent>(24h, [] (dtc::Event&) {}).get();
+
+  dtc::json result {{"num_events", N}};
+
+  std::thread client([&] () {
+
+    auto per_event = [N] (auto d) { return std::chrono::duration<double, std::nano>(d).count() / N; };
+
+    auto measure = [&] (const char* name, auto&& make) {
+
+      std::vector<std::shared_ptr<dtc::Event>> events;
+      events.reserve(N);
+
+      auto t0 = clock_type::now();
+      for(size_t i=0; i<N; ++i) {
+        events.push_back(make().get());
+      }
+      auto t1 = clock_type::now();
+      for(auto& e : events) {
+        R.remove(e).get();
+      }
+      auto t2 = clock_type::now();
+
+      events.clear();
+      for(size_t i=0; i<N; ++i) {
+        events.push_back(dtc::Reactor::make_event<dtc::WriteEvent>(nullptr, device, [] (dtc::Event&) {}));
+      }
+
+      auto t3 = clock_type::now();
+      R.insert_batch(events).get();
+      auto t4 = clock_type::now();
+      R.remove_batch(std::move(events)).get();
+      auto t5 = clock_type::now();
+
+      result[name] = {
+        {"insert_ns", per_event(t1 - t0)},
+        {"remove_ns", per_event(t2 - t1)},
+        {"batch_insert_ns", per_event(t4 - t3)},
+        {"batch_remove_ns", per_event(t5 - t4)}
+      };
+    };
+
+    measure("timeout", [&] () {
+      return R.insert<dtc::TimeoutEvent>(24h, [] (dtc::Event&) {});
+    });
+
+    measure("write", [&] () {
+      return R.insert<dtc::WriteEvent>(device, [] (dtc::Event&) {});
+    });
+
+    R.remove(alive);
+  });
+
+  R.dispatch();
+
+  client.join();
+
+  return result;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Function: usage
+void usage(const char* prog) {
+  std::cerr << "Usage: " << prog << " [-o file] [-t workers] [-s suites] [-d demux] [-n scale]\n"
+            << "suites: pingpong, fanout, fanin, promise, timer, insert\n";
+}
+
+};  // End of anonymous namespace. ---------------------------------------------------------------
+
+int main(int argc, char* argv[]) {
+
+  Config cfg;
+
+  for(int opt; (opt = ::getopt(argc, argv, "o:t:s:d:n:h")) != -1; ) {
+    switch(opt) {
+      case 'o':
+        cfg.output = optarg;
+      break;
+
+      case 't':
+        cfg.workers.clear();
+        for(const auto& t : split(optarg)) {
+          cfg.workers.push_back(std::stoul(t));
+        }
+      break;
+
+      case 's':
+        cfg.suites = split(optarg);
+      break;
+
+      case 'd':
+        if(::strcmp(optarg, "select") == 0) cfg.demux = dtc::DemuxType::SELECT;
+        else if(::strcmp(optarg, "epoll") == 0) cfg.demux = dtc::DemuxType::EPOLL;
+        else if(::strcmp(optarg, "uring") == 0) cfg.demux = dtc::DemuxType::URING;
+        else {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+      break;
+
+      case 'n':
+        cfg.scale = std::stod(optarg);
+      break;
+
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      break;
+    }
+  }
+
+  const std::unordered_map<std::string, std::function<dtc::json(const Config&, unsigned)>> suites {
+    {"pingpong", pingpong},
+    {"fanout", [] (const Config& c, unsigned w) { return streams(c, w, 1, 8); }},
+    {"fanin", [] (const Config& c, unsigned w) { return streams(c, w, 8, 1); }},
+    {"promise", promise},
+    {"timer", timer},
+    {"insert", insert}
+  };
+
+  dtc::json results = dtc::json::array();
+
+  for(const auto& s : cfg.suites) {
+
+    auto itr = suites.find(s);
+
+    if(itr == suites.end()) {
+      std::cerr << "Unknown suite " << s << '\n';
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+
+    for(auto w : cfg.workers) {
+      std::cerr << "Running " << s << " with " << w << " workers ...\n";
+      auto r = itr->second(cfg, w);
+      r["suite"] = s;
+      r["num_workers"] = w;
+      results.push_back(std::move(r));
+    }
+  }
+
+  dtc::json report {
+    {"benchmark", "reactor"},
+    {"version", PACKAGE_VERSION},
+    {"date", now()},
+    {"host", host()},
+    {"demux", to_string(dtc::Reactor(0, cfg.demux).demux_type())},
+    {"scale", cfg.scale},
+    {"environment", environment()},
+    {"results", std::move(results)}
+  };
+
+  if(cfg.output.empty()) {
+    std::cout << report.dump(2) << '\n';
+  }
+  else {
+    std::ofstream ofs(cfg.output);
+    ofs << report.dump(2) << '\n';
+  }
+
+  return 0;
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright (c) 2018, Tsung-Wei Huang and Martin D. F. Wong,                 *
+ * University of Illinois at Urbana-Champaign (UIUC), IL, USA.                *
+ *                                                                            *
+ * All Rights Reserved.                                                       *
+ *                                                                            *
+ * This program is free software. You can redistribute and/or modify          *
+ * it in accordance with the terms of the accompanying license agreement.     *
+ * See LICENSE in the top-level directory for details.                        *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef DTC_BENCHMARK_REPORT_HPP_
+#define DTC_BENCHMARK_REPORT_HPP_
+
+// Helpers shared by the benchmark programs to fill the common fields of their json reports.
+
+#include <dtc/dtc.hpp>
+
+extern char** environ;
+
+namespace benchmark {
+
+// Function: seconds
+template <typename D>
+double seconds(D&& d) {
+  return std::chrono::duration<double>(d).count();
+}
+
+// Function: environment
+// The DTC_* variables in effect.
+inline dtc::json environment() {
+  dtc::json env = dtc::json::object();
+  for(auto e = environ; e && *e; ++e) {
+    std::string_view kv(*e);
+    if(kv.compare(0, 4, "DTC_") == 0) {
+      auto eq = kv.find('=');
+      env[std::string(kv.substr(0, eq))] = eq == kv.npos ? "" : std::string(kv.substr(eq+1));
+    }
+  }
+  return env;
+}
+
+// Function: host
+inline dtc::json host() {
+
+  utsname u;
+  ::uname(&u);
+
+  return {
+    {"name", std::string(u.nodename)},
+    {"kernel", std::string(u.release)},
+    {"machine", std::string(u.machine)},
+    {"num_cpus", std::thread::hardware_concurrency()}
+  };
+}
+
+// Function: now
+inline std::string now() {
+  auto t = std::time(nullptr);
+  char buf[32];
+  std::strftime(buf, sizeof(buf), "%FT%TZ", std::gmtime(&t));
+  return buf;
+}
+
+};  // End of namespace benchmark. ----------------------------------------------------------------
+
+#endif
@@ -0,0 +1,238 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright (c) 2018, Tsung-Wei Huang and Martin D. F. Wong,                 *
+ * University of Illinois at Urbana-Champaign (UIUC), IL, USA.                *
+ *                                                                            *
+ * All Rights Reserved.                                                       *
+ *                                                                            *
+ * This program is free software. You can redistribute and/or modify          *
+ * it in accordance with the terms of the accompanying license agreement.     *
+ * See LICENSE in the top-level directory for details.                        *
+ *                                                                            *
+ ******************************************************************************/
+
+// Program: benchmark/streambuf
+//
+// Throughput of the stream buffers for messages of 1 KB to 64 MB. Every message is packed
+// with BinaryOutputPackager, moved, and unpacked with BinaryInputPackager. The report is a
+// json document in the format of benchmark/reactor.
+//
+// Usage: streambuf [-o file] [-d device] [-n scale]
+//
+//   -o file    write the json report to the file (default: stdout)
+//   -d device  socket or pipe (default: socket)
+//   -n scale   scale factor of the bytes moved per message size (default: 1.0)
+//
+// Suites (each runs once per message size):
+//
+//   memory     pack into an OutputStreamBuffer, hand the blocks to an InputStreamBuffer, unpack
+//   wire       pack and sync on one thread, sync and unpack on another, over the device
+//
+
+#include "report.hpp"
+
+namespace {
+
+using namespace benchmark;
+
+using clock_type = std::chrono::steady_clock;
+
+// Struct: Config
+struct Config {
+
+  std::string output;
+  std::string device {"socket"};
+  double scale {1.0};
+
+  // Number of messages of the given size to move.
+  size_t num_msgs(size_t msg_size) const {
+    constexpr size_t volume = size_t{256} << 20;
+    return std::max<size_t>(4, static_cast<size_t>(volume * scale) / msg_size);
+  }
+};
+
+// Function: max_rss
+// Peak resident set size of the process in KB.
+long max_rss() {
+  rusage u;
+  ::getrusage(RUSAGE_SELF, &u);
+  return u.ru_maxrss;
+}
+
+// Function: report
+dtc::json report(size_t msg_size, size_t num_msgs, double elapsed, const dtc::Histogram& latency) {
+  return {
+    {"msg_size", msg_size},
+    {"num_msgs", num_msgs},
+    {"elapsed_s", elapsed},
+    {"msgs_per_s", num_msgs / elapsed},
+    {"mb_per_s", msg_size * num_msgs / elapsed / (1 << 20)},
+    {"latency", latency.to_json()},
+    {"max_rss_kb", max_rss()},
+    {"num_free_blocks", dtc::StreamBlockPool::get().num_free()}
+  };
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Function: memory
+// Pack and unpack without a device. The latency is the round trip of one message.
+dtc::json memory(const Config& cfg, size_t msg_size) {
+
+  const auto N = cfg.num_msgs(msg_size);
+  const auto payload = std::string(msg_size, 'x');
+
+  dtc::Histogram latency;
+  std::string msg;
+
+  auto beg = clock_type::now();
+
+  for(size_t i=0; i<N; ++i) {
+    auto t = clock_type::now();
+    dtc::OutputStreamBuffer osbuf;
+    dtc::BinaryOutputPackager{osbuf}(payload);
+    dtc::InputStreamBuffer isbuf(std::move(osbuf));
+    if(dtc::BinaryInputPackager(isbuf)(msg) == -1 || msg.size() != msg_size) {
+      throw std::runtime_error("memory: message corrupted");
+    }
+    latency.insert(clock_type::now() - t);
+  }
+
+  return report(msg_size, N, seconds(clock_type::now() - beg), latency);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Function: wire
+// One thread packs and flushes messages into a blocking device; the other syncs and unpacks
+// them. The latency is taken from the start of the pack to the end of the unpack.
+dtc::json wire(const Config& cfg, size_t msg_size) {
+
+  const auto N = cfg.num_msgs(msg_size);
+  const auto payload = std::string(msg_size, 'x');
+
+  std::shared_ptr<dtc::Device> rend, wend;
+
+  if(cfg.device == "pipe") {
+    std::tie(rend, wend) = dtc::make_pipe();
+  }
+  else {
+    std::tie(rend, wend) = dtc::make_socket_pair();
+  }
+
+  rend->blocking(true);
+  wend->blocking(true);
+
+  std::vector<std::atomic<clock_type::rep>> sent(N);
+
+  auto beg = clock_type::now();
+
+  std::thread producer([&] () {
+    dtc::OutputStreamBuffer osbuf(wend.get());
+    for(size_t i=0; i<N; ++i) {
+      sent[i].store(clock_type::now().time_since_epoch().count(), std::memory_order_relaxed);
+      dtc::BinaryOutputPackager{osbuf}(payload);
+      osbuf.flush();
+    }
+  });
+
+  dtc::Histogram latency;
+  dtc::InputStreamBuffer isbuf(rend.get());
+  std::string msg;
+
+  for(size_t i=0; i<N; ++i) {
+    while(dtc::BinaryInputPackager(isbuf) == false) {
+      isbuf.sync();
+    }
+    if(dtc::BinaryInputPackager(isbuf)(msg) == -1 || msg.size() != msg_size) {
+      throw std::runtime_error("wire: message corrupted");
+    }
+    auto t = clock_type::duration(sent[i].load(std::memory_order_relaxed));
+    latency.insert(clock_type::now() - clock_type::time_point(t));
+  }
+
+  auto elapsed = seconds(clock_type::now() - beg);
+
+  producer.join();
+
+  auto r = report(msg_size, N, elapsed, latency);
+  r["device"] = cfg.device;
+  return r;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Function: usage
+void usage(const char* prog) {
+  std::cerr << "Usage: " << prog << " [-o file] [-d device] [-n scale]\n"
+            << "devices: socket, pipe\n";
+}
+
+};  // End of anonymous namespace. ---------------------------------------------------------------
+
+int main(int argc, char* argv[]) {
+
+  Config cfg;
+
+  for(int opt; (opt = ::getopt(argc, argv, "o:d:n:h")) != -1; ) {
+    switch(opt) {
+      case 'o':
+        cfg.output = optarg;
+      break;
+
+      case 'd':
+        if(::strcmp(optarg, "socket") != 0 && ::strcmp(optarg, "pipe") != 0) {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        cfg.device = optarg;
+      break;
+
+      case 'n':
+        cfg.scale = std::stod(optarg);
+      break;
+
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+      break;
+    }
+  }
+
+  const std::vector<std::pair<std::string, std::function<dtc::json(const Config&, size_t)>>> suites {
+    {"memory", memory},
+    {"wire", wire}
+  };
+
+  dtc::json results = dtc::json::array();
+
+  for(const auto& [s, suite] : suites) {
+    for(size_t msg_size = 1 << 10; msg_size <= (64 << 20); msg_size <<= 2) {
+      std::cerr << "Running " << s << " with " << msg_size << "-byte messages ...\n";
+      auto r = suite(cfg, msg_size);
+      r["suite"] = s;
+      results.push_back(std::move(r));
+    }
+  }
+
+  dtc::json report {
+    {"benchmark", "streambuf"},
+    {"version", PACKAGE_VERSION},
+    {"date", now()},
+    {"host", host()},
+    {"block_size", dtc::StreamBlockPool::BLOCK_CAPACITY},
+    {"scale", cfg.scale},
+    {"environment", environment()},
+    {"results", std::move(results)}
+  };
+
+  if(cfg.output.empty()) {
+    std::cout << report.dump(2) << '\n';
+  }
+  else {
+    std::ofstream ofs(cfg.output);
+    ofs << report.dump(2) << '\n';
+  }
+
+  return 0;
+}
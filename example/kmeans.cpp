@@ -70,18 +70,8 @@ struct Result{
  std::vector<Point> cts;        // k centers
  std::vector<Point> next_cts;   // slave-private center storage (k*num_slaves)
  std::vector<size_t> mapping;   // num points mapped to a center.
- std::atomic<size_t> count {0};
+ size_t count {0};              // the master vertex runs on a strand (no locking needed)
  State state;
-
-  Result() = default;
-
-  Result(const Result& r) : 
-    cts {r.cts},
-    next_cts {r.next_cts},
-    mapping {r.mapping},
-    count {r.count.load()},
-    state {r.state} {
-  }
 };
 
 // Function: find_nearest
@@ -111,7 +101,8 @@ int main(int argc, char* argv[]) {
   dtc::Graph G;
 
 
-  auto A = G.vertex();
+  // All callbacks of the master vertex A run serially on its strand.
+  auto A = G.vertex().strand();
   // Cannot use array here, becuz B[i] = G.vertex() is deleted
   std::vector<dtc::VertexBuilder> B;
   std::vector<dtc::StreamBuilder> AtoB; 
@@ -55,7 +55,7 @@ inline BinaryOutputArchiver::BinaryOutputArchiver(OutputStreamBuffer& ostream) :
 // Operator: main archiver function
 template <typename... T>
 std::streamsize BinaryOutputArchiver::operator()(T&&... t) {
-  std::scoped_lock lock(_osbuf._mutex);
+  OutputStreamBuffer::WriteLock lock(_osbuf);
   return (_archive(std::forward<T>(t)) + ... );
 }
     
@@ -477,10 +477,10 @@ inline BinaryOutputPackager::BinaryOutputPackager(OutputStreamBuffer& os) : ar(o
 template <typename... T>
 std::streamsize BinaryOutputPackager::operator()(T&&... items) {
   std::streamsize sz;
-  std::scoped_lock lock(ar._osbuf._mutex);
+  OutputStreamBuffer::WriteLock lock(ar._osbuf);
   sz = ar(sz, std::forward<T>(items)...);
   if(sz != -1) {
-    *reinterpret_cast<std::streamsize*>(ar._osbuf._pptr - sz) = sz;
+    ar._osbuf._rewrite(sz, &sz, sizeof(sz));
   }
   return sz;
 }
@@ -505,8 +505,9 @@ class BinaryInputPackager {
     operator bool () const {
       std::scoped_lock lock(ar._isbuf._mutex);
       std::streamsize sz = ar._isbuf._in_avail();
+      std::streamsize header;
       return (sz >= static_cast<std::streamsize>(sizeof(std::streamsize)) && 
-              sz >= *reinterpret_cast<std::streamsize*>(ar._isbuf._gptr));
+              ar._isbuf._copy(&header, sizeof(header)) && sz >= header);
     }
 };
 
@@ -518,8 +519,9 @@ template <typename... T>
 std::streamsize BinaryInputPackager::operator()(T&&... items) {
   std::scoped_lock lock(ar._isbuf._mutex);
   std::streamsize sz = ar._isbuf._in_avail();
+  std::streamsize header;
   if(sz >= static_cast<std::streamsize>(sizeof(std::streamsize)) && 
-     sz >= *reinterpret_cast<std::streamsize*>(ar._isbuf._gptr)) {
+     ar._isbuf._copy(&header, sizeof(header)) && sz >= header) {
     return ar(sz, std::forward<T>(items)...);
   }
   return -1;
@@ -0,0 +1,171 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright (c) 2018, Tsung-Wei Huang and Martin D. F. Wong,                 *
+ * University of Illinois at Urbana-Champaign (UIUC), IL, USA.                *
+ *                                                                            *
+ * All Rights Reserved.                                                       *
+ *                                                                            *
+ * This program is free software. You can redistribute and/or modify          *
+ * it in accordance with the terms of the accompanying license agreement.     *
+ * See LICENSE in the top-level directory for details.                        *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef DTC_CONCURRENT_TASK_HPP_
+#define DTC_CONCURRENT_TASK_HPP_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace dtc {
+
+// Class: Task
+//
+// Move-only type-erased callable with no argument and no return value. Callables of up to
+// CAPACITY bytes that are nothrow movable are stored inline; larger ones are kept on the heap.
+// Unlike std::function, a task does not require the callable to be copyable, so closures that
+// capture a promise or a unique_ptr need no wrapper, and closures capturing a few pointers do
+// not allocate.
+//
+class Task {
+
+  public:
+
+    static constexpr size_t CAPACITY {64};
+
+    Task() = default;
+
+    template <typename C, typename = std::enable_if_t<!std::is_same_v<std::decay_t<C>, Task>>>
+    Task(C&&);
+
+    inline Task(Task&&) noexcept;
+
+    Task(const Task&) = delete;
+
+    inline ~Task();
+
+    inline Task& operator = (Task&&) noexcept;
+
+    Task& operator = (const Task&) = delete;
+
+    inline void operator()();
+
+    inline explicit operator bool() const;
+
+    inline bool is_inline() const;
+
+    inline void reset();
+
+    template <typename C>
+    inline static constexpr bool fits_inline =
+      sizeof(C) <= CAPACITY &&
+      alignof(C) <= alignof(std::max_align_t) &&
+      std::is_nothrow_move_constructible_v<C>;
+
+  private:
+
+    struct VTable {
+      void (*invoke)(void*);
+      void (*move)(void*, void*);     // move-construct the callable at the source into the target
+      void (*destroy)(void*);
+      bool is_inline;
+    };
+
+    template <typename C>
+    inline static constexpr VTable _inline_vtable {
+      [] (void* s) { (*static_cast<C*>(s))(); },
+      [] (void* t, void* s) {
+        ::new (t) C(std::move(*static_cast<C*>(s)));
+        static_cast<C*>(s)->~C();
+      },
+      [] (void* s) { static_cast<C*>(s)->~C(); },
+      true
+    };
+
+    template <typename C>
+    inline static constexpr VTable _heap_vtable {
+      [] (void* s) { (**static_cast<C**>(s))(); },
+      [] (void* t, void* s) { *static_cast<C**>(t) = *static_cast<C**>(s); },
+      [] (void* s) { delete *static_cast<C**>(s); },
+      false
+    };
+
+    alignas(std::max_align_t) unsigned char _storage[CAPACITY];
+
+    const VTable* _vtable {nullptr};
+};
+
+// Constructor
+template <typename C, typename>
+Task::Task(C&& c) {
+
+  using T = std::decay_t<C>;
+
+  if constexpr(fits_inline<T>) {
+    ::new (static_cast<void*>(_storage)) T(std::forward<C>(c));
+    _vtable = &_inline_vtable<T>;
+  }
+  else {
+    *reinterpret_cast<T**>(_storage) = new T(std::forward<C>(c));
+    _vtable = &_heap_vtable<T>;
+  }
+}
+
+// Move constructor
+inline Task::Task(Task&& rhs) noexcept : _vtable {rhs._vtable} {
+  if(_vtable) {
+    _vtable->move(_storage, rhs._storage);
+    rhs._vtable = nullptr;
+  }
+}
+
+// Destructor
+inline Task::~Task() {
+  reset();
+}
+
+// Move assignment
+inline Task& Task::operator = (Task&& rhs) noexcept {
+  if(this != &rhs) {
+    reset();
+    if(rhs._vtable) {
+      rhs._vtable->move(_storage, rhs._storage);
+      _vtable = rhs._vtable;
+      rhs._vtable = nullptr;
+    }
+  }
+  return *this;
+}
+
+// Operator: ()
+inline void Task::operator()() {
+  _vtable->invoke(_storage);
+}
+
+// Operator: bool
+inline Task::operator bool() const {
+  return _vtable != nullptr;
+}
+
+// Function: is_inline
+// Return true if the callable is stored inline (an empty task is not).
+inline bool Task::is_inline() const {
+  return _vtable && _vtable->is_inline;
+}
+
+// Procedure: reset
+// Destroy the callable and leave the task empty.
+inline void Task::reset() {
+  if(_vtable) {
+    auto vtable = _vtable;
+    _vtable = nullptr;
+    vtable->destroy(_storage);
+  }
+}
+
+};  // End of namespace dtc. ----------------------------------------------------------------------
+
+#endif
+
@@ -23,27 +23,101 @@
 #include <thread>
 #include <future>
 #include <functional>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <dtc/concurrent/mutex.hpp>
+#include <dtc/concurrent/work_stealing_queue.hpp>
+#include <dtc/concurrent/task.hpp>
 
 namespace dtc {
 
 // Class: Threadpool
+//
+// Work-stealing thread pool. Every worker owns a lock-free deque (WorkStealingQueue) and an
+// inbox. Tasks submitted by a worker go to the bottom of its own deque and are popped in LIFO
+// order, which keeps nested work hot in cache. Tasks submitted by any other thread (e.g., the
+// reactor) are dealt round-robin to the inboxes. An idle worker drains its own deque, then its
+// inbox, and then steals from the other workers starting at a random victim. Workers that find
+// nothing to do park on a condition variable, which is only touched when some worker is idle.
+//
+// Tasks are submitted to one of two lanes. HIGH tasks (control-plane work such as kill or 
+// topology messages) sit in a shared queue that every worker checks before its own work, so
+// they never wait behind a backlog of LOW (data-plane) tasks. To keep the LOW lane from 
+// starving, a worker that has run "burst" HIGH tasks in a row takes a LOW task first.
+//
+// A worker running out of tasks spins for a while before it parks, so a task arriving shortly
+// after does not pay for a futex wake and a context switch. The spin budget of each worker 
+// adapts between MIN_SPINS and the configured maximum: it doubles when spinning finds a task
+// and halves when it does not.
+//
+// Workers can be pinned to a set of CPUs, one CPU per worker in a round-robin fashion that 
+// continues across the pools of the process. A pinned worker allocates its own deque and inbox
+// after pinning, so the first touch places them on the NUMA node of its CPU.
+//
 class Threadpool {
 
-  enum class Signal {
-    STANDARD,
-    SHUTDOWN
-  };
+  public:
 
-  template <typename T>
-  struct StrongMovable {
-  
-    StrongMovable(T&& rhs) : object(std::move(rhs)) {}
-    StrongMovable(const StrongMovable& other) : object(std::move(other.object)) {}
+    enum Priority {
+      HIGH = 0,
+      LOW
+    };
 
-    T& get() { return object; }
-    
-    mutable T object; 
-  };
+    // Struct: Job
+    // Fixed-size task of the allocation-free path. The worker calls fn(target, argument).
+    struct Job {
+      void (*fn)(void*, void*);
+      void* target;
+      void* argument;
+    };
+
+    static constexpr size_t DEFAULT_BURST {32};
+    static constexpr size_t MIN_SPINS {16};
+
+  private:
+
+    // Ring buffer of jobs under a spin lock. The buffer only grows, so a steady stream of jobs
+    // allocates nothing.
+    struct Inbox {
+
+      SpinLock lock;
+      std::vector<Job> jobs;
+      size_t head {0};
+      size_t size {0};
+
+      inline void push(const Job&);
+      inline bool pop(Job&);
+    };
+
+    struct alignas(64) Worker {
+
+      Threadpool* pool;
+      size_t id;
+
+      WorkStealingQueue<Job> queue;
+
+      // Jobs submitted by non-worker threads.
+      Inbox inbox;
+
+      // Number of HIGH jobs run in a row.
+      size_t streak {0};
+
+      // Current spin budget before parking.
+      size_t spins {0};
+
+      Worker(Threadpool* p, size_t i) : pool {p}, id {i} {}
+    };
+
+    // Carrier of a closure scheduled by async or silent_async. Nodes are recycled through a 
+    // free list, so scheduling a closure that fits in a Task does not allocate.
+    struct TaskNode {
+      Task task;
+      TaskNode* next {nullptr};
+    };
 
   public:
 
@@ -51,7 +125,12 @@ class Threadpool {
     inline ~Threadpool();
     
     template <typename C>
-    auto async(C&&, const Signal = Signal::STANDARD);
+    auto async(C&&, Priority = LOW);
+
+    template <typename C>
+    void silent_async(C&&, Priority = LOW);
+
+    inline void post(const Job&, Priority = LOW);
     
     inline void shutdown();
     inline void spawn(unsigned);
@@ -60,17 +139,95 @@ class Threadpool {
     inline size_t num_workers() const;
 
     inline bool is_worker() const;
+
+    inline void burst(size_t);
+    inline size_t burst() const;
+
+    inline void spin(size_t);
+    inline size_t spin() const;
+
+    inline void pin(std::vector<int>);
+    inline const std::vector<int>& pin() const;
     
   private:
 
-    mutable std::mutex _mutex;
-
+    std::mutex _mutex;
     std::condition_variable _worker_signal;
-    std::deque<std::function<Signal()>> _task_queue;
+    bool _stop {false};
+    size_t _num_ready {0};
+
+    std::vector<std::unique_ptr<Worker>> _workers;
     std::vector<std::thread> _threads;
-    std::unordered_set<std::thread::id> _worker_ids;
+
+    std::vector<int> _cpus;
+
+    // Next CPU to pin a worker to, shared by all pools.
+    inline static std::atomic<size_t> _cpu_cursor {0};
+
+    std::atomic<size_t> _num_pending {0};
+    std::atomic<size_t> _num_idle {0};
+    std::atomic<size_t> _cursor {0};
+    std::atomic<size_t> _burst {DEFAULT_BURST};
+    std::atomic<size_t> _max_spins {0};
+
+    alignas(64) Inbox _high;
+    std::atomic<size_t> _num_high {0};
+
+    SpinLock _node_lock;
+    TaskNode* _free_nodes {nullptr};
+    std::vector<std::unique_ptr<TaskNode>> _nodes;
+
+    inline static thread_local Worker* _this_worker {nullptr};
+
+    static void _run_task(void*, void*);
+
+    inline TaskNode* _acquire_node();
+    inline void _release_node(TaskNode*);
+
+    inline void _schedule(const Job&, Priority);
+    inline void _run(Worker&);
+    inline bool _take(Worker&, Job&);
+    inline bool _take_low(Worker&, Job&);
+    inline bool _take_high(Job&);
+    inline bool _spin(Worker&, Job&);
+
+    inline static void _pin(int);
 };
 
+// Procedure: push
+inline void Threadpool::Inbox::push(const Job& job) {
+
+  std::scoped_lock guard(lock);
+
+  if(size == jobs.size()) {
+    std::vector<Job> buffer(std::max(size_t{64}, jobs.size() << 1));
+    for(size_t i=0; i<size; ++i) {
+      buffer[i] = jobs[(head + i) % jobs.size()];
+    }
+    jobs = std::move(buffer);
+    head = 0;
+  }
+
+  jobs[(head + size) % jobs.size()] = job;
+  ++size;
+}
+
+// Function: pop
+inline bool Threadpool::Inbox::pop(Job& job) {
+
+  std::scoped_lock guard(lock);
+
+  if(size == 0) {
+    return false;
+  }
+
+  job = jobs[head];
+  head = (head + 1) % jobs.size();
+  --size;
+
+  return true;
+}
+
 // Constructor
 inline Threadpool::Threadpool(unsigned N) {
   spawn(N);
@@ -82,81 +239,324 @@ inline Threadpool::~Threadpool() {
 }
 
 // Function: num_tasks
-// Return the number of "unfinished" tasks. Notice that this value is not necessary equal to
-// the size of the task_queue since the task can be popped out from the task queue while 
-// not yet finished.
+// Return the number of tasks that are queued but not yet picked up by a worker.
 inline size_t Threadpool::num_tasks() const {
-  return _task_queue.size();
+  return _num_pending.load(std::memory_order_relaxed);
 }
 
+// Function: num_workers
 inline size_t Threadpool::num_workers() const {
-  return _threads.size();
+  return _workers.size();
 }
 
+// Function: is_worker
 inline bool Threadpool::is_worker() const {
-  std::scoped_lock<std::mutex> lock(_mutex);
-  return _worker_ids.find(std::this_thread::get_id()) != _worker_ids.end();
+  return _this_worker && _this_worker->pool == this;
+}
+
+// Procedure: burst
+// Set the maximum number of HIGH tasks a worker runs in a row while LOW tasks are waiting.
+inline void Threadpool::burst(size_t n) {
+  _burst.store(std::max(size_t{1}, n), std::memory_order_relaxed);
+}
+
+// Function: burst
+inline size_t Threadpool::burst() const {
+  return _burst.load(std::memory_order_relaxed);
+}
+
+// Procedure: spin
+// Set the maximum number of rounds an idle worker spins before parking (0 parks immediately).
+inline void Threadpool::spin(size_t n) {
+  _max_spins.store(n, std::memory_order_relaxed);
+}
+
+// Function: spin
+inline size_t Threadpool::spin() const {
+  return _max_spins.load(std::memory_order_relaxed);
+}
+
+// Procedure: pin
+// Set the CPUs the workers spawned from now on are pinned to (empty to leave them unpinned).
+inline void Threadpool::pin(std::vector<int> cpus) {
+  _cpus = std::move(cpus);
+}
+
+// Function: pin
+inline const std::vector<int>& Threadpool::pin() const {
+  return _cpus;
+}
+
+// Procedure: _pin
+// Pin the calling thread to a CPU. Pinning is best effort; a CPU that has left the cpuset 
+// meanwhile leaves the thread unpinned.
+inline void Threadpool::_pin(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
 }
 
 // Procedure: spawn
-// The procedure spawns "n" threads monitoring the task queue and executing each task. After the
-// task is finished, the thread reacts to the returned signal.
+// The procedure spawns "n" more workers. Since the set of steal victims is fixed while the 
+// workers run, existing workers are drained and stopped first and the whole set is respawned.
 inline void Threadpool::spawn(unsigned N) {
 
   if(is_worker()) {
     throw std::runtime_error("Worker cannot spawn threads");
   }
 
-  
-  for(size_t i=0; i<N; ++i) {
+  if(N == 0) {
+    return;
+  }
 
-    _threads.emplace_back([this] () -> void { 
+  N += _workers.size();
 
-      {  // Acquire lock
-        std::scoped_lock<std::mutex> lock(_mutex);
-        _worker_ids.insert(std::this_thread::get_id());         
-      }
+  shutdown();
 
-      auto stop = bool {false};
-      while(!stop) {
-        decltype(_task_queue)::value_type task;
+  _workers.resize(N);
+  _num_ready = 0;
 
-        { // Acquire lock. --------------------------------------------------------------------------
-          std::unique_lock<std::mutex> lock(_mutex);
-          _worker_signal.wait(lock, [this] () { return _task_queue.size() != 0; });
-          task = std::move(_task_queue.front());
-          _task_queue.pop_front();
-        } // Release lock. --------------------------------------------------------------------------
+  for(size_t i=0; i<N; ++i) {
 
-        // Execute the task and react to the returned signal.
-        switch(task()) {
-          case Signal::SHUTDOWN:
-            stop = true;
-          break;      
+    auto cpu = _cpus.empty() ? -1 : _cpus[_cpu_cursor.fetch_add(1) % _cpus.size()];
 
-          default:
-          break;
-        };
+    _threads.emplace_back([this, i, N, cpu] () {
 
-      } // End of worker loop.
+      if(cpu != -1) {
+        _pin(cpu);
+      }
+
+      auto w = std::make_unique<Worker>(this, i);
+      w->inbox.jobs.resize(64);
 
-      {  // Acquire lock
-        std::scoped_lock<std::mutex> lock(_mutex);
-        _worker_ids.erase(std::this_thread::get_id());         
+      // Run only once the victim set is complete.
+      std::unique_lock lock(_mutex);
+      _workers[i] = std::move(w);
+      if(++_num_ready == N) {
+        _worker_signal.notify_all();
       }
+      else {
+        _worker_signal.wait(lock, [&] () { return _num_ready == N; });
+      }
+      lock.unlock();
 
+      _run(*_workers[i]);
     });
   }
+
+  std::unique_lock lock(_mutex);
+  _worker_signal.wait(lock, [&] () { return _num_ready == N; });
+}
+
+// Procedure: _run
+// The worker loop. A worker exits once the pool is stopped and no task is left.
+inline void Threadpool::_run(Worker& w) {
+
+  _this_worker = &w;
+
+  Job job;
+
+  while(true) {
+
+    if(_take(w, job) || _spin(w, job)) {
+      _num_pending.fetch_sub(1, std::memory_order_relaxed);
+      job.fn(job.target, job.argument);
+      continue;
+    }
+
+    std::unique_lock lock(_mutex);
+    _num_idle.fetch_add(1);
+    _worker_signal.wait(lock, [this] () { return _num_pending.load() != 0 || _stop; });
+    _num_idle.fetch_sub(1);
+
+    if(_stop && _num_pending.load() == 0) {
+      break;
+    }
+  }
+
+  _this_worker = nullptr;
+}
+
+// Function: _spin
+// Spin on the pending count for up to the worker's budget and take a job once one shows up. 
+// The budget doubles if spinning pays off and halves otherwise.
+inline bool Threadpool::_spin(Worker& w, Job& job) {
+
+  const auto max_spins = _max_spins.load(std::memory_order_relaxed);
+
+  if(max_spins == 0) {
+    return false;
+  }
+
+  const auto min_spins = std::min(MIN_SPINS, max_spins);
+
+  w.spins = std::clamp(w.spins, min_spins, max_spins);
+
+  for(size_t i=0; i<w.spins; ++i) {
+    if(_num_pending.load(std::memory_order_relaxed) != 0 && _take(w, job)) {
+      w.spins = std::min(w.spins << 1, max_spins);
+      return true;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+  }
+
+  w.spins = std::max(w.spins >> 1, min_spins);
+
+  return false;
+}
+
+// Function: _take
+// Take a HIGH job first unless the worker has used up its burst, in which case a LOW job goes
+// first. Either way the other lane is the fallback.
+inline bool Threadpool::_take(Worker& w, Job& job) {
+
+  if(w.streak < _burst.load(std::memory_order_relaxed)) {
+    if(_take_high(job)) {
+      ++w.streak;
+      return true;
+    }
+    if(_take_low(w, job)) {
+      w.streak = 0;
+      return true;
+    }
+  }
+  else {
+    if(_take_low(w, job)) {
+      w.streak = 0;
+      return true;
+    }
+    if(_take_high(job)) {
+      return true;
+    }
+    w.streak = 0;
+  }
+
+  return false;
+}
+
+// Function: _take_high
+inline bool Threadpool::_take_high(Job& job) {
+
+  if(_num_high.load() == 0 || !_high.pop(job)) {
+    return false;
+  }
+
+  _num_high.fetch_sub(1, std::memory_order_relaxed);
+
+  return true;
+}
+
+// Function: _take_low
+// Take a LOW job from the worker's deque, its inbox, or another worker starting at a random 
+// victim.
+inline bool Threadpool::_take_low(Worker& w, Job& job) {
+
+  if(auto j = w.queue.pop(); j) {
+    job = *j;
+    return true;
+  }
+
+  if(w.inbox.pop(job)) {
+    return true;
+  }
+
+  thread_local uint64_t seed = std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+
+  // Xorshift.
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+
+  const auto N = _workers.size();
+
+  for(size_t i=0, v=seed%N; i<N; ++i, v=(v+1)%N) {
+
+    if(v == w.id) continue;
+
+    auto& victim = *_workers[v];
+
+    if(auto j = victim.queue.steal(); j) {
+      job = *j;
+      return true;
+    }
+
+    if(victim.inbox.pop(job)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Procedure: _schedule
+// Place a HIGH job on the shared lane. Place a LOW job on the calling worker's deque or, from 
+// any other thread, on the inbox of the next worker in a round-robin fashion. An idle worker
+// is woken up if there is one.
+inline void Threadpool::_schedule(const Job& job, Priority priority) {
+
+  // The pending count is raised first so a parking worker never misses the job.
+  _num_pending.fetch_add(1);
+
+  if(priority == HIGH) {
+    _high.push(job);
+    _num_high.fetch_add(1);
+  }
+  else if(is_worker()) {
+    _this_worker->queue.push(job);
+  }
+  else {
+    _workers[_cursor.fetch_add(1, std::memory_order_relaxed) % _workers.size()]->inbox.push(job);
+  }
+
+  if(_num_idle.load() != 0) {
+    std::scoped_lock lock(_mutex);
+    _worker_signal.notify_one();
+  }
+}
+
+// Function: _acquire_node
+inline Threadpool::TaskNode* Threadpool::_acquire_node() {
+
+  std::scoped_lock lock(_node_lock);
+
+  if(auto node = _free_nodes; node) {
+    _free_nodes = node->next;
+    return node;
+  }
+
+  return _nodes.emplace_back(std::make_unique<TaskNode>()).get();
+}
+
+// Procedure: _release_node
+// Destroy the closure of the node (outside the lock) and return the node to the free list.
+inline void Threadpool::_release_node(TaskNode* node) {
+
+  node->task.reset();
+
+  std::scoped_lock lock(_node_lock);
+  node->next = _free_nodes;
+  _free_nodes = node;
+}
+
+// Procedure: _run_task
+// The job executed by the worker thread for a closure scheduled by async or silent_async.
+inline void Threadpool::_run_task(void* threadpool, void* node) {
+  auto n = static_cast<TaskNode*>(node);
+  n->task();
+  static_cast<Threadpool*>(threadpool)->_release_node(n);
 }
 
 // Function: async
-// Insert a callable task to the end of the queue. The input must be a callable object. A normal
-// callable object the task is associated with STANDARD task signal. Sicne each task stored in the 
-// task queue must be copy-constructible and copy-assignable, the input callable object is wrapped
-// into a strong movable object which replaces the copy constructor with move constructor.
-// Notice that the procedure is concurrent-safe.
+// Schedule a callable task and return the future of its result. The task is stored in a 
+// recycled node that travels through the deques as a Job; the only allocation left is the 
+// shared state of the promise. Notice that the procedure is concurrent-safe.
 template<typename C>
-auto Threadpool::async(C&& c, const Signal sig) {
+auto Threadpool::async(C&& c, Priority priority) {
 
   using R = std::result_of_t<C()>;
   
@@ -164,7 +564,7 @@ auto Threadpool::async(C&& c, const Signal sig) {
   auto fu = p.get_future();
   
   // No worker, do this immediately.
-  if(_threads.empty()) {
+  if(_workers.empty()) {
     if constexpr(std::is_same_v<void, R>) {
       c();
       p.set_value();
@@ -175,61 +575,91 @@ auto Threadpool::async(C&& c, const Signal sig) {
   }
   // Schedule a thread to do this.
   else {
-    {
-      std::unique_lock lock(_mutex);
-      _task_queue.emplace_back(
-        [p=StrongMovable(std::move(p)), c=std::forward<C>(c), ret=sig] () mutable { 
-          if constexpr(std::is_same_v<void, R>) {
-            c();
-            p.get().set_value();
-          }
-          else {
-            p.get().set_value(c());
-          }
-          return ret;
-        }
-      );
-    }
-    _worker_signal.notify_one();
+    silent_async([p=std::move(p), c=std::forward<C>(c)] () mutable { 
+      if constexpr(std::is_same_v<void, R>) {
+        c();
+        p.set_value();
+      }
+      else {
+        p.set_value(c());
+      }
+    }, priority);
   }
+
   return fu;
+}
+
+// Procedure: silent_async
+// Schedule a callable task without a future (fire-and-forget). No promise is created and a 
+// callable that fits in a Task is stored inline, so the steady-state path does not allocate.
+template <typename C>
+void Threadpool::silent_async(C&& c, Priority priority) {
+
+  // No worker, do this immediately.
+  if(_workers.empty()) {
+    c();
+    return;
+  }
+
+  auto node = _acquire_node();
+  node->task = Task(std::forward<C>(c));
+  _schedule({&Threadpool::_run_task, this, node}, priority);
+}
 
-  //-----------------------------------------------------------------------------------------------
-  // Using packaged_task to propagate the exception automatically.
-
-  //std::packaged_task<R()> task (std::forward<C>(c));
-  //auto fu = task.get_future();
-  //{
-  //  std::unique_lock<std::mutex> lock(_mutex);
-  //  _task_queue.emplace_back(
-  //    [sm=StrongMovable<decltype(task)>(std::move(task)), ret=sig] () { 
-  //      sm.object();
-  //      return ret;
-  //    }
-  //  );
-  //  ++_num_tasks;
-  //}
-  //_worker_signal.notify_one();
-  //return fu;
+// Procedure: post
+// Schedule a job. Unlike async, the job carries no future and is not wrapped in a closure, so
+// posting a job does not allocate unless a deque or an inbox has to grow.
+inline void Threadpool::post(const Job& job, Priority priority) {
+
+  // No worker, do this immediately.
+  if(_workers.empty()) {
+    job.fn(job.target, job.argument);
+    return;
+  }
+
+  _schedule(job, priority);
 }
 
 // Procedure: shutdown
-// Remove a given number of workers. Notice that only the master can call this procedure.
+// Stop all workers after the queued tasks are done. Notice that only the master can call this 
+// procedure.
 inline void Threadpool::shutdown() {
   
   if(is_worker()) {
     throw std::runtime_error("Worker cannot shut down thread pool");
   }
 
-  for(size_t i=0; i<_threads.size(); ++i) {
-    async([](){}, Signal::SHUTDOWN);
+  if(_workers.empty()) {
+    return;
+  }
+
+  {
+    std::scoped_lock lock(_mutex);
+    _stop = true;
   }
+  _worker_signal.notify_all();
   
   for(auto& t : _threads) {
     t.join();
   }
 
+  // Jobs submitted by other threads after the workers had left are run here.
+  for(Job job; _num_pending.load() != 0; ) {
+    while(_take_high(job)) {
+      _num_pending.fetch_sub(1);
+      job.fn(job.target, job.argument);
+    }
+    for(auto& w : _workers) {
+      while(w->inbox.pop(job)) {
+        _num_pending.fetch_sub(1);
+        job.fn(job.target, job.argument);
+      }
+    }
+  }
+
+  _workers.clear();
   _threads.clear();
+  _stop = false;
 }
 
 };  // End of namespace dtc. ----------------------------------------------------------------------
@@ -0,0 +1,213 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright (c) 2018, Tsung-Wei Huang and Martin D. F. Wong,                 *
+ * University of Illinois at Urbana-Champaign (UIUC), IL, USA.                *
+ *                                                                            *
+ * All Rights Reserved.                                                       *
+ *                                                                            *
+ * This program is free software. You can redistribute and/or modify          *
+ * it in accordance with the terms of the accompanying license agreement.     *
+ * See LICENSE in the top-level directory for details.                        *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef DTC_CONCURRENT_WORK_STEALING_QUEUE_HPP_
+#define DTC_CONCURRENT_WORK_STEALING_QUEUE_HPP_
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+namespace dtc {
+
+// Class: WorkStealingQueue
+//
+// Lock-free work-stealing deque of Chase and Lev ("Dynamic Circular Work-Stealing Deque",
+// SPAA'05) with the memory orders of Le et al. (PPoPP'13). The owner thread pushes and pops
+// items at the bottom; any other thread steals items from the top. The buffer grows when full
+// and never shrinks, so a queue in steady state does not allocate.
+//
+// Items must be trivially copyable. They are stored as relaxed atomic words so that a thief
+// reading a slot the owner is overwriting never acts on the torn value: the subsequent CAS on
+// the top index fails and the value is discarded.
+//
+template <typename T>
+class WorkStealingQueue {
+
+  static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(uint64_t) == 0);
+
+  static constexpr size_t NUM_WORDS = sizeof(T) / sizeof(uint64_t);
+
+  struct Array {
+
+    int64_t C;
+    int64_t M;
+    std::unique_ptr<std::atomic<uint64_t>[]> S;
+
+    explicit Array(int64_t c) : C {c}, M {c-1}, S {new std::atomic<uint64_t>[c*NUM_WORDS]} {
+    }
+
+    void put(int64_t i, const T& o) {
+      uint64_t w[NUM_WORDS];
+      std::memcpy(w, &o, sizeof(T));
+      auto s = &S[(i & M) * NUM_WORDS];
+      for(size_t k=0; k<NUM_WORDS; ++k) {
+        s[k].store(w[k], std::memory_order_relaxed);
+      }
+    }
+
+    T get(int64_t i) const {
+      uint64_t w[NUM_WORDS];
+      auto s = &S[(i & M) * NUM_WORDS];
+      for(size_t k=0; k<NUM_WORDS; ++k) {
+        w[k] = s[k].load(std::memory_order_relaxed);
+      }
+      T o;
+      std::memcpy(&o, w, sizeof(T));
+      return o;
+    }
+
+    Array* resize(int64_t b, int64_t t) const {
+      auto a = new Array(2*C);
+      for(auto i=t; i!=b; ++i) {
+        a->put(i, get(i));
+      }
+      return a;
+    }
+  };
+
+  public:
+
+    explicit WorkStealingQueue(int64_t = 256);
+
+    WorkStealingQueue(const WorkStealingQueue&) = delete;
+    WorkStealingQueue& operator = (const WorkStealingQueue&) = delete;
+
+    inline bool empty() const;
+    inline size_t size() const;
+    inline size_t capacity() const;
+
+    inline void push(const T&);
+
+    inline std::optional<T> pop();
+    inline std::optional<T> steal();
+
+  private:
+
+    alignas(64) std::atomic<int64_t> _top {0};
+    alignas(64) std::atomic<int64_t> _bottom {0};
+    std::atomic<Array*> _array;
+
+    // Arrays replaced by a resize. Thieves may still be reading them, so they are kept until
+    // the queue is destroyed.
+    std::vector<std::unique_ptr<Array>> _garbage;
+};
+
+// Constructor
+template <typename T>
+WorkStealingQueue<T>::WorkStealingQueue(int64_t c) {
+  assert(c > 0 && (c & (c-1)) == 0);
+  _garbage.emplace_back(new Array(c));
+  _array.store(_garbage.back().get(), std::memory_order_relaxed);
+}
+
+// Function: empty
+template <typename T>
+inline bool WorkStealingQueue<T>::empty() const {
+  auto b = _bottom.load(std::memory_order_relaxed);
+  auto t = _top.load(std::memory_order_relaxed);
+  return b <= t;
+}
+
+// Function: size
+template <typename T>
+inline size_t WorkStealingQueue<T>::size() const {
+  auto b = _bottom.load(std::memory_order_relaxed);
+  auto t = _top.load(std::memory_order_relaxed);
+  return static_cast<size_t>(b >= t ? b - t : 0);
+}
+
+// Function: capacity
+template <typename T>
+inline size_t WorkStealingQueue<T>::capacity() const {
+  return static_cast<size_t>(_array.load(std::memory_order_relaxed)->C);
+}
+
+// Procedure: push
+// Push an item at the bottom. Only the owner thread may call this.
+template <typename T>
+inline void WorkStealingQueue<T>::push(const T& o) {
+
+  auto b = _bottom.load(std::memory_order_relaxed);
+  auto t = _top.load(std::memory_order_acquire);
+  auto a = _array.load(std::memory_order_relaxed);
+
+  if(b - t > a->C - 1) {
+    a = a->resize(b, t);
+    _garbage.emplace_back(a);
+    _array.store(a, std::memory_order_relaxed);
+  }
+
+  a->put(b, o);
+  std::atomic_thread_fence(std::memory_order_release);
+  _bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+// Function: pop
+// Pop an item from the bottom. Only the owner thread may call this.
+template <typename T>
+inline std::optional<T> WorkStealingQueue<T>::pop() {
+
+  auto b = _bottom.load(std::memory_order_relaxed) - 1;
+  auto a = _array.load(std::memory_order_relaxed);
+  _bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto t = _top.load(std::memory_order_relaxed);
+
+  std::optional<T> item;
+
+  if(t <= b) {
+    item = a->get(b);
+    // The last item; race against the thieves.
+    if(t == b) {
+      if(!_top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        item = std::nullopt;
+      }
+      _bottom.store(b + 1, std::memory_order_relaxed);
+    }
+  }
+  else {
+    _bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  return item;
+}
+
+// Function: steal
+// Steal an item from the top. Any thread may call this.
+template <typename T>
+inline std::optional<T> WorkStealingQueue<T>::steal() {
+
+  auto t = _top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto b = _bottom.load(std::memory_order_acquire);
+
+  if(t < b) {
+    auto a = _array.load(std::memory_order_acquire);
+    auto item = a->get(t);
+    if(_top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return item;
+    }
+  }
+
+  return std::nullopt;
+}
+
+};  // End of namespace dtc. ----------------------------------------------------------------------
+
+#endif
+
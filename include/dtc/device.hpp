@@ -20,16 +20,55 @@
 
 namespace dtc {
 
+// Class: ReadAhead
+// The bytes of a stream socket received by the io_uring demux ahead of the reader (see Uring).
+// While a receive is armed the kernel hands the data of the socket to the demux only, so the
+// reads of the device are served from here. Once the receive ends, the reads drain what is left
+// before going back to the descriptor, and the error that ended it (EPIPE for the end of file)
+// is raised after the data.
+struct ReadAhead {
+
+  std::mutex mutex;
+  std::vector<char> data;
+  size_t head {0};
+  size_t num_bytes {0};           // bytes received ahead so far
+  int error {0};
+  int8_t eligible {-1};           // a stream socket (-1 for unknown)
+  bool armed {false};
+  std::atomic<bool> used {false};
+
+  inline size_t size() const;
+
+  void append(const void*, size_t);
+
+  std::streamsize read(const struct iovec*, int);
+};
+
+// Function: size
+inline size_t ReadAhead::size() const {
+  return data.size() - head;
+}
+
+// ------------------------------------------------------------------------------------------------
+
 // Class: Device
 class Device {
   
   friend class OutputStreamBuffer;
   friend class InputStreamBuffer;
+  friend class Uring;
 
   protected:
 
     int _fd {-1};
 
+  private:
+
+    mutable ReadAhead _ahead;
+
+    std::streamsize _read(void*, std::streamsize) const;
+    std::streamsize _readv(const struct iovec*, int) const;
+
   public:
 
     Device(int);
@@ -40,8 +79,11 @@ class Device {
     virtual std::streamsize purge(void*, std::streamsize) const;
     virtual std::streamsize write(const void*, std::streamsize) const;
     virtual std::streamsize flush(const void*, std::streamsize) const;
+    virtual std::streamsize readv(const struct iovec*, int) const;
+    virtual std::streamsize writev(const struct iovec*, int) const;
     
     inline int fd() const;
+    inline size_t num_read_ahead() const;
     
     Device(const Device&) = delete;
     Device(Device&&) = delete;
@@ -50,7 +92,7 @@ class Device {
     Device& operator = (Device&&) = delete;
 
     Device& blocking(bool);
-    Device& open_on_exec(bool);
+    virtual Device& open_on_exec(bool);
 };
 
 // Function: fd
@@ -58,6 +100,13 @@ inline int Device::fd() const {
   return _fd;
 }
 
+// Function: num_read_ahead
+// Return the number of bytes received ahead of the reader by the io_uring demux.
+inline size_t Device::num_read_ahead() const {
+  std::scoped_lock lock(_ahead.mutex);
+  return _ahead.num_bytes;
+}
+
 // ------------------------------------------------------------------------------------------------
   
 // Class: ScopedOpenOnExec
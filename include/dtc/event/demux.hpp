@@ -13,144 +13,115 @@
 
 // TODO:
 // 1. Enable the randome traversal over the selected file descriptor set.
-// 2. Implement other demuxing mechanisms (epoll, kqueue, etc.).
+// 2. Implement other demuxing mechanisms (kqueue, etc.).
 
 #ifndef DTC_EVENT_DEMUX_HPP_
 #define DTC_EVENT_DEMUX_HPP_
 
 #include <dtc/event/event.hpp>
+#include <dtc/event/select.hpp>
+#include <dtc/event/epoll.hpp>
+#include <dtc/event/uring.hpp>
 
 namespace dtc {
 
-// Class: DemuxIX
-// The gateway class for demultiplexer.
-template <typename DemuxT>
-class DemuxIX {
-  
+// Class: Demux
+// The demultiplexer used by the reactor. The backend (select, epoll, or io_uring) is chosen at 
+// construction and every call is forwarded to it through std::visit. If the kernel cannot run
+// the io_uring backend, the demux falls back to epoll.
+class Demux {
+
   friend class Reactor;
-    
-  protected:
-    
 
-  
   public:
-  
-    // Static polymorphism
-    inline DemuxT* demux();
-    inline const DemuxT* demux() const;
-    
-    // Gateway call.
-    inline void insert(Event*);
-    inline void remove(Event*);
-    inline void freeze(Event*);
-    inline void thaw(Event*);
-
-    template <typename DurationT>
-    inline void poll(DurationT&&);
-
-    // Query
-    inline bool is_valid(const Event*) const;
+
+    Demux(DemuxType = env::demux_type());
+
+    inline DemuxType type() const;
 
   private:
 
-    // Default implementation.
+    std::variant<Select, Epoll, Uring> _backend;
+
     inline void _insert(Event*);
     inline void _remove(Event*);
-    inline void _freeze(Event*);
-    inline void _thaw(Event*);
+    inline void _erase(Event*);
+    inline void _clear();
 
-    template <typename DurationT>
-    inline void _poll(DurationT&&);
+    template <typename D, typename C>
+    void _poll(D&&, C&&);
 };
 
-// Function: demux
-template <typename DemuxT>
-inline DemuxT* DemuxIX<DemuxT>::demux() {
-  return static_cast <DemuxT*> (this);
+// Constructor
+inline Demux::Demux(DemuxType t) {
+  switch(t) {
+    case DemuxType::SELECT:
+      _backend.emplace<Select>();
+    break;
+
+    case DemuxType::EPOLL:
+      _backend.emplace<Epoll>();
+    break;
+
+    case DemuxType::URING:
+      try {
+        _backend.emplace<Uring>();
+      }
+      catch(const std::system_error& e) {
+        LOGW("io_uring unavailable (", e.what(), "); fall back to epoll");
+        _backend.emplace<Epoll>();
+      }
+    break;
+  }
 }
 
-// Function: demux
-template <typename DemuxT>
-inline const DemuxT* DemuxIX<DemuxT>::demux() const {
-  return static_cast <const DemuxT*> (this);
-}
-
-// Function: is_valid
-template <typename DemuxT>
-inline bool DemuxIX<DemuxT>::is_valid(const Event* event) const {
-  if(event == nullptr) return false;
-  if(event->type != Event::READ && event->type != Event::WRITE) return false;
-  if(!is_fd_valid(event->descriptor())) return false;
-  return true;
-}
-
-// Procedure: insert
-template <typename DemuxT>
-inline void DemuxIX<DemuxT>::insert(Event* event) {
-  if(!is_valid(event)) return;
-  demux()->_insert(event);
-}
-
-// Procedure: remove
-template <typename DemuxT>
-inline void DemuxIX<DemuxT>::remove(Event* event) {
-  if(!is_valid(event)) return;
-  demux()->_remove(event);
-}
-
-// Procedure: freeze
-template <typename DemuxT>
-inline void DemuxIX<DemuxT>::freeze(Event* event) {
-  if(!is_valid(event)) return;
-  demux()->_freeze(event);
-}
-
-// Procedure: thaw
-template <typename DemuxT>
-inline void DemuxIX<DemuxT>::thaw(Event* event) {
-  if(!is_valid(event)) return;
-  demux()->_thaw(event);
-}
-
-// Procedure: poll
-template <typename DemuxT>
-template <typename DurationT>
-inline void DemuxIX<DemuxT>::poll(DurationT&& d) {
-  demux()->_poll(std::forward<DurationT>(d));
+// Function: type
+inline DemuxType Demux::type() const {
+  switch(_backend.index()) {
+    case 0:
+      return DemuxType::SELECT;
+    case 1:
+      return DemuxType::EPOLL;
+    default:
+      return DemuxType::URING;
+  }
 }
 
 // Procedure: _insert
-template <typename DemuxT>
-inline void DemuxIX<DemuxT>::_insert(Event* event) {
-  throw std::runtime_error("insert method is not implemented in Demux class");
+inline void Demux::_insert(Event* event) {
+  std::visit([event] (auto& b) { b._insert(event); }, _backend);
 }
 
 // Procedure: _remove
-template <typename DemuxT>
-inline void DemuxIX<DemuxT>::_remove(Event* event) {
-  throw std::runtime_error("remove method is not implemented in Demux class");
+inline void Demux::_remove(Event* event) {
+  std::visit([event] (auto& b) { b._remove(event); }, _backend);
 }
 
-// Procedure: _freeze
-template <typename DemuxT>
-inline void DemuxIX<DemuxT>::_freeze(Event* event) {
-  throw std::runtime_error("freeze method is not implemented in Demux class");
+// Procedure: _erase
+// Remove an event that is leaving the reactor for good. Epoll keeps a kernel registration and
+// io_uring a receive across removals; select treats it as a plain removal.
+inline void Demux::_erase(Event* event) {
+  std::visit([event] (auto& b) { 
+    if constexpr (std::is_same_v<std::decay_t<decltype(b)>, Select>) {
+      b._remove(event);
+    }
+    else {
+      b._erase(event); 
+    }
+  }, _backend);
 }
 
-// Procedure: _thaw
-template <typename DemuxT>
-inline void DemuxIX<DemuxT>::_thaw(Event* event) {
-  throw std::runtime_error("thaw method is not implemented in Demux class");
+// Procedure: _clear
+inline void Demux::_clear() {
+  std::visit([] (auto& b) { b._clear(); }, _backend);
 }
 
 // Procedure: _poll
-template <typename DemuxT>
-template <typename DurationT>
-inline void DemuxIX<DemuxT>::_poll(DurationT&& d) {
-  throw std::runtime_error("poll method is not implemented in Demux class");
+template <typename D, typename C>
+void Demux::_poll(D&& d, C&& on) {
+  std::visit([&] (auto& b) { b._poll(std::forward<D>(d), std::forward<C>(on)); }, _backend);
 }
 
-
 };  // End of namespace dtc. --------------------------------------------------------------
 
 #endif
@@ -16,7 +16,6 @@
 
 #include <dtc/event/event.hpp>
 #include <sys/epoll.h>
-#include <sys/timerfd.h>
 
 namespace dtc {
 
@@ -65,92 +64,107 @@ namespace dtc {
 //    for the caller.  Up to maxevents are returned by epoll_wait().
 //    The maxevents must be greater than zero.
 //
-
-// TODO: refactor
-// 1. move error handling to constructor (timerfd creation, etc.)
-// 2. Check max_fd 
-// 3. Remove should recap?
-
+//  ** Registration policy:
+//
+//  Every file descriptor is registered once with EPOLLONESHOT and stays registered for as 
+//  long as the reactor knows about it. The kernel disarms a oneshot registration after it
+//  reports readiness, which matches the reactor's activation model (an activated event is
+//  taken off the demux until its callback finishes). Re-inserting the event is a single
+//  EPOLL_CTL_MOD on the existing registration instead of a EPOLL_CTL_DEL/EPOLL_CTL_ADD pair.
+//  When the reactor removes the last event of a descriptor for good (_erase), the registration
+//  is deleted with EPOLL_CTL_DEL. The kernel keys a registration on the open file description,
+//  not the number, so a registration left behind would outlive a close() of a descriptor that 
+//  was dup'ed or inherited by a forked child and keep reporting HUP/ERR against the number 
+//  after it has been recycled.
+//
 class Epoll {
 
   friend class Reactor;
+  friend class Demux;
 
-  ~Epoll();
-  Epoll();
+  public:
 
-  int _max_fd {-1};
-  int _epfd {-1};
-  int _timerfd {-1};
+    Epoll();
+    ~Epoll();
 
-  size_t _buf_sz {0};
-  Event** _fd2ev[2] {nullptr, nullptr};
-  epoll_event* _event_buf {nullptr};
-  
-  template <typename D, typename C>
-  void _poll(D&&, C&&);
+  private:
 
-  void _insert(Event*);
-  void _remove(Event*);
-  void _prepare_epoll(struct timeval);
-  void _recap(const int);
-  void _clear();
+    int _max_fd {-1};
+    int _epfd {-1};
 
-
-
-  // In kernels before 2.6.37, a timeout value larger than approximately
-  // LONG_MAX / HZ milliseconds is treated as -1 (i.e., infinity).  Thus,
-  // for example, on a system where sizeof(long) is 4 and the kernel HZ
-  // value is 1000, this means that timeouts greater than 35.79 minutes
-  // are treated as infinity. 
-  const int MAX_EPOLL_TIMEOUT_MSEC {2100000}; // 35*60*1000
+    size_t _buf_sz {0};
+    size_t _num_events {0};
+    Event** _fd2ev[2] {nullptr, nullptr};   // read/write
+    uint32_t* _armed {nullptr};              // interest currently armed in the kernel
+    uint8_t* _registered {nullptr};          // fd has a registration in the kernel
+    epoll_event* _event_buf {nullptr};
+  
+    template <typename D, typename C>
+    void _poll(D&&, C&&);
+
+    void _insert(Event*);
+    void _remove(Event*);
+    void _erase(Event*);
+    void _rearm(const int);
+    void _recap(const int);
+    void _clear();
+
+    int _timeout(std::chrono::milliseconds::rep) const;
+
+    // In kernels before 2.6.37, a timeout value larger than approximately
+    // LONG_MAX / HZ milliseconds is treated as -1 (i.e., infinity).  Thus,
+    // for example, on a system where sizeof(long) is 4 and the kernel HZ
+    // value is 1000, this means that timeouts greater than 35.79 minutes
+    // are treated as infinity. 
+    const int MAX_EPOLL_TIMEOUT_MSEC {2100000}; // 35*60*1000
 };
 
 // Procedure: poll
 template <typename D, typename C>
 void Epoll::_poll(D&& d, C&& on) {
 
-  _prepare_epoll(duration_cast<struct timeval>(std::forward<D>(d)));
+  if(_num_events == 0) return;
+
+  // Round the timeout up to the next millisecond so that we never return before a timer
+  // is due (which would otherwise spin the reactor on sub-millisecond remainders).
+  auto timeout = _timeout(
+    std::chrono::ceil<std::chrono::milliseconds>(std::forward<D>(d)).count()
+  );
 
   // Wait for ready events.
-  // If millisec = -1: block indefinitely. If millisec = 0: return immediately 
-  auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
-  auto avail = ::epoll_wait(_epfd, _event_buf, _max_fd, timeout);
+  auto avail = ::epoll_wait(_epfd, _event_buf, static_cast<int>(_buf_sz), timeout);
 
-  if(avail == -1){
+  if(avail == -1) {
+    if(errno == EINTR) return;
     throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)), "Epoll failed");
   }
 
-  // Iterate ready events 
-  for(auto i=0;i<avail;++i){
-
-    // Ignore timerfd event
-    if(_event_buf[i].data.fd == _timerfd){
-      continue;
-    }
+  // Iterate ready events. The oneshot registration has been disarmed by the kernel.
+  for(auto i=0; i<avail; ++i) {
 
     auto efd = _event_buf[i].data.fd;
-    if(_event_buf[i].events & (EPOLLHUP|EPOLLERR)){
-      if(_fd2ev[0][efd]){
-        on(_fd2ev[0][efd]);
-      }
-      if(_fd2ev[1][efd]){
-        on(_fd2ev[1][efd]);
-      }
+    auto rev = _event_buf[i].events;
+
+    _armed[efd] = 0;
+
+    if(rev & (EPOLLHUP|EPOLLERR)) {
+      rev |= (EPOLLIN | EPOLLOUT);
     }
-    else if(_event_buf[i].events & EPOLLIN){
+
+    if((rev & EPOLLIN) && _fd2ev[0][efd]) {
       on(_fd2ev[0][efd]);
     }
-    else if(_event_buf[i].events & EPOLLOUT){
+    
+    if((rev & EPOLLOUT) && _fd2ev[1][efd]) {
       on(_fd2ev[1][efd]);
     }
-    else{
-      assert(false);
-    }
+
+    // Re-arm the interest that has not been reported (e.g., the write side of a channel
+    // whose read side just fired).
+    _rearm(efd);
   }
 }
 
-
-
 };  // End of namespace dtc. ---------------------------------------------------------------
 
 
@@ -17,6 +17,7 @@
 #include <dtc/policy.hpp>
 #include <dtc/utility/utility.hpp>
 #include <dtc/device.hpp>
+#include <dtc/concurrent/threadpool.hpp>
 
 namespace dtc {
 
@@ -26,7 +27,10 @@ namespace dtc {
 class Reactor;
 class Select;
 class Epoll;
+class Uring;
 class TimeoutEventHeap;
+class TimingWheel;
+class Strand;
 
 // Class: Event
 // The basic event class from which every customized event should inherit. Event is the basic unit
@@ -39,7 +43,10 @@ class Event : public std::enable_shared_from_this <Event> {
   friend class Reactor;
   friend class Select;
   friend class Epoll;
+  friend class Uring;
   friend class TimeoutEventHeap;
+  friend class TimingWheel;
+  friend class Strand;
   
   public:
 
@@ -59,6 +66,8 @@ class Event : public std::enable_shared_from_this <Event> {
     int satellite;
     std::chrono::steady_clock::time_point::duration duration;
     std::chrono::steady_clock::time_point timeout;
+    Event* prev {nullptr};    // intrusive links of the timing wheel slot
+    Event* next {nullptr};
   };
 
     const Type type;
@@ -68,7 +77,22 @@ class Event : public std::enable_shared_from_this <Event> {
 
   private:
 
-    Reactor* _reactor {nullptr};
+    // Written by the owning loop, read by the primary when it looks for the shard of an event.
+    std::atomic<Reactor*> _reactor {nullptr};
+
+    // Number of activations in flight (owned by the reactor thread).
+    int _num_activations {0};
+
+    // Time point at which the event became ready (instrumentation).
+    std::chrono::steady_clock::time_point _ready;
+
+    // Strand that serializes the activation of this event, and the link of its wait queue.
+    std::shared_ptr<Strand> _strand;
+    Event* _strand_next {nullptr};
+    bool _strand_queued {false};
+
+    // Lane of the thread pool the activations are posted to.
+    Threadpool::Priority _priority {Threadpool::LOW};
 
     const std::function<Signal(Event&)> _on;
 
@@ -77,6 +101,10 @@ class Event : public std::enable_shared_from_this <Event> {
     inline Timer& _timer();
 
   protected:
+
+    // The callback reads the device only through Device::read/readv, so the io_uring demux may
+    // receive the data ahead of it.
+    bool _read_ahead {false};
     
     template <typename C>
     inline Event(const Type, std::shared_ptr<Device>, C&&);
@@ -97,6 +125,10 @@ class Event : public std::enable_shared_from_this <Event> {
     virtual ~Event() = default;
     
     inline Reactor* reactor() const;
+    inline Strand* strand() const;
+
+    inline Threadpool::Priority priority() const;
+    inline void priority(Threadpool::Priority);
 
     inline const Timer& timer() const;
     inline std::shared_ptr<Device> device();
@@ -135,7 +167,24 @@ inline Event::Event(const Type t, D&& d, const bool from_now, C&& c) :
 // Function: reactor
 // Return the non-owned pointer to the reactor
 inline Reactor* Event::reactor() const {
-  return _reactor;
+  return _reactor.load(std::memory_order_acquire);
+}
+
+// Function: strand
+// Return the non-owned pointer to the strand of the event (null if the event is not stranded).
+inline Strand* Event::strand() const {
+  return _strand.get();
+}
+
+// Function: priority
+inline Threadpool::Priority Event::priority() const {
+  return _priority;
+}
+
+// Procedure: priority
+// Set the thread-pool lane of the event. The priority must be set before the event is inserted.
+inline void Event::priority(Threadpool::Priority p) {
+  _priority = p;
 }
 
 // Function: timer
@@ -224,6 +273,50 @@ template <typename T> constexpr bool is_event_v = is_event<T>::value;
 
 //-------------------------------------------------------------------------------------------------
 
+// Class: Strand
+// A strand serializes the activations of the events bound to it: at most one of them runs on
+// the thread pool at any time while the others wait in activation order. Callbacks of stranded
+// events can therefore share state without locking. All events of a strand live in the reactor
+// the strand is bound to on the first insertion, and the wait queue is touched by the owner 
+// thread of that reactor only.
+class Strand {
+
+  friend class Reactor;
+
+  public:
+
+    Strand() = default;
+    Strand(const Strand&) = delete;
+    Strand(Strand&&) = delete;
+    
+    Strand& operator = (const Strand&) = delete;
+    Strand& operator = (Strand&&) = delete;
+
+    inline Reactor* reactor() const;
+
+  private:
+
+    std::atomic<Reactor*> _reactor {nullptr};
+
+    bool _busy {false};
+
+    Event* _head {nullptr};
+    Event* _tail {nullptr};
+
+    Reactor* _bind(Reactor*);
+
+    void _push(Event*);
+    Event* _pop();
+};
+
+// Function: reactor
+// Return the reactor the strand is bound to.
+inline Reactor* Strand::reactor() const {
+  return _reactor.load(std::memory_order_acquire);
+}
+
+//-------------------------------------------------------------------------------------------------
+
 // Class: TimeoutEventHeap
 // Priority queue of the event. The priority queue is typically keyed on the timeout.
 class TimeoutEventHeap {
@@ -252,6 +345,100 @@ class TimeoutEventHeap {
     void _bubble_down(size_t, Event*);
 };
 
+//-------------------------------------------------------------------------------------------------
+
+// Class: TimingWheel
+// Hierarchical timing wheel of timeout events. Time is quantized into ticks of the timer slack
+// and an event is due at the first tick not earlier than its timeout, so timers due within the
+// same tick fire in one batch. The wheel has NUM_LEVELS levels of 64 slots; an event sits in the
+// level of the highest 6-bit digit in which its tick differs from the current tick, and is 
+// cascaded to a lower level when the wheel reaches the start of its slot. Insertion and removal
+// are O(1) (intrusive lists), and expiry skips empty slots using one occupancy bitmap per level.
+class TimingWheel {
+
+  public:
+
+    TimingWheel(std::chrono::steady_clock::duration = env::timer_slack());
+
+    void clear();
+    void remove(Event*);
+    void insert(Event*);
+
+    bool empty() const;
+    
+    size_t size() const;
+
+    std::chrono::steady_clock::duration slack() const;
+    std::chrono::steady_clock::time_point next_expiry() const;
+
+    template <typename C>
+    void expire(std::chrono::steady_clock::time_point, C&&);
+
+  private:
+
+    static constexpr size_t NUM_LEVELS {11};
+    static constexpr size_t NUM_SLOTS {64};
+    static constexpr uint64_t NULL_TICK {std::numeric_limits<uint64_t>::max()};
+
+    const std::chrono::steady_clock::duration _slack;
+    const std::chrono::steady_clock::time_point _origin {now()};
+
+    uint64_t _tick {0};
+    size_t _size {0};
+
+    uint64_t _bitmap[NUM_LEVELS] {};
+    Event* _slots[NUM_LEVELS][NUM_SLOTS] {};
+
+    uint64_t _tick_of(std::chrono::steady_clock::time_point, bool) const;
+    uint64_t _next_tick() const;
+
+    void _link(Event*);
+    void _unlink(Event*);
+};
+
+// Procedure: expire
+// Advance the wheel to the time point and invoke the callable on every event that is due. The
+// event is taken off the wheel before the call.
+template <typename C>
+void TimingWheel::expire(std::chrono::steady_clock::time_point tp, C&& on) {
+
+  auto target = _tick_of(tp, false);
+
+  while(_size) {
+
+    auto t = _next_tick();
+
+    if(t > target) break;
+
+    _tick = t;
+
+    // Cascade the upper-level slots that start at this tick.
+    for(size_t l=1; l<NUM_LEVELS; ++l) {
+      if(auto s = (t >> (6*l)) & 63; (_bitmap[l] >> s) & 1) {
+        auto e = _slots[l][s];
+        _slots[l][s] = nullptr;
+        _bitmap[l] &= ~(1ull << s);
+        while(e) {
+          auto next = e->_timer().next;
+          --_size;
+          _link(e);
+          e = next;
+        }
+      }
+    }
+
+    // Fire the events of this tick.
+    while(auto e = _slots[0][t & 63]) {
+      _unlink(e);
+      on(e);
+    }
+  }
+
+  if(target > _tick) {
+    _tick = target;
+  }
+}
+
 
 
 
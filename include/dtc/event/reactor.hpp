@@ -15,8 +15,8 @@
 #define DTC_EVENT_REACTOR_HPP_
 
 #include <dtc/event/event.hpp>
-#include <dtc/event/select.hpp>
-#include <dtc/event/epoll.hpp>
+#include <dtc/event/demux.hpp>
+#include <dtc/event/statistics.hpp>
 #include <dtc/concurrent/mutex.hpp>
 #include <dtc/concurrent/queue.hpp>
 #include <dtc/concurrent/threadpool.hpp>
@@ -46,22 +46,43 @@ class Reactor {
     // Reactor internal.
     bool _break_loop {false};
     std::chrono::steady_clock::time_point _sync_time_point {now()};
-    ConcurrentQueue<std::function<void()>> _promises;
+    ConcurrentQueue<Task> _promises;
+
+    // Completed activations reported by the workers. The two buffers are swapped by the owner
+    // so that the steady-state activation path does not allocate.
+    SpinLock _completion_lock;
+    std::vector<std::pair<Event*, Event::Signal>> _completions;
+    std::vector<std::pair<Event*, Event::Signal>> _completions_swap;
+
+    // Removed events that still have activations in flight.
+    std::vector<std::shared_ptr<Event>> _retired;
 
     // Event container.
     std::unordered_set<std::shared_ptr<Event>> _eventset;
-    TimeoutEventHeap _timeoutpq;
-    Select _demux;
+    TimingWheel _timing_wheel;
+    Demux _demux;
     
     // Customized stopping criteria
     size_t _threshold {0};
     std::function<bool(Reactor&)> _break_loop_on;
 
+    // Instrumentation.
+    bool _monitoring {env::reactor_statistics()};
+    ReactorMonitor _monitor;
+
+    // Sharded event loops. A shard is a reactor that runs on its own (pinned) owner thread 
+    // and reports its event count to the primary reactor that spawned it.
+    Reactor* _primary {nullptr};
+    std::atomic<size_t> _num_sharded_events {0};
+    std::atomic<size_t> _shard_cursor {0};
+    std::vector<Reactor*> _shards;
+    std::vector<std::thread> _shard_threads;
+
   public:
     
     const std::thread::id owner {std::this_thread::get_id()};
 
-    Reactor(unsigned = std::thread::hardware_concurrency());
+    Reactor(unsigned = std::thread::hardware_concurrency(), DemuxType = env::demux_type());
     Reactor(const Reactor&) = delete;
     Reactor(Reactor&&) = delete;
 
@@ -80,17 +101,40 @@ class Reactor {
     template <typename T, typename... ArgsT>
     auto insert(ArgsT&&...);
 
+    template <typename T, typename... ArgsT>
+    auto insert_on(std::shared_ptr<Strand>, ArgsT&&...);
+
+    template <typename T, typename... ArgsT>
+    static std::shared_ptr<T> make_event(std::shared_ptr<Strand>, ArgsT&&...);
+
+    std::future<void> insert_batch(std::vector<std::shared_ptr<Event>>);
+    std::future<void> remove_batch(std::vector<std::shared_ptr<Event>>);
+
     std::future<bool> break_loop();
 
     inline size_t num_events() const;
     inline size_t num_workers() const;
 
+    inline DemuxType demux_type() const;
+
+    void spawn_shards(unsigned);
+
+    inline size_t num_shards() const;
+    inline Reactor& shard(size_t);
+    inline Reactor& next_shard();
+
     template <typename C>
     auto promise(C&&);
 
+    template <typename C>
+    void silent_promise(C&&);
+
     template <typename C>
     auto async(C&&);
 
+    template <typename C>
+    void silent_async(C&&);
+
     inline bool is_owner() const;
     
     bool notify();
@@ -101,21 +145,97 @@ class Reactor {
 
     void clear();
 
+    ReactorStatistics statistics() const;
+
+    void clear_statistics();
+
   private:
     
     void _carry_on_promises();
+    void _carry_on_completions();
+    void _carry_on_completion(Event*, Event::Signal);
+    void _complete(Event*, Event::Signal);
+    void _retire(std::shared_ptr<Event>&&);
+    void _reap(Event*);
+    void _resume(Strand*);
     void _poll_timeout_events();
     void _poll_io_events();
     void _activate_event(Event*);
 
+    void _register(std::shared_ptr<Event>);
     bool _remove(std::shared_ptr<Event>);
     bool _freeze(std::shared_ptr<Event>);
     bool _thaw(std::shared_ptr<Event>);
+
+    void _shutdown_shards();
+
+    std::future<void> _batch(std::vector<std::shared_ptr<Event>>&&, bool);
+
+    static void _run_activation(void*, void*);
+
+    inline void _count_sharded_event(bool);
+    inline Reactor* _shard_of(const std::shared_ptr<Event>&) const;
+
+    template <typename T>
+    auto _insert(std::shared_ptr<T>);
 };
 
 // Function: num_events
+// The number of events held by the reactor, including those living in its shards.
 inline size_t Reactor::num_events() const {
-  return _eventset.size();
+  return _eventset.size() + _num_sharded_events.load(std::memory_order_relaxed);
+}
+
+// Function: num_shards
+// The number of event loops, including the primary one.
+inline size_t Reactor::num_shards() const {
+  return _shards.size() + 1;
+}
+
+// Function: shard
+// Return the i-th event loop. The 0-th loop is the reactor itself.
+inline Reactor& Reactor::shard(size_t i) {
+  return i == 0 ? *this : *_shards[i-1];
+}
+
+// Function: next_shard
+// Return the next event loop in a round-robin fashion.
+inline Reactor& Reactor::next_shard() {
+  if(_shards.empty()) {
+    return *this;
+  }
+  return shard(_shard_cursor.fetch_add(1, std::memory_order_relaxed) % num_shards());
+}
+
+// Procedure: _count_sharded_event
+// Called by a shard on its owner thread whenever an event enters or leaves its event set.
+inline void Reactor::_count_sharded_event(bool inserted) {
+  if(_primary == nullptr) return;
+  if(inserted) {
+    _primary->_num_sharded_events.fetch_add(1, std::memory_order_relaxed);
+  }
+  else {
+    _primary->_num_sharded_events.fetch_sub(1, std::memory_order_relaxed);
+    // Wake up the primary loop so it can re-evaluate its stopping criteria.
+    _primary->notify();
+  }
+}
+
+// Function: _shard_of
+// Return the shard that owns the event if the event does not belong to this reactor. A strand is
+// bound before its event is handed to the shard, so we look up the binding of the strand rather
+// than the reactor of the event, which the shard sets only once it registers the event. Events
+// inserted straight into a shard carry no strand and fall back to the latter.
+inline Reactor* Reactor::_shard_of(const std::shared_ptr<Event>& event) const {
+  
+  if(event == nullptr) return nullptr;
+
+  auto r = event->_strand ? event->_strand->reactor() : event->reactor();
+
+  if(r != nullptr && r != this && r->_primary == this) {
+    return r;
+  }
+  return nullptr;
 }
 
 // Function: num_workers
@@ -123,6 +243,11 @@ inline size_t Reactor::num_workers() const {
   return _threadpool.num_workers();
 }
 
+// Function: demux_type
+inline DemuxType Reactor::demux_type() const {
+  return _demux.type();
+}
+
 // Function: is_owner
 // Query whether the caller is the owner of the reactor
 inline bool Reactor::is_owner() const {
@@ -147,6 +272,13 @@ auto Reactor::async(C&& c) {
   return _threadpool.async(std::forward<C>(c));
 }
 
+// Procedure: silent_async
+// Assign a task without a future.
+template <typename C>
+void Reactor::silent_async(C&& c) {
+  _threadpool.silent_async(std::forward<C>(c));
+}
+
 // Function: promise
 // Let the main thread (reactor thread) to run the task of a callable type.
 template<typename C>
@@ -170,7 +302,15 @@ auto Reactor::promise(C&& c) {
   } 
   // Case 2: caller is not the owner
   else {
-    _promises.enqueue(make_strong_movable_closure(std::move(p), std::forward<C>(c)));
+    _promises.enqueue(Task([p=std::move(p), c=std::forward<C>(c)] () mutable {
+      if constexpr(std::is_same_v<void, R>) {
+        c();
+        p.set_value();
+      }
+      else {
+        p.set_value(c());
+      }
+    }));
     notify();
   }
 
@@ -191,6 +331,20 @@ auto Reactor::promise(C&& c) {
 
   return fu;
 }
+
+// Procedure: silent_promise
+// Let the main thread (reactor thread) run the task without a future. No promise is created,
+// and a task that fits in a Task is queued without allocation.
+template <typename C>
+void Reactor::silent_promise(C&& c) {
+  if(is_owner()) {
+    c();
+  }
+  else {
+    _promises.enqueue(Task(std::forward<C>(c)));
+    notify();
+  }
+}
  
 // Function: remove
 auto Reactor::remove(auto&&... events) {
@@ -218,22 +372,45 @@ auto Reactor::thaw(auto&&... events) {
 // The construction of the event happens at the caller's thread.
 template <typename T, typename... ArgsT>
 auto Reactor::insert(ArgsT&&... args) {
+  return _insert(std::make_shared<T>(std::forward<ArgsT>(args)...));
+}
 
-  return promise([this, event=std::make_shared<T>(std::forward<ArgsT>(args)...)] {
+// Function: insert_on
+// The function creates an event bound to the given strand and inserts it into the reactor of 
+// the strand. An unbound strand is bound to this reactor. A null strand falls back to insert.
+template <typename T, typename... ArgsT>
+auto Reactor::insert_on(std::shared_ptr<Strand> strand, ArgsT&&... args) {
 
-    _eventset.insert(event);                                                                     
-    event->_reactor = this;  
+  if(strand == nullptr) {
+    return _insert(std::make_shared<T>(std::forward<ArgsT>(args)...));
+  }
 
-    if constexpr(std::is_base_of_v<TimeoutEvent, T> || std::is_base_of_v<PeriodicEvent, T>) {    
-      _timeoutpq.insert(event.get());                                                            
-    }
-    else if constexpr(std::is_base_of_v<ReadEvent, T>) {
-      _demux._insert(event.get());
-    }
-    else if constexpr(std::is_base_of_v<WriteEvent, T>) {
-    }
-    else static_assert(dependent_false_v<T>);
-     
+  auto loop = strand->_bind(this);
+
+  return loop->_insert(make_event<T>(std::move(strand), std::forward<ArgsT>(args)...));
+}
+
+// Function: make_event
+// Create an event (optionally bound to a strand) without inserting it. The event is meant to be
+// registered later together with others through insert_batch.
+template <typename T, typename... ArgsT>
+std::shared_ptr<T> Reactor::make_event(std::shared_ptr<Strand> strand, ArgsT&&... args) {
+  auto event = std::make_shared<T>(std::forward<ArgsT>(args)...);
+  event->_strand = std::move(strand);
+  return event;
+}
+
+// Function: _insert
+template <typename T>
+auto Reactor::_insert(std::shared_ptr<T> event) {
+
+  static_assert(
+    std::is_base_of_v<TimeoutEvent, T> || std::is_base_of_v<PeriodicEvent, T> ||
+    std::is_base_of_v<ReadEvent, T> || std::is_base_of_v<WriteEvent, T>
+  );
+
+  return promise([this, event=std::move(event)] {
+    _register(event);
     return event;
   });
 }
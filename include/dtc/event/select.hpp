@@ -41,9 +41,15 @@ namespace dtc {
 class Select {
 
   friend class Reactor;
+  friend class Demux;
 
+  public:
+
+  Select() = default;
   ~Select();
 
+  private:
+
   inline size_t num_fds_per_mask() const;
   inline size_t num_masks(const size_t) const;
   
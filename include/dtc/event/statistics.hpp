@@ -0,0 +1,254 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright (c) 2018, Tsung-Wei Huang and Martin D. F. Wong,                 *
+ * University of Illinois at Urbana-Champaign (UIUC), IL, USA.                *
+ *                                                                            *
+ * All Rights Reserved.                                                       *
+ *                                                                            *
+ * This program is free software. You can redistribute and/or modify          *
+ * it in accordance with the terms of the accompanying license agreement.     *
+ * See LICENSE in the top-level directory for details.                        *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef DTC_EVENT_STATISTICS_HPP_
+#define DTC_EVENT_STATISTICS_HPP_
+
+#include <dtc/event/event.hpp>
+
+namespace dtc {
+
+// Class: Histogram
+// Latency histogram with power-of-two buckets: bucket 0 holds zero-length samples and bucket
+// i > 0 holds samples in [2^(i-1), 2^i) nanoseconds. Percentiles are reported as the upper
+// bound of the bucket, which is accurate within a factor of two.
+class Histogram {
+
+  friend class AtomicHistogram;
+
+  public:
+
+    static constexpr size_t NUM_BUCKETS {48};
+
+    Histogram() = default;
+
+    inline void insert(std::chrono::nanoseconds);
+
+    inline size_t count() const;
+    inline size_t bucket(size_t) const;
+
+    inline std::chrono::nanoseconds max() const;
+    inline std::chrono::nanoseconds mean() const;
+
+    std::chrono::nanoseconds percentile(double) const;
+
+    Histogram& operator += (const Histogram&);
+
+    json to_json() const;
+
+    inline static size_t bucket_of(std::chrono::nanoseconds);
+
+  private:
+
+    std::array<uint64_t, NUM_BUCKETS> _buckets {};
+
+    uint64_t _count {0};
+    uint64_t _sum {0};
+    uint64_t _max {0};
+};
+
+// Function: bucket_of
+inline size_t Histogram::bucket_of(std::chrono::nanoseconds d) {
+  auto v = static_cast<uint64_t>(std::max<int64_t>(d.count(), 0));
+  return v == 0 ? 0 : std::min<size_t>(64 - __builtin_clzll(v), NUM_BUCKETS - 1);
+}
+
+// Procedure: insert
+inline void Histogram::insert(std::chrono::nanoseconds d) {
+  auto v = static_cast<uint64_t>(std::max<int64_t>(d.count(), 0));
+  ++_buckets[bucket_of(d)];
+  ++_count;
+  _sum += v;
+  _max = std::max(_max, v);
+}
+
+// Function: count
+inline size_t Histogram::count() const {
+  return _count;
+}
+
+// Function: bucket
+inline size_t Histogram::bucket(size_t i) const {
+  return _buckets[i];
+}
+
+// Function: max
+inline std::chrono::nanoseconds Histogram::max() const {
+  return std::chrono::nanoseconds(_max);
+}
+
+// Function: mean
+inline std::chrono::nanoseconds Histogram::mean() const {
+  return std::chrono::nanoseconds(_count ? _sum / _count : 0);
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Class: AtomicHistogram
+// The recording side of a histogram. Samples are added with relaxed atomic increments so any
+// thread may record while others take snapshots.
+class AtomicHistogram {
+
+  public:
+
+    inline void insert(std::chrono::nanoseconds);
+
+    void clear();
+
+    Histogram snapshot() const;
+
+  private:
+
+    std::array<std::atomic<uint64_t>, Histogram::NUM_BUCKETS> _buckets {};
+
+    std::atomic<uint64_t> _count {0};
+    std::atomic<uint64_t> _sum {0};
+    std::atomic<uint64_t> _max {0};
+};
+
+// Procedure: insert
+inline void AtomicHistogram::insert(std::chrono::nanoseconds d) {
+  auto v = static_cast<uint64_t>(std::max<int64_t>(d.count(), 0));
+  _buckets[Histogram::bucket_of(d)].fetch_add(1, std::memory_order_relaxed);
+  _count.fetch_add(1, std::memory_order_relaxed);
+  _sum.fetch_add(v, std::memory_order_relaxed);
+  if(v > _max.load(std::memory_order_relaxed)) {
+    _max.store(v, std::memory_order_relaxed);
+  }
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Struct: ReactorStatistics
+// A snapshot of the instruments of one or more event loops.
+struct ReactorStatistics {
+
+  size_t num_loops {0};
+  size_t num_iterations {0};
+  size_t num_promises {0};
+  size_t promise_queue_depth {0};         // sampled at the latest iteration
+  size_t max_promise_queue_depth {0};
+
+  std::array<size_t, 4> num_activations {};    // indexed by Event::Type
+
+  Histogram iteration;                    // one round of the event loop
+  Histogram io_poll;                      // _poll_io_events (including the wait)
+  Histogram promises;                     // _carry_on_promises
+  Histogram completions;                  // _carry_on_completions
+  Histogram delay;                        // readiness to the start of the callback
+
+  std::array<Histogram, 4> callback;      // callback run time, indexed by Event::Type
+
+  ReactorStatistics& operator += (const ReactorStatistics&);
+
+  json to_json() const;
+};
+
+//-------------------------------------------------------------------------------------------------
+
+// Class: ReactorMonitor
+// The live instruments of an event loop. Loop instruments are written by the owner thread only.
+// Callback histograms are written by the workers; they are spread over cache-line aligned
+// slots picked per thread to keep the workers off each other's cache lines.
+class ReactorMonitor {
+
+  public:
+
+    static constexpr size_t NUM_SLOTS {8};
+
+    inline void activation(Event::Type);
+    inline void promises(size_t, size_t, std::chrono::nanoseconds);
+    inline void completions(std::chrono::nanoseconds);
+    inline void io_poll(std::chrono::nanoseconds);
+    inline void iteration(std::chrono::nanoseconds);
+    inline void callback(Event::Type, std::chrono::nanoseconds, std::chrono::nanoseconds);
+
+    void clear();
+
+    ReactorStatistics snapshot() const;
+
+  private:
+
+    struct alignas(64) Slot {
+      AtomicHistogram delay;
+      std::array<AtomicHistogram, 4> callback;
+    };
+
+    std::atomic<size_t> _num_iterations {0};
+    std::atomic<size_t> _num_promises {0};
+    std::atomic<size_t> _promise_queue_depth {0};
+    std::atomic<size_t> _max_promise_queue_depth {0};
+    std::array<std::atomic<size_t>, 4> _num_activations {};
+
+    AtomicHistogram _iteration;
+    AtomicHistogram _io_poll;
+    AtomicHistogram _promises;
+    AtomicHistogram _completions;
+
+    std::array<Slot, NUM_SLOTS> _slots;
+
+    inline static size_t _slot();
+};
+
+// Function: _slot
+inline size_t ReactorMonitor::_slot() {
+  static std::atomic<size_t> cursor {0};
+  static thread_local size_t slot = cursor.fetch_add(1, std::memory_order_relaxed) % NUM_SLOTS;
+  return slot;
+}
+
+// Procedure: activation
+inline void ReactorMonitor::activation(Event::Type type) {
+  _num_activations[type].fetch_add(1, std::memory_order_relaxed);
+}
+
+// Procedure: promises
+// Record the depth of the promise queue, the number of promises carried on, and the time spent.
+inline void ReactorMonitor::promises(size_t depth, size_t num, std::chrono::nanoseconds d) {
+  _num_iterations.fetch_add(1, std::memory_order_relaxed);
+  _num_promises.fetch_add(num, std::memory_order_relaxed);
+  _promise_queue_depth.store(depth, std::memory_order_relaxed);
+  if(depth > _max_promise_queue_depth.load(std::memory_order_relaxed)) {
+    _max_promise_queue_depth.store(depth, std::memory_order_relaxed);
+  }
+  _promises.insert(d);
+}
+
+// Procedure: completions
+inline void ReactorMonitor::completions(std::chrono::nanoseconds d) {
+  _completions.insert(d);
+}
+
+// Procedure: io_poll
+inline void ReactorMonitor::io_poll(std::chrono::nanoseconds d) {
+  _io_poll.insert(d);
+}
+
+// Procedure: iteration
+inline void ReactorMonitor::iteration(std::chrono::nanoseconds d) {
+  _iteration.insert(d);
+}
+
+// Procedure: callback
+inline void ReactorMonitor::callback(
+  Event::Type type, std::chrono::nanoseconds delay, std::chrono::nanoseconds runtime
+) {
+  auto& slot = _slots[_slot()];
+  slot.delay.insert(delay);
+  slot.callback[type].insert(runtime);
+}
+
+};  // End of namespace dtc. ----------------------------------------------------------------------
+
+#endif
+
@@ -0,0 +1,217 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright (c) 2018, Tsung-Wei Huang and Martin D. F. Wong,                 *
+ * University of Illinois at Urbana-Champaign (UIUC), IL, USA.                *
+ *                                                                            *
+ * All Rights Reserved.                                                       *
+ *                                                                            *
+ * This program is free software. You can redistribute and/or modify          *
+ * it in accordance with the terms of the accompanying license agreement.     *
+ * See LICENSE in the top-level directory for details.                        *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef DTC_EVENT_URING_HPP_
+#define DTC_EVENT_URING_HPP_
+
+#include <dtc/event/event.hpp>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+
+namespace dtc {
+
+// Class: Uring
+//
+// Uring drives the reactor with the io_uring interface (Linux 5.11+). The kernel shares two
+// ring buffers with the process: the submission queue (SQ) to which we append requests and
+// the completion queue (CQ) from which we reap results. We talk to the kernel through raw
+// system calls so there is no dependency on liburing.
+//
+//  ** Function signatures:
+//
+//  int io_uring_setup(u32 entries, struct io_uring_params *p);
+//  * Create the rings and return a file descriptor to be mmaped for the SQ, the CQ, and the
+//    submission queue entries (SQE).
+//
+//  int io_uring_enter(unsigned fd, u32 to_submit, u32 min_complete, u32 flags,
+//                     const void* arg, size_t argsz);
+//  * Submit to_submit SQEs and, with IORING_ENTER_GETEVENTS, wait for min_complete CQEs.
+//    With IORING_ENTER_EXT_ARG the arg is an io_uring_getevents_arg carrying the timeout.
+//
+//  ** Registration policy:
+//
+//  Each interest is an IORING_OP_POLL_ADD request, which is oneshot by nature just like
+//  the EPOLLONESHOT registration of Epoll. Insertions and removals do not enter the kernel;
+//  they only mark the descriptor dirty. Right before waiting, all dirty descriptors are
+//  translated into POLL_REMOVE/POLL_ADD SQEs and the whole batch is submitted together with
+//  the wait in a single io_uring_enter. Every poll request carries the generation of its
+//  descriptor in the user data so completions of cancelled requests are discarded.
+//
+//  ** Receive ahead:
+//
+//  The read interest of an event that reads its device only through Device::read/readv (an
+//  istream over a stream socket) is a multishot IORING_OP_RECV instead of a poll. The kernel
+//  picks one of the buffers provided to it (IORING_OP_PROVIDE_BUFFERS), and each completion
+//  carries the data; the demux appends it to the ReadAhead of the device and provides the 
+//  buffer again with the next submission. The reads of the activated event are then served from 
+//  memory, so one io_uring_enter drains all streams that received data in the round. The
+//  receive stays armed across activations and ends when the device holds MAX_READ_AHEAD bytes
+//  (backpressure), when the event is removed for good, or on the end of file or an error, 
+//  which the device raises after the data. The demux holds the device until the final 
+//  completion of its receive.
+//
+//  Writes are still issued by the worker that runs OutputStreamBuffer::sync; the demux only
+//  polls for their readiness.
+//
+//  The constructor throws std::system_error if the kernel does not provide io_uring or lacks
+//  the features we need, in which case the Demux falls back to Epoll. A kernel without
+//  multishot receives (6.0) polls the reads instead.
+//
+class Uring {
+
+  friend class Reactor;
+  friend class Demux;
+
+  public:
+
+    Uring(unsigned = 256);
+    ~Uring();
+
+  private:
+
+    int _max_fd {-1};
+    int _ring_fd {-1};
+
+    size_t _buf_sz {0};
+    size_t _num_events {0};
+    Event** _fd2ev[2] {nullptr, nullptr};   // read/write
+    uint32_t* _armed {nullptr};              // poll mask currently in flight
+    uint32_t* _gen {nullptr};                // generation of the in-flight poll request
+    uint8_t* _dirty {nullptr};               // fd is in the dirty list
+    uint8_t* _recv {nullptr};                // state of the receive of the fd
+    uint32_t* _revents {nullptr};            // readiness to report on this round
+
+    std::vector<int> _dirty_fds;
+    std::vector<int> _ready_fds;
+    std::vector<std::shared_ptr<Device>> _recv_dev;   // device of an in-flight receive
+
+    // Submission queue.
+    void* _sq_ptr {nullptr};
+    size_t _sq_sz {0};
+    unsigned* _sq_head {nullptr};
+    unsigned* _sq_tail {nullptr};
+    unsigned* _sq_mask {nullptr};
+    unsigned* _sq_array {nullptr};
+    io_uring_sqe* _sqes {nullptr};
+    size_t _sqes_sz {0};
+    unsigned _sq_entries {0};
+
+    // Completion queue.
+    void* _cq_ptr {nullptr};
+    size_t _cq_sz {0};
+    unsigned* _cq_head {nullptr};
+    unsigned* _cq_tail {nullptr};
+    unsigned* _cq_mask {nullptr};
+    io_uring_cqe* _cqes {nullptr};
+
+    // Provided buffers of the receives.
+    char* _bufs {nullptr};
+    bool _recv_ok {false};
+
+    template <typename D, typename C>
+    void _poll(D&&, C&&);
+
+    void _insert(Event*);
+    void _remove(Event*);
+    void _erase(Event*);
+    void _recap(const int);
+    void _clear();
+    void _mark(const int);
+    void _ready(const int, const uint32_t);
+    void _flush();
+    void _reap();
+    void _submit(unsigned, const __kernel_timespec*);
+    void _cancel(const int);
+    void _received(const int, const int, const uint32_t);
+    void _recycle(const uint16_t);
+
+    bool _receive(const int);
+
+    io_uring_sqe* _sqe();
+
+    inline uint32_t _want(const int) const;
+
+    static constexpr uint32_t NULL_FD {0xFFFFFFFF};
+    static constexpr uint32_t RECV_TAG {0x80000000};
+
+    static constexpr uint8_t RECV_NONE {0};
+    static constexpr uint8_t RECV_ARMED {1};
+    static constexpr uint8_t RECV_CANCELLED {2};
+
+    static constexpr uint16_t RECV_BGID {0};
+    static constexpr unsigned NUM_RECV_BUFS {64};
+    static constexpr size_t RECV_BUF_SZ {16384};
+    static constexpr size_t MAX_READ_AHEAD {262144};
+
+    // Timeouts beyond this bound are clamped (the reactor re-polls anyway).
+    static constexpr std::chrono::hours MAX_URING_TIMEOUT {24};
+};
+
+// Function: _want
+inline uint32_t Uring::_want(const int fd) const {
+  return (_fd2ev[0][fd] ? POLLIN : 0) | (_fd2ev[1][fd] ? POLLOUT : 0);
+}
+
+// Procedure: poll
+template <typename D, typename C>
+void Uring::_poll(D&& d, C&& on) {
+
+  if(_num_events == 0) return;
+
+  _flush();
+
+  // Submit the pending batch and wait for at least one completion in a single system call. The
+  // data received ahead while the readers were busy are reported without waiting.
+  if(!_ready_fds.empty()) {
+    _submit(0, nullptr);
+  }
+  else if(std::chrono::ceil<std::chrono::milliseconds>(d) == std::chrono::milliseconds::max()) {
+    _submit(1, nullptr);
+  }
+  else {
+    auto ns = std::chrono::ceil<std::chrono::nanoseconds>(
+      std::min<std::chrono::duration<double>>(std::forward<D>(d), MAX_URING_TIMEOUT)
+    ).count();
+    __kernel_timespec ts;
+    ns = std::max<decltype(ns)>(ns, 0);
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    _submit(1, &ts);
+  }
+
+  _reap();
+
+  for(auto fd : _ready_fds) {
+
+    auto rev = _revents[fd];
+
+    _revents[fd] = 0;
+
+    if((rev & POLLIN) && _fd2ev[0][fd]) {
+      on(_fd2ev[0][fd]);
+    }
+
+    if((rev & POLLOUT) && _fd2ev[1][fd]) {
+      on(_fd2ev[1][fd]);
+    }
+  }
+
+  _ready_fds.clear();
+}
+
+};  // End of namespace dtc. ---------------------------------------------------------------
+
+
+#endif
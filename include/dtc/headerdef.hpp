@@ -49,6 +49,7 @@
 #include <type_traits>
 #include <algorithm>
 #include <sys/eventfd.h>
+#include <poll.h>
 #include <sys/mount.h>
 #include <sys/utsname.h>
 #include <sys/ioctl.h>
@@ -33,6 +33,8 @@ class BlockFile : public Device {
 
     std::streamsize read(void*, std::streamsize) const override final;
     std::streamsize write(const void*, std::streamsize) const override final;
+    std::streamsize readv(const struct iovec*, int) const override final;
+    std::streamsize writev(const struct iovec*, int) const override final;
 };
 
 template <typename... Ts>
@@ -0,0 +1,196 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright (c) 2018, Tsung-Wei Huang and Martin D. F. Wong,                 *
+ * University of Illinois at Urbana-Champaign (UIUC), IL, USA.                *
+ *                                                                            *
+ * All Rights Reserved.                                                       *
+ *                                                                            *
+ * This program is free software. You can redistribute and/or modify          *
+ * it in accordance with the terms of the accompanying license agreement.     *
+ * See LICENSE in the top-level directory for details.                        *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef DTC_IPC_CODEC_HPP_
+#define DTC_IPC_CODEC_HPP_
+
+#include <dtc/headerdef.hpp>
+
+namespace dtc {
+
+// Class: Codec
+//
+// Codec compresses the messages of a stream. Each message is packaged as usual and then sent
+// as a frame of a fixed header (raw and encoded sizes) followed by the encoded bytes. A frame 
+// that does not shrink is sent as it is, with both sizes equal.
+//
+// Built-in codecs (no external dependency):
+//   RLE     : PackBits run-length encoding, for sparse data and long runs of equal bytes.
+//   SHUFFLE : byte shuffle of 4-byte elements followed by RLE, for vectors of floats/ints whose
+//             high-order bytes are alike.
+//   LZ4     : LZ77 in the LZ4 block format with a single-probe hash table, for text and
+//             repetitive records.
+//
+// The counters record the bytes and the CPU time spent on each side of the stream.
+//
+class Codec {
+
+  public:
+
+    enum Type {
+      NONE = 0,
+      RLE,
+      SHUFFLE,
+      LZ4
+    };
+
+    // No built-in codec expands a byte into more than 255 raw bytes (an LZ4 match length byte).
+    static constexpr uint64_t MAX_EXPANSION {255};
+
+    struct Header {
+      uint64_t raw;
+      uint64_t encoded;
+
+      inline bool valid() const;
+    };
+    
+    struct Counters {
+      size_t num_frames {0};
+      size_t raw_bytes {0};
+      size_t encoded_bytes {0};
+      uintmax_t encode_time {0};    // nanoseconds
+      uintmax_t decode_time {0};    // nanoseconds
+
+      inline double ratio() const;
+
+      Counters& operator += (const Counters&);
+    };
+
+    virtual ~Codec() = default;
+
+    virtual Type type() const = 0;
+
+    void encode(std::string_view, std::string&);
+    void decode(const Header&, const char*, char*);
+
+    Counters counters() const;
+
+  protected:
+    
+    // Encode into at most the given capacity and return the encoded size, or 0 if it won't fit.
+    virtual size_t _compress(const char*, size_t, char*, size_t) = 0;
+
+    // Decode into exactly the given raw size and return false on malformed input.
+    virtual bool _decompress(const char*, size_t, char*, size_t) = 0;
+
+  private:
+
+    std::atomic<size_t> _num_frames {0};
+    std::atomic<size_t> _raw_bytes {0};
+    std::atomic<size_t> _encoded_bytes {0};
+    std::atomic<uintmax_t> _encode_time {0};
+    std::atomic<uintmax_t> _decode_time {0};
+};
+
+// Function: valid
+// A frame never grows on encoding and cannot decode into more than its expansion bound, so the
+// sizes of a header read off the wire are checked before anything is allocated for them.
+inline bool Codec::Header::valid() const {
+  return encoded <= raw && raw / MAX_EXPANSION <= encoded;
+}
+
+// Function: ratio
+// Return the raw bytes per encoded byte.
+inline double Codec::Counters::ratio() const {
+  return encoded_bytes ? static_cast<double>(raw_bytes) / encoded_bytes : 1.0;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Class: RleCodec
+class RleCodec : public Codec {
+
+  public:
+
+    inline Type type() const override;
+
+    static size_t compress(const char*, size_t, char*, size_t);
+    static bool decompress(const char*, size_t, char*, size_t);
+
+  protected:
+
+    size_t _compress(const char*, size_t, char*, size_t) override;
+    bool _decompress(const char*, size_t, char*, size_t) override;
+};
+
+// Function: type
+inline Codec::Type RleCodec::type() const {
+  return RLE;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Class: ShuffleCodec
+class ShuffleCodec : public Codec {
+
+  public:
+    
+    ShuffleCodec(size_t = 4);
+
+    inline Type type() const override;
+    inline size_t width() const;
+
+  protected:
+
+    size_t _compress(const char*, size_t, char*, size_t) override;
+    bool _decompress(const char*, size_t, char*, size_t) override;
+
+  private:
+
+    const size_t _width;
+};
+
+// Function: type
+inline Codec::Type ShuffleCodec::type() const {
+  return SHUFFLE;
+}
+
+// Function: width
+inline size_t ShuffleCodec::width() const {
+  return _width;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Class: Lz4Codec
+class Lz4Codec : public Codec {
+
+  public:
+
+    static constexpr size_t HASH_LOG {12};
+    
+    inline Type type() const override;
+    
+    static size_t compress(const char*, size_t, char*, size_t);
+    static bool decompress(const char*, size_t, char*, size_t);
+
+  protected:
+
+    size_t _compress(const char*, size_t, char*, size_t) override;
+    bool _decompress(const char*, size_t, char*, size_t) override;
+};
+
+// Function: type
+inline Codec::Type Lz4Codec::type() const {
+  return LZ4;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Function: make_codec
+std::shared_ptr<Codec> make_codec(Codec::Type);
+
+};  // End of namespace dtc. ----------------------------------------------------------------------
+
+#endif
+
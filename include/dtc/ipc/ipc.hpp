@@ -16,17 +16,152 @@
 
 #include <dtc/archive/binary.hpp>
 #include <dtc/ipc/streambuf.hpp>
+#include <dtc/ipc/socket.hpp>
+#include <dtc/ipc/mailbox.hpp>
+#include <dtc/ipc/codec.hpp>
 #include <dtc/event/reactor.hpp>
 
 namespace dtc {
 
+// Class: Drainer
+// Drainer runs a stream callback repeatedly within a single activation. After each round it
+// checks the buffer: if the last synchronization made progress and did not come short (the
+// device may still have data to read, or room to write the data produced meanwhile), the
+// callback is run again on the same worker thread instead of going back to the reactor. The
+// byte budget bounds the work done per activation so a hot stream cannot starve the others. A
+// zero budget runs the callback once.
+class Drainer {
+
+  public:
+
+    struct Counters {
+      size_t num_activations {0};
+      size_t num_rounds {0};
+      size_t num_bytes {0};
+      size_t num_exhausted {0};    // activations stopped by the budget
+      size_t max_bytes {0};        // most bytes drained in a single activation
+
+      inline double bytes_per_activation() const;
+      inline double rounds_per_activation() const;
+    };
+
+    Drainer(size_t = env::stream_drain_budget());
+
+    inline size_t budget() const;
+    inline void budget(size_t);
+
+    Counters counters() const;
+
+    template <typename B, typename C>
+    Event::Signal operator()(B&, C&&);
+
+  private:
+    
+    std::atomic<size_t> _budget;
+    std::atomic<size_t> _num_activations {0};
+    std::atomic<size_t> _num_rounds {0};
+    std::atomic<size_t> _num_bytes {0};
+    std::atomic<size_t> _num_exhausted {0};
+    std::atomic<size_t> _max_bytes {0};
+
+    void _record(size_t, size_t, bool);
+};
+
+// Function: bytes_per_activation
+inline double Drainer::Counters::bytes_per_activation() const {
+  return num_activations ? static_cast<double>(num_bytes) / num_activations : 0.0;
+}
+
+// Function: rounds_per_activation
+inline double Drainer::Counters::rounds_per_activation() const {
+  return num_activations ? static_cast<double>(num_rounds) / num_activations : 0.0;
+}
+
+// Function: budget
+inline size_t Drainer::budget() const {
+  return _budget.load(std::memory_order_relaxed);
+}
+
+// Procedure: budget
+inline void Drainer::budget(size_t b) {
+  _budget.store(b, std::memory_order_relaxed);
+}
+
+// Operator: ()
+template <typename B, typename C>
+Event::Signal Drainer::operator()(B& buf, C&& c) {
+
+  auto state = [&buf] () { 
+    auto lock = buf._lock();
+    return std::make_pair(buf._num_synced, buf._drainable());
+  };
+  
+  auto budget = _budget.load(std::memory_order_relaxed);
+  auto beg = state().first;
+  auto cur = beg;
+  auto num_rounds = size_t {0};
+  auto exhausted = false;
+  auto signal = Event::DEFAULT;
+
+  while(1) {
+    
+    ++num_rounds;
+
+    if(signal = c(); signal != Event::DEFAULT) {
+      cur = state().first;
+      break;
+    }
+
+    auto [synced, drainable] = state();
+
+    // Stop on no progress, on a short sync (the device would block), or once the budget has 
+    // been spent.
+    if(synced == cur || !drainable || budget == 0) {
+      cur = synced;
+      break;
+    }
+
+    if(cur = synced; cur - beg >= budget) {
+      exhausted = true;
+      break;
+    }
+  }
+
+  _record(cur - beg, num_rounds, exhausted);
+
+  return signal;
+}
+
+//-------------------------------------------------------------------------------------------------
+
 // Class: InputStream
+// An istream over a mailbox takes the typed messages as they are when the types match, and
+// goes through the binary archive otherwise. A typed message reports only the header size.
+// An istream with a codec decodes the complete frames of the buffer before unpacking. A batched
+// istream takes the messages of the batches one at a time, each behind a varint length.
 class InputStream : public ReadEvent {
 
+  private:
+
+    Mailbox* _mailbox {nullptr};
+
+    std::shared_ptr<Codec> _codec;
+
+    InputStreamBuffer _decoded;
+
+    bool _batched {false};
+
+    void _unparcel();
+    void _decode();
+
+    bool _peek(InputStreamBuffer&, size_t&, size_t&) const;
+
   public:
 
     InputStreamBuffer isbuf;
 
+    Drainer drainer;
+
     template <typename C>
     InputStream(std::shared_ptr<Device>, C&&);
 
@@ -35,6 +170,14 @@ class InputStream : public ReadEvent {
     template <typename... T>
     std::streamsize operator()(T&&...);
 
+    std::streamsize sync();
+
+    inline void codec(std::shared_ptr<Codec>);
+    inline const std::shared_ptr<Codec>& codec() const;
+
+    inline void batch(bool);
+    inline bool batched() const;
+
     operator bool ();
 };
 
@@ -44,41 +187,145 @@ InputStream::InputStream(std::shared_ptr<Device> device, C&& c) :
   ReadEvent {
     device,
     [this, c=std::forward<C>(c)] (Event& e) mutable {
-      if constexpr(std::is_same_v<std::invoke_result_t<C, InputStream&>, Event::Signal>) {
-        return c(*this);
-      }
-      else {
-        c(*this);
-        return Event::DEFAULT;
-      }
+      return drainer(isbuf, [&] () {
+        if constexpr(std::is_same_v<std::invoke_result_t<C, InputStream&>, Event::Signal>) {
+          return c(*this);
+        }
+        else {
+          c(*this);
+          return Event::DEFAULT;
+        }
+      });
     }
   },
-  isbuf {device.get(), nullptr} {
+  _mailbox {dynamic_cast<Mailbox*>(device.get())},
+  isbuf {_mailbox ? nullptr : device.get(), nullptr} {
+
+  // The completions of zerocopy sends wake the reads of the socket through its error queue, 
+  // which a receive ahead would not see.
+  if(auto socket = dynamic_cast<Socket*>(device.get()); socket && socket->zerocopy() == 0) {
+    _read_ahead = true;
+  }
 }
 
 // Operator
 template <typename... T>
 std::streamsize InputStream::operator()(T&&... t) {
+
+  if(_mailbox) {
+
+    std::scoped_lock lock(isbuf._mutex);
+
+    auto& inbox = _mailbox->_inbox;
+
+    if constexpr((Mailbox::is_parcelable_v<T> && ...)) {
+      if(isbuf._in_avail() == 0 && !inbox.empty()) {
+        if(auto p = dynamic_cast<Mailbox::Parcel<std::decay_t<T>...>*>(inbox.front().get()); p) {
+          std::tie(t...) = std::move(p->data);
+          inbox.pop_front();
+          return sizeof(std::streamsize);
+        }
+      }
+    }
+    
+    // Types differ from the message; take the bytes through the archive.
+    while(!inbox.empty() && !BinaryInputPackager(isbuf)) {
+      _unparcel();
+    }
+  }
+  else if(_batched) {
+
+    std::scoped_lock lock(isbuf._mutex);
+
+    auto& buf = _codec ? (_decode(), _decoded) : isbuf;
+    
+    size_t len, prefix;
+
+    if(!_peek(buf, len, prefix)) {
+      return -1;
+    }
+    
+    buf._drop(prefix);
+    
+    // Skip what the given types leave of the message.
+    if(auto n = BinaryInputArchiver(buf)(std::forward<T>(t)...); n >= 0 && static_cast<size_t>(n) < len) {
+      buf._drop(len - n);
+    }
+
+    return static_cast<std::streamsize>(prefix + len);
+  }
+  else if(_codec) {
+    std::scoped_lock lock(isbuf._mutex);
+    _decode();
+    return BinaryInputPackager(_decoded)(std::forward<T>(t)...);
+  }
+
   return BinaryInputPackager(isbuf)(std::forward<T>(t)...);
 }
 
+// Procedure: codec
+// Set the codec of the stream. This must be done before the stream is inserted into a reactor.
+inline void InputStream::codec(std::shared_ptr<Codec> c) {
+  _codec = std::move(c);
+}
+
+// Function: codec
+inline const std::shared_ptr<Codec>& InputStream::codec() const {
+  return _codec;
+}
+
+// Procedure: batch
+// Take the messages in batches. This must be done before the stream is inserted into a reactor.
+inline void InputStream::batch(bool flag) {
+  _batched = flag;
+}
+
+// Function: batched
+inline bool InputStream::batched() const {
+  return _batched;
+}
+
 //-------------------------------------------------------------------------------------------------
 
 // Class: OutputStream 
+// An ostream with a codec packages each message aside and writes it to the buffer as a frame.
+//
+// A batched ostream collects the messages behind varint lengths instead of fixed-size headers, 
+// and hands the batch to the buffer (through the codec if any) once it reaches the batch size
+// or has waited for the batch delay, whichever comes first.
 class OutputStream : public WriteEvent {
 
   private:
     
-    bool _disabled {false};
-    bool _notified {false};
+    Mailbox* _mailbox {nullptr};
+
+    std::shared_ptr<Codec> _codec;
+
+    size_t _batch_size {0};
+    std::chrono::microseconds _batch_delay {0};
+    bool _batch_armed {false};
+
+    OutputStreamBuffer _batch;
+    OutputStreamBuffer _scratch;
+
+    void _append_batch();
+    void _flush_batch();
+
+    std::atomic<bool> _disabled {false};
+    std::atomic<bool> _notified {false};
     bool _notify();
 
+    bool _reap_armed {false};
+    std::chrono::microseconds _reap_delay {0};
+
     Event::Signal _remove_on_flush();
     
   public:
     
     OutputStreamBuffer osbuf;
 
+    Drainer drainer;
+
     template <typename C>
     OutputStream(std::shared_ptr<Device>, C&&);
 
@@ -88,6 +335,14 @@ class OutputStream : public WriteEvent {
     std::streamsize operator()(T&&...);
     
     void remove_on_flush();
+
+    bool notify();
+
+    inline void codec(std::shared_ptr<Codec>);
+    inline const std::shared_ptr<Codec>& codec() const;
+
+    inline void batch(size_t, std::chrono::microseconds);
+    inline bool batched() const;
 };
 
 // Constructor.
@@ -101,17 +356,22 @@ OutputStream::OutputStream(std::shared_ptr<Device> device, C&& c) :
       
         assert(_notified == true);
 
-        if constexpr(std::is_same_v<std::invoke_result_t<C, OutputStream&>, Event::Signal>) {
-          if(auto s = c(*this); s != Event::DEFAULT) {
-            return s;
+        auto s = drainer(osbuf, [&] () {
+          if constexpr(std::is_same_v<std::invoke_result_t<C, OutputStream&>, Event::Signal>) {
+            return c(*this);
           }
-        }
-        else {
-          c(*this);
+          else {
+            c(*this);
+            return Event::DEFAULT;
+          }
+        });
+
+        if(s != Event::DEFAULT) {
+          return s;
         }
 
         // We have to unmark the flag at the very end.
-        std::lock_guard lock(osbuf._mutex);
+        auto lock = osbuf._lock();
         _notified = false;
         _notify();
 
@@ -122,15 +382,68 @@ OutputStream::OutputStream(std::shared_ptr<Device> device, C&& c) :
       }
     }
   },
-  osbuf {device.get(), [this](){_notify();}} {
+  _mailbox {dynamic_cast<Mailbox*>(device.get())},
+  osbuf {_mailbox ? nullptr : device.get(), [this](){_notify();}} {
 }
 
 // Operator: ()
 template <typename... T>
 std::streamsize OutputStream::operator()(T&&... t) {
+
+  if(_mailbox) {
+    if constexpr((Mailbox::is_parcelable_v<T> && ...)) {
+      _mailbox->push(new Mailbox::Parcel<std::decay_t<T>...>(std::forward<T>(t)...));
+      return sizeof(std::streamsize);
+    }
+    else {
+      auto packet = std::make_unique<Mailbox::Packet>();
+      auto sz = BinaryOutputPackager(packet->osbuf)(std::forward<T>(t)...);
+      _mailbox->push(packet.release());
+      return sz;
+    }
+  }
+  else if(_batch_size) {
+    std::scoped_lock lock(osbuf._mutex);
+    auto sz = BinaryOutputArchiver(_scratch)(std::forward<T>(t)...);
+    _append_batch();
+    return sz;
+  }
+  else if(_codec) {
+    OutputStreamBuffer raw;
+    auto sz = BinaryOutputPackager(raw)(std::forward<T>(t)...);
+    std::string frame;
+    _codec->encode(raw.string_view(), frame);
+    osbuf.write(frame.data(), frame.size());
+    return sz;
+  }
+
   return BinaryOutputPackager(osbuf)(std::forward<T>(t)...);
 }
 
+// Procedure: codec
+// Set the codec of the stream. This must be done before the stream is inserted into a reactor.
+inline void OutputStream::codec(std::shared_ptr<Codec> c) {
+  _codec = std::move(c);
+}
+
+// Function: codec
+inline const std::shared_ptr<Codec>& OutputStream::codec() const {
+  return _codec;
+}
+
+// Procedure: batch
+// Collect the messages in batches of the given size and delay (zero size disables batching). 
+// This must be done before the stream is inserted into a reactor.
+inline void OutputStream::batch(size_t size, std::chrono::microseconds delay) {
+  _batch_size = size;
+  _batch_delay = delay;
+}
+
+// Function: batched
+inline bool OutputStream::batched() const {
+  return _batch_size != 0;
+}
+
 
 }  // End of namespace dtc. -----------------------------------------------------------------------
 
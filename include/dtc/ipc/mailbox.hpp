@@ -0,0 +1,134 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright (c) 2018, Tsung-Wei Huang and Martin D. F. Wong,                 *
+ * University of Illinois at Urbana-Champaign (UIUC), IL, USA.                *
+ *                                                                            *
+ * All Rights Reserved.                                                       *
+ *                                                                            *
+ * This program is free software. You can redistribute and/or modify          *
+ * it in accordance with the terms of the accompanying license agreement.     *
+ * See LICENSE in the top-level directory for details.                        *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef DTC_IPC_MAILBOX_HPP_
+#define DTC_IPC_MAILBOX_HPP_
+
+#include <sys/eventfd.h>
+#include <dtc/archive/binary.hpp>
+#include <dtc/ipc/streambuf.hpp>
+
+namespace dtc {
+
+// Class: Mailbox
+//
+// In-process channel of an intra stream. The writer posts typed messages that the reader moves
+// out as they are, with no serialization and no system call per message. Messages go through 
+// an intrusive lock-free MPSC queue (Vyukov), so any thread may post while the read event of
+// the stream consumes.
+//
+// The device of the mailbox is an eventfd that wakes the read event. The writer signals it only
+// when the reader has announced a wait, i.e., once per activation of the reader rather than 
+// once per message.
+//
+// Types that cannot be held in a message (arrays, pointers, types that cannot be constructed
+// from the argument) are packaged by the writer as usual. A message the reader extracts with 
+// different types is packaged at that point. Both fall back to the binary archive.
+//
+class Mailbox : public Device {
+
+  friend class InputStream;
+  friend class OutputStream;
+
+  public:
+
+    // Struct: Message
+    struct Message {
+      std::atomic<Message*> next {nullptr};
+      virtual ~Message() = default;
+      virtual void archive(OutputStreamBuffer&) {}
+    };
+
+    // Struct: Parcel
+    // A message holding the objects given to the ostream.
+    template <typename... T>
+    struct Parcel : Message {
+
+      std::tuple<T...> data;
+
+      template <typename... U>
+      Parcel(U&&... u) : data {std::forward<U>(u)...} {
+      }
+
+      void archive(OutputStreamBuffer& osbuf) override {
+        std::apply([&] (auto&... d) { BinaryOutputPackager{osbuf}(d...); }, data);
+      }
+    };
+
+    // Struct: Packet
+    // A message holding the packaged bytes of objects that cannot be parceled.
+    struct Packet : Message {
+
+      OutputStreamBuffer osbuf;
+
+      void archive(OutputStreamBuffer& rhs) override {
+        auto sv = osbuf.string_view();
+        rhs.write(sv.data(), sv.size());
+      }
+    };
+
+    template <typename T>
+    static constexpr bool is_parcelable_v = 
+      !std::is_array_v<std::remove_reference_t<T>> &&
+      !std::is_pointer_v<std::decay_t<T>> &&
+      std::is_constructible_v<std::decay_t<T>, T&&>;
+
+    Mailbox(int);
+    
+    Mailbox(Mailbox&&) = delete;
+    Mailbox(const Mailbox&) = delete;
+    
+    Mailbox& operator = (Mailbox&&) = delete;
+    Mailbox& operator = (const Mailbox&) = delete;
+
+    ~Mailbox();
+
+    void push(Message*);
+    void close();
+
+    inline bool closed() const;
+
+  private:
+
+    struct Stub : Message {
+    };
+
+    alignas(64) std::atomic<Message*> _head;
+    alignas(64) Message* _tail;
+
+    Stub _stub;
+
+    std::atomic<bool> _waiting {true};
+    std::atomic<bool> _closed {false};
+
+    std::deque<std::unique_ptr<Message>> _inbox;     // consumer side
+
+    void _enqueue(Message*);
+
+    Message* _pop();
+
+    std::streamsize _sync();
+};
+
+// Function: closed
+inline bool Mailbox::closed() const {
+  return _closed.load(std::memory_order_acquire);
+}
+
+// Function: make_mailbox
+std::shared_ptr<Mailbox> make_mailbox();
+
+};  // End of namespace dtc. ----------------------------------------------------------------------
+
+#endif
+
@@ -14,20 +14,50 @@
 #ifndef DTC_IPC_SHM_HPP_
 #define DTC_IPC_SHM_HPP_
 
-#include <dtc/concurrent/fifo.hpp>
 #include <dtc/device.hpp>
 
 namespace dtc {
 
-/*
 // Class: SharedMemory
+//
+// One end of a single-producer single-consumer byte ring in a memfd mapping. The two ends may
+// live in different processes on the same host; data move with a memcpy into and out of the 
+// ring instead of through the kernel socket buffers.
+//
+// Each end waits on a descriptor of its own, which is the fd of the device, and signals the 
+// descriptor of its peer. The read end waits on one end of a unix socket pair that becomes 
+// readable when the writer sends a wake-up byte after publishing data. The write end waits on 
+// an eventfd that is kept unwritable while the ring is full (the counter is armed to its 
+// maximum) and is reset by the reader once space is freed, so both ends fit the level-triggered
+// read and write events of the reactor. An end only signals its peer when the peer has 
+// announced it is about to wait.
+//
+// The ring is closed once every process holding an end of one side has dropped it. A reader 
+// then drains what remains and gets EPIPE; a writer gets EPIPE right away. A process killed 
+// before it can drop its reference leaves the count of the ring behind, but the kernel closes
+// its descriptors: the socket of the reader reads EOF once no writer holds the other end, and
+// the writer sees that end hang up once no reader holds the socket.
+//
 class SharedMemory : public Device {
 
+  friend std::tuple<std::shared_ptr<SharedMemory>, std::shared_ptr<SharedMemory>> 
+  make_shared_memory(size_t);
+
+  struct Ring {
+    alignas(64) std::atomic<uint64_t> head;      // read position, owned by the reader
+    alignas(64) std::atomic<uint64_t> tail;      // write position, owned by the writer
+    alignas(64) std::atomic<uint32_t> rwait;     // the reader is about to wait for data
+    std::atomic<uint32_t> wwait;                 // the writer armed its eventfd on a full ring
+    std::atomic<uint32_t> refs[2];               // references to the read and write ends
+    uint64_t capacity;
+  };
+
+  static constexpr size_t HEADER_SIZE {4096};
+
   public:
     
-    using fifo_type = std::array<char, BUFSIZ>;
+    SharedMemory(int, int, int, std::ios_base::openmode);
     
-    SharedMemory(int);
     SharedMemory(SharedMemory&&) = delete;
     SharedMemory(const SharedMemory&) = delete;
     
@@ -36,34 +66,66 @@ class SharedMemory : public Device {
   
     ~SharedMemory();
     
-    std::streamsize read(void*, std::streamsize);
-    std::streamsize write(const void*, std::streamsize);
+    std::streamsize read(void*, std::streamsize) const override final;
+    std::streamsize write(const void*, std::streamsize) const override final;
+    std::streamsize readv(const struct iovec*, int) const override final;
+    std::streamsize writev(const struct iovec*, int) const override final;
+
+    Device& open_on_exec(bool) override final;
+
+    void share();
+
+    inline int peer_fd() const;
+    inline int memfd() const;
+    inline size_t capacity() const;
+    inline bool is_reader() const;
   
   private:  
-    
-    //std::array<char, BUFSIZ> _fifo;
-    ConcurrentFIFO<char, BUFSIZ> _fifo;
 
-    //std::unique_ptr<fifo_type, std::function<void(fifo_type*)>> _fifo {_allocate()};
-    //std::streamsize _w_ptr {1};
-    //std::streamsize _r_ptr {0};
-    //std::streamsize _bufcpy(void*, const void*, std::streamsize);
+    const int _peer_fd;
+    const int _memfd;
+    const std::ios_base::openmode _mode;
 
-    bool _notify();
-    
-    //static std::unique_ptr<fifo_type, std::function<void(fifo_type*)>> _allocate();
-};
+    Ring* _ring {nullptr};
+    char* _data {nullptr};
+    size_t _mask {0};
 
-// Function: _bufcpy
-//inline std::streamsize SharedMemory::_bufcpy(void* to , const void* from , std::streamsize num){
-//  std::memcpy(to, from, num);
-//  return num;
-//}
+    std::streamsize _read(const struct iovec*, int) const;
+    std::streamsize _write(const struct iovec*, int) const;
 
+    bool _wait(short) const;
+    void _signal_reader() const;
+    void _signal_writer() const;
+};
 
-// Function: make_shared_memory
-std::shared_ptr<SharedMemory> make_shared_memory(); */
+// Function: peer_fd
+// Return the descriptor signaled by this end: the eventfd of the writer for a reader, and the 
+// writer end of the socket pair of the reader for a writer.
+inline int SharedMemory::peer_fd() const {
+  return _peer_fd;
+}
+
+// Function: memfd
+// Return the memfd holding the ring.
+inline int SharedMemory::memfd() const {
+  return _memfd;
+}
+
+// Function: capacity
+inline size_t SharedMemory::capacity() const {
+  return _mask + 1;
+}
+
+// Function: is_reader
+inline bool SharedMemory::is_reader() const {
+  return _mode & std::ios_base::in;
+}
 
+// Function: make_shared_memory
+// Create the read and write ends of a ring of the given capacity (rounded up to a power of two).
+std::tuple<std::shared_ptr<SharedMemory>, std::shared_ptr<SharedMemory>> make_shared_memory(
+  size_t = env::shm_ring_capacity()
+);
 
 };  // End of namespace dtc. --------------------------------------------------------------
 
@@ -82,6 +82,11 @@ namespace dtc {
 // Class: Socket
 // Basic wrapper for a socket device. A socket is a device that support ::read/::write through the
 // network. By default the socket uses TCP stream to perform message passing.
+//
+// A TCP socket can send large writes with MSG_ZEROCOPY. The kernel then reads the pages of the
+// data in place and reports on the error queue of the socket, by the ids of the sends in order,
+// when it is done with them; the data must stay untouched until then. The error queue makes the
+// socket readable, so the reads of the socket collect the completions on the way.
 class Socket : public Device {
 
   public:
@@ -95,7 +100,7 @@ class Socket : public Device {
     Socket& operator = (Socket&&) = delete;
     Socket& operator = (const Socket&) = delete;
   
-    ~Socket() = default;
+    ~Socket();
     
     bool is_connected() const;
     bool is_listener() const;
@@ -104,14 +109,48 @@ class Socket : public Device {
 
     std::pair<std::string, std::string> peer_host() const;
     std::pair<std::string, std::string> this_host() const;
+
+    std::streamsize read(void*, std::streamsize) const override;
+    std::streamsize readv(const struct iovec*, int) const override;
+    std::streamsize writev_zerocopy(const struct iovec*, int, std::optional<uint32_t>&) const;
+
+    bool zerocopy(size_t);
+
+    uint32_t reap_zerocopy() const;
+
+    void hold_zerocopy(uint32_t, std::shared_ptr<void>) const;
+
+    inline size_t zerocopy() const;
+    inline uint32_t num_zerocopy_completed() const;
+
+  private:
+
+    size_t _zerocopy {0};   // least bytes of a zerocopy write (zero for none)
+
+    mutable uint32_t _num_zerocopy_sent {0};
+    mutable std::atomic<uint32_t> _num_zerocopy_completed {0};
+    mutable std::mutex _zerocopy_mutex;
+    mutable std::vector<std::pair<uint32_t, uint32_t>> _zerocopy_ranges;  // completed out of order
+    mutable std::vector<std::pair<uint32_t, std::shared_ptr<void>>> _zerocopy_held;
 };
 
+// Function: zerocopy
+inline size_t Socket::zerocopy() const {
+  return _zerocopy;
+}
+
+// Function: num_zerocopy_completed
+// Return the number of zerocopy sends completed so far. The sends of smaller ids are all done.
+inline uint32_t Socket::num_zerocopy_completed() const {
+  return _num_zerocopy_completed.load(std::memory_order_acquire);
+}
+
 template <typename... Ts>
 Socket::Socket(Ts&&... ts) : Device {std::forward<Ts>(ts)...} {}
 
 std::tuple<std::string, std::string> to_host(struct sockaddr&, size_t) noexcept;
 
-std::shared_ptr<Socket> make_socket_server(std::string_view);
+std::shared_ptr<Socket> make_socket_server(std::string_view, bool = false);
 std::shared_ptr<Socket> make_socket_client(std::string_view, std::string_view);
 
 std::tuple<std::shared_ptr<Socket>, std::shared_ptr<Socket>> make_socket_pair();
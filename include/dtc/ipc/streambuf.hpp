@@ -16,20 +16,251 @@
 
 #include <dtc/device.hpp>
 #include <dtc/static/logger.hpp>
+#include <dtc/concurrent/mutex.hpp>
 
 namespace dtc {
 
-// Small buffer optimization.
-union LocalStreamBuffer {
-  std::streamsize value;
-  char alignment[32];
+// Struct: StreamBlock
+// Header of a block of stream buffer memory. The data follow the header.
+struct StreamBlock {
+
+  StreamBlock* next {nullptr};
+  size_t capacity {0};
+
+  inline char* data() noexcept { return reinterpret_cast<char*>(this + 1); }
+  inline const char* data() const noexcept { return reinterpret_cast<const char*>(this + 1); }
+};
+
+// Class: StreamBlockPool
+// Process-wide free list of the fixed-size blocks the stream buffers are chained from. Blocks
+// are recycled instead of being returned to the allocator, so a stream in steady state does not
+// allocate. Blocks larger than BLOCK_CAPACITY (see StreamBlockChain::linearize) bypass the pool.
+//
+// The pool gives memory back in two ways. A block freed while the memory of the pool (blocks in
+// use and free) is over the cap (DTC_STREAM_BUFFER_CAP) goes back to the allocator. And every
+// idle period (DTC_STREAM_BUFFER_IDLE) the free blocks that were not taken during the whole
+// period, i.e., the low-water mark of the free list, are released.
+class StreamBlockPool : public EnableSingletonFromThis<StreamBlockPool> {
+
+  friend class EnableSingletonFromThis<StreamBlockPool>;
+
+  using clock_type = std::chrono::steady_clock;
+
+  public:
+
+    static constexpr size_t BLOCK_CAPACITY {16384};
+
+    StreamBlock* allocate(size_t = BLOCK_CAPACITY);
+
+    void deallocate(StreamBlock*) noexcept;
+
+    size_t num_free() const;
+    size_t memory() const;
+    size_t peak_memory() const;
+    size_t cap() const;
+    size_t shrink() noexcept;
+
+    clock_type::duration idle() const;
+
+    void cap(size_t);
+    void idle(clock_type::duration);
+
+  private:
+
+    StreamBlockPool();
+
+    mutable SpinLock _mutex;
+
+    StreamBlock* _free {nullptr};
+
+    size_t _num_free {0};
+    size_t _min_free {0};       // low-water mark of the free list in this idle period
+    size_t _memory {0};         // bytes of the blocks in use and free
+    size_t _peak_memory {0};
+    size_t _cap;
+
+    clock_type::duration _idle;
+    clock_type::time_point _epoch {clock_type::now()};
+
+    StreamBlock* _release(size_t) noexcept;
 };
 
+// Class: StreamBlockChain
+// Byte queue over a singly-linked chain of pooled blocks. Data are appended at the tail block
+// and consumed from the head block; blocks linked past the tail are spares taken by reserve.
+// Growing the queue never moves the bytes already in it, a fully consumed block goes back to
+// the pool at once, and an empty chain holds no block at all.
+//
+// head ------------------- tail ----- spares
+// [begin ... ] [ ... ] [ ... end]   [ ] [ ]
+//
+class StreamBlockChain {
+
+  public:
+
+    // Most segments handed to one readv/writev.
+    static constexpr int MAX_IOVECS {64};
+
+    StreamBlockChain() = default;
+    StreamBlockChain(const StreamBlockChain&) = delete;
+    StreamBlockChain(StreamBlockChain&&) noexcept;
+
+    ~StreamBlockChain();
+
+    StreamBlockChain& operator = (const StreamBlockChain&) = delete;
+    StreamBlockChain& operator = (StreamBlockChain&&) noexcept;
+
+    inline size_t size() const noexcept;
+    inline size_t memory() const noexcept;
+    inline size_t peak_memory() const noexcept;
+
+    void write(const void*, size_t);
+    void append(const StreamBlockChain&);
+    void overwrite(size_t, const void*, size_t) noexcept;
+    void commit(size_t) noexcept;
+    void clear() noexcept;
+
+    size_t copy(void*, size_t) const noexcept;
+    size_t read(void*, size_t) noexcept;
+    size_t drop(size_t) noexcept;
+
+    int gather(struct iovec*, int, size_t = 0) const noexcept;
+    int reserve(struct iovec*, int, size_t);
+
+    char* linearize();
+
+  private:
+
+    StreamBlock* _head {nullptr};
+    StreamBlock* _tail {nullptr};
+
+    size_t _begin {0};    // read offset in the head block
+    size_t _end {0};      // write offset in the tail block
+    size_t _size {0};
+    size_t _memory {0};         // bytes of the blocks held, spares included
+    size_t _peak_memory {0};
+
+    StreamBlock* _acquire(size_t = StreamBlockPool::BLOCK_CAPACITY);
+
+    void _release(StreamBlock*) noexcept;
+    void _extend();
+};
+
+// Function: size
+inline size_t StreamBlockChain::size() const noexcept {
+  return _size;
+}
+
+// Function: memory
+inline size_t StreamBlockChain::memory() const noexcept {
+  return _memory;
+}
+
+// Function: peak_memory
+inline size_t StreamBlockChain::peak_memory() const noexcept {
+  return _peak_memory;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Class: StreamBlockQueue
+// Single-producer single-consumer byte queue over a chain of pooled blocks. The producer owns the
+// tail and the consumer owns the head; the two sides meet only on the published and consumed
+// byte counts, so neither takes a lock. Data written are invisible to the consumer until they 
+// are published (a release of the written count), and may be overwritten until then. The 
+// consumer returns a block to the pool once it has consumed the block and needs data published
+// past it, at which point the producer has moved on to the next block.
+//
+// head -------------------- mark -------------------- tail
+// [begin ...   published     ][      unpublished       end]
+//
+class StreamBlockQueue {
+
+  public:
+
+    StreamBlockQueue() = default;
+    StreamBlockQueue(const StreamBlockQueue&) = delete;
+    StreamBlockQueue(StreamBlockQueue&&) = delete;
+
+    ~StreamBlockQueue();
+
+    StreamBlockQueue& operator = (const StreamBlockQueue&) = delete;
+    StreamBlockQueue& operator = (StreamBlockQueue&&) = delete;
+
+    inline size_t size() const noexcept;
+    inline size_t memory() const noexcept;
+    inline size_t peak_memory() const noexcept;
+
+    // Producer side
+    void write(const void*, size_t);
+    void overwrite(size_t, const void*, size_t) noexcept;
+    size_t publish() noexcept;
+
+    // Consumer side
+    size_t copy(void*, size_t) const noexcept;
+    size_t drop(size_t) noexcept;
+    int gather(struct iovec*, int) const noexcept;
+
+  private:
+
+    // Producer side.
+    StreamBlock* _tail {nullptr};
+    StreamBlock* _mark {nullptr};   // block of the first unpublished byte
+    size_t _end {0};                // write offset in the tail block
+    size_t _offset {0};             // offset of the first unpublished byte in the mark block
+    size_t _written {0};            // bytes written so far
+
+    // Consumer side (the head is set once by the producer before the first publish).
+    alignas(64) StreamBlock* _head {nullptr};
+    size_t _begin {0};              // read offset in the head block
+
+    alignas(64) std::atomic<size_t> _published {0};
+    alignas(64) std::atomic<size_t> _consumed {0};
+    
+    std::atomic<size_t> _memory {0};
+    std::atomic<size_t> _peak_memory {0};
+
+    StreamBlock* _acquire();
+
+    void _release(StreamBlock*) noexcept;
+};
+
+// Function: size
+// Return the bytes published and not yet consumed. Either side may ask.
+inline size_t StreamBlockQueue::size() const noexcept {
+  return _published.load() - _consumed.load();
+}
+
+// Function: memory
+inline size_t StreamBlockQueue::memory() const noexcept {
+  return _memory.load(std::memory_order_relaxed);
+}
+
+// Function: peak_memory
+inline size_t StreamBlockQueue::peak_memory() const noexcept {
+  return _peak_memory.load(std::memory_order_relaxed);
+}
+
+//-------------------------------------------------------------------------------------------------
+
 // OutputStreamBuffer.
+//
+// The buffer is locked by default so any number of threads can write into it while the reactor
+// syncs it. A buffer switched to single writer instead keeps its data in a StreamBlockQueue and
+// takes no lock: the writes must come from one thread at a time and the syncs from another.
+//
+// A locked buffer on a zerocopy socket hands the large syncs to the kernel with MSG_ZEROCOPY.
+// The data of such a send stay at the head of the chain, with the data sent after them, until 
+// the socket reports the send completed; they count as data in the buffer until then.
+//
+// head ---------------------------------------------- tail
+// [ in flight (zerocopy) ][ in flight ][     unsent      ]
+//
 class OutputStreamBuffer {
 
   friend class OutputStream;
   friend class InputStreamBuffer;
+  friend class Drainer;
   friend class BinaryOutputArchiver;
   friend class BinaryOutputPackager;
 
@@ -52,32 +283,68 @@ class OutputStreamBuffer {
     std::streamsize write(const void*, std::streamsize);
     std::streamsize copy(void*, std::streamsize) const;
 
+    size_t memory() const;
+    size_t peak_memory() const;
+
     inline void device(Device*);
     inline Device* device() const;
 
-    inline std::string_view string_view() const;
+    inline bool single_writer() const;
+
+    void single_writer(bool);
+
+    std::string_view string_view();
 
   private:
 
+    // Class: WriteLock
+    // Scope of a write. A locked buffer holds its mutex over the scope. A single-writer buffer
+    // publishes the data as the outermost scope closes, so the syncer never sees a packet whose
+    // size header is still to be rewritten.
+    class WriteLock {
+
+      public:
+
+        inline explicit WriteLock(OutputStreamBuffer&);
+        inline ~WriteLock();
+
+      private:
+
+        OutputStreamBuffer& _osbuf;
+        std::unique_lock<std::recursive_mutex> _lock;
+    };
+
     mutable std::recursive_mutex _mutex;
     
     Device* _device {nullptr};
     
     std::function<void()> _on_write;
 
-    LocalStreamBuffer _size {sizeof(LocalStreamBuffer) - sizeof(char)};
-    char* _data  {reinterpret_cast<char*>(&_size) + sizeof(char)};
-    char* _pbase {_data};
-    char* _pptr  {_data};
-    char* _epptr {_data + _size.value};
+    size_t _num_synced {0};   // bytes moved to the device so far
+    bool _drained {false};    // the last sync came short (the device would block)
+
+    StreamBlockChain _chain;
+
+    std::unique_ptr<StreamBlockQueue> _queue;   // in place of the chain for a single writer
+    size_t _num_scopes {0};                     // write scopes open on a single-writer buffer
+
+    std::deque<std::pair<uint32_t, size_t>> _inflight;    // zerocopy ids and the bytes they hold
+    size_t _num_inflight {0};                             // bytes sent but held for zerocopy
     
-    bool _is_local_data() const noexcept;
+    bool _drainable() const noexcept;
+    bool _syncable() const noexcept;
+
+    std::unique_lock<std::recursive_mutex> _lock() const;
 
     std::streamsize _flush();
     std::streamsize _sync();
     std::streamsize _out_avail() const noexcept;
     std::streamsize _write(const void*, std::streamsize);
     std::streamsize _copy(void*, std::streamsize) const noexcept;
+    
+    void _rewrite(std::streamsize, const void*, std::streamsize) noexcept;
+    void _publish();
+    void _reap();
 };
 
 template <typename C>
@@ -91,12 +358,30 @@ inline Device* OutputStreamBuffer::device() const {
 }
 
 inline void OutputStreamBuffer::device(Device* d) {
-  std::scoped_lock lock(_mutex);
+  auto lock = _lock();
   _device = d;
 }
 
-inline std::string_view OutputStreamBuffer::string_view() const {
-  return {_pbase, static_cast<typename std::string_view::size_type>(_pptr - _pbase)};
+// Function: single_writer
+inline bool OutputStreamBuffer::single_writer() const {
+  return _queue != nullptr;
+}
+
+// Constructor
+inline OutputStreamBuffer::WriteLock::WriteLock(OutputStreamBuffer& osbuf) : _osbuf {osbuf} {
+  if(_osbuf._queue) {
+    ++_osbuf._num_scopes;
+  }
+  else {
+    _lock = std::unique_lock(_osbuf._mutex);
+  }
+}
+
+// Destructor
+inline OutputStreamBuffer::WriteLock::~WriteLock() {
+  if(_osbuf._queue && --_osbuf._num_scopes == 0) {
+    _osbuf._publish();
+  }
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -106,6 +391,7 @@ class InputStreamBuffer {
 
   friend class InputStream;
   friend class OutputStreamBuffer;
+  friend class Drainer;
   friend class BinaryInputArchiver;
   friend class BinaryInputPackager;
   
@@ -130,28 +416,36 @@ class InputStreamBuffer {
     std::streamsize copy(void*, std::streamsize) const;
     std::streamsize drop(std::streamsize);
 
+    size_t memory() const;
+    size_t peak_memory() const;
+
     inline Device* device() const;
     
     inline void device(Device*);
 
-    inline std::string_view string_view() const;
+    std::string_view string_view();
     
   private:  
     
+    static constexpr size_t MAX_WINDOW {StreamBlockChain::MAX_IOVECS * StreamBlockPool::BLOCK_CAPACITY};
+    
     mutable std::recursive_mutex _mutex;
     
     Device* _device {nullptr};
 
     std::function<void()> _on_read;
 
-    LocalStreamBuffer _size {sizeof(LocalStreamBuffer) - sizeof(char)};
-    char* _data  {reinterpret_cast<char*>(&_size) + sizeof(char)};
-    char* _eback {_data};
-    char* _gptr  {_data};
-    char* _egptr {_data};
+    size_t _num_synced {0};   // bytes moved from the device so far
+    bool _drained {false};    // the last sync came short of filling the buffer
+
+    StreamBlockChain _chain;
+
+    size_t _window {StreamBlockPool::BLOCK_CAPACITY};   // bytes asked of the device per sync
     
-    bool _is_local_data() const noexcept;
+    bool _drainable() const noexcept;
     
+    std::unique_lock<std::recursive_mutex> _lock() const;
+
     std::streamsize _purge();
     std::streamsize _in_avail() const noexcept;
     std::streamsize _sync();
@@ -174,10 +468,6 @@ inline void InputStreamBuffer::device(Device* d) {
   _device = d;
 }
 
-inline std::string_view InputStreamBuffer::string_view() const {
-  return {_gptr, static_cast<typename std::string_view::size_type>(_egptr - _gptr)};
-}
-
 //-------------------------------------------------------------------------------------------------
 
 template <typename... Ts>
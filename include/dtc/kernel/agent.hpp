@@ -79,12 +79,13 @@ class Agent : public KernelBase {
   struct Frontier {
     key_type graph;
     key_type stream;
-    std::shared_ptr<Socket> socket;
+    std::shared_ptr<Device> device;
   };
     
   struct Hatchery {
     size_t num_inter_streams;
     std::list<Frontier> frontiers;
+    std::list<Frontier> colocated;    // write ends of the rings to the co-located tails
     std::shared_ptr<Socket> stdout;
     std::shared_ptr<Socket> stderr;
   };
@@ -94,6 +95,7 @@ class Agent : public KernelBase {
     Container container;
     std::shared_ptr<InputStream> istream;
     std::shared_ptr<OutputStream> ostream;
+    pb::TaskInfo report;    // the latest counters reported by the executor
   };
   
   struct Task {
@@ -53,11 +53,13 @@ class Executor : public KernelBase {
     void _make_graph(pb::Topology*);
     void _insert_vertices(pb::Topology*);
     void _insert_streams(pb::Topology*);
-    void _insert_istream(Stream&, std::shared_ptr<Device>);
-    void _insert_ostream(Stream&, std::shared_ptr<Device>);
+    void _insert_istream(Stream&, std::shared_ptr<Device>, std::vector<std::shared_ptr<Event>>&);
+    void _insert_ostream(Stream&, std::shared_ptr<Device>, std::vector<std::shared_ptr<Event>>&);
     void _remove_ostream(key_type);
     void _remove_istream(key_type);
-    void _spawn(Vertex::Program&);
+    void _spawn(std::shared_ptr<Vertex::Program>);
+    void _refresh_bridges(Vertex::Program&);
+    void _report_restart();
 
   public:
     
@@ -74,6 +76,8 @@ class Executor : public KernelBase {
     size_t num_vertices() const;
     size_t graph_size() const;
 
+    pb::TaskInfo taskinfo() const;
+
     void run();
 };
 
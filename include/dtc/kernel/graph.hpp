@@ -123,6 +123,8 @@ class VertexBuilder {
 
     VertexBuilder& tag(std::string);
     VertexBuilder& program(std::string);
+    VertexBuilder& strand(bool = true);
+    VertexBuilder& restart(size_t, std::chrono::milliseconds = env::program_restart_backoff());
 };
 
 // Function: on
@@ -172,6 +174,11 @@ class StreamBuilder {
 
     StreamBuilder& critical(bool);
     StreamBuilder& tag(std::string);
+    StreamBuilder& watermarks(size_t, size_t);
+    StreamBuilder& codec(Codec::Type);
+    StreamBuilder& batch(size_t, std::chrono::microseconds = std::chrono::milliseconds(1));
+    StreamBuilder& single_writer(bool);
+    StreamBuilder& zerocopy(size_t);
 };
 
 // Function: on
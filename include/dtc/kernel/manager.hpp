@@ -40,7 +40,16 @@ class KernelBase : public Reactor {
     template <typename... T>
     KernelBase(T&&... t);
     
-    inline auto insert_channel(std::shared_ptr<Device>, std::ios_base::openmode = default_channel_mode);
+    inline auto insert_channel(
+      std::shared_ptr<Device>, 
+      std::ios_base::openmode = default_channel_mode, 
+      std::shared_ptr<Strand> = nullptr
+    );
+    inline auto make_channel(
+      std::shared_ptr<Device>, 
+      std::ios_base::openmode = default_channel_mode, 
+      std::shared_ptr<Strand> = nullptr
+    );
     inline auto insert_listener(std::string_view);
 
     std::shared_ptr<ReadEvent> insert_stdout_listener();
@@ -50,39 +59,85 @@ class KernelBase : public Reactor {
 // Constructor
 template <typename... T>
 KernelBase::KernelBase(T&&... args) : Reactor{std::forward<T>(args)...} {
+  spawn_shards(env::num_reactors());
 }
     
 // Function: insert_listener    
+// In the sharded mode, every event loop listens on the same port through SO_REUSEPORT so that
+// accepts are spread across loops. The listener of the primary loop is returned.
 inline auto KernelBase::insert_listener(std::string_view P) {
   return [this, P] (auto&& f) mutable {
-    return insert<ReadEvent>(
-      make_socket_server(P),
-      [f=std::forward<decltype(f)>(f)] (Event& event) {
-        try {
-          f(std::static_pointer_cast<Socket>(event.device())->accept());
-        }
-        catch(const std::system_error& s) {
-          LOGE("Failed to accept a new connection: ", s.what());
+
+    auto listen = [&f] (Reactor& r, std::shared_ptr<Socket> skt) {
+      return r.insert<ReadEvent>(
+        std::move(skt),
+        [f] (Event& event) {
+          try {
+            f(std::static_pointer_cast<Socket>(event.device())->accept());
+          }
+          catch(const std::system_error& s) {
+            LOGE("Failed to accept a new connection: ", s.what());
+          }
         }
+      ).get();
+    };
+
+    auto L = listen(*this, make_socket_server(P, num_shards() > 1));
+
+    if(num_shards() > 1) {
+      auto port = std::get<1>(std::static_pointer_cast<Socket>(L->device())->this_host());
+      for(size_t i=1; i<num_shards(); ++i) {
+        listen(shard(i), make_socket_server(port, true));
       }
-    ).get();
+    }
+
+    return L;
   };
 }
 
 // Function: insert_channel
-auto KernelBase::insert_channel(std::shared_ptr<Device> d, std::ios_base::openmode m) {
+// A stranded channel runs its callbacks on the strand, in the event loop the strand is bound to.
+// Channels inserted one by one carry the control plane (master, agent, executor, and webui), so
+// their callbacks run on the HIGH lane of the thread pool ahead of the stream callbacks.
+auto KernelBase::insert_channel(
+  std::shared_ptr<Device> d, std::ios_base::openmode m, std::shared_ptr<Strand> s
+) {
+
+  return [this, d=std::move(d), m, s=std::move(s)] (auto&&... f) {
+    
+    auto [R, W] = make_channel(d, m, s)(std::forward<decltype(f)>(f)...);
+
+    for(auto e : {static_cast<Event*>(R.get()), static_cast<Event*>(W.get())}) {
+      if(e) e->priority(Threadpool::HIGH);
+    }
+
+    // Channels are spread across the event loops. The read and write sides of a device are
+    // kept on the same loop and registered in one go.
+    next_shard().insert_batch({R, W}).get();
+
+    return std::make_pair(std::move(R), std::move(W));
+  };
+}
+
+// Function: make_channel
+// Create the stream events of a channel without inserting them. The caller registers them 
+// through insert_batch, typically together with many other channels.
+auto KernelBase::make_channel(
+  std::shared_ptr<Device> d, std::ios_base::openmode m, std::shared_ptr<Strand> s
+) {
 
-  return [this, d=std::move(d), m] (auto&&... f) {
+  return [d=std::move(d), m, s=std::move(s)] (auto&&... f) {
     
     auto functors = Functors{std::forward<decltype(f)>(f)...};    
     
-    auto R = (m & std::ios_base::in) ? insert<InputStream>(
+    auto R = (m & std::ios_base::in) ? make_event<InputStream>(
+      s,
       d,
       [=, pb=pb::Protobuf()] (InputStream& istream) mutable {
 
         // Synchronized with the underlying data.
         try {
-          istream.isbuf.sync();
+          istream.sync();
         }
         catch (const std::system_error& e) {
           pb = pb::BrokenIO {std::ios_base::in, e.code()};
@@ -112,9 +167,10 @@ auto KernelBase::insert_channel(std::shared_ptr<Device> d, std::ios_base::openmo
           }
         }
       }
-    ).get() : nullptr;
+    ) : nullptr;
 
-    auto W = (m & std::ios_base::out) ? insert<OutputStream>(
+    auto W = (m & std::ios_base::out) ? make_event<OutputStream>(
+      s,
       d,
       [=] (OutputStream& ostream) mutable {
 
@@ -144,7 +200,7 @@ auto KernelBase::insert_channel(std::shared_ptr<Device> d, std::ios_base::openmo
           functors(ostream);
         }
       }
-    ).get() : nullptr;
+    ) : nullptr;
 
     return std::make_pair(std::move(R), std::move(W));
 
@@ -154,6 +154,7 @@ class Master : public KernelBase {
 
     HttpResponse make_response(const HttpRequest&);
     std::string agent_to_json(std::string_view);
+    std::string reactor_to_json(std::string_view);
 
     size_t num_graphs() const;
     size_t num_agents() const;
@@ -24,6 +24,12 @@ class Vertex;
 // ------------------------------------------------------------------------------------------------
 
 // Class: Stream
+//
+// A stream with a nonzero high watermark applies backpressure to its producer. Once the data
+// pending in the local ostream reaches the high watermark, the stream is congested and its 
+// ostream callback is skipped until the pending data drain to the low watermark. Writes issued
+// elsewhere (e.g., broadcast from the vertex callback) still succeed; those producers can poll 
+// Vertex::congested to throttle themselves.
 class Stream final {
 
   friend class Vertex;
@@ -52,7 +58,17 @@ class Stream final {
     std::shared_ptr<Device> extract_obridge();
     std::shared_ptr<Device> extract_ibridge();
 
+    size_t memory() const;
+    size_t peak_memory() const;
+
+    Codec::Counters codec_counters() const;
+
+    bool congested() const;
+
     inline const std::string& tag() const;
+    inline size_t high_watermark() const;
+    inline size_t low_watermark() const;
+    inline Codec::Type codec() const;
 
   private:
 
@@ -61,17 +77,38 @@ class Stream final {
     Writer _writer;
     Reader _reader;
 
+    // Counters folded in from the stream events already removed.
+    std::ios_base::openmode _retired {};
+    size_t _retired_peak_memory {0};
+    Codec::Counters _retired_codec_counters;
+
     Vertex* _tail {nullptr};
     Vertex* _head {nullptr};
 
     bool _critical {false};
 
+    size_t _high_watermark {env::stream_high_watermark()};
+    size_t _low_watermark {env::stream_low_watermark()};
+
+    mutable std::atomic<bool> _congested {false};
+
+    Codec::Type _codec {Codec::NONE};
+
+    size_t _batch_size {0};
+    std::chrono::microseconds _batch_delay {0};
+
+    bool _single_writer {false};
+
+    size_t _zerocopy {env::stream_zerocopy_threshold()};
+
     std::function<Event::Signal(Vertex&, OutputStream&)> _on_ostream;
     std::function<Event::Signal(Vertex&, InputStream&)> _on_istream;
 
     Event::Signal operator () (InputStream&) const;
     Event::Signal operator () (OutputStream&) const;
 
+    void _retire(std::ios_base::openmode);
+
 };
 
 // Function: tag
@@ -79,6 +116,23 @@ inline const std::string& Stream::tag() const {
   return _tag;
 }
 
+// Function: high_watermark
+// Return the pending bytes at which the stream becomes congested (zero disables backpressure).
+inline size_t Stream::high_watermark() const {
+  return _high_watermark;
+}
+
+// Function: low_watermark
+// Return the pending bytes to which a congested stream must drain before it resumes.
+inline size_t Stream::low_watermark() const {
+  return std::min(_low_watermark, _high_watermark);
+}
+
+// Function: codec
+inline Codec::Type Stream::codec() const {
+  return _codec;
+}
+
 // ------------------------------------------------------------------------------------------------
 
 // Class: PlaceHolder
@@ -37,6 +37,8 @@ class Vertex {
     std::unique_ptr<char*, std::function<void(char**)>> c_argv;
     std::unique_ptr<char*, std::function<void(char**)>> c_envp;  
     std::vector<std::shared_ptr<Device>> bridges;
+    std::vector<key_type> streams;                  // the stream of each bridge
+    std::vector<std::shared_ptr<Device>> stale;     // bridges replaced on a respawn
   };
 
   public:
@@ -61,10 +63,16 @@ class Vertex {
     std::shared_ptr<InputStream> istream(key_type) const;
     std::shared_ptr<OutputStream> ostream(key_type) const;
 
+    bool congested() const;
+    bool congested(key_type) const;
+
     inline const std::string& tag() const;
+    inline Strand* strand() const;
 
     bool program() const;
 
+    inline size_t num_restarts() const;
+
   private:
 
     Executor* _executor {nullptr};
@@ -74,12 +82,18 @@ class Vertex {
     std::once_flag _once_flag;
 
     std::function<void(Vertex&)> _on;
+
+    std::shared_ptr<Strand> _strand;
     
     std::unordered_map<key_type, Stream*> _istreams;
     std::unordered_map<key_type, Stream*> _ostreams;
 
     Runtime _runtime;
 
+    size_t _max_restarts {env::program_max_restarts()};
+    std::chrono::milliseconds _restart_backoff {env::program_restart_backoff()};
+    std::atomic<size_t> _num_restarts {0};
+
     Vertex& operator()();
 
     Program _prespawn();
@@ -110,6 +124,18 @@ inline const std::string& Vertex::tag() const {
   return _tag;
 }
 
+// Function: num_restarts
+// Return the number of times the program of the vertex has been respawned.
+inline size_t Vertex::num_restarts() const {
+  return _num_restarts.load(std::memory_order_relaxed);
+}
+
+// Function: strand
+// Return the strand serializing the callbacks of the vertex (null if not in strand mode).
+inline Strand* Vertex::strand() const {
+  return _strand.get();
+}
+
 // ------------------------------------------------------------------------------------------------
 
 // class: Prober
@@ -88,9 +88,9 @@ class Policy final : public EnableSingletonFromThis<Policy> {
     
     ExecutionMode _EXECUTION_MODE {LOCAL};
 
-    unsigned _AGENT_NUM_THREADS {std::thread::hardware_concurrency()};
-    unsigned _EXECUTOR_NUM_THREADS {std::thread::hardware_concurrency()};
-    unsigned _MASTER_NUM_THREADS {std::thread::hardware_concurrency()};
+    unsigned _AGENT_NUM_THREADS {static_cast<unsigned>(this_cpuset().size())};
+    unsigned _EXECUTOR_NUM_THREADS {static_cast<unsigned>(this_cpuset().size())};
+    unsigned _MASTER_NUM_THREADS {static_cast<unsigned>(this_cpuset().size())};
 
     const std::filesystem::path _WEBUI_DIR {DTC_HOME "/webui"};
     const std::filesystem::path _CGROUP_MOUNT {"dtc"};
@@ -226,6 +226,12 @@ enum class ExecutionMode {
   LOCAL 
 };
 
+enum class DemuxType {
+  SELECT,
+  EPOLL,
+  URING
+};
+
 // Class: Runtime
 class Runtime {
 
@@ -238,7 +244,7 @@ class Runtime {
     ExecutionMode execution_mode() const;
 
     std::unordered_map<key_type, std::string> vertex_hosts() const;
-    std::unordered_map<key_type, int> frontiers() const;
+    std::unordered_map<key_type, std::vector<int>> frontiers() const;
     std::unordered_map<std::string, int> bridges() const;
  
     std::unique_ptr<char[]> c_file() const;
@@ -390,6 +396,22 @@ inline ExecutionMode execution_mode() {
   else return ExecutionMode::LOCAL;
 }
 
+inline DemuxType demux_type() {
+  if(auto str = std::getenv("DTC_DEMUX"); str) {
+    if(std::string_view type(str); type == "select") {
+      return DemuxType::SELECT;
+    }
+    else if(type == "epoll") {
+      return DemuxType::EPOLL;
+    }
+    else if(type == "uring") {
+      return DemuxType::URING;
+    }
+    else throw std::runtime_error("Invalid demux type");
+  }
+  else return DemuxType::EPOLL;
+}
+
 inline std::filesystem::path webui_dir() {
   return DTC_HOME "/webui";
 }
@@ -422,25 +444,139 @@ inline int stderr_fd() {
   else return STDERR_FILENO;
 }
 
+inline std::chrono::microseconds timer_slack() {
+  if(auto str = std::getenv("DTC_TIMER_SLACK"); str) {
+    return std::chrono::microseconds(std::stoul(str));
+  }
+  return std::chrono::milliseconds(1);
+}
+
+// The instruments read the clock twice per activation, which is not free on the hot path of
+// small messages. They are off unless asked for.
+inline bool reactor_statistics() {
+  if(auto str = std::getenv("DTC_REACTOR_STATISTICS"); str) {
+    std::string_view flag(str);
+    return !(flag == "0" || flag == "false" || flag == "off");
+  }
+  return false;
+}
+
+inline size_t stream_drain_budget() {
+  if(auto str = std::getenv("DTC_STREAM_DRAIN_BUDGET"); str) {
+    return std::stoul(str);
+  }
+  return 256*1024;
+}
+
+inline size_t stream_buffer_cap() {
+  if(auto str = std::getenv("DTC_STREAM_BUFFER_CAP"); str) {
+    return std::stoul(str);
+  }
+  return 64*1024*1024;
+}
+
+inline std::chrono::milliseconds stream_buffer_idle() {
+  if(auto str = std::getenv("DTC_STREAM_BUFFER_IDLE"); str) {
+    return std::chrono::milliseconds(std::stoul(str));
+  }
+  return std::chrono::seconds(1);
+}
+
+inline size_t shm_ring_capacity() {
+  if(auto str = std::getenv("DTC_SHM_RING_CAPACITY"); str) {
+    return std::stoul(str);
+  }
+  return 1024*1024;
+}
+
+inline size_t stream_high_watermark() {
+  if(auto str = std::getenv("DTC_STREAM_HIGH_WATERMARK"); str) {
+    return std::stoul(str);
+  }
+  return 0;
+}
+
+inline size_t stream_low_watermark() {
+  if(auto str = std::getenv("DTC_STREAM_LOW_WATERMARK"); str) {
+    return std::stoul(str);
+  }
+  return 0;
+}
+
+inline size_t stream_zerocopy_threshold() {
+  if(auto str = std::getenv("DTC_STREAM_ZEROCOPY_THRESHOLD"); str) {
+    return std::stoul(str);
+  }
+  return 0;
+}
+
+inline size_t program_max_restarts() {
+  if(auto str = std::getenv("DTC_PROGRAM_MAX_RESTARTS"); str) {
+    return std::stoul(str);
+  }
+  return 0;
+}
+
+inline std::chrono::milliseconds program_restart_backoff() {
+  if(auto str = std::getenv("DTC_PROGRAM_RESTART_BACKOFF"); str) {
+    return std::chrono::milliseconds(std::stoul(str));
+  }
+  return std::chrono::seconds(1);
+}
+
+inline size_t threadpool_burst() {
+  if(auto str = std::getenv("DTC_THREADPOOL_BURST"); str) {
+    return std::max(1ul, std::stoul(str));
+  }
+  return 32;
+}
+
+inline size_t threadpool_spin() {
+  if(auto str = std::getenv("DTC_THREADPOOL_SPIN"); str) {
+    return std::stoul(str);
+  }
+  // Spinning only pays off if the producer can run while a worker spins.
+  return std::thread::hardware_concurrency() > 1 ? 1024 : 0;
+}
+
+// Pinning pays off when the process owns a slice of the machine (e.g., the cpuset of a 
+// container). On a shared machine every process would stack its workers on the same leading 
+// CPUs, so by default we pin only if our cpuset is a proper subset of the online CPUs.
+inline bool threadpool_pin() {
+  if(auto str = std::getenv("DTC_THREADPOOL_PIN"); str) {
+    std::string_view flag(str);
+    return !(flag == "0" || flag == "false" || flag == "off");
+  }
+  auto online = ::sysconf(_SC_NPROCESSORS_ONLN);
+  return online > 0 && this_cpuset().size() < static_cast<size_t>(online);
+}
+
+inline unsigned num_reactors() {
+  if(auto str = std::getenv("DTC_NUM_REACTORS"); str) {
+    return std::max(1ul, std::stoul(str));
+  }
+  return 1;
+}
+
 inline unsigned master_num_threads() {
   if(auto str = std::getenv("DTC_MASTER_NUM_THREADS"); str) {
     return std::stoul(str);
   }
-  return std::thread::hardware_concurrency();
+  return this_cpuset().size();
 }
 
 inline unsigned agent_num_threads() {
   if(auto str = std::getenv("DTC_AGENT_NUM_THREADS"); str) {
     return std::stoul(str);
   }
-  return std::thread::hardware_concurrency();
+  return this_cpuset().size();
 }
 
 inline unsigned executor_num_threads() {
   if(auto str = std::getenv("DTC_EXECUTOR_NUM_THREADS"); str) {
     return std::stoul(str);
   }
-  return std::thread::hardware_concurrency();
+  return this_cpuset().size();
 }
 
 inline void stdout_listener_port(std::string_view str) {
@@ -32,6 +32,11 @@ struct TaskInfo {
   uintmax_t memory_limit_in_bytes {0};
   uintmax_t memory_max_usage_in_bytes {0};
 
+  size_t num_restarts {0};          // vertex programs respawned by the executor
+  size_t stream_peak_memory {0};    // peak buffer bytes, summed over the streams
+  size_t codec_raw_bytes {0};       // bytes through the stream codecs, before encoding
+  size_t codec_encoded_bytes {0};   // bytes through the stream codecs, after encoding
+
   TaskInfo(const TaskID&, std::string_view, int);
   TaskInfo() = default;
   TaskInfo(TaskInfo&&) = default;
@@ -54,7 +59,11 @@ struct TaskInfo {
       status, 
       elapsed_time, 
       memory_limit_in_bytes, 
-      memory_max_usage_in_bytes
+      memory_max_usage_in_bytes,
+      num_restarts,
+      stream_peak_memory,
+      codec_raw_bytes,
+      codec_encoded_bytes
     ); 
   }
 
@@ -20,6 +20,9 @@
 #include <unordered_map>
 #include <set>
 #include <unordered_set>
+#include <vector>
+#include <thread>
+#include <algorithm>
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
@@ -160,6 +163,16 @@ pid_t spawn(const char*, char *const[], char *const[]);
 std::tuple<double, double, double> cpu_load_average(std::error_code&) noexcept;
 std::tuple<double, double, double> cpu_load_average();
 
+// Function: this_cpuset
+// Return the CPUs the process is allowed to run on, which reflects the cpuset of its control 
+// group. The CPUs are ordered by NUMA node and then by id, so that consecutive CPUs share a 
+// node whenever possible.
+std::vector<int> this_cpuset();
+
+// Function: numa_node_of
+// Return the NUMA node of a CPU, or -1 if the topology is not exposed.
+int numa_node_of(int) noexcept;
+
 //// Function: make_temp_file
 //// Create a temp file and return the name of the temp file. 
 //inline auto make_temp_file(const std::string& fpath = "/tmp/XXXXXX") {
@@ -15,6 +15,50 @@
 
 namespace dtc {
 
+// Procedure: append
+// Append the data of a completed receive.
+void ReadAhead::append(const void* buf, size_t sz) {
+  data.insert(data.end(), static_cast<const char*>(buf), static_cast<const char*>(buf) + sz);
+  num_bytes += sz;
+}
+
+// Function: read
+// Copy the data received ahead into the given segments. Return the number of bytes copied, -1 if
+// there is nothing yet but a receive is armed, or 0 if the caller shall read the descriptor.
+std::streamsize ReadAhead::read(const struct iovec* iov, int n) {
+
+  if(size() == 0) {
+    if(error) {
+      throw std::system_error(
+        std::make_error_code(static_cast<std::errc>(error)), "Device read failed"
+      );
+    }
+    if(armed) {
+      errno = EAGAIN;
+      return -1;
+    }
+    return 0;
+  }
+
+  auto num = std::streamsize {0};
+
+  for(int i=0; i<n && size(); ++i) {
+    auto len = std::min(iov[i].iov_len, size());
+    std::memcpy(iov[i].iov_base, data.data() + head, len);
+    head += len;
+    num += len;
+  }
+
+  if(size() == 0) {
+    data.clear();
+    head = 0;
+  }
+
+  return num;
+}
+
+// ------------------------------------------------------------------------------------------------
+
 // Constructor.
 Device::Device(int fd) : _fd {fd} {
 }
@@ -55,8 +99,27 @@ std::streamsize Device::purge(void* B, std::streamsize N) const {
 }
 
 // Function: read
+// Read the device. The data received ahead by the io_uring demux, if any, go first.
 std::streamsize Device::read(void* buf, std::streamsize sz) const {
 
+  if(!_ahead.used.load(std::memory_order_acquire)) {
+    return _read(buf, sz);
+  }
+
+  struct iovec iov {buf, static_cast<size_t>(sz)};
+
+  std::scoped_lock lock(_ahead.mutex);
+
+  if(auto ret = _ahead.read(&iov, 1); ret != 0) {
+    return ret;
+  }
+
+  return _read(buf, sz);
+}
+
+// Function: _read
+std::streamsize Device::_read(void* buf, std::streamsize sz) const {
+
   assert(sz != 0);
 
   issue_read:
@@ -105,6 +168,74 @@ std::streamsize Device::write(const void* buf, std::streamsize sz) const {
   return ret;
 }
 
+// Function: readv
+// Scatter read into the given segments. Errors are handled the same way as read.
+std::streamsize Device::readv(const struct iovec* iov, int n) const {
+
+  if(!_ahead.used.load(std::memory_order_acquire)) {
+    return _readv(iov, n);
+  }
+
+  std::scoped_lock lock(_ahead.mutex);
+
+  if(auto ret = _ahead.read(iov, n); ret != 0) {
+    return ret;
+  }
+
+  return _readv(iov, n);
+}
+
+// Function: _readv
+std::streamsize Device::_readv(const struct iovec* iov, int n) const {
+
+  assert(n > 0);
+
+  issue_readv:
+  auto ret = ::readv(_fd, iov, n);
+
+  // case 1: fail or in-progress
+  if(ret == -1) {
+    if(errno == EINTR) {
+      goto issue_readv;
+    }
+    else if(errno != EAGAIN && errno != EWOULDBLOCK) {
+      throw std::system_error(
+        std::make_error_code(static_cast<std::errc>(errno)), "Device readv failed"
+      );
+    }
+  }
+  // case 2: eof
+  else if(ret == 0) {
+    throw std::system_error(
+      std::make_error_code(static_cast<std::errc>(EPIPE)), "Device readv failed"
+    );
+  }
+
+  return ret;
+}
+
+// Function: writev
+// Gather write from the given segments. Errors are handled the same way as write.
+std::streamsize Device::writev(const struct iovec* iov, int n) const {
+
+  issue_writev:
+  auto ret = ::writev(_fd, iov, n);
+  
+  // Case 1: error
+  if(ret == -1) {
+    if(errno == EINTR) {
+      goto issue_writev;
+    }
+    else if(errno != EAGAIN && errno != EWOULDBLOCK) {
+      throw std::system_error(
+        std::make_error_code(static_cast<std::errc>(errno)), "Device writev failed"
+      );
+    }
+  }
+  
+  return ret;
+}
+
 Device& Device::blocking(bool flag) {
   flag ? make_fd_blocking(_fd) : make_fd_nonblocking(_fd);
   return *this;
@@ -18,56 +18,35 @@ namespace dtc {
 
 // Ctor
 Epoll::Epoll() {
-
   if(_epfd = ::epoll_create1(EPOLL_CLOEXEC); _epfd == -1){
     throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)),"epoll epfd create failed");
   }
-
-  if(_timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC); _timerfd == -1){
-    throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)),"epoll timerfd create failed");
-  }
-
-  _recap(_timerfd);
-
-  epoll_event ev;
-  ev.data.fd = _timerfd;
-  ev.events = EPOLLIN;
-
-  // Add the timerfd event to epoll
-  if(auto ret = ::epoll_ctl(_epfd, EPOLL_CTL_ADD, _timerfd, &ev); ret == -1){
-    throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)),"epoll_ctl adds timerfd failed");
-  }
 }
 
 // Destructor
 Epoll::~Epoll() {
   // No need to use epoll_ctl + EPOLL_CTL_DEL to remove the event in epoll 
-  // as the reactor destructor will close the notify fd first and the fd becomes invalid 
-  ::free(_fd2ev[0]);
-  ::free(_fd2ev[1]);
-  ::free(_event_buf);
-  ::close(_timerfd);
+  // as closing the epoll fd releases all registrations.
+  std::free(_fd2ev[0]);
+  std::free(_fd2ev[1]);
+  std::free(_armed);
+  std::free(_registered);
+  std::free(_event_buf);
   ::close(_epfd);
 }
 
-void Epoll::_prepare_epoll(struct timeval tv){
-  auto timeout = tv.tv_sec*1000 + tv.tv_usec/1000;
-  if( timeout > MAX_EPOLL_TIMEOUT_MSEC ){
-    timeout = MAX_EPOLL_TIMEOUT_MSEC;
-  }
-  else if(tv.tv_sec != 0 || tv.tv_usec != 0){
-    struct itimerspec is;
-    is.it_interval.tv_sec = tv.tv_sec;    // Interval for periodic timer
-    is.it_interval.tv_nsec = tv.tv_usec * 1000;
-    is.it_value.tv_sec = 0;       // Initial expiration
-    is.it_value.tv_nsec = 0;
-
-    if(::timerfd_settime(_timerfd, 0, &is, nullptr) < 0){
-      throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)),"epoll timerfd_settime failed");
-    }
+// Function: _timeout
+// Convert the millisecond count into the timeout argument of epoll_wait.
+// If millisec = -1: block indefinitely. If millisec = 0: return immediately 
+int Epoll::_timeout(std::chrono::milliseconds::rep ms) const {
+  if(ms == std::chrono::milliseconds::max().count()) {
+    return -1;
   }
+  return ms <= 0 ? 0 : static_cast<int>(std::min<decltype(ms)>(ms, MAX_EPOLL_TIMEOUT_MSEC));
 }
 
+// Procedure: _recap
+// Adjust the capacity to accommodate the file descriptor fd.
 void Epoll::_recap(const int fd){
 
   if(_max_fd < fd){
@@ -86,9 +65,55 @@ void Epoll::_recap(const int fd){
     _event_buf = static_cast<epoll_event*>(std::realloc(_event_buf, _buf_sz*sizeof(epoll_event)));
     _fd2ev[0] = static_cast<Event**>(std::realloc(_fd2ev[0], _buf_sz*sizeof(Event*)));
     _fd2ev[1] = static_cast<Event**>(std::realloc(_fd2ev[1], _buf_sz*sizeof(Event*)));
+    _armed = static_cast<uint32_t*>(std::realloc(_armed, _buf_sz*sizeof(uint32_t)));
+    _registered = static_cast<uint8_t*>(std::realloc(_registered, _buf_sz*sizeof(uint8_t)));
     ::memset((uint8_t*)_fd2ev[0] + old_cap*sizeof(Event*), 0, (_buf_sz-old_cap)*sizeof(Event*));
     ::memset((uint8_t*)_fd2ev[1] + old_cap*sizeof(Event*), 0, (_buf_sz-old_cap)*sizeof(Event*));
+    ::memset((uint8_t*)_armed + old_cap*sizeof(uint32_t), 0, (_buf_sz-old_cap)*sizeof(uint32_t));
+    ::memset((uint8_t*)_registered + old_cap*sizeof(uint8_t), 0, (_buf_sz-old_cap)*sizeof(uint8_t));
+  }
+}
+
+// Procedure: _rearm
+// Synchronize the kernel registration of the file descriptor with the interest set of the
+// demux. The registration is kept in place (EPOLL_CTL_MOD) once created. A descriptor number
+// can be recycled by a different file description after the old one is closed, in which case
+// the kernel reports ENOENT on MOD and we fall back to ADD (and vice versa for EEXIST).
+void Epoll::_rearm(const int efd) {
+
+  uint32_t want = (_fd2ev[0][efd] ? EPOLLIN : 0) | (_fd2ev[1][efd] ? EPOLLOUT : 0);
+
+  if(want == _armed[efd]) return;
+
+  // Nothing has been registered and nothing to be armed.
+  if(want == 0 && !_registered[efd]) {
+    _armed[efd] = 0;
+    return;
   }
+
+  epoll_event ev;
+  ev.data.fd = efd;
+  ev.events = want | EPOLLONESHOT;
+
+  auto op = _registered[efd] ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+  if(::epoll_ctl(_epfd, op, efd, &ev) == -1) {
+    if(op == EPOLL_CTL_MOD && errno == ENOENT) {
+      op = EPOLL_CTL_ADD;
+    }
+    else if(op == EPOLL_CTL_ADD && errno == EEXIST) {
+      op = EPOLL_CTL_MOD;
+    }
+    else {
+      throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)),"epoll_ctl failed");
+    }
+    if(::epoll_ctl(_epfd, op, efd, &ev) == -1) {
+      throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)),"epoll_ctl failed");
+    }
+  }
+
+  _registered[efd] = 1;
+  _armed[efd] = want;
 }
 
 // Procedure: _insert
@@ -99,100 +124,94 @@ void Epoll::_insert(Event* event) {
 
   _recap(efd);
 
-  epoll_event ev;
-  ev.data.fd = efd;
-
   switch(event->type){
     case Event::READ:
-      ev.events = EPOLLIN;
+      if(_fd2ev[0][efd] == nullptr) ++_num_events;
       _fd2ev[0][efd] = event;
-      break;
+    break;
+
     case Event::WRITE:
-      ev.events = EPOLLOUT;
+      if(_fd2ev[1][efd] == nullptr) ++_num_events;
       _fd2ev[1][efd] = event;
-      break;
+    break;
+
     default:
       assert(false);
-      break;
+    break;
   }
 
-
-  // Try insert first to see whether the event exists or not
-  if(_fd2ev[0][efd] != nullptr && _fd2ev[1][efd] != nullptr){
-    // If the fd has been registered (A Read & Write event)
-    ev.events = (EPOLLIN | EPOLLOUT);
-    if(::epoll_ctl(_epfd, EPOLL_CTL_MOD, efd, &ev) == -1){
-      throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)),"epoll_ctl mod failed");
-    }
-  }
-  else{
-    // If this is the first time to insert that event 
-    if(::epoll_ctl(_epfd, EPOLL_CTL_ADD, efd, &ev) == -1){
-      throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)),"epoll_ctl mod failed");
-    }
-  }
+  _rearm(efd);
 }
 
-// Remove an event from the demux.
+// Procedure: _remove
+// Remove an event from the demux. The kernel registration is only touched when it still has 
+// the removed interest armed. An event taken off the demux on activation has already been 
+// disarmed by EPOLLONESHOT and costs no system call.
 void Epoll::_remove(Event* event) {
 
   auto efd = event->device()->fd();
 
-  //_recap(efd);
-  // In kernel versions before 2.6.9, the EPOLL_CTL_DEL operation required
-  // a non-null pointer in event, even though this argument is ignored.
-  // Since Linux 2.6.9, event can be specified as NULL when using
-  // EPOLL_CTL_DEL.  Applications that need to be portable to kernels
-  // before 2.6.9 should specify a non-null pointer in event.
-  
-  epoll_event ev;
-  ev.data.fd = efd;
+  _recap(efd);
 
+  switch(event->type){
+    case Event::READ:
+      if(_fd2ev[0][efd] != nullptr) --_num_events;
+      _fd2ev[0][efd] = nullptr;
+    break;
 
-  if(_fd2ev[0][efd] != nullptr && _fd2ev[1][efd] != nullptr){
-    // A Read & Write event 
-    switch(event->type){
-      case Event::READ:
-        ev.events = EPOLLOUT;
-        _fd2ev[0][efd] = nullptr;
-      break;
-      case Event::WRITE:
-        ev.events = EPOLLIN;
-        _fd2ev[1][efd] = nullptr;
-      break;
-      default:
-        assert(false);
-      break;
-    }
-    if(auto ret = epoll_ctl(_epfd, EPOLL_CTL_MOD, efd, &ev); ret == -1){
+    case Event::WRITE:
+      if(_fd2ev[1][efd] != nullptr) --_num_events;
+      _fd2ev[1][efd] = nullptr;
+    break;
+
+    default:
       assert(false);
-      throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)),"epoll_ctl mod failed");
-    }
+    break;
+  }
+
+  uint32_t want = (_fd2ev[0][efd] ? EPOLLIN : 0) | (_fd2ev[1][efd] ? EPOLLOUT : 0);
+
+  if(_armed[efd] & ~want) {
+    _rearm(efd);
   }
-  else{
-    if(_fd2ev[0][efd] != nullptr || _fd2ev[1][efd] != nullptr){
-      if(epoll_ctl(_epfd, EPOLL_CTL_DEL, efd, &ev) == -1){
-        throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)),"epoll_ctl del failed");
-      }
+}
+
+// Procedure: _erase
+// Remove an event for good. Once the descriptor has no event left, its registration is deleted
+// as well (see the registration policy in epoll.hpp). ENOENT and EBADF are ignored since the 
+// registration is gone already when the descriptor has been closed without being shared.
+void Epoll::_erase(Event* event) {
+
+  _remove(event);
+
+  auto efd = event->device()->fd();
+
+  if(_registered[efd] && !_fd2ev[0][efd] && !_fd2ev[1][efd]) {
+    epoll_event ev;
+    if(::epoll_ctl(_epfd, EPOLL_CTL_DEL, efd, &ev) == -1 && errno != ENOENT && errno != EBADF) {
+      throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)),"epoll_ctl failed");
     }
-    _fd2ev[0][efd] = nullptr;
-    _fd2ev[1][efd] = nullptr;
+    _registered[efd] = 0;
+    _armed[efd] = 0;
   }
 }
 
-// TODO(clin99)
-void Epoll::_clear(){
-  epoll_event ev;  
-  for(int i=0;i<_max_fd;++i){
-    if(_fd2ev[0][i] != nullptr || _fd2ev[1][i] != nullptr){
-      auto efd = _fd2ev[0][i] != nullptr ? _fd2ev[0][i]->device()->fd() : _fd2ev[1][i]->device()->fd();
-      epoll_ctl(_epfd, EPOLL_CTL_DEL, efd, &ev);
+// Procedure: _clear
+void Epoll::_clear() {
+  for(int fd=0; fd<=_max_fd; ++fd) {
+    if(_registered[fd]) {
+      epoll_event ev;
+      ::epoll_ctl(_epfd, EPOLL_CTL_DEL, fd, &ev);
     }
   }
-  _max_fd = _timerfd;
+  if(_buf_sz) {
+    ::memset(_fd2ev[0], 0, _buf_sz*sizeof(Event*));
+    ::memset(_fd2ev[1], 0, _buf_sz*sizeof(Event*));
+    ::memset(_armed, 0, _buf_sz*sizeof(uint32_t));
+    ::memset(_registered, 0, _buf_sz*sizeof(uint8_t));
+  }
+  _num_events = 0;
+  _max_fd = -1;
 }
 
 };  // End of namespace dtc. ---------------------------------------------------------------
-
-
-
@@ -15,6 +15,48 @@
 
 namespace dtc {
 
+// Function: _bind
+// Bind the strand to the given reactor unless it has been bound already. Return the reactor the
+// strand is bound to.
+Reactor* Strand::_bind(Reactor* r) {
+  Reactor* expected {nullptr};
+  if(_reactor.compare_exchange_strong(expected, r, std::memory_order_acq_rel)) {
+    return r;
+  }
+  return expected;
+}
+
+// Procedure: _push
+// Append an event to the wait queue.
+void Strand::_push(Event* e) {
+  assert(!e->_strand_queued);
+  e->_strand_queued = true;
+  e->_strand_next = nullptr;
+  if(_tail) {
+    _tail->_strand_next = e;
+  }
+  else {
+    _head = e;
+  }
+  _tail = e;
+}
+
+// Function: _pop
+// Remove the first event from the wait queue.
+Event* Strand::_pop() {
+  auto e = _head;
+  if(e) {
+    if(_head = e->_strand_next; _head == nullptr) {
+      _tail = nullptr;
+    }
+    e->_strand_next = nullptr;
+    e->_strand_queued = false;
+  }
+  return e;
+}
+
+// ------------------------------------------------------------------------------------------------
+
 // Function: empty
 bool TimeoutEventHeap::empty() const {
   return _array.empty();
@@ -48,6 +90,12 @@ void TimeoutEventHeap::remove(Event* e) {
   auto last = _array.back();
   _array.pop_back();
 
+  // The event is the last item.
+  if(last == e) {
+    e->_timer().satellite = -1;
+    return;
+  }
+
   if(e->_timer().satellite && _less(last, _array[(e->_timer().satellite-1) >> 1])) {
     _bubble_up(e->_timer().satellite, last);
   }
@@ -110,5 +158,150 @@ void TimeoutEventHeap::_bubble_down(size_t idx, Event* e) {
 }
 
 
+//-------------------------------------------------------------------------------------------------
+
+// Constructor
+TimingWheel::TimingWheel(std::chrono::steady_clock::duration slack) : 
+  _slack {std::max(slack, std::chrono::steady_clock::duration(1))} {
+}
+
+// Function: empty
+bool TimingWheel::empty() const {
+  return _size == 0;
+}
+
+// Function: size
+size_t TimingWheel::size() const {
+  return _size;
+}
+
+// Function: slack
+std::chrono::steady_clock::duration TimingWheel::slack() const {
+  return _slack;
+}
+
+// Function: next_expiry
+// Return the time point of the next tick that needs attention (an expiry or a cascade), or
+// time_point::max() if the wheel is empty.
+std::chrono::steady_clock::time_point TimingWheel::next_expiry() const {
+  if(auto t = _next_tick(); t != NULL_TICK) {
+    return _origin + _slack * t;
+  }
+  return std::chrono::steady_clock::time_point::max();
+}
+
+// Procedure: clear
+void TimingWheel::clear() {
+  for(size_t l=0; l<NUM_LEVELS; ++l) {
+    for(size_t s=0; s<NUM_SLOTS; ++s) {
+      for(auto e = _slots[l][s]; e; ) {
+        auto next = e->_timer().next;
+        e->_timer().satellite = -1;
+        e->_timer().prev = e->_timer().next = nullptr;
+        e = next;
+      }
+      _slots[l][s] = nullptr;
+    }
+    _bitmap[l] = 0;
+  }
+  _size = 0;
+}
+
+// Procedure: insert
+void TimingWheel::insert(Event* e) {
+  if(e->_timer().satellite != -1) return;
+  _link(e);
+}
+
+// Procedure: remove
+void TimingWheel::remove(Event* e) {
+  if(e->_timer().satellite == -1) return;
+  _unlink(e);
+}
+
+// Function: _tick_of
+// Convert the time point to a tick, rounding up (due tick of a timeout) or down (the last tick
+// that has been reached by the time point).
+uint64_t TimingWheel::_tick_of(std::chrono::steady_clock::time_point tp, bool round_up) const {
+  if(tp <= _origin) {
+    return 0;
+  }
+  auto d = (tp - _origin).count();
+  auto q = static_cast<uint64_t>(d / _slack.count());
+  return (round_up && d % _slack.count()) ? q + 1 : q;
+}
+
+// Function: _next_tick
+// Find the first tick at or after the current tick whose slot is occupied. Slots of a lower level
+// always come before slots of an upper level.
+uint64_t TimingWheel::_next_tick() const {
+
+  for(size_t l=0; l<NUM_LEVELS; ++l) {
+
+    if(_bitmap[l] == 0) continue;
+
+    auto c = (_tick >> (6*l)) & 63;
+    auto m = l == 0 ? _bitmap[l] & (~0ull << c) : (c == 63 ? 0 : _bitmap[l] & (~0ull << (c+1)));
+
+    if(m == 0) continue;
+
+    uint64_t s = __builtin_ctzll(m);
+    uint64_t hi = 6*(l+1) >= 64 ? 0 : (_tick >> (6*(l+1))) << (6*(l+1));
+
+    return hi | (s << (6*l));
+  }
+
+  return NULL_TICK;
+}
+
+// Procedure: _link
+// Place the event in the slot of its due tick relative to the current tick.
+void TimingWheel::_link(Event* e) {
+
+  auto& t = e->_timer();
+  auto due = std::max(_tick_of(t.timeout, true), _tick);
+  size_t l = (due == _tick) ? 0 : (63 - __builtin_clzll(due ^ _tick)) / 6;
+  size_t s = (due >> (6*l)) & 63;
+
+  t.satellite = static_cast<int>(l*NUM_SLOTS + s);
+  t.prev = nullptr;
+  t.next = _slots[l][s];
+
+  if(t.next) {
+    t.next->_timer().prev = e;
+  }
+
+  _slots[l][s] = e;
+  _bitmap[l] |= (1ull << s);
+  ++_size;
+}
+
+// Procedure: _unlink
+void TimingWheel::_unlink(Event* e) {
+
+  auto& t = e->_timer();
+  size_t l = t.satellite / NUM_SLOTS;
+  size_t s = t.satellite % NUM_SLOTS;
+
+  if(t.prev) {
+    t.prev->_timer().next = t.next;
+  }
+  else {
+    _slots[l][s] = t.next;
+  }
+
+  if(t.next) {
+    t.next->_timer().prev = t.prev;
+  }
+
+  if(_slots[l][s] == nullptr) {
+    _bitmap[l] &= ~(1ull << s);
+  }
+
+  t.satellite = -1;
+  t.prev = t.next = nullptr;
+  --_size;
+}
+
 
 };  // End of namespace dtc. ----------------------------------------------------------------------
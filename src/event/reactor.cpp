@@ -16,13 +16,19 @@
 namespace dtc {
 
 // Constructor
-Reactor::Reactor(unsigned num_workers) {
+Reactor::Reactor(unsigned num_workers, DemuxType demux) : _demux {demux} {
 
   // Ignore the signal sigpipe
   ::signal(SIGPIPE, SIG_IGN);
 
   // Enable the thread pool. To ensure correct functionality, each reactor must have 
-  // at least one working thread.
+  // at least one working thread. Workers are pinned to the CPUs of our cpuset if the
+  // pinning policy says so.
+  _threadpool.burst(env::threadpool_burst());
+  _threadpool.spin(env::threadpool_spin());
+  if(env::threadpool_pin()) {
+    _threadpool.pin(this_cpuset());
+  }
   _threadpool.spawn(num_workers);
   
   // Initiate the notify event.
@@ -38,9 +44,13 @@ Reactor::Reactor(unsigned num_workers) {
 // Destructor
 Reactor::~Reactor() {
 
+  // Stop the shards before tearing down our own events.
+  _shutdown_shards();
+
   // Fetch all events from the eventset to break all possible dependencies among event 
   // destructors that are defined by users.
   auto fetch = std::move(_eventset);
+  auto retired = std::move(_retired);
 
   // Disable the thread pool. Make sure all threads are dead before reactor is destroyed.
   _threadpool.shutdown();
@@ -48,9 +58,111 @@ Reactor::~Reactor() {
 
 // Procedure: clear
 void Reactor::clear() {
-  _timeoutpq.clear();
+
+  for(auto s : _shards) {
+    s->promise([s] () { s->clear(); }).get();
+  }
+
+  _timing_wheel.clear();
   _demux._clear();
+
+  if(_primary) {
+    _primary->_num_sharded_events.fetch_sub(_eventset.size(), std::memory_order_relaxed);
+  }
+
   auto fetch = std::move(_eventset);
+
+  // Events with activations in flight must outlive their workers.
+  for(auto& event : fetch) {
+    event->_reactor.store(nullptr, std::memory_order_release);
+    if(event->_num_activations) {
+      _retired.push_back(event);
+    }
+  }
+}
+
+// Function: statistics
+// Return a snapshot of the instruments of the reactor merged with those of its shards.
+ReactorStatistics Reactor::statistics() const {
+  auto s = _monitor.snapshot();
+  for(auto shard : _shards) {
+    s += shard->_monitor.snapshot();
+  }
+  return s;
+}
+
+// Procedure: clear_statistics
+void Reactor::clear_statistics() {
+  _monitor.clear();
+  for(auto shard : _shards) {
+    shard->_monitor.clear();
+  }
+}
+
+// Procedure: spawn_shards
+// Partition the reactor into N event loops. Each additional loop is a reactor with its own demux,
+// timeout heap, promise queue, and thread pool, driven by an owner thread pinned to a core of 
+// our cpuset when workers are pinned (env::threadpool_pin). The worker threads of the primary 
+// reactor are split evenly among all N loops, the primary included, which shrinks its own pool.
+//
+// The owner thread of the primary loop is the caller and is left unpinned: its affinity is the
+// cpuset of the process seen by this_cpuset, and is inherited by the programs it forks.
+void Reactor::spawn_shards(unsigned N) {
+
+  if(!is_owner()) {
+    throw std::runtime_error("Only the reactor owner can spawn shards");
+  }
+
+  if(_primary != nullptr || !_shards.empty() || N <= 1) return;
+
+  auto W = std::max(1u, static_cast<unsigned>(num_workers()) / N);
+
+  if(num_workers() > W) {
+    _threadpool.shutdown();
+    _threadpool.spawn(W);
+  }
+  auto C = this_cpuset();
+  auto D = demux_type();
+  auto P = env::threadpool_pin();
+
+  for(unsigned i=1; i<N; ++i) {
+
+    std::promise<Reactor*> p;
+    auto fu = p.get_future();
+
+    // The shard must be constructed by the thread that dispatches it (the owner).
+    _shard_threads.emplace_back([this, &p, i, W, C, D, P] () {
+
+      if(P) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(C[i % C.size()], &set);
+        ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+      }
+
+      auto shard = std::make_unique<Reactor>(W, D);
+      shard->_primary = this;
+      p.set_value(shard.get());
+      shard->dispatch();
+    });
+
+    _shards.push_back(fu.get());
+  }
+}
+
+// Procedure: _shutdown_shards
+void Reactor::_shutdown_shards() {
+
+  for(auto s : _shards) {
+    s->break_loop();
+  }
+
+  for(auto& t : _shard_threads) {
+    t.join();
+  }
+
+  _shards.clear();
+  _shard_threads.clear();
 }
 
 //// Function: _expired
@@ -67,12 +179,18 @@ void Reactor::clear() {
 // Function: _freeze
 bool Reactor::_freeze(std::shared_ptr<Event> event) {
 
-  if(_eventset.find(event) == _eventset.end()) return false;
+  if(_eventset.find(event) == _eventset.end()) {
+    if(auto s = _shard_of(event); s) {
+      s->freeze(std::move(event));
+      return true;
+    }
+    return false;
+  }
 
   switch(event->type) {
     case Event::TIMEOUT:
     case Event::PERIODIC:
-      _timeoutpq.remove(event.get());
+      _timing_wheel.remove(event.get());
     break;
 
     case Event::READ:
@@ -90,12 +208,18 @@ bool Reactor::_freeze(std::shared_ptr<Event> event) {
 // Function: _thaw
 bool Reactor::_thaw(std::shared_ptr<Event> event) {
 
-  if(_eventset.find(event) == _eventset.end()) return false;
+  if(_eventset.find(event) == _eventset.end()) {
+    if(auto s = _shard_of(event); s) {
+      s->thaw(std::move(event));
+      return true;
+    }
+    return false;
+  }
 
   switch(event->type) {
     case Event::TIMEOUT:
     case Event::PERIODIC:
-      _timeoutpq.insert(event.get());
+      _timing_wheel.insert(event.get());
     break;
 
     case Event::READ:
@@ -110,6 +234,113 @@ bool Reactor::_thaw(std::shared_ptr<Event> event) {
   return true;
 }
 
+// Procedure: _register
+// Register an event with the reactor. A write event stays off the demux until it is thawed.
+void Reactor::_register(std::shared_ptr<Event> event) {
+
+  auto e = event.get();
+
+  _eventset.insert(std::move(event));
+  e->_reactor.store(this, std::memory_order_release);
+
+  _count_sharded_event(true);
+
+  switch(e->type) {
+    case Event::TIMEOUT:
+    case Event::PERIODIC:
+      _timing_wheel.insert(e);
+    break;
+
+    case Event::READ:
+      _demux._insert(e);
+    break;
+
+    default:
+    break;
+  }
+}
+
+// Function: insert_batch
+// Insert a set of events created by the caller. The events are grouped by their event loop (the
+// loop of their strand, or this reactor) and each group is registered by a single promise. The
+// returned future becomes ready once all groups are in.
+std::future<void> Reactor::insert_batch(std::vector<std::shared_ptr<Event>> events) {
+  return _batch(std::move(events), true);
+}
+
+// Function: remove_batch
+// Remove a set of events. The events are grouped by the event loop that holds them (the loop of
+// their strand, or this reactor) and each group is removed by a single promise.
+std::future<void> Reactor::remove_batch(std::vector<std::shared_ptr<Event>> events) {
+  return _batch(std::move(events), false);
+}
+
+// Function: _batch
+std::future<void> Reactor::_batch(std::vector<std::shared_ptr<Event>>&& events, bool insert) {
+
+  struct State {
+    std::atomic<size_t> num_pending {0};
+    std::promise<void> done;
+  };
+
+  std::vector<std::pair<Reactor*, std::vector<std::shared_ptr<Event>>>> groups;
+
+  for(auto& event : events) {
+
+    if(event == nullptr) continue;
+
+    // The loop comes from the strand, which is bound before its event is handed to a shard, so a
+    // removal issued right after a batch insert is queued behind the registration.
+    auto loop = this;
+
+    if(insert) {
+      if(event->_strand) {
+        loop = event->_strand->_bind(this);
+      }
+    }
+    else if(auto s = _shard_of(event); s) {
+      loop = s;
+    }
+
+    auto itr = std::find_if(groups.begin(), groups.end(), [loop] (auto& g) { return g.first == loop; });
+
+    if(itr == groups.end()) {
+      groups.emplace_back(loop, std::vector<std::shared_ptr<Event>>{});
+      itr = std::prev(groups.end());
+    }
+
+    itr->second.push_back(std::move(event));
+  }
+
+  auto state = std::make_shared<State>();
+  auto fu = state->done.get_future();
+
+  if(groups.empty()) {
+    state->done.set_value();
+    return fu;
+  }
+
+  state->num_pending = groups.size();
+
+  for(auto& [loop, batch] : groups) {
+    loop->silent_promise([loop=loop, batch=std::move(batch), state, insert] () mutable {
+      for(auto& event : batch) {
+        if(insert) {
+          loop->_register(std::move(event));
+        }
+        else {
+          loop->_remove(std::move(event));
+        }
+      }
+      if(state->num_pending.fetch_sub(1) == 1) {
+        state->done.set_value();
+      }
+    });
+  }
+
+  return fu;
+}
+
 // Function: _remove
 // The public wrapper of the function to remove a list of events.
 bool Reactor::_remove(std::shared_ptr<Event> event) {
@@ -121,13 +352,13 @@ bool Reactor::_remove(std::shared_ptr<Event> event) {
       // Timeout-related event.
       case Event::TIMEOUT:
       case Event::PERIODIC:
-        _timeoutpq.remove(event.get());
+        _timing_wheel.remove(event.get());
       break;
 
       // Non-blocking IO event.
       case Event::READ:
       case Event::WRITE:
-        _demux._remove(event.get());
+        _demux._erase(event.get());
       break;
 
       default:
@@ -137,17 +368,34 @@ bool Reactor::_remove(std::shared_ptr<Event> event) {
     
     // Remove the event from the reactor
     _eventset.erase(itr);
-    event->_reactor = nullptr;
+    event->_reactor.store(nullptr, std::memory_order_release);
+
+    _count_sharded_event(false);
 
-    // Let the worker thread to perform the destructor.
-    _threadpool.async([event=std::move(event)](){});
+    _retire(std::move(event));
 
     return true;
   }
+  else if(auto s = _shard_of(event); s) {
+    s->remove(std::move(event));
+    return true;
+  }
 
   return false;
 }
     
+// Procedure: _retire
+// Release a removed event. An event with activations in flight is kept until the last one
+// completes; otherwise we let the worker thread to perform the destructor.
+void Reactor::_retire(std::shared_ptr<Event>&& event) {
+  if(event->_num_activations) {
+    _retired.push_back(std::move(event));
+  }
+  else {
+    _threadpool.silent_async([event=std::move(event)](){});
+  }
+}
+
 // Function: notify
 // Notify the reactor to wake up by the eventfd technique.
 bool Reactor::notify() {
@@ -183,21 +431,46 @@ void Reactor::dispatch() {
 
   while(1) {
 
-    // Carry on the promises
+    auto beg = _monitoring ? now() : std::chrono::steady_clock::time_point{};
+
+    // Carry on the promises and the completed activations. The notify flag is reset before 
+    // draining the queues so that a producer enqueuing after this point wakes us up again.
+    _notified = false;
     _carry_on_promises();
 
-    if(_break_loop || _eventset.size() <= _threshold || (_break_loop_on && _break_loop_on(*this))) {
+    if(_monitoring) {
+      auto tp = now();
+      _carry_on_completions();
+      _monitor.completions(now() - tp);
+    }
+    else {
+      _carry_on_completions();
+    }
+
+    // A shard lives until its primary reactor breaks its loop.
+    if(_break_loop || (_primary == nullptr && num_events() <= _threshold) || 
+       (_break_loop_on && _break_loop_on(*this))) {
       break;
     }
 
     // Activate the io events.
-    _poll_io_events();
-
-    // Synchronize the time point.
-    _sync_time_point = now();
+    if(_monitoring) {
+      auto tp = now();
+      _poll_io_events();
+      _sync_time_point = now();
+      _monitor.io_poll(_sync_time_point - tp);
+    }
+    else {
+      _poll_io_events();
+      _sync_time_point = now();
+    }
 
     // Activate timeout events.
     _poll_timeout_events();
+
+    if(_monitoring) {
+      _monitor.iteration(now() - beg);
+    }
   }
   
   _break_loop = true;
@@ -205,132 +478,207 @@ void Reactor::dispatch() {
 
 // Procedure: _carry_on_promises
 void Reactor::_carry_on_promises() {
+
   assert(is_owner());
-  std::function<void()> c;
+
+  Task c;
+
+  if(!_monitoring) {
+    while(_promises.try_dequeue(c)) {
+      c(); 
+    }
+    return;
+  }
+
+  auto beg = now();
+  auto depth = _promises.size_approx();
+  auto num = size_t {0};
+
   while(_promises.try_dequeue(c)) {
     c(); 
+    ++num;
   }
+
+  _monitor.promises(depth, num, now() - beg);
 }
 
-// Procedure: _activate_event
-// On event activation, the procedure pushes an active event into the task queue.
-// The procedure can only be called by the main thread (under reactor lock) sequentially.
-//
-// reactor ---- (create additional event owner) ----> worker threads
-//
-void Reactor::_activate_event(Event* e) {
+// Procedure: _carry_on_completions
+// Finish the activations reported by the workers: re-arm read events, reschedule periodic events,
+// remove events whose callback asked for it, and hand strands over to their next events.
+void Reactor::_carry_on_completions() {
 
-  // Clear the notify event.
-  if(e == _notifier.get()) {
-    uint64_t c;
-    while(::read(_notifier->device()->fd(), &c, sizeof(c)) > 0);
-    _notified = false;
+  assert(is_owner());
+
+  {
+    std::scoped_lock lock(_completion_lock);
+    std::swap(_completions, _completions_swap);
+  }
+
+  for(auto [e, s] : _completions_swap) {
+    if(e->_strand) {
+      // The event may be released below; keep its strand alive until resumed.
+      auto strand = e->_strand;
+      _carry_on_completion(e, s);
+      _resume(strand.get());
+    }
+    else {
+      _carry_on_completion(e, s);
+    }
+  }
+
+  _completions_swap.clear();
+}
+
+// Procedure: _carry_on_completion
+void Reactor::_carry_on_completion(Event* e, Event::Signal s) {
+
+  --e->_num_activations;
+
+  // The event has been removed while the activation was in flight.
+  if(e->_reactor.load(std::memory_order_relaxed) != this) {
+    if(e->_num_activations == 0) {
+      _reap(e);
+    }
     return;
   }
 
-  
-  // Create a new ownership for worker thread.
-  auto event = e->shared_from_this();
+  if(s == Event::REMOVE || e->type == Event::TIMEOUT) {
+    _remove(e->shared_from_this());
+    return;
+  }
 
-  switch(event->type) {
-    
-    // Case 1-1: Read event.
+  switch(e->type) {
     case Event::READ:
-      _demux._remove(event.get());
-      _threadpool.async(
-        [this, event=std::move(event)] () mutable {
-
-          switch(auto s = event->_on(*event); s) {
-
-            case Event::REMOVE:
-              remove(std::move(event));
-            break;
-
-            default:
-              promise([this, event=std::move(event)] {
-                if(_eventset.find(event) != _eventset.end()) {
-                  _demux._insert(event.get());
-                }
-              });
-            break;
-          }
-        }
-      );
+      _demux._insert(e);
     break;
 
-    // Case 1-2: Write event.
-    case Event::WRITE:
-      _demux._remove(event.get());
-      _threadpool.async(
-        [this, event=std::move(event)] () mutable {
-          switch(auto s = event->_on(*event); s) {
-            case Event::REMOVE:
-              remove(std::move(event));
-            break;
-            
-            default:
-            break;
-          }
-        }
-      );
-    break;
-    
-    // Case 2: Timeout event
-    case Event::TIMEOUT:
-      //_eventset.erase(event);
-      _threadpool.async(
-        [this, event=std::move(event)] () mutable {
-          event->_on(*event);
-          remove(std::move(event));
-        }
-      );
-    break;
-
-    // Case 3: Periodic event.
     case Event::PERIODIC:
-      _threadpool.async(
-        [this, event=std::move(event)] () mutable {
-          // Adjust the timeout.
-          switch(auto s = event->_on(*event); s) {
-
-            case Event::REMOVE:
-              remove(std::move(event));
-            break;
-
-            default:
-              event->_timer().timeout = _sync_time_point + event->_timer().duration;
-              promise([this, event=std::move(event)]() { 
-                if(_eventset.find(event) != _eventset.end()) { 
-                  _timeoutpq.insert(event.get()); 
-                } 
-              });
-            break;
-          }
-        }
-      );
+      e->_timer().timeout = _sync_time_point + e->_timer().duration;
+      _timing_wheel.insert(e);
     break;
 
     default:
     break;
-  };
+  }
 }
 
-// Procedure: _poll_timeout_events 
-// The procedure removes activate timeout events (those events with timeout value passing the
-// last synchronization point) from the priority queue.
-void Reactor::_poll_timeout_events() {
+// Procedure: _reap
+// Release a retired event whose last activation has completed.
+void Reactor::_reap(Event* e) {
+  auto itr = std::find_if(_retired.begin(), _retired.end(), [e] (auto& r) { return r.get() == e; });
+  if(itr != _retired.end()) {
+    auto event = std::move(*itr);
+    *itr = std::move(_retired.back());
+    _retired.pop_back();
+    _retire(std::move(event));
+  }
+}
+
+// Procedure: _resume
+// Hand the strand over to its next waiting event. Waiting events that have been removed in 
+// the meantime are dropped without running.
+void Reactor::_resume(Strand* strand) {
+
+  while(auto e = strand->_pop()) {
+    
+    if(e->_reactor.load(std::memory_order_relaxed) == this) {
+      _threadpool.post({&Reactor::_run_activation, this, e}, e->_priority);
+      return;
+    }
+
+    if(--e->_num_activations == 0) {
+      _reap(e);
+    }
+  }
+
+  strand->_busy = false;
+}
+
+// Procedure: _complete
+// Called by the worker (or the owner if there is no worker) when an activation finishes.
+void Reactor::_complete(Event* e, Event::Signal s) {
+  {
+    std::scoped_lock lock(_completion_lock);
+    _completions.emplace_back(e, s);
+  }
+  notify();
+}
+
+// Procedure: _run_activation
+// The job executed by the worker thread for an activated event.
+void Reactor::_run_activation(void* reactor, void* event) {
+
+  auto r = static_cast<Reactor*>(reactor);
+  auto e = static_cast<Event*>(event);
+
+  if(!r->_monitoring) {
+    r->_complete(e, e->_on(*e));
+    return;
+  }
+
+  auto beg = now();
+  auto s = e->_on(*e);
+  r->_monitor.callback(e->type, beg - e->_ready, now() - beg);
+  r->_complete(e, s);
+}
+
+// Procedure: _activate_event
+// On event activation, the procedure pushes an active event into the task queue.
+// The procedure can only be called by the main thread (under reactor lock) sequentially.
+// The activation is posted to the thread pool as a fixed-size job holding raw pointers; the
+// event is kept alive by the reactor (_eventset, or _retired if it is removed meanwhile) until
+// the worker reports the completion. Hence, the steady-state activation path does not allocate.
+//
+// reactor ---- (job) ----> worker threads ---- (completion) ----> reactor
+//
+void Reactor::_activate_event(Event* e) {
 
-  while(!_timeoutpq.empty()) {
+  // Clear the notify event.
+  if(e == _notifier.get()) {
+    uint64_t c;
+    while(::read(_notifier->device()->fd(), &c, sizeof(c)) > 0);
+    return;
+  }
 
-    // Stop if the minimum timeout is not yet reached.
-    if(_timeoutpq.top()->_timer().timeout > _sync_time_point) break;
+  if(_monitoring) {
+    _monitor.activation(e->type);
+  }
 
-    // Remove the timeout event.
-    auto event = _timeoutpq.pop();
+  // IO events are taken off the demux until the activation completes (read events) or the 
+  // event is thawed (write events).
+  if(e->type == Event::READ || e->type == Event::WRITE) {
+    _demux._remove(e);
+  }
   
-    // Insert the event into the active list.
-    _activate_event(event);
+  // A stranded event waits for its turn if another event of the strand is running. An event
+  // that is already waiting is not queued twice.
+  if(auto strand = e->_strand.get(); strand) {
+    if(e->_strand_queued) {
+      return;
+    }
+    ++e->_num_activations;
+    if(strand->_busy) {
+      strand->_push(e);
+      return;
+    }
+    strand->_busy = true;
   }
+  else {
+    ++e->_num_activations;
+  }
+  
+  _threadpool.post({&Reactor::_run_activation, this, e}, e->_priority);
+}
+
+// Procedure: _poll_timeout_events 
+// The procedure removes activate timeout events (those events with timeout value passing the
+// last synchronization point) from the timing wheel.
+void Reactor::_poll_timeout_events() {
+  _timing_wheel.expire(_sync_time_point, [this] (Event* e) { 
+    // A timer becomes ready at its deadline.
+    e->_ready = e->_timer().timeout;
+    _activate_event(e); 
+  });
 }
 
 // Procedure: _poll_io_events
@@ -338,17 +686,29 @@ void Reactor::_poll_timeout_events() {
 // list through the procedure on_activate_event.
 void Reactor::_poll_io_events() {
 
-  // Obtain the waiting time for this round.
-  auto event = _timeoutpq.top();
+  // IO events reported by the same poll become ready at the same time point, which is taken 
+  // once on the first activation.
+  auto ready = std::chrono::steady_clock::time_point{};
+
+  auto on = [this, &ready] (Event* e) { 
+    if(_monitoring) {
+      if(ready == std::chrono::steady_clock::time_point{}) {
+        ready = now();
+      }
+      e->_ready = ready;
+    }
+    _activate_event(e); 
+  };
 
-  if(event != nullptr) {
-    if(event->_timer().timeout > _sync_time_point) {
-      _demux._poll(event->_timer().timeout - _sync_time_point, [this] (Event* e) { _activate_event(e); });
+  // Obtain the waiting time for this round.
+  if(!_timing_wheel.empty()) {
+    if(auto tp = _timing_wheel.next_expiry(); tp > _sync_time_point) {
+      _demux._poll(tp - _sync_time_point, on);
     }
     // else to process the timeout first.
   }
   else {
-    _demux._poll(std::chrono::milliseconds::max(), [this] (Event* e) { _activate_event(e); });
+    _demux._poll(std::chrono::milliseconds::max(), on);
   }
 }
 
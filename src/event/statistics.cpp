@@ -0,0 +1,197 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright (c) 2018, Tsung-Wei Huang and Martin D. F. Wong,                 *
+ * University of Illinois at Urbana-Champaign (UIUC), IL, USA.                *
+ *                                                                            *
+ * All Rights Reserved.                                                       *
+ *                                                                            *
+ * This program is free software. You can redistribute and/or modify          *
+ * it in accordance with the terms of the accompanying license agreement.     *
+ * See LICENSE in the top-level directory for details.                        *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <dtc/event/statistics.hpp>
+
+namespace dtc {
+
+// Function: percentile
+// Return the upper bound of the bucket holding the p-th quantile (0 <= p <= 1).
+std::chrono::nanoseconds Histogram::percentile(double p) const {
+
+  if(_count == 0) {
+    return std::chrono::nanoseconds(0);
+  }
+
+  auto rank = static_cast<uint64_t>(std::ceil(std::clamp(p, 0.0, 1.0) * _count));
+  auto cumulative = uint64_t {0};
+
+  for(size_t i=0; i<NUM_BUCKETS; ++i) {
+    if(cumulative += _buckets[i]; cumulative >= std::max(rank, uint64_t{1})) {
+      return std::chrono::nanoseconds(i == 0 ? 0 : std::min(uint64_t{1} << i, _max));
+    }
+  }
+
+  return max();
+}
+
+// Operator: +=
+Histogram& Histogram::operator += (const Histogram& rhs) {
+  for(size_t i=0; i<NUM_BUCKETS; ++i) {
+    _buckets[i] += rhs._buckets[i];
+  }
+  _count += rhs._count;
+  _sum += rhs._sum;
+  _max = std::max(_max, rhs._max);
+  return *this;
+}
+
+// Function: to_json
+json Histogram::to_json() const {
+
+  // Trailing empty buckets are trimmed.
+  auto n = NUM_BUCKETS;
+  while(n > 0 && _buckets[n-1] == 0) --n;
+
+  return {
+    {"count", _count},
+    {"mean_ns", mean().count()},
+    {"max_ns", _max},
+    {"p50_ns", percentile(0.5).count()},
+    {"p90_ns", percentile(0.9).count()},
+    {"p99_ns", percentile(0.99).count()},
+    {"p999_ns", percentile(0.999).count()},
+    {"buckets", std::vector<uint64_t>(_buckets.begin(), _buckets.begin() + n)}
+  };
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Procedure: clear
+void AtomicHistogram::clear() {
+  for(auto& b : _buckets) {
+    b.store(0, std::memory_order_relaxed);
+  }
+  _count.store(0, std::memory_order_relaxed);
+  _sum.store(0, std::memory_order_relaxed);
+  _max.store(0, std::memory_order_relaxed);
+}
+
+// Function: snapshot
+Histogram AtomicHistogram::snapshot() const {
+  Histogram h;
+  for(size_t i=0; i<Histogram::NUM_BUCKETS; ++i) {
+    h._buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+  }
+  h._count = _count.load(std::memory_order_relaxed);
+  h._sum = _sum.load(std::memory_order_relaxed);
+  h._max = _max.load(std::memory_order_relaxed);
+  return h;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Operator: +=
+ReactorStatistics& ReactorStatistics::operator += (const ReactorStatistics& rhs) {
+  num_loops += rhs.num_loops;
+  num_iterations += rhs.num_iterations;
+  num_promises += rhs.num_promises;
+  promise_queue_depth += rhs.promise_queue_depth;
+  max_promise_queue_depth = std::max(max_promise_queue_depth, rhs.max_promise_queue_depth);
+  for(size_t i=0; i<num_activations.size(); ++i) {
+    num_activations[i] += rhs.num_activations[i];
+  }
+  iteration += rhs.iteration;
+  io_poll += rhs.io_poll;
+  promises += rhs.promises;
+  completions += rhs.completions;
+  delay += rhs.delay;
+  for(size_t i=0; i<callback.size(); ++i) {
+    callback[i] += rhs.callback[i];
+  }
+  return *this;
+}
+
+// Function: to_json
+json ReactorStatistics::to_json() const {
+
+  static const std::array<const char*, 4> types {"timeout", "periodic", "read", "write"};
+
+  json activations, callbacks;
+
+  for(size_t i=0; i<types.size(); ++i) {
+    activations[types[i]] = num_activations[i];
+    callbacks[types[i]] = callback[i].to_json();
+  }
+
+  return {
+    {"num_loops", num_loops},
+    {"num_iterations", num_iterations},
+    {"num_promises", num_promises},
+    {"promise_queue_depth", promise_queue_depth},
+    {"max_promise_queue_depth", max_promise_queue_depth},
+    {"num_activations", activations},
+    {"iteration", iteration.to_json()},
+    {"io_poll", io_poll.to_json()},
+    {"promises", promises.to_json()},
+    {"completions", completions.to_json()},
+    {"delay", delay.to_json()},
+    {"callback", callbacks}
+  };
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Procedure: clear
+void ReactorMonitor::clear() {
+  _iteration.clear();
+  _io_poll.clear();
+  _promises.clear();
+  _completions.clear();
+  _num_iterations.store(0, std::memory_order_relaxed);
+  _num_promises.store(0, std::memory_order_relaxed);
+  _promise_queue_depth.store(0, std::memory_order_relaxed);
+  _max_promise_queue_depth.store(0, std::memory_order_relaxed);
+  for(auto& n : _num_activations) {
+    n.store(0, std::memory_order_relaxed);
+  }
+  for(auto& slot : _slots) {
+    slot.delay.clear();
+    for(auto& c : slot.callback) {
+      c.clear();
+    }
+  }
+}
+
+// Function: snapshot
+ReactorStatistics ReactorMonitor::snapshot() const {
+
+  ReactorStatistics s;
+
+  s.num_loops = 1;
+  s.num_iterations = _num_iterations.load(std::memory_order_relaxed);
+  s.num_promises = _num_promises.load(std::memory_order_relaxed);
+  s.promise_queue_depth = _promise_queue_depth.load(std::memory_order_relaxed);
+  s.max_promise_queue_depth = _max_promise_queue_depth.load(std::memory_order_relaxed);
+
+  for(size_t i=0; i<_num_activations.size(); ++i) {
+    s.num_activations[i] = _num_activations[i].load(std::memory_order_relaxed);
+  }
+
+  s.iteration = _iteration.snapshot();
+  s.io_poll = _io_poll.snapshot();
+  s.promises = _promises.snapshot();
+  s.completions = _completions.snapshot();
+
+  for(const auto& slot : _slots) {
+    s.delay += slot.delay.snapshot();
+    for(size_t i=0; i<slot.callback.size(); ++i) {
+      s.callback[i] += slot.callback[i].snapshot();
+    }
+  }
+
+  return s;
+}
+
+};  // End of namespace dtc. ----------------------------------------------------------------------
+
@@ -0,0 +1,620 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright (c) 2018, Tsung-Wei Huang and Martin D. F. Wong,                 *
+ * University of Illinois at Urbana-Champaign (UIUC), IL, USA.                *
+ *                                                                            *
+ * All Rights Reserved.                                                       *
+ *                                                                            *
+ * This program is free software. You can redistribute and/or modify          *
+ * it in accordance with the terms of the accompanying license agreement.     *
+ * See LICENSE in the top-level directory for details.                        *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <dtc/event/uring.hpp>
+
+namespace dtc {
+
+// Ctor
+Uring::Uring(unsigned entries) {
+
+  io_uring_params p;
+  ::memset(&p, 0, sizeof(p));
+
+  if(_ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p)); _ring_fd == -1) {
+    throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)), "io_uring setup failed");
+  }
+
+  // We need the single mmap layout (5.4), the non-dropping CQ (5.5), and the timeout argument
+  // of io_uring_enter (5.11).
+  auto features = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+
+  if((p.features & features) != features) {
+    ::close(_ring_fd);
+    throw std::system_error(std::make_error_code(std::errc::function_not_supported), "io_uring features missing");
+  }
+
+  _sq_entries = p.sq_entries;
+  _sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  _cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+  _sq_sz = std::max(_sq_sz, _cq_sz);
+  _sqes_sz = p.sq_entries * sizeof(io_uring_sqe);
+
+  _sq_ptr = ::mmap(
+    nullptr, _sq_sz, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING
+  );
+
+  if(_sq_ptr == MAP_FAILED) {
+    ::close(_ring_fd);
+    throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)), "io_uring mmap failed");
+  }
+
+  // With IORING_FEAT_SINGLE_MMAP the CQ ring shares the mapping of the SQ ring.
+  _cq_ptr = _sq_ptr;
+
+  _sqes = static_cast<io_uring_sqe*>(::mmap(
+    nullptr, _sqes_sz, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, _ring_fd, IORING_OFF_SQES
+  ));
+
+  if(_sqes == MAP_FAILED) {
+    ::munmap(_sq_ptr, _sq_sz);
+    ::close(_ring_fd);
+    throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)), "io_uring mmap failed");
+  }
+
+  auto sq = static_cast<uint8_t*>(_sq_ptr);
+  auto cq = static_cast<uint8_t*>(_cq_ptr);
+
+  _sq_head  = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+  _sq_tail  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+  _sq_mask  = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+  _sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+  _cq_head  = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+  _cq_tail  = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+  _cq_mask  = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+  _cqes     = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+  // Provide the buffers of the receives to the kernel (5.7). A returned buffer is provided 
+  // again by a request whose success is not reported (5.17), so it rides along with the next 
+  // submission. The buffers are reserved lazily, so the pages the receives never touch cost 
+  // nothing.
+#if defined(IORING_RECV_MULTISHOT)
+  if(p.features & IORING_FEAT_CQE_SKIP) {
+
+    _bufs = static_cast<char*>(::mmap(
+      nullptr, NUM_RECV_BUFS*RECV_BUF_SZ, PROT_READ|PROT_WRITE, 
+      MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0
+    ));
+
+    if(_bufs == MAP_FAILED) {
+      _bufs = nullptr;
+    }
+    else {
+      auto sqe = _sqe();
+      sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+      sqe->fd = NUM_RECV_BUFS;
+      sqe->addr = reinterpret_cast<uint64_t>(_bufs);
+      sqe->len = RECV_BUF_SZ;
+      sqe->off = 0;
+      sqe->buf_group = RECV_BGID;
+      sqe->user_data = NULL_FD;
+
+      _submit(1, nullptr);
+
+      auto head = *_cq_head;
+      _recv_ok = (_cqes[head & *_cq_mask].res >= 0);
+      __atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);
+    }
+  }
+#endif
+}
+
+// Destructor
+Uring::~Uring() {
+
+  // Collect the data of the receives before closing the ring, which cancels all in-flight 
+  // requests. A receive whose cancellation does not complete in time leaves its device to the
+  // reads of the descriptor.
+  _clear();
+
+  for(auto& dev : _recv_dev) {
+    if(dev) {
+      std::scoped_lock lock(dev->_ahead.mutex);
+      dev->_ahead.armed = false;
+    }
+  }
+
+  ::munmap(_sqes, _sqes_sz);
+  ::munmap(_sq_ptr, _sq_sz);
+  ::close(_ring_fd);
+
+  if(_bufs) {
+    ::munmap(_bufs, NUM_RECV_BUFS*RECV_BUF_SZ);
+  }
+
+  std::free(_fd2ev[0]);
+  std::free(_fd2ev[1]);
+  std::free(_armed);
+  std::free(_gen);
+  std::free(_dirty);
+  std::free(_recv);
+  std::free(_revents);
+}
+
+// Procedure: _recap
+// Adjust the capacity to accommodate the file descriptor fd.
+void Uring::_recap(const int fd) {
+
+  if(_max_fd < fd){
+    _max_fd = fd;
+  }
+
+  if(size_t fd_num = _max_fd + 1; _buf_sz < fd_num){
+
+    auto old_cap =_buf_sz;
+    _buf_sz = _buf_sz == 0 ? 1 : _buf_sz;
+
+    while(_buf_sz < fd_num){
+      _buf_sz *= 2;
+    }
+
+    _fd2ev[0] = static_cast<Event**>(std::realloc(_fd2ev[0], _buf_sz*sizeof(Event*)));
+    _fd2ev[1] = static_cast<Event**>(std::realloc(_fd2ev[1], _buf_sz*sizeof(Event*)));
+    _armed = static_cast<uint32_t*>(std::realloc(_armed, _buf_sz*sizeof(uint32_t)));
+    _gen = static_cast<uint32_t*>(std::realloc(_gen, _buf_sz*sizeof(uint32_t)));
+    _dirty = static_cast<uint8_t*>(std::realloc(_dirty, _buf_sz*sizeof(uint8_t)));
+    _recv = static_cast<uint8_t*>(std::realloc(_recv, _buf_sz*sizeof(uint8_t)));
+    _revents = static_cast<uint32_t*>(std::realloc(_revents, _buf_sz*sizeof(uint32_t)));
+    ::memset((uint8_t*)_fd2ev[0] + old_cap*sizeof(Event*), 0, (_buf_sz-old_cap)*sizeof(Event*));
+    ::memset((uint8_t*)_fd2ev[1] + old_cap*sizeof(Event*), 0, (_buf_sz-old_cap)*sizeof(Event*));
+    ::memset((uint8_t*)_armed + old_cap*sizeof(uint32_t), 0, (_buf_sz-old_cap)*sizeof(uint32_t));
+    ::memset((uint8_t*)_gen + old_cap*sizeof(uint32_t), 0, (_buf_sz-old_cap)*sizeof(uint32_t));
+    ::memset((uint8_t*)_dirty + old_cap*sizeof(uint8_t), 0, (_buf_sz-old_cap)*sizeof(uint8_t));
+    ::memset((uint8_t*)_recv + old_cap*sizeof(uint8_t), 0, (_buf_sz-old_cap)*sizeof(uint8_t));
+    ::memset((uint8_t*)_revents + old_cap*sizeof(uint32_t), 0, (_buf_sz-old_cap)*sizeof(uint32_t));
+    _recv_dev.resize(_buf_sz);
+  }
+}
+
+// Procedure: _submit
+// Enter the kernel to submit all pending SQEs and optionally wait for completions. A null 
+// timeout with min_complete > 0 blocks until a completion arrives.
+void Uring::_submit(unsigned min_complete, const __kernel_timespec* ts) {
+
+  auto to_submit = *_sq_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+
+  if(to_submit == 0 && min_complete == 0) return;
+
+  io_uring_getevents_arg arg;
+  ::memset(&arg, 0, sizeof(arg));
+  arg.ts = reinterpret_cast<uint64_t>(ts);
+
+  auto ret = min_complete ? 
+    ::syscall(
+      __NR_io_uring_enter, _ring_fd, to_submit, min_complete, 
+      IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg)
+    ) :
+    ::syscall(__NR_io_uring_enter, _ring_fd, to_submit, 0, 0, nullptr, 0);
+
+  // Interrupted or timed out; whatever has been consumed by the kernel stays submitted.
+  if(ret == -1 && errno != EINTR && errno != ETIME && errno != EBUSY) {
+    throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)), "io_uring enter failed");
+  }
+}
+
+// Function: _sqe
+// Acquire the next free submission queue entry. If the queue is full, the pending batch is
+// pushed to the kernel first.
+io_uring_sqe* Uring::_sqe() {
+
+  auto tail = *_sq_tail;
+
+  if(tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) == _sq_entries) {
+    _submit(0, nullptr);
+    if(tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) == _sq_entries) {
+      throw std::system_error(std::make_error_code(std::errc::resource_unavailable_try_again), "io_uring sq full");
+    }
+  }
+
+  auto idx = tail & *_sq_mask;
+  auto sqe = &_sqes[idx];
+  ::memset(sqe, 0, sizeof(io_uring_sqe));
+
+  _sq_array[idx] = idx;
+  __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  return sqe;
+}
+
+// Procedure: _mark
+// Put the file descriptor on the dirty list to be synchronized with the kernel on the next poll.
+void Uring::_mark(const int fd) {
+  if(!_dirty[fd]) {
+    _dirty[fd] = 1;
+    _dirty_fds.push_back(fd);
+  }
+}
+
+// Procedure: _ready
+// Put the file descriptor on the list of descriptors to report on this round.
+void Uring::_ready(const int fd, const uint32_t rev) {
+  if(rev == 0) {
+    return;
+  }
+  if(_revents[fd] == 0) {
+    _ready_fds.push_back(fd);
+  }
+  _revents[fd] |= rev;
+}
+
+// Procedure: _flush
+// Translate the dirty list into poll requests. An in-flight request whose mask no longer matches
+// the interest set is cancelled and a new one (with a new generation) is queued. The read 
+// interest of an event that reads ahead goes to its receive instead.
+void Uring::_flush() {
+
+  for(auto fd : _dirty_fds) {
+
+    _dirty[fd] = 0;
+
+    auto want = _want(fd);
+
+    if((want & POLLIN) && _fd2ev[0][fd]->_read_ahead && _receive(fd)) {
+      want &= ~POLLIN;
+    }
+
+    if(want == _armed[fd]) continue;
+
+    if(_armed[fd]) {
+      auto sqe = _sqe();
+      sqe->opcode = IORING_OP_POLL_REMOVE;
+      sqe->fd = -1;
+      sqe->addr = (static_cast<uint64_t>(_gen[fd]) << 32) | static_cast<uint32_t>(fd);
+      sqe->user_data = NULL_FD;
+    }
+
+    ++_gen[fd];
+
+    if(want) {
+      auto sqe = _sqe();
+      sqe->opcode = IORING_OP_POLL_ADD;
+      sqe->fd = fd;
+      sqe->poll32_events = want;
+      sqe->user_data = (static_cast<uint64_t>(_gen[fd]) << 32) | static_cast<uint32_t>(fd);
+    }
+
+    _armed[fd] = want;
+  }
+
+  _dirty_fds.clear();
+}
+
+// Function: _receive
+// Cover the read interest of the descriptor with a multishot receive. Data already received 
+// ahead is reported on this round. Return false if the interest has to be polled instead: the
+// kernel cannot do it, the device is not a stream socket, or a reader is on the descriptor.
+bool Uring::_receive(const int fd) {
+
+  if(!_recv_ok) {
+    return false;
+  }
+
+  auto dev = _fd2ev[0][fd]->device();
+  auto& ahead = dev->_ahead;
+
+  // The final completion of the receive marks the descriptor dirty again.
+  if(_recv[fd] == RECV_CANCELLED) {
+    return true;
+  }
+
+  std::unique_lock lock(ahead.mutex, std::try_to_lock);
+
+  if(!lock.owns_lock()) {
+    return _recv[fd] == RECV_ARMED;
+  }
+
+  if(ahead.size() || ahead.error) {
+    _ready(fd, POLLIN);
+  }
+
+  if(_recv[fd] == RECV_ARMED) {
+    return true;
+  }
+
+  // Armed by the demux of another reactor that has yet to reap its cancellation; spin on the
+  // reader until the device is released.
+  if(ahead.armed) {
+    _ready(fd, POLLIN);
+    return true;
+  }
+
+  if(ahead.error || ahead.size() >= MAX_READ_AHEAD) {
+    return true;
+  }
+
+  if(ahead.eligible == -1) {
+    int type {0};
+    socklen_t len = sizeof(type);
+    ahead.eligible = (::getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == 0 && type == SOCK_STREAM);
+  }
+
+  if(!ahead.eligible) {
+    return false;
+  }
+
+#if defined(IORING_RECV_MULTISHOT)
+  auto sqe = _sqe();
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = RECV_BGID;
+  sqe->user_data = RECV_TAG | static_cast<uint32_t>(fd);
+#endif
+
+  ahead.armed = true;
+  ahead.used.store(true, std::memory_order_release);
+
+  _recv[fd] = RECV_ARMED;
+  _recv_dev[fd] = std::move(dev);
+
+  return true;
+}
+
+// Procedure: _cancel
+// Cancel the receive of the descriptor. The device is released on its final completion.
+void Uring::_cancel(const int fd) {
+  auto sqe = _sqe();
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = RECV_TAG | static_cast<uint32_t>(fd);
+  sqe->user_data = NULL_FD;
+  _recv[fd] = RECV_CANCELLED;
+}
+
+// Procedure: _received
+// Take the completion of a receive. The data go to the device, and the buffer goes back to the
+// ring. On the final completion the error that ended the receive, if any, is left to the reads
+// of the device, and the receive is re-armed for an event that still wants to read.
+void Uring::_received(const int fd, const int res, const uint32_t flags) {
+
+#if defined(IORING_RECV_MULTISHOT)
+  auto& ahead = _recv_dev[fd]->_ahead;
+  auto more = (flags & IORING_CQE_F_MORE) != 0;
+  auto bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+  auto error = 0;
+  auto size = size_t {0};
+
+  {
+    std::scoped_lock lock(ahead.mutex);
+
+    if(res > 0) {
+      ahead.append(_bufs + bid*RECV_BUF_SZ, res);
+    }
+
+    if(!more) {
+      ahead.armed = false;
+      switch(res) {
+        // Cancelled, or out of buffers for a moment.
+        case -ECANCELED:
+        case -ENOBUFS:
+        break;
+
+        // The kernel cannot do multishot receives.
+        case -EINVAL:
+          LOGW("io_uring multishot receive unsupported; poll the reads instead");
+          _recv_ok = false;
+        break;
+
+        case 0:
+          error = EPIPE;
+        break;
+
+        default:
+          error = res < 0 ? -res : 0;
+        break;
+      }
+      if(error) {
+        ahead.error = error;
+      }
+    }
+
+    size = ahead.size();
+  }
+
+  if(flags & IORING_CQE_F_BUFFER) {
+    _recycle(bid);
+  }
+
+  if(res > 0 || error) {
+    _ready(fd, POLLIN);
+  }
+
+  if(more) {
+    if(size >= MAX_READ_AHEAD && _recv[fd] == RECV_ARMED) {
+      _cancel(fd);
+    }
+    return;
+  }
+
+  _recv[fd] = RECV_NONE;
+  _recv_dev[fd].reset();
+
+  if(_fd2ev[0][fd]) {
+    _mark(fd);
+  }
+#endif
+}
+
+// Procedure: _recycle
+// Provide a returned buffer to the kernel again.
+void Uring::_recycle(const uint16_t bid) {
+#if defined(IORING_RECV_MULTISHOT)
+  auto sqe = _sqe();
+  sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+  sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+  sqe->fd = 1;
+  sqe->addr = reinterpret_cast<uint64_t>(_bufs + bid*RECV_BUF_SZ);
+  sqe->len = RECV_BUF_SZ;
+  sqe->off = bid;
+  sqe->buf_group = RECV_BGID;
+  sqe->user_data = NULL_FD;
+#endif
+}
+
+// Procedure: _reap
+// Take the completions. The readiness is collected on the ready list, and the interest that has
+// not been reported is re-armed on the next round.
+void Uring::_reap() {
+
+  auto head = *_cq_head;
+  auto tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+
+  for(; head != tail; ++head) {
+
+    auto& cqe = _cqes[head & *_cq_mask];
+    uint32_t efd = static_cast<uint32_t>(cqe.user_data);
+    uint32_t gen = static_cast<uint32_t>(cqe.user_data >> 32);
+
+    // Removal and cancellation acknowledgements.
+    if(efd == NULL_FD) {
+      continue;
+    }
+
+    if(efd & RECV_TAG) {
+      _received(efd & ~RECV_TAG, cqe.res, cqe.flags);
+      continue;
+    }
+
+    // The completion of a stale/cancelled poll request.
+    if(static_cast<int>(efd) > _max_fd || gen != _gen[efd] || _armed[efd] == 0) {
+      continue;
+    }
+
+    uint32_t rev = cqe.res < 0 ? (POLLIN | POLLOUT) : static_cast<uint32_t>(cqe.res);
+
+    _armed[efd] = 0;
+
+    if(rev & (POLLHUP|POLLERR|POLLNVAL)) {
+      rev |= (POLLIN | POLLOUT);
+    }
+
+    _ready(efd, rev & (POLLIN | POLLOUT));
+    _mark(efd);
+  }
+
+  __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+}
+
+// Procedure: _insert
+// Insert an event into the demux.
+void Uring::_insert(Event* event) {
+
+  auto efd = event->device()->fd();
+
+  _recap(efd);
+
+  switch(event->type){
+    case Event::READ:
+      if(_fd2ev[0][efd] == nullptr) ++_num_events;
+      _fd2ev[0][efd] = event;
+    break;
+
+    case Event::WRITE:
+      if(_fd2ev[1][efd] == nullptr) ++_num_events;
+      _fd2ev[1][efd] = event;
+    break;
+
+    default:
+      assert(false);
+    break;
+  }
+
+  _mark(efd);
+}
+
+// Procedure: _remove
+// Remove an event from the demux. An event taken off the demux on activation has already
+// completed its oneshot poll and costs no submission. The receive of a read event stays armed,
+// so the data keep coming in while the reader is busy.
+void Uring::_remove(Event* event) {
+
+  auto efd = event->device()->fd();
+
+  _recap(efd);
+
+  switch(event->type){
+    case Event::READ:
+      if(_fd2ev[0][efd] != nullptr) --_num_events;
+      _fd2ev[0][efd] = nullptr;
+    break;
+
+    case Event::WRITE:
+      if(_fd2ev[1][efd] != nullptr) --_num_events;
+      _fd2ev[1][efd] = nullptr;
+    break;
+
+    default:
+      assert(false);
+    break;
+  }
+
+  if(_armed[efd] & ~_want(efd)) {
+    _mark(efd);
+  }
+}
+
+// Procedure: _erase
+// Remove an event that is leaving the reactor for good. The receive of a read event is cancelled
+// right away and its completions are collected, so the device keeps the data received so far 
+// and is not held past the removal.
+void Uring::_erase(Event* event) {
+
+  _remove(event);
+
+  auto efd = event->device()->fd();
+
+  if(event->type != Event::READ || _recv[efd] == RECV_NONE) {
+    return;
+  }
+
+  if(_recv[efd] == RECV_ARMED) {
+    _cancel(efd);
+  }
+
+  _submit(0, nullptr);
+  _reap();
+}
+
+// Procedure: _clear
+void Uring::_clear() {
+  for(int fd=0; fd<=_max_fd; ++fd) {
+    if(_armed[fd]) {
+      auto sqe = _sqe();
+      sqe->opcode = IORING_OP_POLL_REMOVE;
+      sqe->fd = -1;
+      sqe->addr = (static_cast<uint64_t>(_gen[fd]) << 32) | static_cast<uint32_t>(fd);
+      sqe->user_data = NULL_FD;
+      ++_gen[fd];
+    }
+    if(_recv[fd] == RECV_ARMED) {
+      _cancel(fd);
+    }
+  }
+  _submit(0, nullptr);
+  if(_buf_sz) {
+    ::memset(_fd2ev[0], 0, _buf_sz*sizeof(Event*));
+    ::memset(_fd2ev[1], 0, _buf_sz*sizeof(Event*));
+    ::memset(_armed, 0, _buf_sz*sizeof(uint32_t));
+    ::memset(_dirty, 0, _buf_sz*sizeof(uint8_t));
+  }
+  _dirty_fds.clear();
+  _num_events = 0;
+  _reap();
+  if(_buf_sz) {
+    ::memset(_revents, 0, _buf_sz*sizeof(uint32_t));
+  }
+  _ready_fds.clear();
+}
+
+};  // End of namespace dtc. ---------------------------------------------------------------
@@ -44,6 +44,46 @@ std::streamsize BlockFile::read(void* buf, std::streamsize sz) const {
 }
 
 
+// Function: writev
+std::streamsize BlockFile::writev(const struct iovec* iov, int n) const {
+
+  issue_writev:
+  auto ret = ::writev(_fd, iov, n);
+  
+  if(ret == -1) {
+    if(errno == EINTR) {
+      goto issue_writev;
+    }
+    else {
+      throw std::system_error(
+        std::make_error_code(static_cast<std::errc>(errno)), "BlockFile writev failed"
+      );
+    }
+  }
+  
+  return ret;
+}
+
+// Function: readv
+std::streamsize BlockFile::readv(const struct iovec* iov, int n) const {
+
+  issue_readv:
+  auto ret = ::readv(_fd, iov, n);
+
+  if(ret == -1) {
+    if(errno == EINTR) {
+      goto issue_readv;
+    }
+    else {
+      throw std::system_error(
+        std::make_error_code(static_cast<std::errc>(errno)), "BlockFile readv failed"
+      );
+    }
+  }
+
+  return ret;
+}
+
 // Function: make_block_file
 std::shared_ptr<BlockFile> make_block_file(const std::filesystem::path& path, std::ios_base::openmode m) {
 
@@ -0,0 +1,399 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright (c) 2018, Tsung-Wei Huang, Chun-Xun Lin, and Martin D. F. Wong,  *
+ * University of Illinois at Urbana-Champaign (UIUC), IL, USA.                *
+ *                                                                            *
+ * All Rights Reserved.                                                       *
+ *                                                                            *
+ * This program is free software. You can redistribute and/or modify          *
+ * it in accordance with the terms of the accompanying license agreement.     *
+ * See LICENSE in the top-level directory for details.                        *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <dtc/ipc/codec.hpp>
+
+namespace dtc {
+
+// Operator: +=
+Codec::Counters& Codec::Counters::operator += (const Counters& rhs) {
+  num_frames += rhs.num_frames;
+  raw_bytes += rhs.raw_bytes;
+  encoded_bytes += rhs.encoded_bytes;
+  encode_time += rhs.encode_time;
+  decode_time += rhs.decode_time;
+  return *this;
+}
+
+// Procedure: encode
+// Append the frame of a raw message to the given string.
+void Codec::encode(std::string_view raw, std::string& frame) {
+  
+  auto beg = std::chrono::steady_clock::now();
+
+  auto off = frame.size();
+  
+  frame.resize(off + sizeof(Header) + raw.size());
+
+  auto data = frame.data() + off + sizeof(Header);
+
+  // Store the message as it is unless the encoding is smaller.
+  auto num = raw.size() > 0 ? _compress(raw.data(), raw.size(), data, raw.size() - 1) : 0;
+
+  if(num == 0) {
+    std::memcpy(data, raw.data(), raw.size());
+    num = raw.size();
+  }
+
+  frame.resize(off + sizeof(Header) + num);
+
+  Header header {raw.size(), num};
+  std::memcpy(frame.data() + off, &header, sizeof(header));
+  
+  auto end = std::chrono::steady_clock::now();
+  
+  _num_frames.fetch_add(1, std::memory_order_relaxed);
+  _raw_bytes.fetch_add(raw.size(), std::memory_order_relaxed);
+  _encoded_bytes.fetch_add(sizeof(Header) + num, std::memory_order_relaxed);
+  _encode_time.fetch_add(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(end - beg).count(), 
+    std::memory_order_relaxed
+  );
+}
+
+// Procedure: decode
+// Decode the payload of a frame into a buffer of the raw size.
+void Codec::decode(const Header& header, const char* data, char* raw) {
+  
+  auto beg = std::chrono::steady_clock::now();
+
+  if(header.encoded == header.raw) {
+    std::memcpy(raw, data, header.raw);
+  }
+  else if(header.encoded > header.raw || !_decompress(data, header.encoded, raw, header.raw)) {
+    throw std::system_error(
+      std::make_error_code(static_cast<std::errc>(EBADMSG)), "Failed to decode frame"
+    );
+  }
+  
+  auto end = std::chrono::steady_clock::now();
+  
+  _num_frames.fetch_add(1, std::memory_order_relaxed);
+  _raw_bytes.fetch_add(header.raw, std::memory_order_relaxed);
+  _encoded_bytes.fetch_add(sizeof(Header) + header.encoded, std::memory_order_relaxed);
+  _decode_time.fetch_add(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(end - beg).count(), 
+    std::memory_order_relaxed
+  );
+}
+
+// Function: counters
+Codec::Counters Codec::counters() const {
+  Counters c;
+  c.num_frames = _num_frames.load(std::memory_order_relaxed);
+  c.raw_bytes = _raw_bytes.load(std::memory_order_relaxed);
+  c.encoded_bytes = _encoded_bytes.load(std::memory_order_relaxed);
+  c.encode_time = _encode_time.load(std::memory_order_relaxed);
+  c.decode_time = _decode_time.load(std::memory_order_relaxed);
+  return c;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Function: compress
+// A control byte c < 128 is followed by c+1 literal bytes; c >= 128 is followed by one byte 
+// repeated (c & 0x7f) + 3 times.
+size_t RleCodec::compress(const char* src, size_t n, char* dst, size_t cap) {
+
+  size_t i {0}, o {0};
+
+  auto run = [&] (size_t k) {
+    size_t r {1};
+    while(k + r < n && r < 130 && src[k + r] == src[k]) ++r;
+    return r;
+  };
+
+  while(i < n) {
+
+    if(auto r = run(i); r >= 3) {
+      if(o + 2 > cap) return 0;
+      dst[o++] = static_cast<char>(0x80 | (r - 3));
+      dst[o++] = src[i];
+      i += r;
+    }
+    else {
+      auto j = i + r;
+      while(j < n && j - i < 128 && run(j) < 3) ++j;
+      auto len = std::min(j - i, size_t{128});
+      if(o + 1 + len > cap) return 0;
+      dst[o++] = static_cast<char>(len - 1);
+      std::memcpy(dst + o, src + i, len);
+      o += len;
+      i += len;
+    }
+  }
+
+  return o;
+}
+
+// Function: decompress
+bool RleCodec::decompress(const char* src, size_t n, char* dst, size_t raw) {
+
+  size_t i {0}, o {0};
+
+  while(i < n) {
+    auto c = static_cast<unsigned char>(src[i++]);
+    if(c & 0x80) {
+      size_t r = (c & 0x7f) + 3;
+      if(i >= n || o + r > raw) return false;
+      std::memset(dst + o, src[i++], r);
+      o += r;
+    }
+    else {
+      size_t len = c + 1;
+      if(i + len > n || o + len > raw) return false;
+      std::memcpy(dst + o, src + i, len);
+      i += len;
+      o += len;
+    }
+  }
+
+  return o == raw;
+}
+
+// Function: _compress
+size_t RleCodec::_compress(const char* src, size_t n, char* dst, size_t cap) {
+  return compress(src, n, dst, cap);
+}
+
+// Function: _decompress
+bool RleCodec::_decompress(const char* src, size_t n, char* dst, size_t raw) {
+  return decompress(src, n, dst, raw);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Constructor
+ShuffleCodec::ShuffleCodec(size_t width) : _width {std::max(width, size_t{1})} {
+}
+
+// Function: _compress
+// Group the j-th bytes of all elements together; the bytes past the last whole element stay
+// in place. The result is run-length encoded.
+size_t ShuffleCodec::_compress(const char* src, size_t n, char* dst, size_t cap) {
+  
+  const auto num = n / _width;
+
+  std::string tmp(n, '\0');
+
+  for(size_t i=0; i<num; ++i) {
+    for(size_t j=0; j<_width; ++j) {
+      tmp[j*num + i] = src[i*_width + j];
+    }
+  }
+
+  std::memcpy(tmp.data() + num*_width, src + num*_width, n - num*_width);
+
+  return RleCodec::compress(tmp.data(), n, dst, cap);
+}
+
+// Function: _decompress
+bool ShuffleCodec::_decompress(const char* src, size_t n, char* dst, size_t raw) {
+
+  std::string tmp(raw, '\0');
+
+  if(!RleCodec::decompress(src, n, tmp.data(), raw)) {
+    return false;
+  }
+
+  const auto num = raw / _width;
+  
+  for(size_t i=0; i<num; ++i) {
+    for(size_t j=0; j<_width; ++j) {
+      dst[i*_width + j] = tmp[j*num + i];
+    }
+  }
+  
+  std::memcpy(dst + num*_width, tmp.data() + num*_width, raw - num*_width);
+
+  return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Function: compress
+// Greedy LZ77 in the LZ4 block format. A sequence is a token (literal length, match length - 4),
+// the literals, a 2-byte little-endian offset, and the length extensions. The last sequence 
+// carries literals only and the last 5 bytes are always literals.
+size_t Lz4Codec::compress(const char* src, size_t n, char* dst, size_t cap) {
+
+  constexpr size_t MIN_MATCH {4};
+  constexpr size_t LAST_LITERALS {5};
+  constexpr size_t MF_LIMIT {12};
+  constexpr size_t MAX_OFFSET {65535};
+
+  size_t o {0};
+
+  auto read32 = [src] (size_t p) {
+    uint32_t v;
+    std::memcpy(&v, src + p, sizeof(v));
+    return v;
+  };
+
+  auto hash = [] (uint32_t v) {
+    return (v * 2654435761u) >> (32 - HASH_LOG);
+  };
+
+  auto length = [&] (size_t len) {
+    for(; len >= 255; len -= 255) {
+      if(o >= cap) return false;
+      dst[o++] = static_cast<char>(255);
+    }
+    if(o >= cap) return false;
+    dst[o++] = static_cast<char>(len);
+    return true;
+  };
+  
+  auto sequence = [&] (size_t anchor, size_t lit, size_t offset, size_t match) {
+    
+    if(o >= cap) return false;
+    
+    auto& token = dst[o++];
+    token = static_cast<char>((std::min(lit, size_t{15}) << 4) | (match ? std::min(match - MIN_MATCH, size_t{15}) : 0));
+    
+    if(lit >= 15 && !length(lit - 15)) return false;
+    
+    if(o + lit > cap) return false;
+    std::memcpy(dst + o, src + anchor, lit);
+    o += lit;
+    
+    if(match) {
+      if(o + 2 > cap) return false;
+      dst[o++] = static_cast<char>(offset & 0xff);
+      dst[o++] = static_cast<char>(offset >> 8);
+      if(match - MIN_MATCH >= 15 && !length(match - MIN_MATCH - 15)) return false;
+    }
+
+    return true;
+  };
+
+  size_t anchor {0};
+
+  if(n > MF_LIMIT) {
+
+    std::vector<uint32_t> table(size_t{1} << HASH_LOG, 0);   // position + 1, 0 if empty
+    
+    const auto limit = n - MF_LIMIT;
+    const auto match_limit = n - LAST_LITERALS;
+
+    for(size_t p=0; p < limit; ) {
+
+      auto v = read32(p);
+      auto& slot = table[hash(v)];
+      auto ref = static_cast<size_t>(slot);
+      
+      slot = static_cast<uint32_t>(p + 1);
+      
+      if(ref == 0 || p + 1 - ref > MAX_OFFSET || read32(--ref) != v) {
+        ++p;
+        continue;
+      }
+      
+      auto match = MIN_MATCH;
+      while(p + match < match_limit && src[ref + match] == src[p + match]) ++match;
+      
+      if(!sequence(anchor, p - anchor, p - ref, match)) return 0;
+
+      p += match;
+      anchor = p;
+    }
+  }
+
+  if(!sequence(anchor, n - anchor, 0, 0)) return 0;
+
+  return o;
+}
+
+// Function: decompress
+bool Lz4Codec::decompress(const char* src, size_t n, char* dst, size_t raw) {
+
+  size_t i {0}, o {0};
+
+  auto length = [&] (size_t& len) {
+    unsigned char b;
+    do {
+      if(i >= n) return false;
+      b = static_cast<unsigned char>(src[i++]);
+      len += b;
+    } while(b == 255);
+    return true;
+  };
+
+  while(i < n) {
+
+    auto token = static_cast<unsigned char>(src[i++]);
+
+    size_t lit = token >> 4;
+    if(lit == 15 && !length(lit)) return false;
+    if(i + lit > n || o + lit > raw) return false;
+
+    std::memcpy(dst + o, src + i, lit);
+    i += lit;
+    o += lit;
+
+    // The last sequence has no match.
+    if(i == n) break;
+
+    if(i + 2 > n) return false;
+    size_t offset = static_cast<unsigned char>(src[i]) | (static_cast<unsigned char>(src[i+1]) << 8);
+    i += 2;
+    if(offset == 0 || offset > o) return false;
+
+    size_t match = token & 0x0f;
+    if(match == 15 && !length(match)) return false;
+    match += 4;
+    if(o + match > raw) return false;
+
+    // An overlapping match repeats the last offset bytes, so it is copied byte by byte.
+    if(offset >= match) {
+      std::memcpy(dst + o, dst + o - offset, match);
+      o += match;
+    }
+    else {
+      for(size_t k=0; k<match; ++k, ++o) {
+        dst[o] = dst[o - offset];
+      }
+    }
+  }
+
+  return o == raw;
+}
+
+// Function: _compress
+size_t Lz4Codec::_compress(const char* src, size_t n, char* dst, size_t cap) {
+  return compress(src, n, dst, cap);
+}
+
+// Function: _decompress
+bool Lz4Codec::_decompress(const char* src, size_t n, char* dst, size_t raw) {
+  return decompress(src, n, dst, raw);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Function: make_codec
+std::shared_ptr<Codec> make_codec(Codec::Type type) {
+  switch(type) {
+    case Codec::RLE:
+      return std::make_shared<RleCodec>();
+    case Codec::SHUFFLE:
+      return std::make_shared<ShuffleCodec>();
+    case Codec::LZ4:
+      return std::make_shared<Lz4Codec>();
+    default:
+      return nullptr;
+  }
+}
+
+};  // End of namespace dtc. ----------------------------------------------------------------------
+
@@ -15,17 +15,150 @@
 
 namespace dtc {
 
+// Constructor
+Drainer::Drainer(size_t budget) : _budget {budget} {
+}
+
+// Function: counters
+Drainer::Counters Drainer::counters() const {
+  Counters c;
+  c.num_activations = _num_activations.load(std::memory_order_relaxed);
+  c.num_rounds = _num_rounds.load(std::memory_order_relaxed);
+  c.num_bytes = _num_bytes.load(std::memory_order_relaxed);
+  c.num_exhausted = _num_exhausted.load(std::memory_order_relaxed);
+  c.max_bytes = _max_bytes.load(std::memory_order_relaxed);
+  return c;
+}
+
+// Procedure: _record
+// Only the worker in the critical section of the stream records, so plain read-modify-write
+// sequences on the relaxed atomics are sufficient.
+void Drainer::_record(size_t num_bytes, size_t num_rounds, bool exhausted) {
+  _num_activations.fetch_add(1, std::memory_order_relaxed);
+  _num_rounds.fetch_add(num_rounds, std::memory_order_relaxed);
+  _num_bytes.fetch_add(num_bytes, std::memory_order_relaxed);
+  if(exhausted) {
+    _num_exhausted.fetch_add(1, std::memory_order_relaxed);
+  }
+  if(num_bytes > _max_bytes.load(std::memory_order_relaxed)) {
+    _max_bytes.store(num_bytes, std::memory_order_relaxed);
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
 // operator
 InputStream::operator bool () {
+  if(_mailbox) {
+    std::scoped_lock lock(isbuf._mutex);
+    if(isbuf._in_avail() == 0) {
+      return !_mailbox->_inbox.empty();
+    }
+  }
+  else if(_batched) {
+    std::scoped_lock lock(isbuf._mutex);
+    auto& buf = _codec ? (_decode(), _decoded) : isbuf;
+    size_t len, prefix;
+    return _peek(buf, len, prefix);
+  }
+  else if(_codec) {
+    std::scoped_lock lock(isbuf._mutex);
+    _decode();
+    return BinaryInputPackager(_decoded) == true;
+  }
   return BinaryInputPackager(isbuf) == true;
 }
 
+// Function: sync
+// Synchronize the stream with its device: the posted messages for a mailbox, or the bytes 
+// of the device for the others. The complete frames are decoded with the codec if any.
+std::streamsize InputStream::sync() {
+  if(_mailbox) {
+    std::scoped_lock lock(isbuf._mutex);
+    return _mailbox->_sync();
+  }
+  else if(_codec) {
+    std::scoped_lock lock(isbuf._mutex);
+    auto ret = isbuf.sync();
+    _decode();
+    return ret;
+  }
+  return isbuf.sync();
+}
+
+// Procedure: _decode
+// Decode the complete frames of the buffer into the buffer of decoded messages. A malformed 
+// header fails the stream with EBADMSG.
+void InputStream::_decode() {
+
+  Codec::Header header;
+  std::string frame, raw;
+
+  while(isbuf._in_avail() >= static_cast<std::streamsize>(sizeof(header))) {
+
+    isbuf._copy(&header, sizeof(header));
+
+    if(!header.valid()) {
+      throw std::system_error(
+        std::make_error_code(static_cast<std::errc>(EBADMSG)), "Malformed frame header"
+      );
+    }
+    
+    if(isbuf._in_avail() < static_cast<std::streamsize>(sizeof(header) + header.encoded)) {
+      break;
+    }
+
+    isbuf._drop(sizeof(header));
+
+    frame.resize(header.encoded);
+    isbuf._read(frame.data(), header.encoded);
+
+    raw.resize(header.raw);
+    _codec->decode(header, frame.data(), raw.data());
+
+    _decoded._chain.write(raw.data(), raw.size());
+  }
+}
+
+// Function: _peek
+// Read the varint length at the front of the buffer. Return true if the whole message is in.
+bool InputStream::_peek(InputStreamBuffer& buf, size_t& len, size_t& prefix) const {
+  
+  unsigned char bytes[10];
+  
+  auto n = buf._copy(bytes, sizeof(bytes));
+
+  len = 0;
+
+  for(prefix = 0; prefix < static_cast<size_t>(n); ++prefix) {
+    len |= static_cast<size_t>(bytes[prefix] & 0x7f) << (7*prefix);
+    if((bytes[prefix] & 0x80) == 0) {
+      ++prefix;
+      return buf._in_avail() >= static_cast<std::streamsize>(prefix + len);
+    }
+  }
+
+  return false;
+}
+
+// Procedure: _unparcel
+// Package the front message into the buffer.
+void InputStream::_unparcel() {
+  OutputStreamBuffer osbuf;
+  _mailbox->_inbox.front()->archive(osbuf);
+  _mailbox->_inbox.pop_front();
+  InputStreamBuffer tmp(std::move(osbuf));
+  isbuf._chain.append(tmp._chain);
+}
+
 // ------------------------------------------------------------------------------------------------
 
 // Destructor
 OutputStream::~OutputStream() {
 
   try {
+    auto lock = osbuf._lock();
+    _flush_batch();
     osbuf.flush();
   } 
   catch(...) {
@@ -34,6 +167,11 @@ OutputStream::~OutputStream() {
   if(auto rem = osbuf.out_avail(); rem > 0) {
     LOGW("ostream remain ", rem, " bytes uncleaned");
   }
+
+  // The reader sees the end of the stream once the messages are taken.
+  if(_mailbox) {
+    _mailbox->close();
+  }
   
 }
 
@@ -42,9 +180,10 @@ bool OutputStream::_notify() {
 
   auto r = reactor();
   
-  if(_notified || r == nullptr || osbuf._out_avail() == 0) return false;
-
-  _notified = true;
+  // The flag is exchanged as the writer of a single-writer buffer notifies without the lock.
+  if(_notified || r == nullptr || !osbuf._syncable() || _notified.exchange(true)) {
+    return false;
+  }
   
   // Here we need promise to avoid deadlock.
   r->thaw(shared_from_this());
@@ -69,12 +208,110 @@ Event::Signal OutputStream::_remove_on_flush() {
   //}
 
 
-  std::scoped_lock lock(osbuf._mutex);
+  auto lock = osbuf._lock();
   _notified = false;
 
   //LOGD("out_avail=", osbuf._out_avail());
 
-  return _notify() == false ? Event::REMOVE : Event::DEFAULT;
+  if(_notify()) {
+    return Event::DEFAULT;
+  }
+
+  // Zerocopy sends still in flight hold the buffer. Their completions wake the stream through 
+  // notify when the read side of the socket collects them (see the executor). In case nobody 
+  // reads the socket, a timer backing off up to 10 ms wakes the stream to collect them itself.
+  if(auto r = reactor(); r && osbuf._out_avail() > 0) {
+    if(!_reap_armed) {
+      _reap_armed = true;
+      _reap_delay = std::clamp(
+        2*_reap_delay, std::chrono::microseconds(100), std::chrono::microseconds(10000)
+      );
+      r->insert<TimeoutEvent>(_reap_delay, [w=weak_from_this()] (Event&) {
+        if(auto e = w.lock(); e) {
+          auto& os = static_cast<OutputStream&>(*e);
+          auto lock = os.osbuf._lock();
+          os._reap_armed = false;
+          if(auto r = os.reactor(); r && !os._notified.exchange(true)) {
+            r->thaw(std::move(e));
+          }
+        }
+      });
+    }
+    return Event::DEFAULT;
+  }
+
+  return Event::REMOVE;
+}
+
+// Function: notify
+// Wake the stream if a sync would make progress, e.g., after the completions of its zerocopy
+// sends have been collected from the socket elsewhere.
+bool OutputStream::notify() {
+  auto lock = osbuf._lock();
+  return _notify();
+}
+
+// Procedure: _append_batch
+// Move the message archived in the scratch buffer to the batch behind its varint length. The
+// caller holds the lock of the buffer.
+void OutputStream::_append_batch() {
+
+  unsigned char varint[10];
+  size_t k {0};
+
+  for(auto n = _scratch._chain.size(); ; n >>= 7) {
+    if(n < 0x80) {
+      varint[k++] = static_cast<unsigned char>(n);
+      break;
+    }
+    varint[k++] = static_cast<unsigned char>(n | 0x80);
+  }
+
+  _batch._chain.write(varint, k);
+  _batch._chain.append(_scratch._chain);
+  _scratch._chain.clear();
+
+  if(_batch._chain.size() >= _batch_size) {
+    _flush_batch();
+    _notify();
+  }
+  else if(auto r = reactor(); r == nullptr) {
+    _flush_batch();
+  }
+  else if(!_batch_armed) {
+    _batch_armed = true;
+    r->insert<TimeoutEvent>(_batch_delay, [w=weak_from_this()] (Event&) {
+      if(auto e = w.lock(); e) {
+        auto& os = static_cast<OutputStream&>(*e);
+        std::scoped_lock lock(os.osbuf._mutex);
+        os._flush_batch();
+        os._notify();
+      }
+    });
+  }
+}
+
+// Procedure: _flush_batch
+// Hand the batch to the buffer, as a frame if the stream has a codec. The caller holds the lock
+// of the buffer and notifies.
+void OutputStream::_flush_batch() {
+
+  _batch_armed = false;
+
+  if(_batch._chain.size() == 0) {
+    return;
+  }
+
+  if(_codec) {
+    std::string frame;
+    _codec->encode({_batch._chain.linearize(), _batch._chain.size()}, frame);
+    osbuf._chain.write(frame.data(), frame.size());
+  }
+  else {
+    osbuf._chain.append(_batch._chain);
+  }
+
+  _batch._chain.clear();
 }
 
 // Procedure: remove_on_flush
@@ -84,11 +321,11 @@ void OutputStream::remove_on_flush() {
     return; 
   }
   else {
-    std::scoped_lock lock(osbuf._mutex);
+    auto lock = osbuf._lock();
 
-    if(_disabled) return;
+    if(_disabled.exchange(true)) return;
 
-    _disabled = true; 
+    _flush_batch();
 
     if(osbuf._out_avail() > 0) {
       r->thaw(shared_from_this());
@@ -0,0 +1,146 @@
+/******************************************************************************
+ *                                                                            *
+ * Copyright (c) 2018, Tsung-Wei Huang, Chun-Xun Lin, and Martin D. F. Wong,  *
+ * University of Illinois at Urbana-Champaign (UIUC), IL, USA.                *
+ *                                                                            *
+ * All Rights Reserved.                                                       *
+ *                                                                            *
+ * This program is free software. You can redistribute and/or modify          *
+ * it in accordance with the terms of the accompanying license agreement.     *
+ * See LICENSE in the top-level directory for details.                        *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <dtc/ipc/mailbox.hpp>
+
+namespace dtc {
+
+// Constructor
+Mailbox::Mailbox(int fd) : Device {fd}, _head {&_stub}, _tail {&_stub} {
+}
+
+// Destructor
+Mailbox::~Mailbox() {
+  while(auto m = _pop()) {
+    delete m;
+  }
+}
+
+// Procedure: push
+// Post a message. Any thread may call this; the mailbox takes the ownership of the message.
+void Mailbox::push(Message* m) {
+
+  _enqueue(m);
+
+  // Pairs with the fence in _sync: either the reader sees the message or we see its wait.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if(_waiting.load(std::memory_order_relaxed) && _waiting.exchange(false)) {
+    uint64_t v {1};
+    while(::write(_fd, &v, sizeof(v)) == -1 && errno == EINTR);
+  }
+}
+
+// Procedure: _enqueue
+void Mailbox::_enqueue(Message* m) {
+  m->next.store(nullptr, std::memory_order_relaxed);
+  auto prev = _head.exchange(m, std::memory_order_acq_rel);
+  prev->next.store(m, std::memory_order_release);
+}
+
+// Procedure: close
+// Mark the writer gone and wake up the reader, which gets EPIPE once the mailbox is drained.
+void Mailbox::close() {
+  _closed.store(true, std::memory_order_release);
+  uint64_t v {1};
+  while(::write(_fd, &v, sizeof(v)) == -1 && errno == EINTR);
+}
+
+// Function: _pop
+// Take the oldest message, or nullptr if none is ready. Only the reader may call this.
+Mailbox::Message* Mailbox::_pop() {
+
+  auto tail = _tail;
+  auto next = tail->next.load(std::memory_order_acquire);
+
+  if(tail == &_stub) {
+    if(next == nullptr) {
+      return nullptr;
+    }
+    _tail = tail = next;
+    next = next->next.load(std::memory_order_acquire);
+  }
+
+  if(next) {
+    _tail = next;
+    return tail;
+  }
+
+  // A writer is between the exchange and the link.
+  if(tail != _head.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+
+  _enqueue(&_stub);
+  
+  if(next = tail->next.load(std::memory_order_acquire); next) {
+    _tail = next;
+    return tail;
+  }
+
+  return nullptr;
+}
+
+// Function: _sync
+// Move the posted messages to the inbox of the reader and return their number. Throw EPIPE if 
+// the writer has closed and nothing is left to move.
+std::streamsize Mailbox::_sync() {
+
+  uint64_t v;
+  while(::read(_fd, &v, sizeof(v)) == -1 && errno == EINTR);
+
+  _waiting.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  auto closed = _closed.load(std::memory_order_acquire);
+  auto num = std::streamsize {0};
+
+  while(auto m = _pop()) {
+    if(m != &_stub) {
+      _inbox.emplace_back(m);
+      ++num;
+    }
+  }
+
+  if(closed) {
+    if(num == 0) {
+      throw std::system_error(
+        std::make_error_code(static_cast<std::errc>(EPIPE)), "Mailbox sync failed"
+      );
+    }
+    // Keep the reader awake to see the end of the stream after taking these messages.
+    uint64_t v {1};
+    while(::write(_fd, &v, sizeof(v)) == -1 && errno == EINTR);
+  }
+
+  return num;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Function: make_mailbox
+std::shared_ptr<Mailbox> make_mailbox() {
+  
+  int fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+  if(fd == -1) {
+    throw std::system_error(
+      std::make_error_code(static_cast<std::errc>(errno)), "Failed to create mailbox"
+    );
+  }
+
+  return std::make_shared<Mailbox>(fd);
+}
+
+};  // End of namespace dtc. ----------------------------------------------------------------------
+
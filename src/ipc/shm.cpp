@@ -15,213 +15,443 @@
 
 namespace dtc {
 
+namespace {
+
+// The eventfd counter of a write end that waits for space. A counter at its maximum makes the 
+// eventfd unwritable.
+constexpr uint64_t ARMED {0xfffffffffffffffe};
+
+// Function: eventfd_add
+// Add to the counter of an eventfd. Return false if the counter would overflow.
+bool eventfd_add(int fd, uint64_t v) {
+  while(::write(fd, &v, sizeof(v)) == -1) {
+    if(errno == EINTR) {
+      continue;
+    }
+    if(errno == EAGAIN || errno == EWOULDBLOCK) {
+      return false;
+    }
+    throw std::system_error(
+      std::make_error_code(static_cast<std::errc>(errno)), "Failed to signal eventfd"
+    );
+  }
+  return true;
+}
+
+// Procedure: eventfd_clear
+// Reset the counter of an eventfd. The eventfd is polled first so that a blocking descriptor 
+// with a zero counter does not block.
+void eventfd_clear(int fd) {
+  struct pollfd p {fd, POLLIN, 0};
+  if(::poll(&p, 1, 0) > 0 && (p.revents & POLLIN)) {
+    uint64_t v;
+    while(::read(fd, &v, sizeof(v)) == -1 && errno == EINTR);
+  }
+}
+
+// Function: socket_signal
+// Queue a wake-up byte on the socket of a reader. A full socket already holds a wake-up. Return
+// false if every process holding the reader has gone.
+bool socket_signal(int fd) {
+  char c {0};
+  while(::send(fd, &c, 1, MSG_DONTWAIT | MSG_NOSIGNAL) == -1) {
+    if(errno == EINTR) {
+      continue;
+    }
+    if(errno == EAGAIN || errno == EWOULDBLOCK) {
+      return true;
+    }
+    if(errno == EPIPE || errno == ECONNRESET) {
+      return false;
+    }
+    throw std::system_error(
+      std::make_error_code(static_cast<std::errc>(errno)), "Failed to signal shared memory"
+    );
+  }
+  return true;
+}
+
+// Function: socket_clear
+// Drop the wake-up bytes queued on the socket of a reader. Return false once the socket is at 
+// EOF, i.e., every process holding the writer has gone.
+bool socket_clear(int fd) {
+  char buf[64];
+  while(1) {
+    if(auto ret = ::recv(fd, buf, sizeof(buf), MSG_DONTWAIT); ret > 0) {
+      continue;
+    }
+    else if(ret == 0) {
+      return false;
+    }
+    else if(errno != EINTR) {
+      return errno != ECONNRESET;
+    }
+  }
+}
+
+// Function: socket_hup
+// Return true if the peer of the socket has gone.
+bool socket_hup(int fd) {
+  struct pollfd p {fd, 0, 0};
+  return ::poll(&p, 1, 0) > 0 && (p.revents & (POLLHUP | POLLERR));
+}
+
+// Function: total
+std::streamsize total(const struct iovec* iov, int n) {
+  std::streamsize sz {0};
+  for(int i=0; i<n; ++i) {
+    sz += iov[i].iov_len;
+  }
+  return sz;
+}
+
+};  // End of anonymous namespace. ---------------------------------------------------------------
+
 // Constructor
-//SharedMemory::SharedMemory(int fd) : Device{fd} {
-//  //make_fd_nonblocking(fd);
-//  //make_fd_close_on_exec(fd);
-//}
-//
-//// Destructor
-//SharedMemory::~SharedMemory() {
-//  //::close(_fd);
-//}
-
-// Function: _allocate
-//std::unique_ptr<SharedMemory::fifo_type, std::function<void(SharedMemory::fifo_type*)>> 
-//SharedMemory::_allocate(){
-//
-//  static std::mutex mtx;
-//  static constexpr int sz = 16; 
-//
-//  static std::array<fifo_type, sz> pool;
-//  static std::array<size_t, sz> released;
-//  
-//  static size_t p {0};
-//  static size_t r {0};
-//
-//  std::lock_guard guard(mtx);
-//
-//  if( p < sz ){
-//    size_t _p = p++;
-//    return std::unique_ptr<fifo_type, std::function<void(fifo_type*)>>( 
-//      &(pool[_p]), 
-//      [&, _p] (fifo_type* ptr) {
-//        std::lock_guard guard(mtx);
-//        released[r++] = _p;
-//      } 
-//    );
-//  }
-//  else if( r > 0 ){
-//    size_t _r = --r;
-//    return std::unique_ptr<fifo_type, std::function<void(fifo_type*)>>( 
-//      &(pool[released[_r]]),
-//      [&, idx=released[_r]] (fifo_type* ptr) {
-//        std::lock_guard guard(mtx);
-//        released[r++] = idx;
-//      } 
-//    );
-//  }
-//  else{
-//    return std::unique_ptr<fifo_type, std::function<void(fifo_type*)>>( 
-//      new fifo_type(), [](fifo_type* ptr) { delete ptr; } 
-//    );
-//  }
-//}
-
-/* 
-std::streamsize SharedMemory::read(void* given, std::streamsize sz) {
-
-  const std::streamsize fence = _w_ptr;
-  const std::streamsize bufsz = _fifo->size();
+// Map the ring of the given memfd. The end takes over the three descriptors together with one 
+// reference to its side of the ring.
+SharedMemory::SharedMemory(int fd, int peer_fd, int memfd, std::ios_base::openmode mode) : 
+  Device   {fd},
+  _peer_fd {peer_fd},
+  _memfd   {memfd},
+  _mode    {mode} {
+
+  static_assert(sizeof(Ring) <= HEADER_SIZE && std::atomic<uint64_t>::is_always_lock_free);
+
+  struct stat st;
+
+  void* ptr = MAP_FAILED;
+
+  if(::fstat(_memfd, &st) != -1 && static_cast<size_t>(st.st_size) > HEADER_SIZE) {
+    ptr = ::mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, _memfd, 0);
+  }
   
-  // The buffer is empty (similar to EAGAIN and EWOULDBLOCK)
-  if ((_r_ptr + 1) % bufsz == fence) {
-    return -1;
+  if(ptr == MAP_FAILED) {
+    auto err = errno ? errno : EINVAL;
+    ::close(_peer_fd);
+    ::close(_memfd);
+    throw std::system_error(
+      std::make_error_code(static_cast<std::errc>(err)), "Failed to map shared memory"
+    );
   }
 
-  // Clear notify
-  static uint64_t c;
-  assert(::read(_fd, &c, sizeof(c)) == sizeof(c) || errno == EAGAIN);
+  _ring = static_cast<Ring*>(ptr);
+  _data = static_cast<char*>(ptr) + HEADER_SIZE;
+  _mask = _ring->capacity - 1;
+}
 
-  std::streamsize num_reads {0};
+// Destructor
+// Drop the reference of this end. The last reference of a side closes the ring and wakes up
+// the peer so that it observes EPIPE.
+SharedMemory::~SharedMemory() {
 
-  if (fence < _r_ptr) {
-    if (_r_ptr != bufsz - 1) {
-      num_reads = _bufcpy(given, &((*_fifo)[_r_ptr + 1]), std::min(sz, bufsz - _r_ptr - 1));
-      _r_ptr += num_reads;
+  if(is_reader()) {
+    if(_ring->refs[0].fetch_sub(1, std::memory_order_seq_cst) == 1) {
+      _signal_writer();
     }
-    if (num_reads < sz && fence != 0) {
-      _r_ptr = _bufcpy(&(static_cast<char*>(given)[num_reads]), _fifo->data(), std::min(fence, sz - num_reads)) - 1;
-      num_reads += _r_ptr + 1;
+  }
+  else {
+    if(_ring->refs[1].fetch_sub(1, std::memory_order_seq_cst) == 1) {
+      try {
+        socket_signal(_peer_fd);
+      }
+      catch(const std::system_error& e) {
+        LOGW("Failed to close shared memory fd=", _fd, ": ", e.what());
+      }
     }
-  } else {
-    num_reads = _bufcpy(given, &((*_fifo)[_r_ptr + 1]), std::min(fence - _r_ptr - 1, sz));
-    _r_ptr += num_reads;
   }
-  
-  // Notify again.
-  if((_w_ptr - _r_ptr + 1 + bufsz) % bufsz > 0) {
-    assert(_notify() == true); 
+
+  ::munmap(_ring, HEADER_SIZE + capacity());
+  ::close(_peer_fd);
+  ::close(_memfd);
+}
+
+// Procedure: share
+// Add a reference to this end on behalf of a process that inherits its descriptors, e.g., an 
+// executor spawned with the end as a frontier. The process adopts the reference when it maps
+// the end, so the ring stays open after the spawner drops its copy.
+void SharedMemory::share() {
+  _ring->refs[is_reader() ? 0 : 1].fetch_add(1, std::memory_order_relaxed);
+}
+
+// Function: open_on_exec
+Device& SharedMemory::open_on_exec(bool flag) {
+  for(auto fd : {_fd, _peer_fd, _memfd}) {
+    flag ? make_fd_open_on_exec(fd) : make_fd_close_on_exec(fd);
+  }
+  return *this;
+}
+
+// Function: read
+std::streamsize SharedMemory::read(void* buf, std::streamsize sz) const {
+  assert(sz != 0);
+  struct iovec iov {buf, static_cast<size_t>(sz)};
+  return _read(&iov, 1);
+}
+
+// Function: readv
+std::streamsize SharedMemory::readv(const struct iovec* iov, int n) const {
+  assert(n > 0);
+  return _read(iov, n);
+}
+
+// Function: write
+std::streamsize SharedMemory::write(const void* buf, std::streamsize sz) const {
+  struct iovec iov {const_cast<void*>(buf), static_cast<size_t>(sz)};
+  return _write(&iov, 1);
+}
+
+// Function: writev
+std::streamsize SharedMemory::writev(const struct iovec* iov, int n) const {
+  return _write(iov, n);
+}
+
+// Function: _wait
+// Block on the descriptor of this end if it is in blocking mode. A writer also wakes up when the
+// socket of the reader hangs up. Return false if the end is non-blocking and the caller should
+// report EAGAIN.
+bool SharedMemory::_wait(short events) const {
+
+  if(::fcntl(_fd, F_GETFL) & O_NONBLOCK) {
+    return false;
+  }
+
+  struct pollfd p[2] {{_fd, events, 0}, {_peer_fd, 0, 0}};
+
+  while(::poll(p, is_reader() ? 1 : 2, -1) == -1) {
+    if(errno != EINTR) {
+      throw std::system_error(
+        std::make_error_code(static_cast<std::errc>(errno)), "Device wait failed"
+      );
+    }
   }
 
-  return num_reads;
+  return true;
+}
 
-} */
+// Procedure: _signal_reader
+// Wake up the reader if it announced a wait. Called by the writer after publishing data.
+void SharedMemory::_signal_reader() const {
+  if(_ring->rwait.load(std::memory_order_seq_cst) && _ring->rwait.exchange(0)) {
+    if(!socket_signal(_peer_fd)) {
+      throw std::system_error(
+        std::make_error_code(static_cast<std::errc>(EPIPE)), "Device write failed"
+      );
+    }
+  }
+}
 
-/*// Function: write
-std::streamsize SharedMemory::write(const void* given, std::streamsize sz) {
+// Procedure: _signal_writer
+// Disarm the writer if it armed its eventfd on a full ring. Called by the reader after freeing
+// space. Only the party that takes the flag resets the counter.
+void SharedMemory::_signal_writer() const {
+  if(_ring->wwait.load(std::memory_order_seq_cst) && _ring->wwait.exchange(0)) {
+    eventfd_clear(_peer_fd);
+  }
+}
 
-  const std::streamsize fence = _r_ptr;
-  const std::streamsize bufsz = _fifo->size();
+// Function: _read
+// Copy data out of the ring. Return -1 with EAGAIN if the ring is empty, or throw EPIPE if it
+// is empty and the writer has closed or died.
+std::streamsize SharedMemory::_read(const struct iovec* iov, int n) const {
 
-  // The buffer is full (similar to EAGAIN and EWOULDBLOCK)
-  if ((_w_ptr + 1) % bufsz == fence) {
-    return -1;
+  if(!is_reader()) {
+    throw std::system_error(
+      std::make_error_code(std::errc::bad_file_descriptor), "Device read failed"
+    );
   }
 
-  std::streamsize num_writes = 0;
+  while(1) {
 
-  if (fence < _w_ptr) {
-    if (fence == 0) {
-      num_writes = _bufcpy(&((*_fifo)[_w_ptr]), given, std::min(sz, bufsz - _w_ptr - 1));
-      _w_ptr += num_writes;
-    } 
-    else {
-      num_writes = _bufcpy(&((*_fifo)[_w_ptr]), given, std::min(sz, bufsz - _w_ptr));
-      _w_ptr = (_w_ptr + num_writes) % bufsz;
-      if (num_writes < sz) {
-        auto given_ptr = static_cast<const char*>(given);
-        _w_ptr = _bufcpy(_fifo->data(), &(given_ptr[num_writes]), std::min(fence - 1, sz - num_writes));
-        num_writes += _w_ptr;
+    auto h = _ring->head.load(std::memory_order_relaxed);
+    auto t = _ring->tail.load(std::memory_order_acquire);
+
+    if(t != h) {
+
+      auto num = std::min<uint64_t>(t - h, total(iov, n));
+      auto off = uint64_t {0};
+
+      for(int i=0; i<n && off<num; ++i) {
+        auto len = std::min<uint64_t>(iov[i].iov_len, num - off);
+        auto beg = (h + off) & _mask;
+        auto seg = std::min<uint64_t>(len, capacity() - beg);
+        std::memcpy(iov[i].iov_base, _data + beg, seg);
+        std::memcpy(static_cast<char*>(iov[i].iov_base) + seg, _data, len - seg);
+        off += len;
+      }
+
+      _ring->head.store(h + num, std::memory_order_seq_cst);
+      _signal_writer();
+
+      return num;
+    }
+
+    // A writer killed before it could drop its reference leaves the socket at EOF.
+    if(_ring->refs[1].load(std::memory_order_acquire) == 0 || !socket_clear(_fd)) {
+      if(_ring->tail.load(std::memory_order_acquire) != h) {
+        continue;
       }
+      throw std::system_error(
+        std::make_error_code(static_cast<std::errc>(EPIPE)), "Device read failed"
+      );
+    }
+
+    // Announce the wait and look again; a writer publishing meanwhile either shows up in the 
+    // second look or sees the announcement and signals.
+    _ring->rwait.store(1, std::memory_order_seq_cst);
+
+    if(_ring->tail.load(std::memory_order_seq_cst) != h || 
+       _ring->refs[1].load(std::memory_order_seq_cst) == 0) {
+      continue;
+    }
+
+    if(!_wait(POLLIN)) {
+      errno = EAGAIN;
+      return -1;
     }
-  } else {
-    num_writes = _bufcpy(&((*_fifo)[_w_ptr]), given, std::min(fence - _w_ptr - 1, sz));
-    _w_ptr += num_writes;
   }
+}
+
+// Function: _write
+// Copy data into the ring. Return -1 with EAGAIN if the ring is full, or throw EPIPE if the 
+// reader has closed or died.
+std::streamsize SharedMemory::_write(const struct iovec* iov, int n) const {
 
-  if(num_writes > 0) {
-    assert(_notify() == true);
+  if(is_reader()) {
+    throw std::system_error(
+      std::make_error_code(std::errc::bad_file_descriptor), "Device write failed"
+    );
+  }
+
+  while(1) {
+    
+    if(_ring->refs[0].load(std::memory_order_acquire) == 0) {
+      throw std::system_error(
+        std::make_error_code(static_cast<std::errc>(EPIPE)), "Device write failed"
+      );
+    }
+
+    auto t = _ring->tail.load(std::memory_order_relaxed);
+    auto h = _ring->head.load(std::memory_order_acquire);
+
+    if(auto room = capacity() - (t - h); room > 0) {
+
+      auto num = std::min<uint64_t>(room, total(iov, n));
+      auto off = uint64_t {0};
+
+      for(int i=0; i<n && off<num; ++i) {
+        auto len = std::min<uint64_t>(iov[i].iov_len, num - off);
+        auto beg = (t + off) & _mask;
+        auto seg = std::min<uint64_t>(len, capacity() - beg);
+        std::memcpy(_data + beg, iov[i].iov_base, seg);
+        std::memcpy(_data, static_cast<const char*>(iov[i].iov_base) + seg, len - seg);
+        off += len;
+      }
+
+      _ring->tail.store(t + num, std::memory_order_seq_cst);
+      _signal_reader();
+
+      return num;
+    }
+
+    // The ring is full. Arm the eventfd so the write event sleeps until the reader disarms it,
+    // then look again. A failed arm means a disarm is in flight.
+    if(_ring->wwait.load(std::memory_order_seq_cst) == 0) {
+      if(!eventfd_add(_fd, ARMED)) {
+        continue;
+      }
+      _ring->wwait.store(1, std::memory_order_seq_cst);
+    }
+
+    if(_ring->head.load(std::memory_order_seq_cst) != h ||
+       _ring->refs[0].load(std::memory_order_seq_cst) == 0) {
+      if(_ring->wwait.exchange(0)) {
+        eventfd_clear(_fd);
+      }
+      continue;
+    }
+
+    // A reader killed before it could drop its reference never frees space again.
+    if(socket_hup(_peer_fd)) {
+      throw std::system_error(
+        std::make_error_code(static_cast<std::errc>(EPIPE)), "Device write failed"
+      );
+    }
+
+    if(!_wait(POLLOUT)) {
+      errno = EAGAIN;
+      return -1;
+    }
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Function: make_shared_memory
+std::tuple<std::shared_ptr<SharedMemory>, std::shared_ptr<SharedMemory>> make_shared_memory(
+  size_t capacity
+) {
+
+  auto fail = [] (const char* what) {
+    throw std::system_error(std::make_error_code(static_cast<std::errc>(errno)), what);
+  };
+
+  size_t cap = 4096;
+  while(cap < capacity) {
+    cap <<= 1;
   }
   
-  return num_writes;
-} */
-
-// Function: _notify
-//bool SharedMemory::_notify() {
-//  static uint64_t c = 1;
-//  auto r = ::write(_fd, &c, sizeof(c));
-//  return (r == sizeof(c) || errno == EAGAIN);
-//}
-//
-//// Function: read
-//std::streamsize SharedMemory::read(void* given, std::streamsize sz) {
-//
-//  // The buffer is empty (similar to EAGAIN and EWOULDBLOCK)
-//  if (_fifo.empty()) {
-//    return -1;
-//  }
-//
-//  // Clear notify
-//  static uint64_t c;
-//  assert(::read(_fd, &c, sizeof(c)) == sizeof(c) || errno == EAGAIN);
-//
-//  std::streamsize num_reads {0};
-//  while(sz > num_reads && _fifo.pop((static_cast<char*>(given)[num_reads]))){
-//    ++num_reads;
-//  }
-//  
-//  // Notify again.
-//  if(_fifo.size() > 0) {
-//    assert(_notify() == true); 
-//  }
-//
-//  return num_reads;
-//}
-//
-//// Function: write
-//std::streamsize SharedMemory::write(const void* given, std::streamsize sz) {
-//  
-//  // The buffer is full (similar to EAGAIN and EWOULDBLOCK)
-//  if (_fifo.capacity() == 0) {
-//    return -1;
-//  }
-//
-//  std::streamsize num_writes = 0;
-//  while(sz > num_writes && _fifo.push((static_cast<const char*>(given)[num_writes]))){
-//    ++num_writes;
-//  }
-//  
-//  if(num_writes > 0) {
-//    assert(_notify() == true);
-//  }
-//  return num_writes;
-//}
-//
-////-------------------------------------------------------------------------------------------------
-//
-//// Function: make_shared_memory
-//std::shared_ptr<SharedMemory> make_shared_memory() {
-//  if(auto fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK); fd == -1) {
-//    throw std::system_error(
-//      std::make_error_code(static_cast<std::errc>(errno)), 
-//      "Failed to create an event notification for shared memory"
-//    );
-//  }
-//  else {
-//    return std::make_shared<SharedMemory>(fd);
-//  }
-//}
-
-
-
-};  // End of namespace dtc. --------------------------------------------------------------
+  int memfd = ::memfd_create("dtc-shm", MFD_CLOEXEC);
 
+  if(memfd == -1) {
+    fail("Failed to create shared memory");
+  }
 
+  if(::ftruncate(memfd, SharedMemory::HEADER_SIZE + cap) == -1) {
+    ::close(memfd);
+    fail("Failed to size shared memory");
+  }
+  
+  // A fresh memfd reads as zeros, so only the capacity, the references, and the wait flag of
+  // the reader need to be set. The reader starts as waiting so the first data signal it.
+  auto ptr = ::mmap(nullptr, SharedMemory::HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
 
+  if(ptr == MAP_FAILED) {
+    ::close(memfd);
+    fail("Failed to map shared memory");
+  }
 
+  auto ring = ::new (ptr) SharedMemory::Ring {};
+  ring->capacity = cap;
+  ring->refs[0].store(1, std::memory_order_relaxed);
+  ring->refs[1].store(1, std::memory_order_relaxed);
+  ring->rwait.store(1, std::memory_order_relaxed);
+  ::munmap(ptr, SharedMemory::HEADER_SIZE);
 
+  // The reader waits on a socket whose peer is held by the writer, so the kernel reports a 
+  // writer that goes away without closing the ring; the writer polls the peer for the reader.
+  int sv[2] = {-1, -1};
+  int wfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  int fds[2] = {-1, -1};
 
+  if(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) != -1 && wfd != -1) {
+    fds[0] = ::fcntl(wfd, F_DUPFD_CLOEXEC, 0);
+    fds[1] = ::fcntl(memfd, F_DUPFD_CLOEXEC, 0);
+  }
 
+  if(std::find(std::begin(fds), std::end(fds), -1) != std::end(fds)) {
+    auto err = errno;
+    for(auto fd : {sv[0], sv[1], wfd, memfd, fds[0], fds[1]}) {
+      if(fd != -1) ::close(fd);
+    }
+    errno = err;
+    fail("Failed to create shared memory descriptors");
+  }
 
+  return {
+    std::make_shared<SharedMemory>(sv[0], fds[0], memfd, std::ios_base::in),
+    std::make_shared<SharedMemory>(wfd, sv[1], fds[1], std::ios_base::out)
+  };
+}
 
+};  // End of namespace dtc. ----------------------------------------------------------------------
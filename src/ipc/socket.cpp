@@ -12,9 +12,44 @@
  ******************************************************************************/
 
 #include <dtc/ipc/socket.hpp>
+#include <linux/errqueue.h>
 
 namespace dtc {
    
+// Destructor
+// The data of zerocopy sends handed over by streams already gone must outlive the kernel's use
+// of them. We wait a while for their completions. If the peer has not taken the data by then,
+// the connection is reset on close, which discards the unsent data before it is freed.
+Socket::~Socket() {
+
+  if(_zerocopy_held.empty()) {
+    return;
+  }
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+  while(reap_zerocopy(), !_zerocopy_held.empty()) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - std::chrono::steady_clock::now()
+    ).count();
+    if(left <= 0) {
+      break;
+    }
+    // The completions are queued on the error queue, which polls as POLLERR.
+    struct pollfd pfd {_fd, 0, 0};
+    ::poll(&pfd, 1, static_cast<int>(left));
+  }
+
+  if(!_zerocopy_held.empty()) {
+    LOGW("Socket fd=", _fd, " resets the connection with zerocopy sends in flight");
+    struct linger lg {1, 0};
+    ::setsockopt(_fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    ::close(_fd);
+    _fd = -1;
+    _zerocopy_held.clear();
+  }
+}
+
 // Function: is_connected
 bool Socket::is_connected() const {
   // Special case for FreeBSD7, for which send() does not generate SIGPIPE.
@@ -114,6 +149,153 @@ std::shared_ptr<Socket> Socket::accept() const {
   }
 }
 
+// Function: read
+// Read the socket after collecting the completions of zerocopy sends, which make it readable.
+std::streamsize Socket::read(void* buf, std::streamsize sz) const {
+  if(_zerocopy) {
+    reap_zerocopy();
+  }
+  return Device::read(buf, sz);
+}
+
+// Function: readv
+// Scatter read the socket after collecting the completions of zerocopy sends.
+std::streamsize Socket::readv(const struct iovec* iov, int n) const {
+  if(_zerocopy) {
+    reap_zerocopy();
+  }
+  return Device::readv(iov, n);
+}
+
+// Function: zerocopy
+// Send the writes of at least the given bytes with MSG_ZEROCOPY, or none for zero. Return false 
+// if the socket cannot do it, e.g., a unix domain socket or a kernel without MSG_ZEROCOPY.
+bool Socket::zerocopy(size_t threshold) {
+
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  if(int one = 1; threshold && ::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == -1) {
+    return false;
+  }
+  _zerocopy = threshold;
+  return true;
+#else
+  return threshold == 0;
+#endif
+}
+
+// Function: writev_zerocopy
+// Gather write with MSG_ZEROCOPY. On success the id of the send is set; the segments must stay
+// untouched until num_zerocopy_completed passes it. A send the kernel cannot pin pages for 
+// (ENOBUFS, out of option memory) is copied instead and has no id. Other errors are handled the 
+// same way as writev.
+std::streamsize Socket::writev_zerocopy(
+  const struct iovec* iov, int n, std::optional<uint32_t>& id
+) const {
+
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  struct msghdr msg;
+  ::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = const_cast<struct iovec*>(iov);
+  msg.msg_iovlen = n;
+
+  issue_sendmsg:
+  auto ret = ::sendmsg(_fd, &msg, MSG_ZEROCOPY);
+
+  if(ret == -1) {
+    if(errno == EINTR) {
+      goto issue_sendmsg;
+    }
+    else if(errno == ENOBUFS) {
+      return writev(iov, n);
+    }
+    else if(errno != EAGAIN && errno != EWOULDBLOCK) {
+      throw std::system_error(
+        std::make_error_code(static_cast<std::errc>(errno)), "Socket zerocopy write failed"
+      );
+    }
+  }
+  else {
+    id = _num_zerocopy_sent++;
+  }
+
+  return ret;
+#else
+  return writev(iov, n);
+#endif
+}
+
+// Function: reap_zerocopy
+// Drain the error queue of the socket and return the number of zerocopy sends completed. The
+// kernel reports ranges of ids; a range ahead of the completed ones waits until the gap closes.
+uint32_t Socket::reap_zerocopy() const {
+
+  char control[256];
+
+  while(1) {
+
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if(::recvmsg(_fd, &msg, MSG_ERRQUEUE) == -1) {
+      if(errno == EINTR) continue;
+      break;
+    }
+
+    for(auto cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+
+      if(!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+         !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+        continue;
+      }
+
+      auto ee = reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+
+      if(ee->ee_errno != 0 || ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+
+      std::scoped_lock lock(_zerocopy_mutex);
+
+      auto num = _num_zerocopy_completed.load(std::memory_order_relaxed);
+
+      _zerocopy_ranges.emplace_back(ee->ee_info, ee->ee_data);
+
+      for(auto itr = _zerocopy_ranges.begin(); itr != _zerocopy_ranges.end(); ) {
+        if(itr->first == num) {
+          num = itr->second + 1;
+          _zerocopy_ranges.erase(itr);
+          itr = _zerocopy_ranges.begin();
+        }
+        else ++itr;
+      }
+
+      _num_zerocopy_completed.store(num, std::memory_order_release);
+
+      // Release the data held for the sends completed.
+      _zerocopy_held.erase(
+        std::remove_if(_zerocopy_held.begin(), _zerocopy_held.end(), [num] (const auto& h) {
+          return static_cast<int32_t>(num - h.first) > 0;
+        }),
+        _zerocopy_held.end()
+      );
+    }
+  }
+
+  return num_zerocopy_completed();
+}
+
+// Procedure: hold_zerocopy
+// Keep the data of a buffer until the zerocopy send of the given id (and all before it) has
+// completed. An ostream destroyed with sends in flight hands its data over to the socket.
+void Socket::hold_zerocopy(uint32_t id, std::shared_ptr<void> data) const {
+  std::scoped_lock lock(_zerocopy_mutex);
+  if(static_cast<int32_t>(_num_zerocopy_completed.load(std::memory_order_relaxed) - id) <= 0) {
+    _zerocopy_held.emplace_back(id, std::move(data));
+  }
+}
+
 //-------------------------------------------------------------------------------------------------
 
 // Function: to_host
@@ -169,7 +351,9 @@ std::tuple<int, int> make_socket_pair_raw() {
 }
 
 // Function: make_socket_server
-std::shared_ptr<Socket> make_socket_server(std::string_view P) {
+// Create a listening socket on port P. With reuse_port, multiple sockets can listen on the same
+// port (SO_REUSEPORT) and the kernel balances incoming connections among them.
+std::shared_ptr<Socket> make_socket_server(std::string_view P, bool reuse_port) {
 
   // Memo:
   // struct addrinfo {
@@ -221,6 +405,10 @@ std::shared_ptr<Socket> make_socket_server(std::string_view P) {
     
     ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
 
+    if(reuse_port && ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == -1) {
+      goto try_next;
+    }
+
     if(::bind(fd, ptr->ai_addr, ptr->ai_addrlen) == -1) {
       goto try_next;
     }
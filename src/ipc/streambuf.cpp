@@ -12,9 +12,629 @@
  ******************************************************************************/
 
 #include <dtc/ipc/streambuf.hpp>
+#include <dtc/ipc/socket.hpp>
+#include <dtc/policy.hpp>
 
 namespace dtc {
 
+// Constructor
+StreamBlockPool::StreamBlockPool() :
+  _cap  {env::stream_buffer_cap()},
+  _idle {env::stream_buffer_idle()} {
+}
+
+// Function: allocate
+// Take a block of at least the given capacity. Blocks of BLOCK_CAPACITY come from the free list.
+StreamBlock* StreamBlockPool::allocate(size_t capacity) {
+
+  {
+    std::scoped_lock lock(_mutex);
+
+    if(capacity <= BLOCK_CAPACITY) {
+      if(auto b = _free; b) {
+        _free = b->next;
+        _min_free = std::min(_min_free, --_num_free);
+        b->next = nullptr;
+        return b;
+      }
+      capacity = BLOCK_CAPACITY;
+    }
+    
+    _memory += capacity;
+    _peak_memory = std::max(_peak_memory, _memory);
+  }
+
+  auto b = static_cast<StreamBlock*>(::operator new(sizeof(StreamBlock) + capacity));
+  b->next = nullptr;
+  b->capacity = capacity;
+  return b;
+}
+
+// Procedure: deallocate
+// Return a block to the free list. The block goes back to the allocator instead if it is not of 
+// BLOCK_CAPACITY or if the pool is over the cap. Free blocks left idle for a whole period are
+// released on the way.
+void StreamBlockPool::deallocate(StreamBlock* b) noexcept {
+
+  auto now = clock_type::now();
+  
+  StreamBlock* garbage {nullptr};
+
+  {
+    std::scoped_lock lock(_mutex);
+
+    if(b->capacity != BLOCK_CAPACITY || _memory > _cap) {
+      _memory -= b->capacity;
+      b->next = garbage;
+      garbage = b;
+    }
+    else {
+      b->next = _free;
+      _free = b;
+      ++_num_free;
+    }
+
+    if(now - _epoch >= _idle) {
+      if(auto idle = _release(_min_free); idle) {
+        auto tail = idle;
+        while(tail->next) tail = tail->next;
+        tail->next = garbage;
+        garbage = idle;
+      }
+      _min_free = _num_free;
+      _epoch = now;
+    }
+  }
+
+  while(garbage) {
+    auto next = garbage->next;
+    ::operator delete(garbage);
+    garbage = next;
+  }
+}
+
+// Function: _release
+// Unlink up to the given number of blocks from the free list. The caller holds the lock.
+StreamBlock* StreamBlockPool::_release(size_t n) noexcept {
+
+  StreamBlock* list {nullptr};
+
+  for(; n && _free; --n) {
+    auto b = _free;
+    _free = b->next;
+    b->next = list;
+    list = b;
+    --_num_free;
+    _memory -= b->capacity;
+  }
+
+  _min_free = std::min(_min_free, _num_free);
+
+  return list;
+}
+
+// Function: shrink
+// Release every free block to the allocator. Return the number of bytes released.
+size_t StreamBlockPool::shrink() noexcept {
+
+  StreamBlock* garbage {nullptr};
+
+  {
+    std::scoped_lock lock(_mutex);
+    garbage = _release(_num_free);
+  }
+
+  size_t num_bytes {0};
+
+  while(garbage) {
+    auto next = garbage->next;
+    num_bytes += garbage->capacity;
+    ::operator delete(garbage);
+    garbage = next;
+  }
+
+  return num_bytes;
+}
+
+// Function: num_free
+size_t StreamBlockPool::num_free() const {
+  std::scoped_lock lock(_mutex);
+  return _num_free;
+}
+
+// Function: memory
+// Return the bytes of the blocks held by the stream buffers and the free list.
+size_t StreamBlockPool::memory() const {
+  std::scoped_lock lock(_mutex);
+  return _memory;
+}
+
+// Function: peak_memory
+size_t StreamBlockPool::peak_memory() const {
+  std::scoped_lock lock(_mutex);
+  return _peak_memory;
+}
+
+// Function: cap
+size_t StreamBlockPool::cap() const {
+  std::scoped_lock lock(_mutex);
+  return _cap;
+}
+
+// Procedure: cap
+void StreamBlockPool::cap(size_t c) {
+  std::scoped_lock lock(_mutex);
+  _cap = c;
+}
+
+// Function: idle
+StreamBlockPool::clock_type::duration StreamBlockPool::idle() const {
+  std::scoped_lock lock(_mutex);
+  return _idle;
+}
+
+// Procedure: idle
+void StreamBlockPool::idle(clock_type::duration d) {
+  std::scoped_lock lock(_mutex);
+  _idle = d;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Move constructor
+StreamBlockChain::StreamBlockChain(StreamBlockChain&& rhs) noexcept :
+  _head  {rhs._head},
+  _tail  {rhs._tail},
+  _begin {rhs._begin},
+  _end   {rhs._end},
+  _size  {rhs._size},
+  _memory {rhs._memory},
+  _peak_memory {rhs._peak_memory} {
+  rhs._head = rhs._tail = nullptr;
+  rhs._begin = rhs._end = rhs._size = rhs._memory = 0;
+}
+
+// Destructor
+StreamBlockChain::~StreamBlockChain() {
+  clear();
+}
+
+// Move assignment
+StreamBlockChain& StreamBlockChain::operator = (StreamBlockChain&& rhs) noexcept {
+  if(this != &rhs) {
+    clear();
+    _head  = rhs._head;
+    _tail  = rhs._tail;
+    _begin = rhs._begin;
+    _end   = rhs._end;
+    _size  = rhs._size;
+    _memory = rhs._memory;
+    _peak_memory = std::max(_peak_memory, _memory);
+    rhs._head = rhs._tail = nullptr;
+    rhs._begin = rhs._end = rhs._size = rhs._memory = 0;
+  }
+  return *this;
+}
+
+// Procedure: clear
+// Return every block, spares included, to the pool.
+void StreamBlockChain::clear() noexcept {
+  while(_head) {
+    auto b = _head;
+    _head = b->next;
+    _release(b);
+  }
+  _tail = nullptr;
+  _begin = _end = _size = 0;
+}
+
+// Function: _acquire
+StreamBlock* StreamBlockChain::_acquire(size_t capacity) {
+  auto b = StreamBlockPool::get().allocate(capacity);
+  _memory += b->capacity;
+  _peak_memory = std::max(_peak_memory, _memory);
+  return b;
+}
+
+// Procedure: _release
+void StreamBlockChain::_release(StreamBlock* b) noexcept {
+  _memory -= b->capacity;
+  StreamBlockPool::get().deallocate(b);
+}
+
+// Procedure: _extend
+// Move the tail to the next block, taking a spare or a new block from the pool.
+void StreamBlockChain::_extend() {
+  if(_tail == nullptr) {
+    _head = _tail = _acquire();
+    _begin = 0;
+  }
+  else {
+    if(_tail->next == nullptr) {
+      _tail->next = _acquire();
+    }
+    _tail = _tail->next;
+  }
+  _end = 0;
+}
+
+// Procedure: write
+// Append data at the tail.
+void StreamBlockChain::write(const void* s, size_t count) {
+
+  auto src = static_cast<const char*>(s);
+
+  while(count) {
+    if(_tail == nullptr || _end == _tail->capacity) {
+      _extend();
+    }
+    auto n = std::min(count, _tail->capacity - _end);
+    std::memcpy(_tail->data() + _end, src, n);
+    _end += n;
+    _size += n;
+    src += n;
+    count -= n;
+  }
+}
+
+// Procedure: append
+// Append a copy of the data of another chain.
+void StreamBlockChain::append(const StreamBlockChain& rhs) {
+  for(auto b = rhs._head, e = rhs._tail ? rhs._tail->next : nullptr; b != e; b = b->next) {
+    auto beg = (b == rhs._head) ? rhs._begin : 0;
+    auto end = (b == rhs._tail) ? rhs._end : b->capacity;
+    write(b->data() + beg, end - beg);
+  }
+}
+
+// Procedure: overwrite
+// Overwrite the data at the given offset from the head in place.
+void StreamBlockChain::overwrite(size_t pos, const void* s, size_t count) noexcept {
+
+  assert(pos + count <= _size);
+
+  auto src = static_cast<const char*>(s);
+  auto b = _head;
+  auto off = _begin + pos;
+
+  while(off >= b->capacity) {
+    off -= b->capacity;
+    b = b->next;
+  }
+
+  while(count) {
+    auto n = std::min(count, b->capacity - off);
+    std::memcpy(b->data() + off, src, n);
+    src += n;
+    count -= n;
+    b = b->next;
+    off = 0;
+  }
+}
+
+// Function: copy
+// Copy data from the head without consuming them.
+size_t StreamBlockChain::copy(void* d, size_t count) const noexcept {
+
+  count = std::min(count, _size);
+
+  auto dst = static_cast<char*>(d);
+  auto b = _head;
+  auto off = _begin;
+
+  for(auto left = count; left; b = b->next, off = 0) {
+    auto n = std::min(left, ((b == _tail) ? _end : b->capacity) - off);
+    std::memcpy(dst, b->data() + off, n);
+    dst += n;
+    left -= n;
+  }
+
+  return count;
+}
+
+// Function: drop
+// Consume data from the head. Blocks fully consumed go back to the pool.
+size_t StreamBlockChain::drop(size_t count) noexcept {
+
+  count = std::min(count, _size);
+
+  for(auto left = count; left; ) {
+    auto n = std::min(left, ((_head == _tail) ? _end : _head->capacity) - _begin);
+    _begin += n;
+    left -= n;
+    if(_begin == _head->capacity && _head != _tail) {
+      auto b = _head;
+      _head = b->next;
+      _begin = 0;
+      _release(b);
+    }
+  }
+
+  if((_size -= count) == 0) {
+    clear();
+  }
+
+  return count;
+}
+
+// Function: read
+// Copy and consume data from the head.
+size_t StreamBlockChain::read(void* d, size_t count) noexcept {
+  return drop(copy(d, count));
+}
+
+// Function: gather
+// Fill the segments holding the data, from the head past the given bytes, for writev. Return
+// the number of segments.
+int StreamBlockChain::gather(struct iovec* iov, int max, size_t skip) const noexcept {
+
+  int n = 0;
+
+  if(_size <= skip) {
+    return n;
+  }
+
+  auto b = _head;
+  auto off = _begin + skip;
+
+  while(off >= b->capacity) {
+    off -= b->capacity;
+    b = b->next;
+  }
+
+  for(; n < max; b = b->next, off = 0) {
+    auto end = (b == _tail) ? _end : b->capacity;
+    iov[n].iov_base = const_cast<char*>(b->data()) + off;
+    iov[n].iov_len = end - off;
+    ++n;
+    if(b == _tail) break;
+  }
+
+  return n;
+}
+
+// Function: reserve
+// Make at least the given number of bytes available past the tail, taking spare blocks as
+// needed, and fill the free segments for readv. The data read in are added by commit.
+int StreamBlockChain::reserve(struct iovec* iov, int max, size_t count) {
+
+  if(_tail == nullptr) {
+    _extend();
+  }
+
+  int n = 0;
+  size_t num_bytes = 0;
+
+  if(_end < _tail->capacity) {
+    iov[n].iov_base = _tail->data() + _end;
+    iov[n].iov_len = _tail->capacity - _end;
+    num_bytes += iov[n++].iov_len;
+  }
+
+  for(auto b = _tail; n < max && num_bytes < count; b = b->next) {
+    if(b->next == nullptr) {
+      b->next = _acquire();
+    }
+    iov[n].iov_base = b->next->data();
+    iov[n].iov_len = b->next->capacity;
+    num_bytes += iov[n++].iov_len;
+  }
+
+  return n;
+}
+
+// Procedure: commit
+// Add the given number of bytes read into the segments of the last reserve.
+void StreamBlockChain::commit(size_t count) noexcept {
+  _size += count;
+  while(count) {
+    if(_end == _tail->capacity) {
+      _tail = _tail->next;
+      _end = 0;
+    }
+    auto n = std::min(count, _tail->capacity - _end);
+    _end += n;
+    count -= n;
+  }
+}
+
+// Function: linearize
+// Coalesce the data into a single block and return a pointer to them. Data already sitting in
+// one block are not moved.
+char* StreamBlockChain::linearize() {
+
+  if(_size == 0) {
+    return nullptr;
+  }
+
+  if(_head != _tail) {
+    auto b = _acquire(_size);
+    auto n = copy(b->data(), _size);
+    clear();
+    _head = _tail = b;
+    _end = _size = n;
+  }
+
+  return _head->data() + _begin;
+}
+
+//-------------------------------------------------------------------------------------------------
+
+// Destructor
+// Both sides are done by now; the blocks from the head on go back to the pool.
+StreamBlockQueue::~StreamBlockQueue() {
+  while(_head) {
+    auto b = _head;
+    _head = b->next;
+    _release(b);
+  }
+}
+
+// Function: _acquire
+// Only the producer acquires, so it alone moves the peak.
+StreamBlock* StreamBlockQueue::_acquire() {
+  auto b = StreamBlockPool::get().allocate();
+  auto m = _memory.fetch_add(b->capacity, std::memory_order_relaxed) + b->capacity;
+  if(m > _peak_memory.load(std::memory_order_relaxed)) {
+    _peak_memory.store(m, std::memory_order_relaxed);
+  }
+  return b;
+}
+
+// Procedure: _release
+void StreamBlockQueue::_release(StreamBlock* b) noexcept {
+  _memory.fetch_sub(b->capacity, std::memory_order_relaxed);
+  StreamBlockPool::get().deallocate(b);
+}
+
+// Procedure: write
+// Append data at the tail without publishing them. A new block is linked before any byte in it
+// is published, so the consumer always finds the link it follows.
+void StreamBlockQueue::write(const void* s, size_t count) {
+
+  auto src = static_cast<const char*>(s);
+
+  while(count) {
+    if(_tail == nullptr) {
+      _head = _tail = _mark = _acquire();
+      _end = _offset = 0;
+    }
+    else if(_end == _tail->capacity) {
+      _tail->next = _acquire();
+      _tail = _tail->next;
+      _end = 0;
+    }
+    auto n = std::min(count, _tail->capacity - _end);
+    std::memcpy(_tail->data() + _end, src, n);
+    _end += n;
+    _written += n;
+    src += n;
+    count -= n;
+  }
+}
+
+// Procedure: overwrite
+// Overwrite the data starting the given number of bytes behind the tail. The data must not have
+// been published.
+void StreamBlockQueue::overwrite(size_t back, const void* s, size_t count) noexcept {
+
+  auto published = _published.load(std::memory_order_relaxed);
+
+  assert(back <= _written - published && count <= back);
+
+  auto src = static_cast<const char*>(s);
+  auto b = _mark;
+  auto off = _offset + (_written - back - published);
+
+  while(off >= b->capacity) {
+    off -= b->capacity;
+    b = b->next;
+  }
+
+  while(count) {
+    auto n = std::min(count, b->capacity - off);
+    std::memcpy(b->data() + off, src, n);
+    src += n;
+    count -= n;
+    b = b->next;
+    off = 0;
+  }
+}
+
+// Function: publish
+// Make the data written so far visible to the consumer and return the bytes newly published.
+// The store is sequentially consistent so a consumer that clears its notification flag and then
+// checks the size cannot miss data published by a producer that saw the flag set.
+size_t StreamBlockQueue::publish() noexcept {
+
+  auto n = _written - _published.load(std::memory_order_relaxed);
+
+  if(n) {
+    _mark = _tail;
+    _offset = _end;
+    _published.store(_written);
+  }
+
+  return n;
+}
+
+// Function: copy
+// Copy published data from the head without consuming them.
+size_t StreamBlockQueue::copy(void* d, size_t count) const noexcept {
+
+  count = std::min(count, size());
+
+  auto dst = static_cast<char*>(d);
+  auto b = _head;
+  auto off = _begin;
+
+  for(auto left = count; left; ) {
+    if(off == b->capacity) {
+      b = b->next;
+      off = 0;
+    }
+    auto n = std::min(left, b->capacity - off);
+    std::memcpy(dst, b->data() + off, n);
+    dst += n;
+    off += n;
+    left -= n;
+  }
+
+  return count;
+}
+
+// Function: drop
+// Consume published data from the head. A consumed block is returned to the pool when the data
+// that follow are reached, which keeps the block the producer may still be filling.
+size_t StreamBlockQueue::drop(size_t count) noexcept {
+
+  auto consumed = _consumed.load(std::memory_order_relaxed);
+
+  count = std::min(count, _published.load(std::memory_order_acquire) - consumed);
+
+  for(auto left = count; left; ) {
+    if(_begin == _head->capacity) {
+      auto b = _head;
+      _head = b->next;
+      _begin = 0;
+      _release(b);
+    }
+    auto n = std::min(left, _head->capacity - _begin);
+    _begin += n;
+    left -= n;
+  }
+
+  _consumed.store(consumed + count, std::memory_order_release);
+
+  return count;
+}
+
+// Function: gather
+// Fill the segments holding the published data, from the head, for writev. Return the number
+// of segments.
+int StreamBlockQueue::gather(struct iovec* iov, int max) const noexcept {
+
+  int n = 0;
+  auto b = _head;
+  auto off = _begin;
+
+  for(auto left = size(); left && n < max; ++n) {
+    if(off == b->capacity) {
+      b = b->next;
+      off = 0;
+    }
+    auto len = std::min(left, b->capacity - off);
+    iov[n].iov_base = b->data() + off;
+    iov[n].iov_len = len;
+    off += len;
+    left -= len;
+  }
+
+  return n;
+}
+
+//-------------------------------------------------------------------------------------------------
+
 // Constructor
 OutputStreamBuffer::OutputStreamBuffer(Device* device) :
   _device {device} {
@@ -23,6 +643,14 @@ OutputStreamBuffer::OutputStreamBuffer(Device* device) :
 // Destructor
 OutputStreamBuffer::~OutputStreamBuffer() {
 
+  // The kernel may still read the blocks of zerocopy sends in flight. They are handed to the
+  // socket rather than recycled under it, and freed once the last send completes.
+  if(_reap(); !_inflight.empty()) {
+    static_cast<const Socket*>(_device)->hold_zerocopy(
+      _inflight.back().first, std::make_shared<StreamBlockChain>(std::move(_chain))
+    );
+  }
+
   //try {
   //  _flush();
   //} 
@@ -37,15 +665,11 @@ OutputStreamBuffer::~OutputStreamBuffer() {
   //if(_out_avail() > 0) {
   //  LOGW("Failed to flush data (remain ", _out_avail(), " bytes)");
   //}
-  
-  if(!_is_local_data()) {
-    std::free(_data);
-  }
 }
 
 // Function: flush
 std::streamsize OutputStreamBuffer::flush() {
-  std::scoped_lock lock(_mutex);
+  auto lock = _lock();
   return _flush();
 }
 
@@ -60,81 +684,120 @@ std::streamsize OutputStreamBuffer::_flush() {
   return _out_avail() != 0 ? -1 : sz;
 }
 
-// Function: _is_local_data
-// Check whether the buffer sits in the local buffer 
-bool OutputStreamBuffer::_is_local_data() const noexcept {
-  return _data == (reinterpret_cast<const char*>(&_size) + sizeof(char));
-}
-
 // Function: out_avail
 // Return the amount of data in the buffer. The call is thread-safe.
 std::streamsize OutputStreamBuffer::out_avail() const {
-  std::scoped_lock lock(_mutex);
+  auto lock = _lock();
   return _out_avail();
 }
 
 // Function: _out_avail
 std::streamsize OutputStreamBuffer::_out_avail() const noexcept {
-  return _pptr - _pbase;
+  return _queue ? _queue->size() : _chain.size();
+}
+
+// Function: _drainable
+// The device took everything on the last sync and more data has been written since.
+bool OutputStreamBuffer::_drainable() const noexcept {
+  return !_drained && _out_avail() > static_cast<std::streamsize>(_num_inflight);
+}
+
+// Function: _syncable
+// A sync would make progress: there are data to hand to the device, or zerocopy sends the socket
+// has reported completed.
+bool OutputStreamBuffer::_syncable() const noexcept {
+
+  if(_out_avail() > static_cast<std::streamsize>(_num_inflight)) {
+    return true;
+  }
+
+  if(_inflight.empty()) {
+    return false;
+  }
+
+  auto socket = dynamic_cast<const Socket*>(_device);
+
+  return socket && static_cast<int32_t>(socket->num_zerocopy_completed() - _inflight.front().first) > 0;
+}
+
+// Function: _lock
+// Lock the buffer unless it has a single writer, whose two sides never share a lock.
+std::unique_lock<std::recursive_mutex> OutputStreamBuffer::_lock() const {
+  return _queue ? std::unique_lock<std::recursive_mutex>() : std::unique_lock(_mutex);
+}
+
+// Procedure: single_writer
+// Switch the buffer between the locked chain and the lock-free queue of a single writer. The
+// buffer must be empty.
+void OutputStreamBuffer::single_writer(bool flag) {
+
+  auto lock = _lock();
+
+  assert(_out_avail() == 0 && _num_scopes == 0);
+
+  if(flag && !_queue) {
+    _chain.clear();
+    _queue = std::make_unique<StreamBlockQueue>();
+  }
+  else if(!flag) {
+    _queue.reset();
+  }
 }
 
 // Function: copy
 std::streamsize OutputStreamBuffer::copy(void* data, std::streamsize count) const {
-  std::scoped_lock lock(_mutex);
+  auto lock = _lock();
   return _copy(data, count);
 }
 
 // Function: _copy
 std::streamsize OutputStreamBuffer::_copy(void* data, std::streamsize count) const noexcept {
-  auto num_bytes = std::min(_pptr - _pbase, count);
-  std::memcpy(data, _pbase, num_bytes);
-  return num_bytes;
+  return _queue ? _queue->copy(data, count) : _chain.copy(data, count);
+}
+
+// Function: memory
+// Return the bytes of the blocks held by the buffer. The call is thread-safe.
+size_t OutputStreamBuffer::memory() const {
+  auto lock = _lock();
+  return _queue ? _queue->memory() : _chain.memory();
+}
+
+// Function: peak_memory
+// Return the most bytes of blocks the buffer has held. The call is thread-safe.
+size_t OutputStreamBuffer::peak_memory() const {
+  auto lock = _lock();
+  return _queue ? _queue->peak_memory() : _chain.peak_memory();
+}
+
+// Function: string_view
+// Return a view of the data in the buffer. Data spanning several blocks are coalesced first.
+// The data of a single-writer buffer cannot be moved under the writer and have no view.
+std::string_view OutputStreamBuffer::string_view() {
+  if(_queue) {
+    throw std::system_error(make_posix_error_code(ENOTSUP), "Single-writer buffer has no view");
+  }
+  std::scoped_lock lock(_mutex);
+  return {_chain.linearize(), _chain.size()};
 }
 
 // Function: write
-// Add data into the buffer. The call is thread-safe.
+// Add data into the buffer. The call is thread-safe unless the buffer has a single writer.
 std::streamsize OutputStreamBuffer::write(const void* s, std::streamsize count) {
-  std::scoped_lock lock(_mutex);
+  WriteLock lock(*this);
   return _write(s, count);
 }
 
 // Function: _write
-// Add data into the buffer. The call is thread-safe.
+// Add data into the buffer. The data of a single-writer buffer are published, and the callback
+// invoked, as the write scope closes.
 std::streamsize OutputStreamBuffer::_write(const void* s, std::streamsize count) {
 
-  // Immediate space is not enought where the buffer has to be either enlarged or adjusted.
-  if(_epptr < _pptr + count) {
-
-    size_t avail = _pptr - _pbase;
-    size_t csize = _is_local_data() ? static_cast<char>(_size.value) : _size.value;
-    
-    // Case 1: Empty space is enough.
-    if(csize >= avail + count) {
-      std::memmove(_data, _pbase, avail*sizeof(char));
-    }
-    // Case 2: Empty space is not enough
-    else {
-      while(csize < avail + count) {
-        csize = csize * 2;
-      }
-      auto chunk = static_cast<char*>(std::malloc(csize*sizeof(char)));
-      assert(chunk != nullptr);
-
-      std::memcpy(chunk, _pbase, avail*sizeof(char));
-
-      if(!_is_local_data()) {
-        std::free(_data);
-      }
-      _data = chunk;
-      _size.value = csize;
-    }
-    _pbase = _data;
-    _epptr = _data + csize;
-    _pptr = _data + avail;
+  if(_queue) {
+    _queue->write(s, count);
+    return count;
   }
 
-  std::memcpy(_pptr, s, count*sizeof(char));
-  _pptr += count;
+  _chain.write(s, count);
   
   // Invoke the callback.
   if(count > 0 && _on_write) {
@@ -145,24 +808,111 @@ std::streamsize OutputStreamBuffer::_write(const void* s, std::streamsize count)
   return count;
 }
 
+// Procedure: _rewrite
+// Overwrite the data starting the given number of bytes behind the put position, e.g., the 
+// size header of a packet whose size is known only after the body has been written.
+void OutputStreamBuffer::_rewrite(std::streamsize back, const void* s, std::streamsize count) noexcept {
+  if(_queue) {
+    _queue->overwrite(back, s, count);
+  }
+  else {
+    _chain.overwrite(_chain.size() - back, s, count);
+  }
+}
+
+// Procedure: _publish
+// Hand the data written in the closing scope of a single-writer buffer to the syncer.
+void OutputStreamBuffer::_publish() {
+  if(_queue->publish() && _on_write) {
+    _on_write();
+  }
+}
+
+// Procedure: _reap
+// Drop the data of the zerocopy sends the socket reports completed, together with the data sent
+// after them up to the next send in flight.
+void OutputStreamBuffer::_reap() {
+
+  if(_inflight.empty()) {
+    return;
+  }
+
+  auto socket = dynamic_cast<const Socket*>(_device);
+
+  if(socket == nullptr) {
+    return;
+  }
+
+  auto num = socket->reap_zerocopy();
+
+  while(!_inflight.empty() && static_cast<int32_t>(num - _inflight.front().first) > 0) {
+    _chain.drop(_inflight.front().second);
+    _num_inflight -= _inflight.front().second;
+    _inflight.pop_front();
+  }
+}
+
 // Function: sync
-// Flush the output buffer into the underlying file descriptor.
+// Flush the output buffer into the underlying file descriptor. The blocks holding the data are
+// handed to the device in one gather write, with MSG_ZEROCOPY if the device is a zerocopy socket
+// and the data reach its threshold.
 //
-// pbase ------------- pptr -------------- epptr
-// [     available      ]
+// head ------------------- tail
+// [ in flight ][ available  ]
 //
 std::streamsize OutputStreamBuffer::_sync() {
+
   if(!_device) return -1;
-  auto ret = _device->write(_pbase, _pptr - _pbase);
+
+  _reap();
+
+  struct iovec iov[StreamBlockChain::MAX_IOVECS];
+  
+  auto n = _queue ? _queue->gather(iov, StreamBlockChain::MAX_IOVECS) :
+                    _chain.gather(iov, StreamBlockChain::MAX_IOVECS, _num_inflight);
+  auto num = std::streamsize {0};
+  auto ret = std::streamsize {0};
+
+  for(int i=0; i<n; ++i) {
+    num += iov[i].iov_len;
+  }
+
+  auto socket = (n > 0 && !_queue) ? dynamic_cast<const Socket*>(_device) : nullptr;
+
+  std::optional<uint32_t> id;
+
+  if(socket && socket->zerocopy() && static_cast<size_t>(num) >= socket->zerocopy()) {
+    ret = socket->writev_zerocopy(iov, n, id);
+  }
+  else if(n == 1) {
+    ret = _device->write(iov[0].iov_base, num);
+  }
+  else if(n > 1) {
+    ret = _device->writev(iov, n);
+  }
+
   if(ret > 0) {
-    _pbase += ret;
+    // Data sent behind a zerocopy send in flight are held until it completes.
+    if(id) {
+      _inflight.emplace_back(*id, ret);
+      _num_inflight += ret;
+    }
+    else if(!_inflight.empty()) {
+      _inflight.back().second += ret;
+      _num_inflight += ret;
+    }
+    else {
+      _queue ? _queue->drop(ret) : _chain.drop(ret);
+    }
+    _num_synced += ret;
   }
+  _drained = (ret < num);
   return ret;
 }
 
 // Function: sync
 std::streamsize OutputStreamBuffer::sync() {
-  std::scoped_lock lock(_mutex);
+  auto lock = _lock();
   return _sync();
 }
 
@@ -175,64 +925,33 @@ InputStreamBuffer::InputStreamBuffer(Device* device) noexcept :
 
 // Constructor.
 InputStreamBuffer::InputStreamBuffer(const OutputStreamBuffer& osbuf) {
-
-  std::scoped_lock lock(osbuf._mutex);
-
-  auto count = osbuf._pptr - osbuf._pbase;
-  
-  // Push to the local buffer
-  if(count < _size.value) {
-    std::memcpy(_data, osbuf._pbase, count);
-    _egptr += count;
+  auto lock = osbuf._lock();
+  if(osbuf._queue) {
+    std::vector<char> data(osbuf._queue->size());
+    _chain.write(data.data(), osbuf._queue->copy(data.data(), data.size()));
   }
-  // Accommodate the data through malloc.
   else {
-    _size.value = count;
-    _data = static_cast<char*>(std::malloc(count*sizeof(char)));
-    std::memcpy(_data, osbuf._pbase, count);
-    _eback = _data;
-    _gptr = _data;
-    _egptr = _data + count;
+    _chain.append(osbuf._chain);
   }
 }
 
 // Constructor.
+// The blocks of the ostream buffer are taken over and the ostream buffer is left empty. The data
+// of a single-writer buffer are copied and consumed instead.
 InputStreamBuffer::InputStreamBuffer(OutputStreamBuffer&& osbuf) {
-  
-  std::scoped_lock lock(osbuf._mutex);
-
-  auto count = osbuf._pptr - osbuf._pbase;
-  
-  if(osbuf._is_local_data()) {
-    std::memcpy(_data, osbuf._pbase, count);
-    _egptr += count;
+  auto lock = osbuf._lock();
+  if(osbuf._queue) {
+    std::vector<char> data(osbuf._queue->size());
+    _chain.write(data.data(), osbuf._queue->copy(data.data(), data.size()));
+    osbuf._queue->drop(data.size());
   }
   else {
-    std::memmove(osbuf._data, osbuf._pbase, count*sizeof(char));
-    _size.value = osbuf._size.value;
-    _data = osbuf._data;
-    _eback = _data;
-    _gptr = _data;
-    _egptr = _data + count;
+    _chain = std::move(osbuf._chain);
   }
-
-  // Reset the pointer of ostream buffer.
-  osbuf._size = {sizeof(LocalStreamBuffer) - sizeof(char)};
-  osbuf._data  = reinterpret_cast<char*>(&osbuf._size) + sizeof(char);
-  osbuf._pbase = osbuf._data;
-  osbuf._pptr  = osbuf._data;
-  osbuf._epptr = osbuf._data + osbuf._size.value;
 }
 
 // Destructor.
 InputStreamBuffer::~InputStreamBuffer() {
-  if(!_is_local_data()) {
-    std::free(_data);
-  }
-}
-
-bool InputStreamBuffer::_is_local_data() const noexcept {
-  return _data == (reinterpret_cast<const char*>(&_size) + sizeof(char));
 }
 
 // Function: in_avail
@@ -244,7 +963,18 @@ std::streamsize InputStreamBuffer::in_avail() const {
 
 // Function: _in_avail
 std::streamsize InputStreamBuffer::_in_avail() const noexcept {
-  return _egptr - _gptr;
+  return _chain.size();
+}
+
+// Function: _drainable
+// The last sync filled the buffer so the device may have more data.
+bool InputStreamBuffer::_drainable() const noexcept {
+  return !_drained;
+}
+
+// Function: _lock
+std::unique_lock<std::recursive_mutex> InputStreamBuffer::_lock() const {
+  return std::unique_lock(_mutex);
 }
 
 // Function: copy
@@ -255,9 +985,28 @@ std::streamsize InputStreamBuffer::copy(void* data, std::streamsize count) const
 
 // Function: _copy
 std::streamsize InputStreamBuffer::_copy(void* data, std::streamsize count) const noexcept {
-  auto num_bytes = std::min(_egptr - _gptr, count);
-  std::memcpy(data, _gptr, num_bytes);
-  return num_bytes;
+  return _chain.copy(data, count);
+}
+
+// Function: memory
+// Return the bytes of the blocks held by the buffer. The call is thread-safe.
+size_t InputStreamBuffer::memory() const {
+  std::scoped_lock lock(_mutex);
+  return _chain.memory();
+}
+
+// Function: peak_memory
+// Return the most bytes of blocks the buffer has held. The call is thread-safe.
+size_t InputStreamBuffer::peak_memory() const {
+  std::scoped_lock lock(_mutex);
+  return _chain.peak_memory();
+}
+
+// Function: string_view
+// Return a view of the data in the buffer. Data spanning several blocks are coalesced first.
+std::string_view InputStreamBuffer::string_view() {
+  std::scoped_lock lock(_mutex);
+  return {_chain.linearize(), _chain.size()};
 }
 
 // Function: purge
@@ -292,49 +1041,42 @@ std::streamsize InputStreamBuffer::sync() {
 }
 
 // Function: _sync
-// Synchronize the buffer with the underlying device.
+// Synchronize the buffer with the underlying device. The free space of the tail block and the
+// spare blocks past it are handed to the device in one scatter read. The read window doubles 
+// while the device keeps filling it and falls back to one block once the device runs dry.
 std::streamsize InputStreamBuffer::_sync() {
 
   if(!_device) return -1;
 
-  size_t csize = _is_local_data() ? static_cast<char>(_size.value) : _size.value;
-
-  // The buffer is already full. We must guarantee at least one slot before calling 
-  // device read or otherwise we will run into problem in the zero return value.
-  if(_egptr == _eback + csize) {
-    
-    size_t empty = _gptr - _eback;
-    size_t avail = _egptr - _gptr;
+  struct iovec iov[StreamBlockChain::MAX_IOVECS];
 
-    // Reuse the empty region.
-    if (empty > csize / 2) {
-      std::memmove(_eback, _gptr, avail*sizeof(char));
-    }
-    // Double the array size.
-    else {
-      csize = csize * 2;
-      auto chunk = static_cast<char*>(std::malloc(csize*sizeof(char)));
-      assert(chunk != nullptr);
+  auto n = _chain.reserve(iov, StreamBlockChain::MAX_IOVECS, _window);
+  auto num = std::streamsize {0};
+  auto ret = std::streamsize {0};
 
-      std::memcpy(chunk, _gptr, avail);
-
-      if(!_is_local_data()) {
-        std::free(_data);
-      } 
-      _data = chunk;
-      _size.value = csize;
-    }
-    _eback = _data;
-    _gptr = _data;
-    _egptr = _data + avail;
+  for(int i=0; i<n; ++i) {
+    num += iov[i].iov_len;
   }
 
   // Read the data.
-  auto ret = _device->read(_egptr, csize - (_egptr - _eback));
+  if(n == 1) {
+    ret = _device->read(iov[0].iov_base, num);
+  }
+  else {
+    ret = _device->readv(iov, n);
+  }
 
   if(ret > 0) {
-    _egptr += ret;
+    _chain.commit(ret);
+    _num_synced += ret;
   }
+  // Nothing came in; do not hold the reserved blocks while the stream is idle.
+  else if(_chain.size() == 0) {
+    _chain.clear();
+  }
+
+  _drained = (ret < num);
+  _window = _drained ? StreamBlockPool::BLOCK_CAPACITY : std::min(_window << 1, MAX_WINDOW);
 
   return ret;
 }
@@ -348,9 +1090,7 @@ std::streamsize InputStreamBuffer::read(void* s, std::streamsize count) {
 
 // Function: _read
 std::streamsize InputStreamBuffer::_read(void* s, std::streamsize count) {
-  auto num_read = std::min(count, _egptr - _gptr);
-  std::memcpy(s, _gptr, num_read*sizeof(char));
-  _gptr += num_read;
+  auto num_read = static_cast<std::streamsize>(_chain.read(s, count));
   if(num_read > 0 && _on_read) {
     _on_read();
   }
@@ -365,12 +1105,8 @@ std::streamsize InputStreamBuffer::drop(std::streamsize count) {
 
 // Function: _drop
 std::streamsize InputStreamBuffer::_drop(std::streamsize count) {
-  auto n = std::min(count, _egptr - _gptr);
-  _gptr += n;
-  return n;
+  return _chain.drop(count);
 }
 
 
 };  // End of dtc namespace .----------------------------------------------------------------------
-
-
@@ -56,6 +56,16 @@ Agent::Task::Task(pb::Topology&& tpg) :
     }
     
     assert(vhosts.find(stream.tail) != vhosts.end());
+
+    // Both ends on this host: the stream goes through a shared memory ring. The read end stays
+    // with this task and the write end is handed to the task of the tail.
+    if(env::shm_ring_capacity() > 0 && vhosts.at(stream.tail) == vhosts.at(stream.head)) {
+      auto [rend, wend] = make_shared_memory();
+      LOGI("Frontier ring key/fd=", skey, "/", rend->fd());
+      hatchery().frontiers.push_back(Frontier{topology.graph, skey, std::move(rend)});
+      hatchery().colocated.push_back(Frontier{topology.graph, skey, std::move(wend)});
+      continue;
+    }
     
     Frontier ftr{
       topology.graph, 
@@ -64,9 +74,9 @@ Agent::Task::Task(pb::Topology&& tpg) :
     };
     
     FrontierPacket pkt {ftr.graph, ftr.stream};
-    ftr.socket->flush(&pkt, sizeof(pkt));
+    ftr.device->flush(&pkt, sizeof(pkt));
 
-    LOGI("Frontier written key/fd=", ftr.stream, "/", ftr.socket->fd());
+    LOGI("Frontier written key/fd=", ftr.stream, "/", ftr.device->fd());
     
     hatchery().frontiers.push_back(std::move(ftr));
   }
@@ -94,7 +104,12 @@ void Agent::Task::splice_frontiers(std::list<Frontier>& src) {
 std::string Agent::Task::frontiers_to_string() const {
   std::ostringstream oss;
   for(const auto& ftr : hatchery().frontiers) {
-    oss << ftr.stream << ":" << ftr.socket->fd() << ' ';
+    if(auto shm = std::dynamic_pointer_cast<SharedMemory>(ftr.device); shm) {
+      oss << ftr.stream << ":" << shm->fd() << ',' << shm->peer_fd() << ',' << shm->memfd() << ' ';
+    }
+    else {
+      oss << ftr.stream << ":" << ftr.device->fd() << ' ';
+    }
   }
   return oss.str();
 }
@@ -212,7 +227,7 @@ void Agent::_init_frontier_listener() {
           FrontierPacket pkt;
           event.device()->purge(&pkt, sizeof(pkt)); 
           LOGI("Frontier received for stream ", pkt.stream, " fd=", event.device()->fd());
-          insert_frontier(Frontier{pkt.graph, pkt.stream, std::static_pointer_cast<Socket>(event.device())});
+          insert_frontier(Frontier{pkt.graph, pkt.stream, event.device()});
           return Event::REMOVE;
         }
       );
@@ -254,6 +269,12 @@ bool Agent::_insert_task(Task& task) {
   assert(is_owner());
   
   const auto key = task.topology.task_id();
+
+  // Hand the write ends of the co-located rings to the tails.
+  for(auto& ftr : task.hatchery().colocated) {
+    _insert_frontier(ftr);
+  }
+  task.hatchery().colocated.clear();
     
   task.splice_frontiers(_frontiers);
 
@@ -307,8 +328,12 @@ bool Agent::_deploy(Task& task) {
 
     std::vector<ScopedOpenOnExec> devices;
 
+    // The executor adopts a reference to each ring end it inherits.
     for(auto& ftr : task.hatchery().frontiers) {
-      devices.emplace_back(std::move(ftr.socket));
+      if(auto shm = std::dynamic_pointer_cast<SharedMemory>(ftr.device); shm) {
+        shm->share();
+      }
+      devices.emplace_back(std::move(ftr.device));
     }
     devices.emplace_back(std::move(eskt));
     devices.emplace_back(std::move(task.hatchery().stderr));
@@ -332,7 +357,16 @@ bool Agent::_deploy(Task& task) {
 
     // Build up the communication channel.
     std::tie(executor.istream, executor.ostream) = insert_channel(std::move(askt))(
-      [this, key=task.key] (pb::BrokenIO&) { remove_task(key, false); }
+      [this, key=task.key] (pb::BrokenIO&) { remove_task(key, false); },
+      [this, key=task.key] (pb::TaskInfo& info) { 
+        promise([this, key, info=std::move(info)] () mutable {
+          if(auto itr = _tasks.find(key); itr != _tasks.end()) {
+            if(auto eptr = std::get_if<Executor>(&itr->second.handle)) {
+              eptr->report = std::move(info);
+            }
+          }
+        });
+      }
     );
 
     // Send the topology to the executor.
@@ -367,6 +401,10 @@ void Agent::_remove_task(Task& task, bool kill) {
     taskinfo.status = eptr->container.status();
     taskinfo.memory_limit_in_bytes = eptr->container.cgroup().memory_limit_in_bytes();
     taskinfo.memory_max_usage_in_bytes = eptr->container.cgroup().memory_max_usage_in_bytes();
+    taskinfo.num_restarts = eptr->report.num_restarts;
+    taskinfo.stream_peak_memory = eptr->report.stream_peak_memory;
+    taskinfo.codec_raw_bytes = eptr->report.codec_raw_bytes;
+    taskinfo.codec_encoded_bytes = eptr->report.codec_encoded_bytes;
   }    
   
   // Measure the elapsed time.
@@ -84,6 +84,27 @@ size_t Executor::graph_size() const {
   return num_streams() + num_vertices();
 }
 
+// Function: taskinfo
+// Query the task information known to this executor: the restarts of its vertex programs, and
+// the peak buffer memory and codec bytes of its streams summed over the streams.
+pb::TaskInfo Executor::taskinfo() const {
+  
+  pb::TaskInfo info {_graph._task_id, env::this_host(), -1};
+
+  for(const auto& kvp : _graph._vertices) {
+    info.num_restarts += kvp.second.num_restarts();
+  }
+
+  for(const auto& kvp : _graph._streams) {
+    auto c = kvp.second.codec_counters();
+    info.stream_peak_memory += kvp.second.peak_memory();
+    info.codec_raw_bytes += c.raw_bytes;
+    info.codec_encoded_bytes += c.encoded_bytes;
+  }
+
+  return info;
+}
+
 // Procedure: _remove_istream
 // Remove the stream from the istream side.
 void Executor::_remove_istream(key_type key) {
@@ -95,9 +116,11 @@ void Executor::_remove_istream(key_type key) {
     if(s->_critical) std::exit(EXIT_CRITICAL_STREAM);
 
     if(s->is_intra_stream()) {
+      s->_retire(std::ios_base::in | std::ios_base::out);
       remove(s->istream(), s->ostream());
     }
     else {
+      s->_retire(std::ios_base::in);
       remove(s->istream());
     }
   }
@@ -118,6 +141,8 @@ void Executor::_remove_ostream(key_type key) {
 
     if(s->_critical) std::exit(EXIT_CRITICAL_STREAM);
 
+    s->_retire(std::ios_base::out);
+
     if(s->is_intra_stream()) {
       if(auto os = s->ostream(); os) {
         os->remove_on_flush();
@@ -255,6 +280,10 @@ void Executor::_teardown_distributed() {
   redirect_fd(STDERR_FILENO, _agent->stderr_fd);
   _agent->stdout_fd = STDOUT_FILENO;
   _agent->stderr_fd = STDERR_FILENO;
+
+  // The loop is over; flush the final counters to the agent by hand.
+  (*_agent->ostream)(pb::Protobuf{taskinfo()});
+  _agent->ostream->osbuf.flush();
   
   remove(_agent->ostream, _agent->istream);
 }
@@ -293,117 +322,281 @@ void Executor::_make_graph(pb::Topology* tpg) {
 }
   
 // Procedure: _insert_vertices
+// Create a timeout event for each vertex. All events are registered in a single batch.
 void Executor::_insert_vertices(pb::Topology* tpg) {
 
+  std::vector<std::shared_ptr<Event>> batch;
+
+  batch.reserve(_graph._vertices.size());
+
   for(auto& kvp : _graph._vertices) {
 
     // Assign the executor pointer.
     kvp.second._executor = this;
     
     // Create a timeout event for each vertex.
-    insert<TimeoutEvent>(0ms, [this, &v=kvp.second] (Event& e) mutable {
-      v();
-      if(v.program()) {
-        promise([this, program=v._prespawn()] () mutable {
-          _spawn(program);
-        });  
+    batch.push_back(make_event<TimeoutEvent>(
+      kvp.second._strand, 0ms, [this, &v=kvp.second] (Event& e) mutable {
+        v();
+        if(v.program()) {
+          promise([this, program=std::make_shared<Vertex::Program>(v._prespawn())] () {
+            _spawn(program);
+          });  
+        }
       }
-    });
+    ));
   }
+
+  insert_batch(std::move(batch));
 }
 
 // Procedure: _spawn
-// Spawn a vertex program.
-void Executor::_spawn(Vertex::Program& program) {
+// Spawn a vertex program. The executor keeps its copies of the stream bridges until the program
+// exits successfully, so a failed program can be respawned on the same channels. The task fails
+// only when the restart policy of the vertex is exhausted.
+void Executor::_spawn(std::shared_ptr<Vertex::Program> program) {
 
   assert(is_owner());
 
   try {
-    auto& v = _graph._vertices.at(program.vertex);
+    auto& v = _graph._vertices.at(program->vertex);
 
-    LOGI("Spawn vertex pgoram ", program.vertex, " [", v._runtime.program(), "]");
+    LOGI("Spawn vertex pgoram ", program->vertex, " [", v._runtime.program(), "]");
     // Create a communication channel based on domain sockets.
     auto [rp, wp] = make_pipe();
 
     // Open-on-exec all related devices.
     std::vector<ScopedDeviceRestorer> devices;
-    for(auto& bridge : program.bridges) {
-      devices.emplace_back(std::move(bridge));
+    for(auto& bridge : program->bridges) {
+      devices.emplace_back(bridge);
     }
     devices.emplace_back(std::move(wp));
     
     // Fork-exec
-    auto pid = spawn(program.c_file.get(), program.c_argv.get(), program.c_envp.get());
+    auto pid = spawn(program->c_file.get(), program->c_argv.get(), program->c_envp.get());
 
     // Build a connection channel.
-    LOGI("Successfully spawned vertex program ", program.vertex);
-    insert<ReadEvent>(std::move(rp), [pid] (Event& ev) {
+    LOGI("Successfully spawned vertex program ", program->vertex);
+    insert<ReadEvent>(std::move(rp), [this, &v, pid, program] (Event& ev) {
+      
       int s;
-      assert(::read(ev.device()->fd(), &s, sizeof(s)) == 0); 
-      assert(::waitpid(pid, &s, 0) == pid);
+      
+      [[maybe_unused]] auto n = ::read(ev.device()->fd(), &s, sizeof(s));
+      assert(n == 0); 
+      
+      [[maybe_unused]] auto w = ::waitpid(pid, &s, 0);
+      assert(w == pid);
+
       if((WIFEXITED(s) && WEXITSTATUS(s) != EXIT_SUCCESS) || WIFSIGNALED(s)) {
-        std::exit(s);
+        
+        if(auto r = v._num_restarts.load(); r < v._max_restarts) {
+          
+          auto backoff = v._restart_backoff * (1 << std::min(r, size_t{10}));
+
+          LOGW(
+            "Vertex program ", program->vertex, " failed (", status_to_string(s), "), ",
+            "restart ", r + 1, "/", v._max_restarts, " in ", backoff.count(), "ms"
+          );
+          
+          v._num_restarts.fetch_add(1, std::memory_order_relaxed);
+          _report_restart();
+
+          insert<TimeoutEvent>(backoff, [this, program] (Event&) {
+            promise([this, program] () { 
+              _refresh_bridges(*program);
+              _spawn(program); 
+            });
+          });
+
+          return Event::REMOVE;
+        }
+
+        LOGE("Vertex program ", program->vertex, " failed (", status_to_string(s), ")");
+        std::exit(EXIT_VERTEX_PROGRAM_FAILED);
       }
+
+      // Release the bridges so the peers see the end of the streams.
+      program->bridges.clear();
+      program->stale.clear();
+
       LOGI("Vertex program sccessfully exited");
       return Event::REMOVE;
     });
   }
   catch(std::exception& e) {
-    LOGE("Failed to spawn vertex program ", program.vertex, " (", e.what(), ")");
+    LOGE("Failed to spawn vertex program ", program->vertex, " (", e.what(), ")");
     std::exit(EXIT_VERTEX_PROGRAM_FAILED);
   }
 }
 
+// Procedure: _refresh_bridges
+// Give the intra streams of a failed program fresh bridges before it is respawned. A program 
+// killed in the middle of a write leaves a partial frame in its peer, which would otherwise 
+// prefix the first write of the new program; likewise the new program would start reading in 
+// the middle of a frame. The peer event is replaced together with the bridge, dropping what it
+// has buffered. The new socket takes over the descriptor number of the old bridge, so the
+// environment of the program stays valid. The old socket is kept open until the program exits,
+// so the removed peer event never observes a hangup. Inter streams and streams between two 
+// programs keep their bridges, and a frame cut by the failure reaches the peer as is.
+void Executor::_refresh_bridges(Vertex::Program& program) {
+
+  assert(is_owner() && program.bridges.size() == program.streams.size());
+
+  std::vector<std::shared_ptr<Event>> batch;
+
+  for(size_t i=0; i<program.bridges.size(); ++i) {
+
+    auto s = _graph._stream(program.streams[i]);
+    auto& bridge = program.bridges[i];
+
+    if(!s->is_intra_stream() || (s->_tail->program() && s->_head->program())) {
+      LOGW(
+        "Stream ", s->key, " keeps its bridge across the restart of vertex program ", 
+        program.vertex, " (a frame cut by the failure is passed on as is)"
+      );
+      continue;
+    }
+
+    const auto reads = (s->_head->key == program.vertex);
+
+    // The peer has closed its end already; the new program sees the end of the stream.
+    auto peer = reads ? std::shared_ptr<Event>(s->ostream()) : std::shared_ptr<Event>(s->istream());
+
+    if(!peer) {
+      continue;
+    }
+
+    remove(std::move(peer));
+
+    auto [rdev, wdev] = make_socket_pair();
+    
+    auto fd = duplicate_fd(bridge->fd());
+    make_fd_close_on_exec(fd);
+    program.stale.push_back(std::make_shared<Socket>(fd));
+
+    duplicate_fd((reads ? rdev : wdev)->fd(), bridge->fd());
+    make_fd_close_on_exec(bridge->fd());
+
+    if(reads) {
+      _insert_ostream(*s, std::move(wdev), batch);
+    }
+    else {
+      _insert_istream(*s, std::move(rdev), batch);
+    }
+  }
+
+  insert_batch(std::move(batch));
+}
+
+// Procedure: _report_restart
+// Send the agent the number of program restarts of the task so far, which it carries to the
+// master in the final taskinfo.
+void Executor::_report_restart() {
+  
+  if(!_agent || !_agent->ostream) {
+    return;
+  }
+
+  (*_agent->ostream)(pb::Protobuf{taskinfo()});
+}
+
 // Procedure: _insert_streams
 // Create an IO event for each stream of the graph. The stream and fd information is stored 
-// in the runtime variable of topology.
+// in the runtime variable of topology. Streams are spread across the event loops and the 
+// events of each loop are registered in a single batch, so a large graph costs one hop per 
+// loop rather than one round trip per channel.
 void Executor::_insert_streams(pb::Topology* tpg) {
 
-  auto frontiers = tpg ? tpg->runtime.frontiers() : std::unordered_map<key_type, int>();
+  auto frontiers = tpg ? tpg->runtime.frontiers() : std::unordered_map<key_type, std::vector<int>>();
+
+  std::unordered_map<Reactor*, std::vector<std::shared_ptr<Event>>> batches;
   
   for(auto& [key, stream] : _graph._streams) {
 
+    auto& batch = batches[&next_shard()];
+
+    // A vertex program reads and writes bare bytes, which leaves no room for frames or batches.
+    if((stream._tail->program() || stream._head->program()) && 
+       (stream._codec != Codec::NONE || stream._batch_size != 0)) {
+      LOGW("Stream ", key, " ignores its codec and batching (vertex program at an end)");
+    }
+
     // Case 1: intra stream
     if(auto fitr=frontiers.find(key); fitr == frontiers.end()) {
 
       assert(!stream.is_inter_stream());
 
+      // Vertices on both ends pass typed messages through a mailbox. Programs need a real
+      // descriptor, and an ostream callback or watermark works on the bytes of the buffer.
+      if(!stream._tail->program() && !stream._head->program() && 
+         !stream._on_ostream && stream._high_watermark == 0) {
+        auto mailbox = make_mailbox();
+        _insert_istream(stream, mailbox, batch);
+        _insert_ostream(stream, std::move(mailbox), batch);
+        continue;
+      }
+
       auto [rdev, wdev] = make_socket_pair();
 
       //LOGI("Created an intra stream for ", key, " fd=", rdev->fd());
-      _insert_istream(stream, std::move(rdev));
-      _insert_ostream(stream, std::move(wdev));
+      _insert_istream(stream, std::move(rdev), batch);
+      _insert_ostream(stream, std::move(wdev), batch);
     }
     // Case 2: inter stream
     else {
 
       assert(stream.is_inter_stream());
 
-      make_fd_close_on_exec(fitr->second);
-      //LOGI("Created an inter stream for ", key, " fd=", fitr->second);
+      const auto& fds = fitr->second;
+
+      for(auto fd : fds) {
+        make_fd_close_on_exec(fd);
+      }
+      //LOGI("Created an inter stream for ", key, " fd=", fds[0]);
+      
+      // A co-located stream comes as a shared memory ring (fd, peer fd, memfd).
+      auto device = [&] (std::ios_base::openmode m) -> std::shared_ptr<Device> {
+        if(fds.size() == 3) {
+          return std::make_shared<SharedMemory>(fds[0], fds[1], fds[2], m);
+        }
+        return std::make_shared<Socket>(fds[0]);
+      };
       
       if(stream.is_inter_stream(std::ios_base::in)) {
-        _insert_istream(stream, std::make_shared<Socket>(fitr->second));
+        _insert_istream(stream, device(std::ios_base::in), batch);
       }
       else if(stream.is_inter_stream(std::ios_base::out)) {
-        _insert_ostream(stream, std::make_shared<Socket>(fitr->second));
+        _insert_ostream(stream, device(std::ios_base::out), batch);
       }
       else {
         assert(false);
       }
     }
   }
+
+  // Vertices may write to the streams right away, so all streams must be in their loops first.
+  std::vector<std::future<void>> futures;
+
+  for(auto& [loop, batch] : batches) {
+    futures.push_back(loop->insert_batch(std::move(batch)));
+  }
+
+  for(auto& fu : futures) {
+    fu.get();
+  }
 }
 
 // Procedure: _insert_istream
-void Executor::_insert_istream(Stream& stream, std::shared_ptr<Device> idev) {
+void Executor::_insert_istream(
+  Stream& stream, std::shared_ptr<Device> idev, std::vector<std::shared_ptr<Event>>& batch
+) {
 
   if(stream._head->program()) {
     stream._reader = std::move(idev);
     return;
   }
 
-  std::tie(stream._reader, std::ignore) = insert_channel(std::move(idev), std::ios_base::in)(
+  auto [R, W] = make_channel(std::move(idev), std::ios_base::in, stream._head->_strand)(
     [this, &stream] (pb::BrokenIO& b) {
       remove_istream(stream.key);
     },
@@ -414,25 +607,62 @@ void Executor::_insert_istream(Stream& stream, std::shared_ptr<Device> idev) {
       }
     }
   );
+
+  // A vertex program writes bare bytes; neither frames nor batches come from it.
+  if(!stream._tail->program() && !std::dynamic_pointer_cast<Mailbox>(R->device())) {
+    R->codec(make_codec(stream._codec));
+    R->batch(stream._batch_size != 0);
+  }
+
+  stream._reader = R;
+  batch.push_back(std::move(R));
 }
 
 // Procedure: _insert_ostream
-void Executor::_insert_ostream(Stream& stream, std::shared_ptr<Device> odev) {
+void Executor::_insert_ostream(
+  Stream& stream, std::shared_ptr<Device> odev, std::vector<std::shared_ptr<Event>>& batch
+) {
 
   if(stream._tail->program()) {
     stream._writer = std::move(odev);
     return;
   }
         
+  // Large writes go out with MSG_ZEROCOPY if the device is a TCP socket.
+  if(auto socket = std::dynamic_pointer_cast<Socket>(odev); socket && stream._zerocopy) {
+    socket->zerocopy(stream._zerocopy);
+  }
+
+  // The read side watches the socket for the peer to hang up. A shared memory ring has no read
+  // side; a copy of the writer end of its wake-up socket stands in, which hangs up with the 
+  // reader even if the reader dies while the writer sleeps on a full ring. The completions of 
+  // zerocopy sends also wake the read side, which collects them and wakes the writer to release
+  // the data.
   if(stream.is_inter_stream(std::ios_base::out)) {
-    std::tie(stream._reader, std::ignore) = insert_channel(odev, std::ios_base::in)(
+
+    auto wdev = odev;
+
+    if(auto shm = std::dynamic_pointer_cast<SharedMemory>(odev); shm) {
+      auto fd = duplicate_fd(shm->peer_fd());
+      make_fd_close_on_exec(fd);
+      wdev = std::make_shared<Socket>(fd);
+    }
+
+    auto [R, W] = make_channel(std::move(wdev), std::ios_base::in, stream._tail->_strand)(
       [this, &stream] (pb::BrokenIO& b) {
         remove_ostream(stream.key);
+      },
+      [&stream] (InputStream&) {
+        if(auto os = stream.ostream(); os) {
+          os->notify();
+        }
       }
     );
+    stream._reader = R;
+    batch.push_back(std::move(R));
   }
 
-  std::tie(std::ignore, stream._writer) = insert_channel(std::move(odev), std::ios_base::out)(
+  auto [R, W] = make_channel(std::move(odev), std::ios_base::out, stream._tail->_strand)(
     [this, &stream] (pb::BrokenIO& b) {
       remove_ostream(stream.key);
     },
@@ -442,6 +672,19 @@ void Executor::_insert_ostream(Stream& stream, std::shared_ptr<Device> odev) {
       }
     }
   );
+  
+  // A vertex program reads bare bytes; it could not take the frames of a codec or a batch.
+  if(stream._head->program()) {
+    W->osbuf.single_writer(stream._single_writer);
+  }
+  else if(!std::dynamic_pointer_cast<Mailbox>(W->device())) {
+    W->codec(make_codec(stream._codec));
+    W->batch(stream._batch_size, stream._batch_delay);
+    W->osbuf.single_writer(stream._single_writer && stream._batch_size == 0);
+  }
+
+  stream._writer = W;
+  batch.push_back(std::move(W));
 
 }
 
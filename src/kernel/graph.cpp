@@ -54,6 +54,39 @@ VertexBuilder& VertexBuilder::program(std::string cmd) {
   return *this;
 }
 
+// Function: strand
+// Run all callbacks of the vertex (the vertex callback and the callbacks of its input and output
+// streams) serially, one at a time, so the vertex state needs no locking. Different vertices
+// still run in parallel.
+VertexBuilder& VertexBuilder::strand(bool flag) {
+  _graph->_tasks.emplace_back(
+    [G=_graph, key=key, flag] (pb::Topology* tpg) mutable {
+      // Local/distributed mode
+      if(tpg == nullptr || (tpg->topology != -1 && tpg->has_vertex(key))) {
+        G->_vertices.at(key)._strand = flag ? std::make_shared<Strand>() : nullptr;
+      }
+    }
+  );
+  return *this;
+}
+
+// Function: restart
+// Set the restart policy of the vertex program: the number of times a failed program is 
+// respawned and the delay before the first respawn, doubled on each subsequent one.
+VertexBuilder& VertexBuilder::restart(size_t max_restarts, std::chrono::milliseconds backoff) {
+  _graph->_tasks.emplace_back(
+    [G=_graph, key=key, max_restarts, backoff] (pb::Topology* tpg) mutable {
+      // Local/distributed mode
+      if(tpg == nullptr || (tpg->topology != -1 && tpg->has_vertex(key))) {
+        auto& v = G->_vertices.at(key);
+        v._max_restarts = max_restarts;
+        v._restart_backoff = backoff;
+      }
+    }
+  );
+  return *this;
+}
+
 //-------------------------------------------------------------------------------------------------
 // StreamBuilder
 //-------------------------------------------------------------------------------------------------
@@ -94,6 +127,90 @@ StreamBuilder& StreamBuilder::tag(std::string s) {
   return *this;
 }
 
+// Function: watermarks
+// Set the high and low watermarks of the pending bytes in the ostream. A zero high watermark
+// disables backpressure.
+StreamBuilder& StreamBuilder::watermarks(size_t high, size_t low) {
+  _graph->_tasks.emplace_back(
+    [G=_graph, key=key, high, low] (pb::Topology* tpg) {
+      // Local/distributed mode
+      if(tpg == nullptr || (tpg->topology != -1 && tpg->has_stream(key))) {
+        auto& s = G->_streams.at(key);
+        s._high_watermark = high;
+        s._low_watermark = low;
+      }
+    }
+  ); 
+  return *this;
+}
+
+// Function: codec
+// Compress the messages of the stream with the given codec. Both ends must be vertices in the
+// graph; a vertex program at either end reads and writes raw bytes, and the executor drops the
+// codec of such a stream with a warning. An intra stream between two vertices passes typed 
+// objects and ignores the codec.
+StreamBuilder& StreamBuilder::codec(Codec::Type type) {
+  _graph->_tasks.emplace_back(
+    [G=_graph, key=key, type] (pb::Topology* tpg) {
+      // Local/distributed mode
+      if(tpg == nullptr || (tpg->topology != -1 && tpg->has_stream(key))) {
+        G->_streams.at(key)._codec = type;
+      }
+    }
+  ); 
+  return *this;
+}
+
+// Function: batch
+// Coalesce the messages of the stream into batches of up to the given bytes, each sent no later
+// than the given delay after its first message. The same restrictions as the codec apply.
+StreamBuilder& StreamBuilder::batch(size_t size, std::chrono::microseconds delay) {
+  _graph->_tasks.emplace_back(
+    [G=_graph, key=key, size, delay] (pb::Topology* tpg) {
+      // Local/distributed mode
+      if(tpg == nullptr || (tpg->topology != -1 && tpg->has_stream(key))) {
+        auto& s = G->_streams.at(key);
+        s._batch_size = size;
+        s._batch_delay = delay;
+      }
+    }
+  ); 
+  return *this;
+}
+
+// Function: single_writer
+// Declare that the messages of the stream are written by one thread at a time, e.g., only from
+// the callbacks of a stranded tail vertex. The ostream then takes no lock between the writer and
+// the reactor. A batched stream flushes from a timer as well and keeps the locked buffer.
+StreamBuilder& StreamBuilder::single_writer(bool flag) {
+  _graph->_tasks.emplace_back(
+    [G=_graph, key=key, flag] (pb::Topology* tpg) {
+      // Local/distributed mode
+      if(tpg == nullptr || (tpg->topology != -1 && tpg->has_stream(key))) {
+        G->_streams.at(key)._single_writer = flag;
+      }
+    }
+  ); 
+  return *this;
+}
+
+// Function: zerocopy
+// Send the writes of at least the given bytes with MSG_ZEROCOPY when the stream runs over a TCP 
+// socket, i.e., between vertices in different containers. Zero turns it off. Zerocopy saves the
+// copy of multi-megabyte messages into the kernel but costs more than the copy of small ones.
+// A single-writer stream keeps copying.
+StreamBuilder& StreamBuilder::zerocopy(size_t threshold) {
+  _graph->_tasks.emplace_back(
+    [G=_graph, key=key, threshold] (pb::Topology* tpg) {
+      // Local/distributed mode
+      if(tpg == nullptr || (tpg->topology != -1 && tpg->has_stream(key))) {
+        G->_streams.at(key)._zerocopy = threshold;
+      }
+    }
+  ); 
+  return *this;
+}
+
 //-------------------------------------------------------------------------------------------------
 // ContainerBuilder
 //-------------------------------------------------------------------------------------------------
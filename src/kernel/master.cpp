@@ -492,6 +492,12 @@ std::string Master::agent_to_json(std::string_view query){
   return std::string {query.substr(query.find("=")+1)} + "(" + info.to_json().dump() + ")";
 }
 
+// Function: reactor_to_json
+// Export the event-loop instruments of the master (merged over its shards).
+std::string Master::reactor_to_json(std::string_view query) {
+  return std::string {query.substr(query.find("=")+1)} + "(" + statistics().to_json().dump() + ")";
+}
+
 // Function: make_response
 HttpResponse Master::make_response(const HttpRequest& req) {
 
@@ -506,6 +512,9 @@ HttpResponse Master::make_response(const HttpRequest& req) {
         if(match[1] == "cluster") {
           return HttpResponse { HttpStatusCode::OK, HttpBodyType::QUERY, ".json", agent_to_json(query), req.keep_alive };
         }
+        else if(match[1] == "reactor") {
+          return HttpResponse { HttpStatusCode::OK, HttpBodyType::QUERY, ".json", reactor_to_json(query), req.keep_alive };
+        }
       }
     }
     break;
@@ -56,8 +56,14 @@ Event::Signal Stream::operator()(InputStream& is) const {
   else return Event::DEFAULT;
 }
 
+// The ostream callback is the producer of the stream and is paused while the stream is 
+// congested. The event syncs the buffer before every callback, so the callback resumes in the 
+// round that drains the buffer to the low watermark.
 Event::Signal Stream::operator()(OutputStream& os) const {
-  if(_on_ostream) return _on_ostream((*_tail)(), os);
+  if(_on_ostream) {
+    auto& v = (*_tail)();
+    return congested() ? Event::DEFAULT : _on_ostream(v, os);
+  }
   else return Event::DEFAULT;
 }
 
@@ -109,6 +115,86 @@ std::shared_ptr<Device> Stream::extract_ibridge() {
   else return nullptr;
 }
 
+// Function: memory
+// Return the bytes of buffer blocks held by the stream events of this stream in this process.
+size_t Stream::memory() const {
+  size_t m {0};
+  if(auto os = ostream(); os) m += os->osbuf.memory();
+  if(auto is = istream(); is) m += is->isbuf.memory();
+  return m;
+}
+
+// Function: peak_memory
+// Return the peak bytes of buffer blocks held by the stream events of this stream in this process,
+// including the events already removed.
+size_t Stream::peak_memory() const {
+  size_t m {_retired_peak_memory};
+  if(auto os = ostream(); os && !(_retired & std::ios_base::out)) m += os->osbuf.peak_memory();
+  if(auto is = istream(); is && !(_retired & std::ios_base::in)) m += is->isbuf.peak_memory();
+  return m;
+}
+
+// Function: codec_counters
+// Return the codec counters of the stream events of this stream in this process: the encoded
+// frames of the ostream and the decoded frames of the istream, including the events already
+// removed.
+Codec::Counters Stream::codec_counters() const {
+  Codec::Counters c {_retired_codec_counters};
+  if(auto os = ostream(); os && os->codec() && !(_retired & std::ios_base::out)) {
+    c += os->codec()->counters();
+  }
+  if(auto is = istream(); is && is->codec() && !(_retired & std::ios_base::in)) {
+    c += is->codec()->counters();
+  }
+  return c;
+}
+
+// Procedure: _retire
+// Fold the counters of the stream events on the given sides into the stream before the executor
+// removes them. The stream only holds weak references to its events, and the counters of a
+// finished stream would otherwise go with them.
+void Stream::_retire(std::ios_base::openmode m) {
+
+  if((m & std::ios_base::out) && !(_retired & std::ios_base::out)) {
+    if(auto os = ostream(); os) {
+      _retired_peak_memory += os->osbuf.peak_memory();
+      if(os->codec()) _retired_codec_counters += os->codec()->counters();
+    }
+    _retired |= std::ios_base::out;
+  }
+
+  if((m & std::ios_base::in) && !(_retired & std::ios_base::in)) {
+    if(auto is = istream(); is) {
+      _retired_peak_memory += is->isbuf.peak_memory();
+      if(is->codec()) _retired_codec_counters += is->codec()->counters();
+    }
+    _retired |= std::ios_base::in;
+  }
+}
+
+// Function: congested
+// Return true if the stream is over its high watermark, or has not yet drained to its low 
+// watermark since. Only the ostream in this process counts; a stream without one is never 
+// congested.
+bool Stream::congested() const {
+
+  if(_high_watermark == 0) {
+    return false;
+  }
+
+  if(auto os = ostream(); os) {
+    if(auto n = static_cast<size_t>(os->osbuf.out_avail()); n >= _high_watermark) {
+      _congested.store(true, std::memory_order_relaxed);
+    }
+    else if(n <= low_watermark()) {
+      _congested.store(false, std::memory_order_relaxed);
+    }
+    return _congested.load(std::memory_order_relaxed);
+  }
+
+  return false;
+}
+
 // ------------------------------------------------------------------------------------------------
 
 // Constructor
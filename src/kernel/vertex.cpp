@@ -42,6 +42,25 @@ std::shared_ptr<InputStream> Vertex::istream(key_type k) const {
   return itr->second->istream();
 }
 
+// Function: congested
+// Return true if any ostream of the vertex is congested.
+bool Vertex::congested() const {
+  for(const auto& kvp : _ostreams) {
+    if(kvp.second->congested()) return true;
+  }
+  return false;
+}
+
+// Function: congested
+// Return true if the given ostream of the vertex is congested.
+bool Vertex::congested(key_type k) const {
+  auto itr = _ostreams.find(k);
+  if(itr == _ostreams.end()) {
+    DTC_THROW("Failed to query ostream ", k, " of vertex ", key, " (invalid key)");
+  }
+  return itr->second->congested();
+}
+
 // Operator
 Vertex& Vertex::operator()() {
   if(_on) {
@@ -95,15 +114,18 @@ Vertex::Program Vertex::_prespawn() {
 
   // Assign the bridges [key|tag]:fd
   std::vector<std::shared_ptr<Device>> B;
+  std::vector<key_type> K;
   std::ostringstream oss;
 
   for(const auto& [k, s] : _istreams) {
     B.push_back(s->extract_ibridge());
+    K.push_back(k);
     oss << (s->tag().empty() ? std::to_string(k) : s->tag()) << ":" << B.back()->fd() << ' ';
   }
 
   for(const auto& [k, s] : _ostreams) { 
     B.push_back(s->extract_obridge());
+    K.push_back(k);
     oss << (s->tag().empty() ? std::to_string(k) : s->tag()) << ":" << B.back()->fd() << ' ';
   }
 
@@ -118,7 +140,9 @@ Vertex::Program Vertex::_prespawn() {
           .remove_stderr_listener_port()
           .remove_stdout_listener_port();
 
-  return Program{key, _runtime.c_file(), _runtime.c_argv(), _runtime.c_envp(), std::move(B)};
+  return Program{
+    key, _runtime.c_file(), _runtime.c_argv(), _runtime.c_envp(), std::move(B), std::move(K), {}
+  };
 }
 
 // Procedure: _extract_bridges
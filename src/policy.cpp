@@ -260,9 +260,10 @@ std::unordered_map<key_type, std::string> Runtime::vertex_hosts() const {
 }
 
 // Function: frontiers
-std::unordered_map<key_type, int> Runtime::frontiers() const {
+// Each frontier is a pair key:fd of a socket, or key:fd,fd,fd of a shared memory ring.
+std::unordered_map<key_type, std::vector<int>> Runtime::frontiers() const {
 
-  std::unordered_map<key_type, int> frontiers;
+  std::unordered_map<key_type, std::vector<int>> frontiers;
 
   if(auto itr = _map.find("DTC_FRONTIERS"); itr != _map.end()) {
     const static std::regex e("[^\\s:]+"); 
@@ -271,8 +272,12 @@ std::unordered_map<key_type, int> Runtime::frontiers() const {
     assert((std::distance(sbeg, send) & 1) == 0);  // must be a pair
     for(auto itr=sbeg; itr!=send;) {
       key_type k = std::stoi(*itr++);
-      int fd = std::stoi(*itr++);
-      frontiers.try_emplace(k, fd);
+      std::istringstream iss(*itr++);
+      std::vector<int> fds;
+      for(std::string fd; std::getline(iss, fd, ',');) {
+        fds.push_back(std::stoi(fd));
+      }
+      frontiers.try_emplace(k, std::move(fds));
     }
   }
 
@@ -54,7 +54,11 @@ bool TaskInfo::has_error() const {
 
 // Function: to_string
 std::string TaskInfo::to_string() const {
-  return "Task "s + task_id.to_string() + ' ' + status_to_string(status) + " @" + agent;
+  return "Task "s + task_id.to_string() + ' ' + status_to_string(status) + " @" + agent + 
+         (num_restarts ? " (" + std::to_string(num_restarts) + " restarts)" : "") +
+         (stream_peak_memory ? " (stream peak " + std::to_string(stream_peak_memory) + "B)" : "") +
+         (codec_raw_bytes ? " (codec " + std::to_string(codec_raw_bytes) + "B->" + 
+                            std::to_string(codec_encoded_bytes) + "B)" : "");
 }
 
 // Operator: <<
@@ -508,6 +508,63 @@ std::tuple<double, double, double> cpu_load_average() {
   return std::make_tuple(val[0], val[1], val[2]);
 }
 
+// Function: numa_node_of
+int numa_node_of(int cpu) noexcept {
+
+  std::error_code errc;
+
+  auto dir = std::filesystem::path("/sys/devices/system/cpu") / ("cpu" + std::to_string(cpu));
+
+  for(const auto& entry : std::filesystem::directory_iterator(dir, errc)) {
+    if(auto name = entry.path().filename().string(); name.compare(0, 4, "node") == 0) {
+      try {
+        return std::stoi(name.substr(4));
+      }
+      catch(...) {
+      }
+    }
+  }
+
+  return -1;
+}
+
+// Function: this_cpuset
+// The affinity of the process (i.e., its main thread) is set by the kernel from the cpuset of
+// the control group, while worker threads may have been pinned to a single CPU.
+std::vector<int> this_cpuset() {
+
+  std::vector<int> cpus;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  if(::sched_getaffinity(::getpid(), sizeof(set), &set) == 0) {
+    for(int c=0; c<CPU_SETSIZE; ++c) {
+      if(CPU_ISSET(c, &set)) {
+        cpus.push_back(c);
+      }
+    }
+  }
+
+  if(cpus.empty()) {
+    for(int c=0, N=std::max(1u, std::thread::hardware_concurrency()); c<N; ++c) {
+      cpus.push_back(c);
+    }
+  }
+
+  std::vector<std::pair<int, int>> order;
+  for(auto c : cpus) {
+    order.emplace_back(numa_node_of(c), c);
+  }
+  std::sort(order.begin(), order.end());
+
+  for(size_t i=0; i<order.size(); ++i) {
+    cpus[i] = order[i].second;
+  }
+
+  return cpus;
+}
+
 };  // End of namespace dtc. ----------------------------------------------------------------------
 
 
@@ -17,6 +17,8 @@
 #include <dtc/unittest/catch.hpp>
 #include <dtc/concurrent/fifo.hpp>
 #include <dtc/concurrent/threadpool.hpp>
+#include <dtc/concurrent/work_stealing_queue.hpp>
+#include <dtc/concurrent/task.hpp>
 #include <dtc/concurrent/mutex.hpp>
 #include <dtc/concurrent/synchronized.hpp>
 #include <dtc/concurrent/unique_guard.hpp>
@@ -303,6 +305,117 @@ TEST_CASE("LockTest.SharedSynchronized") {
   }
 }
 
+// ---- WorkStealingQueue -------------------------------------------------------------------------
+
+// Test case: OwnerThieves
+TEST_CASE("WorkStealingQueueTest.OwnerThieves") {
+
+  struct Item {
+    uint64_t value;
+  };
+
+  for(int w=0; w<=4; ++w) {
+
+    dtc::WorkStealingQueue<Item> queue(2);
+
+    REQUIRE(queue.empty());
+
+    const uint64_t N = 1 << 16;
+
+    std::atomic<bool> done {false};
+    std::atomic<uint64_t> sum {0};
+    std::atomic<uint64_t> num {0};
+    std::vector<std::thread> thieves;
+
+    for(int i=0; i<w; ++i) {
+      thieves.emplace_back([&] () {
+        while(!done || !queue.empty()) {
+          if(auto item = queue.steal(); item) {
+            sum += item->value;
+            ++num;
+          }
+        }
+      });
+    }
+
+    // The owner interleaves pushes and pops and grows the buffer along the way.
+    for(uint64_t i=1; i<=N; ++i) {
+      queue.push({i});
+      if(i % 3 == 0) {
+        if(auto item = queue.pop(); item) {
+          sum += item->value;
+          ++num;
+        }
+      }
+    }
+
+    while(auto item = queue.pop()) {
+      sum += item->value;
+      ++num;
+    }
+    
+    done = true;
+    
+    for(auto& t : thieves) t.join();
+
+    REQUIRE(queue.empty());
+    REQUIRE(queue.capacity() >= 2);
+    REQUIRE(num == N);
+    REQUIRE(sum == N*(N+1)/2);
+  }
+}
+
+// ---- Task --------------------------------------------------------------------------------------
+
+// Test case: Storage
+TEST_CASE("TaskTest.Storage") {
+
+  auto counter = std::make_shared<int>(0);
+
+  // Small closure: stored inline.
+  dtc::Task small([counter] () { ++*counter; });
+  REQUIRE(small);
+  REQUIRE(small.is_inline());
+
+  // Large closure: stored on the heap.
+  std::array<char, 2*dtc::Task::CAPACITY> bytes {};
+  dtc::Task large([counter, bytes] () { *counter += 1 + bytes[0]; });
+  REQUIRE(large);
+  REQUIRE(!large.is_inline());
+
+  // Move-only closure.
+  dtc::Task unique([counter, p=std::make_unique<int>(10)] () { *counter += *p; });
+  REQUIRE(unique.is_inline());
+
+  REQUIRE(counter.use_count() == 4);
+
+  small();
+  large();
+  unique();
+  REQUIRE(*counter == 12);
+
+  // Move construction and assignment transfer the callable.
+  dtc::Task moved(std::move(large));
+  REQUIRE(!large);
+  REQUIRE(moved);
+  moved();
+  REQUIRE(*counter == 13);
+
+  small = std::move(unique);
+  REQUIRE(!unique);
+  REQUIRE(counter.use_count() == 3);
+  small();
+  REQUIRE(*counter == 23);
+
+  // Reset and destruction release the captures.
+  small.reset();
+  REQUIRE(!small);
+  REQUIRE(counter.use_count() == 2);
+  
+  moved = dtc::Task();
+  REQUIRE(counter.use_count() == 1);
+}
+
 // ---- Threadpool --------------------------------------------------------------------------------
 
 // Test case: SpawnShutdown
@@ -348,6 +461,190 @@ TEST_CASE("ThreadpoolTest.Task") {
   }
 }
 
+// Test case: WorkStealing
+// Tasks spawned by a worker go to its own deque. Other workers must steal them.
+TEST_CASE("ThreadpoolTest.WorkStealing") {
+
+  for(int w=1; w<=4; ++w) {
+
+    dtc::Threadpool threadpool(w);
+
+    const auto N = 1024;
+
+    std::atomic<size_t> counter {0};
+    std::atomic<size_t> stolen {0};
+
+    auto is_worker = threadpool.async([&] () {
+
+      const auto root = std::this_thread::get_id();
+
+      for(int n=0; n<N; ++n) {
+        threadpool.async([&, root] () { 
+          if(std::this_thread::get_id() != root) ++stolen;
+          ++counter; 
+        });
+      }
+
+      // Hold on to the children for a while so the other workers can steal them.
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+      while(w > 1 && stolen == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+      }
+
+      return threadpool.is_worker();
+    }).get();
+
+    threadpool.shutdown();
+
+    REQUIRE(is_worker);
+    REQUIRE(counter == N);
+    REQUIRE((w == 1 || stolen > 0));
+  }
+}
+
+// Test case: Priority
+// HIGH tasks run ahead of queued LOW tasks, but at most "burst" of them in a row.
+TEST_CASE("ThreadpoolTest.Priority") {
+
+  for(size_t burst=1; burst<=4; ++burst) {
+
+    dtc::Threadpool threadpool(1);
+
+    threadpool.burst(burst);
+    REQUIRE(threadpool.burst() == burst);
 
+    // Hold the only worker until every task is queued.
+    std::promise<void> gate, held;
+    threadpool.async([&held, fu=gate.get_future().share()] () { 
+      held.set_value();
+      fu.wait(); 
+    });
+    held.get_future().wait();
 
+    const size_t N = 16;
+
+    std::mutex mutex;
+    std::vector<dtc::Threadpool::Priority> order;
+
+    for(size_t i=0; i<N; ++i) {
+      threadpool.async([&] () { 
+        std::scoped_lock lock(mutex); 
+        order.push_back(dtc::Threadpool::LOW); 
+      });
+    }
+    
+    for(size_t i=0; i<N; ++i) {
+      threadpool.async([&] () { 
+        std::scoped_lock lock(mutex); 
+        order.push_back(dtc::Threadpool::HIGH); 
+      }, dtc::Threadpool::HIGH);
+    }
+
+    REQUIRE(threadpool.num_tasks() >= 2*N);
+
+    gate.set_value();
+    threadpool.shutdown();
+
+    REQUIRE(order.size() == 2*N);
+
+    // Every "burst" HIGH tasks are followed by one LOW task until the HIGH lane is empty.
+    size_t h = 0;
+    for(size_t i=0; i<order.size() && h<N; ++i) {
+      if(i % (burst+1) == burst) {
+        REQUIRE(order[i] == dtc::Threadpool::LOW);
+      }
+      else {
+        REQUIRE(order[i] == dtc::Threadpool::HIGH);
+        ++h;
+      }
+    }
+  }
+}
+
+// Test case: SilentAsync
+TEST_CASE("ThreadpoolTest.SilentAsync") {
+
+  for(int w=0; w<=4; ++w) {
+
+    dtc::Threadpool threadpool(w);
+
+    const auto N = 65536;
+
+    std::atomic<size_t> counter {0};
+    auto object = std::make_shared<int>(0);
+
+    for(auto n=0; n<N; n++) {
+      threadpool.silent_async([&counter, object] () { counter++; });
+    }
+
+    threadpool.shutdown();
+    REQUIRE(counter == N);
+    REQUIRE(object.use_count() == 1);
+  }
+}
+
+// Test case: Spin
+// One task at a time so that workers keep going idle between tasks.
+TEST_CASE("ThreadpoolTest.Spin") {
+
+  for(size_t spin : {0, 1, 16, 4096}) {
+    for(int w=1; w<=4; ++w) {
+
+      dtc::Threadpool threadpool(w);
+
+      threadpool.spin(spin);
+      REQUIRE(threadpool.spin() == spin);
+
+      const auto N = 1024;
+
+      size_t counter {0};
+
+      for(auto n=0; n<N; n++) {
+        threadpool.async([&] () { ++counter; }).get();
+      }
+
+      threadpool.shutdown();
+      REQUIRE(counter == N);
+    }
+  }
+}
+
+// Test case: Pin
+// Every pinned worker runs on a single CPU of the given set.
+TEST_CASE("ThreadpoolTest.Pin") {
+
+  const auto cpus = dtc::this_cpuset();
+
+  auto affinity = [] () {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    ::pthread_getaffinity_np(::pthread_self(), sizeof(set), &set);
+    std::vector<int> cpus;
+    for(int c=0; c<CPU_SETSIZE; ++c) {
+      if(CPU_ISSET(c, &set)) cpus.push_back(c);
+    }
+    return cpus;
+  };
+
+  for(int w=1; w<=4; ++w) {
+
+    dtc::Threadpool threadpool;
+    threadpool.pin(cpus);
+    REQUIRE(threadpool.pin() == cpus);
+
+    threadpool.spawn(w);
+    REQUIRE(threadpool.num_workers() == w);
+
+    std::vector<std::future<std::vector<int>>> futures;
+    for(int i=0; i<64; ++i) {
+      futures.push_back(threadpool.async(affinity));
+    }
+
+    for(auto& fu : futures) {
+      auto set = fu.get();
+      REQUIRE(set.size() == 1);
+      REQUIRE(std::find(cpus.begin(), cpus.end(), set[0]) != cpus.end());
+    }
+  }
+}
 
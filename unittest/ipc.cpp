@@ -31,6 +31,9 @@ auto make_device_pair() {
   else if constexpr(std::is_same_v<D, dtc::BlockFile>) {
     return dtc::make_block_file();
   }
+  else if constexpr(std::is_same_v<D, dtc::SharedMemory>) {
+    return dtc::make_shared_memory();
+  }
   else static_assert(dtc::dependent_false_v<D>);
 }
 
@@ -104,6 +107,133 @@ TEST_CASE("DeviceTest.BlockFile") {
   REQUIRE(dtc::is_fd_close_on_exec(F->fd()));
 }
 
+// Test case: DeviceTest.SharedMemory
+TEST_CASE("DeviceTest.SharedMemory") {
+
+  auto [rend, wend] = dtc::make_shared_memory(5000);
+  REQUIRE((rend->is_reader() and !wend->is_reader()));
+  REQUIRE((rend->capacity() == 8192 and wend->capacity() == 8192));
+
+  for(auto& d : {rend, wend}) {
+    for(auto fd : {d->fd(), d->peer_fd(), d->memfd()}) {
+      REQUIRE(dtc::is_fd_valid(fd));
+      REQUIRE(dtc::is_fd_close_on_exec(fd));
+    }
+    REQUIRE(dtc::is_fd_nonblocking(d->fd()));
+  }
+
+  // Wrap around the ring with odd-sized messages.
+  for(size_t i=0; i<100; ++i) {
+    auto wstr = dtc::random<std::string>('a', 'z', dtc::random<size_t>(1, 8192));
+    auto rstr = std::string(wstr.size(), ' ');
+    REQUIRE(wend->write(wstr.data(), wstr.size()) == static_cast<std::streamsize>(wstr.size()));
+    REQUIRE(rend->read(rstr.data(), rstr.size()) == static_cast<std::streamsize>(rstr.size()));
+    REQUIRE(rstr == wstr);
+  }
+
+  // A blocking writer in a child process that adopts a reference to the write end; the parent 
+  // reads until the writer closes.
+  auto data = dtc::random<std::string>('0', '9', 1000000);
+
+  wend->share();
+  
+  if(auto pid = ::fork(); pid == 0) {
+    wend->blocking(true);
+    auto ok = wend->flush(data.data(), data.size()) == static_cast<std::streamsize>(data.size());
+    wend.reset();
+    std::_Exit(ok ? 0 : 1);
+  }
+  else {
+    REQUIRE(pid > 0);
+    wend.reset();
+    rend->blocking(true);
+    std::string recv(data.size() + 1, ' ');
+    std::streamsize n {0};
+    REQUIRE_THROWS_AS(
+      [&] () { while(1) n += rend->read(recv.data() + n, recv.size() - n); } (), std::system_error
+    );
+    REQUIRE(recv.substr(0, n) == data);
+    int s;
+    REQUIRE((::waitpid(pid, &s, 0) == pid && WIFEXITED(s) && WEXITSTATUS(s) == 0));
+  }
+  
+  // A writer observes the closed reader.
+  auto [r, w] = dtc::make_shared_memory();
+  r.reset();
+  REQUIRE_THROWS_AS(w->write(data.data(), data.size()), std::system_error);
+}
+
+// Test case: DeviceTest.SharedMemory.Liveness
+// A peer killed before it can drop its reference still closes the ring for the other end.
+TEST_CASE("DeviceTest.SharedMemory.Liveness") {
+
+  // Return the error of the first failed call.
+  auto errc = [] (auto&& f) {
+    try {
+      while(1) f();
+    }
+    catch(const std::system_error& e) {
+      return e.code();
+    }
+  };
+
+  const std::string data {"liveness"};
+
+  // A killed writer: the reader drains the ring and gets EPIPE.
+  {
+    auto [rend, wend] = dtc::make_shared_memory();
+
+    wend->share();
+
+    auto pid = ::fork();
+
+    if(pid == 0) {
+      wend->write(data.data(), data.size());
+      while(1) ::pause();
+    }
+
+    REQUIRE(pid > 0);
+    wend.reset();
+
+    std::string recv(data.size(), ' ');
+    rend->blocking(true);
+    REQUIRE(rend->read(recv.data(), recv.size()) == static_cast<std::streamsize>(data.size()));
+    REQUIRE(recv == data);
+    
+    int s;
+    REQUIRE(::kill(pid, SIGKILL) != -1);
+    REQUIRE((::waitpid(pid, &s, 0) == pid && WIFSIGNALED(s)));
+
+    REQUIRE(errc([&] () { rend->read(recv.data(), recv.size()); }) == std::errc::broken_pipe);
+  }
+
+  // A killed reader: the writer fills the ring and gets EPIPE instead of waiting for space.
+  {
+    auto [rend, wend] = dtc::make_shared_memory();
+
+    rend->share();
+
+    auto pid = ::fork();
+
+    if(pid == 0) {
+      while(1) ::pause();
+    }
+
+    REQUIRE(pid > 0);
+    rend.reset();
+
+    while(wend->write(data.data(), data.size()) != -1);
+    REQUIRE(errno == EAGAIN);
+
+    int s;
+    REQUIRE(::kill(pid, SIGKILL) != -1);
+    REQUIRE((::waitpid(pid, &s, 0) == pid && WIFSIGNALED(s)));
+    
+    wend->blocking(true);
+    REQUIRE(errc([&] () { wend->write(data.data(), data.size()); }) == std::errc::broken_pipe);
+  }
+}
+
 // Test case: DeviceTest.IO.Socket
 TEST_CASE("DeviceTest.IO.Socket") {
   std::apply(test_device_io, make_device_pair<dtc::Socket>());
@@ -114,6 +244,11 @@ TEST_CASE("DeviceTest.IO.Pipe") {
   std::apply(test_device_io, make_device_pair<dtc::Pipe>());
 }
 
+// Test case: DeviceTest.IO.SharedMemory
+TEST_CASE("DeviceTest.IO.SharedMemory") {
+  std::apply(test_device_io, make_device_pair<dtc::SharedMemory>());
+}
+
 // ---- StreamBufferTest --------------------------------------------------------------------------
 
 // Procedure: test_streambuf_string_view
@@ -212,6 +347,113 @@ auto test_streambuf_move() {
   }
 }
 
+// Procedure: test_streambuf_segments
+// Data spanning many blocks are written, packed, and consumed in pieces of random sizes.
+auto test_streambuf_segments() {
+
+  constexpr auto B = dtc::StreamBlockPool::BLOCK_CAPACITY;
+
+  for(auto n : {B-1, B, B+1, 5*B+7}) {
+
+    const auto S = dtc::random<std::string>('a', 'z', n);
+
+    dtc::OutputStreamBuffer osbuf;
+    for(size_t i=0; i<n; ) {
+      auto k = std::min(n - i, dtc::random<size_t>(1, 3*B));
+      REQUIRE(osbuf.write(S.data() + i, k) == static_cast<std::streamsize>(k));
+      i += k;
+    }
+    REQUIRE(osbuf.out_avail() == static_cast<std::streamsize>(n));
+
+    dtc::InputStreamBuffer isbuf(std::move(osbuf));
+    std::string s(n, ' ');
+    for(size_t i=0; i<n; ) {
+      auto k = isbuf.read(s.data() + i, dtc::random<size_t>(1, B+B/2));
+      REQUIRE(k > 0);
+      i += k;
+    }
+    REQUIRE((s == S && isbuf.in_avail() == 0));
+
+    // The size header of the second packet straddles a block boundary.
+    std::string pad(B - 2*sizeof(std::streamsize) - 3, 'x');
+    dtc::OutputStreamBuffer obuf;
+    REQUIRE(dtc::BinaryOutputPackager(obuf)(pad) != -1);
+    REQUIRE(dtc::BinaryOutputPackager(obuf)(S) != -1);
+
+    dtc::InputStreamBuffer ibuf(obuf);
+    std::string a, b;
+    REQUIRE((dtc::BinaryInputPackager(ibuf)(a) != -1 && a == pad));
+    REQUIRE((dtc::BinaryInputPackager(ibuf)(b) != -1 && b == S));
+    REQUIRE(ibuf.in_avail() == 0);
+  }
+}
+
+// Procedure: test_streambuf_pool
+// Blocks are recycled through the pool, which gives them back over the cap or once idle.
+auto test_streambuf_pool() {
+
+  using namespace std::chrono_literals;
+
+  constexpr auto B = dtc::StreamBlockPool::BLOCK_CAPACITY;
+
+  auto& pool = dtc::StreamBlockPool::get();
+  auto cap = pool.cap();
+  auto idle = pool.idle();
+
+  pool.idle(1h);
+  pool.shrink();
+  REQUIRE(pool.num_free() == 0);
+
+  const std::string S(8*B, 'x');
+
+  // Memory of a buffer.
+  {
+    dtc::OutputStreamBuffer osbuf;
+    REQUIRE(osbuf.memory() == 0);
+    osbuf.write(S.data(), S.size());
+    REQUIRE((osbuf.memory() == 8*B && osbuf.peak_memory() == 8*B));
+
+    dtc::InputStreamBuffer isbuf(std::move(osbuf));
+    REQUIRE((osbuf.memory() == 0 && osbuf.peak_memory() == 8*B));
+    REQUIRE(isbuf.drop(4*B) == static_cast<std::streamsize>(4*B));
+    REQUIRE((isbuf.memory() == 4*B && isbuf.peak_memory() == 8*B));
+    REQUIRE(isbuf.drop(4*B) == static_cast<std::streamsize>(4*B));
+    REQUIRE((isbuf.memory() == 0 && pool.num_free() == 8));
+  }
+
+  // Blocks are taken from the free list.
+  {
+    dtc::OutputStreamBuffer osbuf;
+    osbuf.write(S.data(), S.size());
+    REQUIRE((pool.num_free() == 0 && pool.memory() == 8*B));
+  }
+  REQUIRE((pool.num_free() == 8 && pool.memory() == 8*B));
+
+  // Blocks freed over the cap go back to the allocator.
+  pool.cap(2*B);
+  {
+    dtc::OutputStreamBuffer osbuf;
+    osbuf.write(S.data(), S.size());
+  }
+  REQUIRE((pool.num_free() == 2 && pool.memory() == 2*B));
+  pool.cap(cap);
+
+  // Blocks left free for a whole idle period are released.
+  pool.idle(50ms);
+  {
+    dtc::OutputStreamBuffer osbuf;
+    osbuf.write(S.data(), 4*B);
+  }
+  for(int i=0; i<2; ++i) {
+    std::this_thread::sleep_for(60ms);
+    dtc::OutputStreamBuffer osbuf;
+    osbuf.write(S.data(), 1);
+  }
+  REQUIRE(pool.num_free() == 1);
+
+  pool.idle(idle);
+}
+
 // Procedure: test_streambuf_sync
 template <typename D>
 auto test_streambuf_sync() {
@@ -281,6 +523,134 @@ auto test_streambuf_sync() {
   }
 }
 
+// Procedure: test_streambuf_single_writer
+// One thread packs messages into a single-writer buffer while another syncs it to the device.
+// The messages come out whole and in order, including those spanning several blocks.
+template <typename D>
+auto test_streambuf_single_writer() {
+
+  constexpr auto B = dtc::StreamBlockPool::BLOCK_CAPACITY;
+  constexpr auto N = 4096;
+
+  auto [rend, wend] = make_device_pair<D>();
+
+  dtc::InputStreamBuffer isbuf(rend.get());
+  dtc::OutputStreamBuffer osbuf(wend.get());
+
+  osbuf.single_writer(true);
+  REQUIRE((osbuf.single_writer() && osbuf.out_avail() == 0 && osbuf.sync() == 0));
+
+  std::vector<std::string> S(N);
+  for(auto& s : S) {
+    s = dtc::random<std::string>('a', 'z', dtc::random<size_t>(0, dtc::random<int>(0, 1) ? 64 : 3*B));
+  }
+
+  std::atomic<bool> done {false};
+  std::atomic<size_t> num_failed {0};
+
+  std::thread writer([&] () {
+    for(const auto& s : S) {
+      if(dtc::BinaryOutputPackager(osbuf)(s) == -1) ++num_failed;
+    }
+    done = true;
+  });
+
+  std::thread syncer([&] () {
+    while(!done || osbuf.out_avail() > 0) {
+      osbuf.sync();
+    }
+  });
+
+  std::vector<std::string> R;
+  while(R.size() < S.size()) {
+    isbuf.sync();
+    for(std::string s; dtc::BinaryInputPackager(isbuf)(s) != -1; ) {
+      R.push_back(std::move(s));
+    }
+  }
+
+  writer.join();
+  syncer.join();
+
+  REQUIRE((num_failed == 0 && R == S && osbuf.out_avail() == 0 && isbuf.in_avail() == 0));
+  REQUIRE(osbuf.memory() <= B);
+
+  // A plain write is published at once.
+  const std::string M {"single writer"};
+  REQUIRE(osbuf.write(M.data(), M.size()) == static_cast<std::streamsize>(M.size()));
+  REQUIRE(osbuf.out_avail() == static_cast<std::streamsize>(M.size()));
+
+  dtc::InputStreamBuffer copy(osbuf);
+  REQUIRE((copy.string_view() == M && osbuf.out_avail() == static_cast<std::streamsize>(M.size())));
+}
+
+// Procedure: test_streambuf_zerocopy
+// Large syncs over a TCP socket go out with MSG_ZEROCOPY. Their data stay in the buffer until the
+// socket reports them completed, and the messages come out whole and in order.
+auto test_streambuf_zerocopy() {
+
+  constexpr auto T = 64*1024;
+
+  // A unix domain socket declines.
+  auto [U1, U2] = dtc::make_socket_pair();
+  REQUIRE((!U1->zerocopy(T) && U1->zerocopy() == 0));
+
+  auto L = dtc::make_socket_server("0");
+  auto C = dtc::make_socket_client("127.0.0.1", L->this_host().second);
+  auto A = L->accept();
+
+  REQUIRE((C->zerocopy(T) && C->zerocopy() == T));
+
+  dtc::OutputStreamBuffer osbuf(C.get());
+  dtc::InputStreamBuffer isbuf(A.get());
+
+  std::vector<std::string> S(64);
+  for(auto& s : S) {
+    s = dtc::random<std::string>('a', 'z', dtc::random<size_t>(0, dtc::random<int>(0, 1) ? 256 : 4*T));
+  }
+
+  std::vector<std::string> R;
+  for(size_t i=0; i<S.size() || R.size() < S.size() || osbuf.out_avail() > 0; ) {
+    if(i < S.size()) {
+      REQUIRE(dtc::BinaryOutputPackager(osbuf)(S[i++]) != -1);
+    }
+    osbuf.sync();
+    isbuf.sync();
+    for(std::string s; dtc::BinaryInputPackager(isbuf)(s) != -1; ) {
+      R.push_back(std::move(s));
+    }
+  }
+
+  REQUIRE((R == S && isbuf.in_avail() == 0));
+  REQUIRE(C->num_zerocopy_completed() > 0);
+
+  // A buffer destroyed with sends in flight hands its blocks over to the socket, which returns
+  // them to the pool once the sends complete.
+  auto& pool = dtc::StreamBlockPool::get();
+  auto in_use = [&pool] () {
+    return pool.memory() / dtc::StreamBlockPool::BLOCK_CAPACITY - pool.num_free();
+  };
+
+  auto num_blocks = in_use();
+  auto s = dtc::random<std::string>('a', 'z', 4*T);
+  {
+    dtc::OutputStreamBuffer osbuf(C.get());
+    REQUIRE(dtc::BinaryOutputPackager(osbuf)(s) != -1);
+    REQUIRE(osbuf.sync() > 0);
+  }
+
+  std::string r;
+  while(dtc::BinaryInputPackager(isbuf)(r) == -1) {
+    isbuf.sync();
+  }
+  REQUIRE(r == s);
+
+  for(int i=0; i<1000 && (C->reap_zerocopy(), in_use() != num_blocks); ++i) {
+    std::this_thread::sleep_for(1ms);
+  }
+  REQUIRE(in_use() == num_blocks);
+}
+
 // Test case: StreamBufferTest.StringView
 TEST_CASE("StreamBufferTest.StringView") {
   test_streambuf_string_view();
@@ -296,6 +666,16 @@ TEST_CASE("StreamBufferTest.Move") {
   test_streambuf_move();
 }
 
+// Test case: StreamBufferTest.Segments
+TEST_CASE("StreamBufferTest.Segments") {
+  test_streambuf_segments();
+}
+
+// Test case: StreamBufferTest.Pool
+TEST_CASE("StreamBufferTest.Pool") {
+  test_streambuf_pool();
+}
+
 // Test case: StreamBufferTest.Flush.Socket
 TEST_CASE("StreamBufferTest.Flush.Socket") {
   test_streambuf_flush<dtc::Socket>();
@@ -306,6 +686,11 @@ TEST_CASE("StreamBufferTest.Flush.Pipe") {
   test_streambuf_flush<dtc::Pipe>();
 }
 
+// Test case: StreamBufferTest.Flush.SharedMemory
+TEST_CASE("StreamBufferTest.Flush.SharedMemory") {
+  test_streambuf_flush<dtc::SharedMemory>();
+}
+
 // Test case: StreamBufferTest.Sync.Socket
 TEST_CASE("StreamBufferTest.Sync.Socket") {
   test_streambuf_sync<dtc::Socket>();
@@ -316,6 +701,26 @@ TEST_CASE("StreamBufferTest.Sync.Pipe") {
   test_streambuf_sync<dtc::Pipe>();
 }
 
+// Test case: StreamBufferTest.Sync.SharedMemory
+TEST_CASE("StreamBufferTest.Sync.SharedMemory") {
+  test_streambuf_sync<dtc::SharedMemory>();
+}
+
+// Test case: StreamBufferTest.Zerocopy
+TEST_CASE("StreamBufferTest.Zerocopy") {
+  test_streambuf_zerocopy();
+}
+
+// Test case: StreamBufferTest.SingleWriter.Socket
+TEST_CASE("StreamBufferTest.SingleWriter.Socket") {
+  test_streambuf_single_writer<dtc::Socket>();
+}
+
+// Test case: StreamBufferTest.SingleWriter.Pipe
+TEST_CASE("StreamBufferTest.SingleWriter.Pipe") {
+  test_streambuf_single_writer<dtc::Pipe>();
+}
+
 // ---- Stream test -------------------------------------------------------------------------------
 
 // Procedure: test_stream_criticality
@@ -417,6 +822,763 @@ auto test_stream_io() {
   }
 }
 
+// Procedure: test_stream_drain
+// The procedure tests the drain loop of an iostream pair under different budgets.
+template <typename D>
+auto test_stream_drain() {
+
+  for(size_t budget : {size_t{0}, size_t{4096}, size_t{1} << 20}) {
+    for(int i=0; i<=2; ++i) {
+
+      dtc::Reactor R(i);
+
+      auto [rend, wend] = make_device_pair<D>();
+      auto n = dtc::random<size_t>(100000, 2000000);
+      auto data = dtc::random<std::string>('0', '9', n);
+
+      auto ostream = R.insert<dtc::OutputStream>(
+        wend,
+        [] (auto& ostream) {
+          ostream.osbuf.sync();
+          if(ostream.osbuf.out_avail() == 0) {
+            return dtc::Event::REMOVE;
+          }
+          return dtc::Event::DEFAULT;
+        }
+      ).get();
+      
+      auto istream = R.insert<dtc::InputStream>(
+        rend,
+        [data] (auto& istream) {
+          istream.isbuf.sync();
+          if(std::string recv; istream(recv) != -1) {
+            REQUIRE(recv == data);
+            return dtc::Event::REMOVE;
+          }
+          return dtc::Event::DEFAULT;
+        }
+      ).get();
+      
+      ostream->drainer.budget(budget);
+      istream->drainer.budget(budget);
+      
+      (*ostream)(data);
+      
+      R.dispatch();
+
+      auto ic = istream->drainer.counters();
+      auto oc = ostream->drainer.counters();
+
+      REQUIRE(ic.num_bytes == oc.num_bytes);
+      REQUIRE(ic.num_bytes >= n);
+      REQUIRE(ic.num_activations > 0);
+      REQUIRE(ic.num_rounds >= ic.num_activations);
+      REQUIRE(ic.bytes_per_activation() > 0.0);
+      REQUIRE(ic.max_bytes <= ic.num_bytes);
+      
+      if(budget == 0) {
+        REQUIRE(ic.num_rounds == ic.num_activations);
+        REQUIRE(oc.num_rounds == oc.num_activations);
+        REQUIRE(ic.num_exhausted == 0);
+      }
+    }
+  }
+}
+
+// Procedure: test_stream_read_ahead
+// The procedure tests the istreams fed by the receives of the io_uring demux. Each istream gets
+// its data and then the end of file; a slow reader lets the data received ahead reach the cap.
+auto test_stream_read_ahead() {
+
+  constexpr int S = 16;
+
+  for(int i=0; i<=2; ++i) {
+
+    dtc::Reactor R(i, dtc::DemuxType::URING);
+
+    std::atomic<int> num_eofs {0};
+    std::vector<std::shared_ptr<dtc::Socket>> rends;
+
+    for(int s=0; s<S; ++s) {
+
+      auto [rend, wend] = dtc::make_socket_pair();
+      auto n = s == 0 ? size_t{2000000} : dtc::random<size_t>(1, 1000000);
+      auto data = dtc::random<std::string>('0', '9', n);
+
+      // The writer goes away once its data are out, which hangs up the reader.
+      auto ostream = R.insert<dtc::OutputStream>(
+        wend,
+        [] (auto& ostream) {
+          ostream.osbuf.sync();
+          if(ostream.osbuf.out_avail() == 0) {
+            return dtc::Event::REMOVE;
+          }
+          return dtc::Event::DEFAULT;
+        }
+      ).get();
+
+      (*ostream)(data);
+      
+      R.insert<dtc::InputStream>(
+        rend,
+        [data, slow=(s == 0), done=false, &num_eofs] (dtc::InputStream& istream) mutable {
+          if(slow) {
+            std::this_thread::sleep_for(1ms);
+          }
+          try {
+            istream.isbuf.sync();
+          }
+          catch(const std::system_error& e) {
+            REQUIRE(done);
+            REQUIRE(e.code() == std::errc::broken_pipe);
+            ++num_eofs;
+            return dtc::Event::REMOVE;
+          }
+          if(std::string recv; !done && istream(recv) != -1) {
+            REQUIRE(recv == data);
+            done = true;
+          }
+          return dtc::Event::DEFAULT;
+        }
+      );
+
+      rends.push_back(rend);
+    }
+    
+    R.dispatch(); 
+
+    REQUIRE(num_eofs == S);
+
+    // The data come through the receives unless the kernel cannot do them. A receive that runs
+    // out of buffers leaves the reads to the descriptor until it is armed again.
+    if(R.demux_type() == dtc::DemuxType::URING) {
+      for(auto& rend : rends) {
+        REQUIRE(rend->num_read_ahead() > 0);
+      }
+    }
+  }
+}
+
+// Procedure: test_stream_mailbox
+// The procedure tests the typed messages of an iostream pair over a mailbox.
+auto test_stream_mailbox() {
+
+  // Typed messages, the archive fallback, and the end of the stream.
+  {
+    auto mailbox = dtc::make_mailbox();
+    auto ostream = std::make_shared<dtc::OutputStream>(mailbox, [] (dtc::OutputStream&) {});
+    auto istream = std::make_shared<dtc::InputStream>(mailbox, [] (dtc::InputStream&) {});
+
+    auto uptr = std::make_unique<int>(5);
+
+    (*ostream)(1, std::string("one"));
+    (*ostream)(int32_t{7});
+    (*ostream)(uptr);
+
+    REQUIRE(istream->sync() == 3);
+    REQUIRE(static_cast<bool>(*istream));
+
+    int i;
+    std::string s;
+    REQUIRE(istream->operator()(i, s) > 0);
+    REQUIRE((i == 1 && s == "one"));
+
+    uint32_t u;
+    REQUIRE(istream->operator()(u) > 0);
+    REQUIRE(u == 7);
+    
+    std::unique_ptr<int> recv;
+    REQUIRE(istream->operator()(recv) > 0);
+    REQUIRE((recv && *recv == 5));
+
+    REQUIRE(istream->operator()(i) == -1);
+    REQUIRE(istream->isbuf.in_avail() == 0);
+
+    (*ostream)(2);
+    ostream.reset();
+
+    REQUIRE(istream->sync() == 1);
+    REQUIRE((istream->operator()(i) > 0 && i == 2));
+    REQUIRE_THROWS_AS(istream->sync(), std::system_error);
+  }
+
+  // Concurrent writers.
+  for(int i=0; i<=4; ++i) {
+   
+    dtc::Reactor R(i);
+
+    auto mailbox = dtc::make_mailbox();
+
+    constexpr auto P = 1024;
+
+    auto ostream = R.insert<dtc::OutputStream>(mailbox, [] (dtc::OutputStream&) {}).get();
+
+    for(int p=0; p<P; ++p) { 
+      R.insert<dtc::TimeoutEvent>(
+        0ms,
+        [&ostream, p] (dtc::Event& e) mutable {
+          (*ostream)(p, std::to_string(p));
+        }
+      );
+    }
+
+    R.insert<dtc::InputStream>(
+      mailbox,
+      [n=0, sum=0, &R] (dtc::InputStream& istream) mutable {
+        istream.sync();
+        int p;
+        std::string s;
+        while(istream(p, s) != -1) {
+          REQUIRE(std::to_string(p) == s);
+          sum += p;
+          ++n;
+        }
+        if(n == P) {
+          REQUIRE(sum == P*(P-1)/2);
+          R.break_loop();
+        }
+      }
+    );
+
+    R.dispatch(); 
+  }
+}
+
+// Test case: StreamTest.Mailbox
+TEST_CASE("StreamTest.Mailbox") {
+  test_stream_mailbox();
+}
+
+// Procedure: test_stream_codec
+// The procedure tests the read/write operations of an iostream pair with a codec.
+auto test_stream_codec(dtc::Codec::Type type) {
+
+  for(int i=0; i<=2; ++i) {
+
+    dtc::Reactor R(i);
+
+    auto [rend, wend] = make_device_pair<dtc::Socket>();
+
+    constexpr auto P = 64;
+
+    // Sparse vectors and repetitive text compress under every codec.
+    std::vector<std::vector<float>> vecs(P);
+    std::vector<std::string> strs(P);
+
+    for(int p=0; p<P; ++p) {
+      vecs[p].resize(dtc::random<size_t>(0, 20000));
+      for(auto& v : vecs[p]) {
+        v = dtc::random<int>(0, 9) == 0 ? dtc::random<float>(-1.0f, 1.0f) : 0.0f;
+      }
+      for(auto n = dtc::random<size_t>(0, 1000); n; --n) {
+        strs[p] += "the quick brown fox jumps over the lazy dog";
+      }
+    }
+
+    auto ostream = dtc::Reactor::make_event<dtc::OutputStream>(
+      nullptr,
+      wend,
+      [] (auto& ostream) {
+        ostream.osbuf.sync();
+        if(ostream.osbuf.out_avail() == 0) {
+          return dtc::Event::REMOVE;
+        }
+        return dtc::Event::DEFAULT;
+      }
+    );
+    
+    auto istream = dtc::Reactor::make_event<dtc::InputStream>(
+      nullptr,
+      rend,
+      [&, p=0] (auto& istream) mutable {
+        istream.sync();
+        std::vector<float> vec;
+        std::string str;
+        while(istream(vec, str) != -1) {
+          REQUIRE(vec == vecs[p]);
+          REQUIRE(str == strs[p]);
+          ++p;
+        }
+        return p == P ? dtc::Event::REMOVE : dtc::Event::DEFAULT;
+      }
+    );
+
+    ostream->codec(dtc::make_codec(type));
+    istream->codec(dtc::make_codec(type));
+
+    R.insert_batch({ostream, istream}).get();
+
+    for(int p=0; p<P; ++p) {
+      (*ostream)(vecs[p], strs[p]);
+    }
+
+    R.dispatch();
+
+    auto oc = ostream->codec()->counters();
+    auto ic = istream->codec()->counters();
+
+    REQUIRE(oc.num_frames == P);
+    REQUIRE(ic.num_frames == P);
+    REQUIRE(oc.raw_bytes == ic.raw_bytes);
+    REQUIRE(oc.encoded_bytes == ic.encoded_bytes);
+    REQUIRE(oc.ratio() > 1.0);
+  }
+}
+
+// Test case: StreamTest.Codec
+TEST_CASE("StreamTest.Codec") {
+  
+  // Round trips of incompressible, empty, and short inputs.
+  for(auto type : {dtc::Codec::RLE, dtc::Codec::SHUFFLE, dtc::Codec::LZ4}) {
+    
+    auto codec = dtc::make_codec(type);
+
+    REQUIRE(codec->type() == type);
+
+    for(size_t n : {0, 1, 3, 13, 255, 65536, 200000}) {
+      
+      auto raw = dtc::random<std::string>('a', 'z', n);
+      
+      std::string frame;
+      codec->encode(raw, frame);
+
+      dtc::Codec::Header header;
+      std::memcpy(&header, frame.data(), sizeof(header));
+
+      REQUIRE(header.raw == n);
+      REQUIRE(header.encoded <= n);
+      REQUIRE(frame.size() == sizeof(header) + header.encoded);
+
+      std::string recv(n, '\0');
+      codec->decode(header, frame.data() + sizeof(header), recv.data());
+      REQUIRE(recv == raw);
+    }
+    
+    // Malformed frame.
+    dtc::Codec::Header header {100, 10};
+    std::string junk(10, '\xff'), recv(100, '\0');
+    REQUIRE_THROWS_AS(codec->decode(header, junk.data(), recv.data()), std::system_error);
+
+    // Malformed headers are rejected before the frame is allocated.
+    REQUIRE((dtc::Codec::Header{0, 0}.valid() && dtc::Codec::Header{100, 10}.valid()));
+    REQUIRE_FALSE(dtc::Codec::Header{10, 100}.valid());
+    REQUIRE_FALSE(dtc::Codec::Header{uint64_t{1} << 62, 1}.valid());
+    {
+      auto [rend, wend] = dtc::make_socket_pair();
+      dtc::InputStream istream(rend, [] (dtc::InputStream&) {});
+      istream.codec(dtc::make_codec(type));
+      dtc::Codec::Header bad {uint64_t{1} << 62, 1};
+      REQUIRE(wend->write(&bad, sizeof(bad)) == sizeof(bad));
+      REQUIRE(istream.isbuf.sync() == sizeof(bad));
+      int x;
+      try {
+        istream(x);
+        REQUIRE(false);
+      }
+      catch(const std::system_error& e) {
+        REQUIRE(e.code().value() == EBADMSG);
+      }
+    }
+
+    test_stream_codec(type);
+  }
+}
+
+// Procedure: test_stream_batch
+// The procedure tests the read/write operations of a batched iostream pair. The last batch is
+// short and goes out on the batch delay.
+auto test_stream_batch(dtc::Codec::Type type) {
+
+  for(int i=0; i<=2; ++i) {
+
+    dtc::Reactor R(i);
+
+    auto [rend, wend] = make_device_pair<dtc::Socket>();
+
+    constexpr auto P = 10007;
+
+    auto ostream = dtc::Reactor::make_event<dtc::OutputStream>(
+      nullptr,
+      wend,
+      [] (auto& ostream) {
+        ostream.osbuf.sync();
+      }
+    );
+    
+    auto istream = dtc::Reactor::make_event<dtc::InputStream>(
+      nullptr,
+      rend,
+      [&, p=0] (auto& istream) mutable {
+        istream.sync();
+        int k;
+        std::string str;
+        while(istream(k, str) != -1) {
+          REQUIRE(k == p);
+          REQUIRE(str == std::to_string(p));
+          ++p;
+        }
+        if(p == P) {
+          REQUIRE(static_cast<bool>(istream) == false);
+          R.break_loop();
+        }
+      }
+    );
+
+    ostream->codec(dtc::make_codec(type));
+    istream->codec(dtc::make_codec(type));
+    ostream->batch(4096, 1ms);
+    istream->batch(true);
+
+    REQUIRE(ostream->batched());
+    REQUIRE(istream->batched());
+
+    R.insert_batch({ostream, istream}).get();
+
+    for(int p=0; p<P; ++p) {
+      REQUIRE((*ostream)(p, std::to_string(p)) > 0);
+    }
+
+    R.dispatch();
+  }
+}
+
+// Test case: StreamTest.Batch
+TEST_CASE("StreamTest.Batch") {
+  for(auto type : {dtc::Codec::NONE, dtc::Codec::LZ4}) {
+    test_stream_batch(type);
+  }
+}
+
+// Procedure: test_stream_zerocopy
+// An ostream removed on flush with zerocopy sends in flight waits for their completions without
+// reactivating itself in a loop. The reader starts late, so the sends sit in the socket queue
+// for a while, and nothing but the ostream reads the error queue of the socket.
+auto test_stream_zerocopy() {
+
+  constexpr auto T = 64*1024;
+
+  REQUIRE(::setenv("DTC_REACTOR_STATISTICS", "1", 1) != -1);
+  dtc::Reactor R;
+  REQUIRE(::unsetenv("DTC_REACTOR_STATISTICS") != -1);
+
+  auto L = dtc::make_socket_server("0");
+  auto C = dtc::make_socket_client("127.0.0.1", L->this_host().second);
+  auto A = L->accept();
+
+  REQUIRE(C->zerocopy(T));
+
+  const auto S = dtc::random<std::string>('a', 'z', 4*T);
+
+  auto ostream = R.insert<dtc::OutputStream>(C, [] (dtc::OutputStream&) {}).get();
+  (*ostream)(S);
+  ostream->remove_on_flush();
+
+  std::string recv;
+  R.insert<dtc::TimeoutEvent>(200ms, [&] (dtc::Event&) {
+    R.insert<dtc::InputStream>(A, [&] (dtc::InputStream& istream) {
+      istream.isbuf.sync();
+      return istream(recv) != -1 ? dtc::Event::REMOVE : dtc::Event::DEFAULT;
+    });
+  });
+
+  R.dispatch();
+
+  REQUIRE(recv == S);
+  REQUIRE(C->num_zerocopy_completed() > 0);
+  REQUIRE(R.statistics().num_activations[dtc::Event::WRITE] < 256);
+}
+
+// Test case: StreamTest.Zerocopy
+TEST_CASE("StreamTest.Zerocopy") {
+  test_stream_zerocopy();
+}
+
+// Procedure: test_stream_watermarks
+// The producer writes until Vertex::congested reports the stream over its high watermark. The
+// ostream callback must then stay paused until the pending bytes drain to the low watermark,
+// and the slow reader must still receive every message in order.
+auto test_stream_watermarks() {
+
+  constexpr size_t H = 64*1024;
+  constexpr size_t L = 16*1024;
+  constexpr size_t N = 2048;
+
+  REQUIRE(::setenv("DTC_EXECUTION_MODE", "local", 1) != -1);
+
+  const auto M = dtc::random<std::string>('a', 'z', 4096);
+
+  size_t num_sent {0};
+  size_t num_recv {0};
+  size_t num_calls {0};
+  size_t num_pauses {0};
+  size_t num_over_high {0};         // callbacks entered at or over the high watermark
+  size_t num_over_low {0};          // resumes entered over the low watermark
+  size_t num_congested {0};         // callbacks entered while the stream is congested
+  size_t num_corrupted {0};
+  bool paused {false};
+
+  dtc::Graph G;
+
+  auto A = G.vertex();
+  auto B = G.vertex();
+
+  auto AB = G.stream(A, B).watermarks(H, L);
+  
+  AB.on([&] (dtc::Vertex& v, dtc::OutputStream& os) {
+
+    ++num_calls;
+
+    if(auto n = static_cast<size_t>(os.osbuf.out_avail()); n >= H) {
+      ++num_over_high;
+    }
+    else if(paused && n > L) {
+      ++num_over_low;
+    }
+    
+    if(v.congested(AB)) {
+      ++num_congested;
+    }
+
+    paused = false;
+
+    while(num_sent < N) {
+      os(M);
+      if(++num_sent; v.congested(AB)) {
+        ++num_pauses;
+        paused = true;
+        break;
+      }
+    }
+
+    return num_sent == N ? dtc::Event::REMOVE : dtc::Event::DEFAULT;
+  });
+
+  AB.on([&] (dtc::Vertex&, dtc::InputStream& is) {
+    std::this_thread::sleep_for(1ms);
+    for(std::string m; is(m) != -1; ++num_recv) {
+      if(m != M) ++num_corrupted;
+    }
+    return num_recv == N ? dtc::Event::REMOVE : dtc::Event::DEFAULT;
+  });
+
+  A.on([&] (dtc::Vertex& v) {
+    (*v.ostream(AB))(M);
+    ++num_sent;
+  });
+
+  dtc::Executor(G).run();
+
+  REQUIRE(::unsetenv("DTC_EXECUTION_MODE") != -1);
+
+  REQUIRE(num_sent == N);
+  REQUIRE(num_recv == N);
+  REQUIRE(num_corrupted == 0);
+  REQUIRE(num_pauses > 0);
+  REQUIRE(num_calls > num_pauses);
+  REQUIRE(num_over_high == 0);
+  REQUIRE(num_over_low == 0);
+  REQUIRE(num_congested == 0);
+}
+
+// Test case: StreamTest.Watermarks
+TEST_CASE("StreamTest.Watermarks") {
+  test_stream_watermarks();
+}
+
+// Procedure: test_stream_counters
+// The buffer and codec counters of a stream outlive its events, and the executor reports them
+// in its taskinfo once the graph has run. Stream BA keeps the graph running for a while after 
+// stream AB has finished, so the events of AB are gone by the end.
+auto test_stream_counters() {
+
+  constexpr size_t N = 64;
+  constexpr size_t K = 128;
+  
+  REQUIRE(::setenv("DTC_EXECUTION_MODE", "local", 1) != -1);
+
+  const auto M = std::string(16*1024, 'a');
+
+  size_t num_sent {0};
+  size_t num_recv {0};
+  size_t num_pings {0};
+  size_t num_pongs {0};
+
+  dtc::Graph G;
+
+  auto A = G.vertex();
+  auto B = G.vertex();
+
+  auto AB = G.stream(A, B).codec(dtc::Codec::LZ4);
+  auto BA = G.stream(B, A);
+
+  AB.on([&] (dtc::Vertex&, dtc::OutputStream& os) {
+    if(num_sent < N) {
+      os(M);
+      ++num_sent;
+    }
+    return num_sent == N ? dtc::Event::REMOVE : dtc::Event::DEFAULT;
+  });
+
+  AB.on([&] (dtc::Vertex& v, dtc::InputStream& is) {
+    for(std::string m; is(m) != -1; ++num_recv) {
+      REQUIRE(m == M);
+    }
+    if(num_recv == N) {
+      (*v.ostream(BA))(++num_pings);
+      return dtc::Event::REMOVE;
+    }
+    return dtc::Event::DEFAULT;
+  });
+
+  BA.on([&] (dtc::Vertex&, dtc::OutputStream& os) {
+    if(num_pings < K) {
+      std::this_thread::sleep_for(1ms);
+      os(++num_pings);
+    }
+    return num_pings == K ? dtc::Event::REMOVE : dtc::Event::DEFAULT;
+  });
+
+  BA.on([&] (dtc::Vertex&, dtc::InputStream& is) {
+    for(size_t p; is(p) != -1; ) {
+      REQUIRE(p == ++num_pongs);
+    }
+    return num_pongs == K ? dtc::Event::REMOVE : dtc::Event::DEFAULT;
+  });
+
+  A.on([&] (dtc::Vertex& v) {
+    (*v.ostream(AB))(M);
+    ++num_sent;
+  });
+
+  dtc::Executor E(G);
+  
+  E.run();
+
+  REQUIRE(::unsetenv("DTC_EXECUTION_MODE") != -1);
+
+  REQUIRE(num_recv == N);
+  REQUIRE(num_pongs == K);
+
+  auto info = E.taskinfo();
+
+  REQUIRE(info.num_restarts == 0);
+  REQUIRE(info.stream_peak_memory > 0);
+  REQUIRE(info.codec_raw_bytes >= 2*N*M.size());
+  REQUIRE(info.codec_encoded_bytes > 0);
+  REQUIRE(info.codec_encoded_bytes < info.codec_raw_bytes);
+}
+
+// Test case: StreamTest.Counters
+TEST_CASE("StreamTest.Counters") {
+  test_stream_counters();
+}
+
+// Procedure: test_stream_respawn
+// A failed vertex program is respawned until one of its runs succeeds. Every failed run leaves
+// half a line behind; each respawn comes with a fresh bridge, so the reader only ever sees the
+// line of the run that succeeds.
+auto test_stream_respawn() {
+
+  REQUIRE(::setenv("DTC_EXECUTION_MODE", "local", 1) != -1);
+
+  const auto dir = std::filesystem::temp_directory_path();
+  const auto script = dir / ("dtc.respawn." + std::to_string(::getpid()) + ".sh");
+  const auto count = dir / ("dtc.respawn." + std::to_string(::getpid()) + ".count");
+
+  std::filesystem::remove(count);
+
+  std::ofstream(script) 
+    << "fd=${DTC_BRIDGES#*AB:}; fd=${fd%% *}\n"
+    << "n=$(cat " << count.string() << " 2>/dev/null || echo 0)\n"
+    << "echo $((n+1)) > " << count.string() << '\n'
+    << "if [ $n -lt 2 ]; then printf torn >&$fd; exit 1; fi\n"
+    << "printf 'whole\\n' >&$fd\n";
+
+  std::string lines;
+
+  dtc::Graph G;
+
+  auto A = G.vertex().program("/bin/bash " + script.string()).restart(3, 10ms);
+  auto B = G.vertex();
+
+  G.stream(A, B).tag("AB").on([&] (dtc::Vertex&, dtc::InputStream& is) {
+    std::string s(is.isbuf.in_avail(), ' ');
+    is.isbuf.copy(s.data(), s.size());
+    if(auto n = s.rfind('\n'); n != std::string::npos) {
+      lines += s.substr(0, n + 1);
+      is.isbuf.drop(n + 1);
+    }
+    return dtc::Event::DEFAULT;
+  });
+
+  dtc::Executor E(G);
+
+  E.run();
+
+  REQUIRE(::unsetenv("DTC_EXECUTION_MODE") != -1);
+
+  size_t num_runs {0};
+  std::ifstream(count) >> num_runs;
+
+  std::filesystem::remove(script);
+  std::filesystem::remove(count);
+
+  REQUIRE(num_runs == 3);
+  REQUIRE(E.taskinfo().num_restarts == 2);
+  REQUIRE(lines == "whole\n");
+}
+
+// Procedure: test_stream_respawn_exhausted
+// A vertex program that keeps failing is respawned with a doubling backoff, and the executor 
+// exits with EXIT_VERTEX_PROGRAM_FAILED once the restarts run out.
+auto test_stream_respawn_exhausted() {
+
+  auto beg = std::chrono::steady_clock::now();
+
+  auto pid = ::fork();
+
+  if(pid == 0) {
+    ::setenv("DTC_EXECUTION_MODE", "local", 1);
+    dtc::Graph G;
+    G.vertex().program("/bin/false").restart(2, 50ms);
+    dtc::Executor(G).run();
+    std::_Exit(EXIT_SUCCESS);
+  }
+
+  REQUIRE(pid > 0);
+
+  int s;
+  REQUIRE(::waitpid(pid, &s, 0) == pid);
+  REQUIRE((WIFEXITED(s) && WEXITSTATUS(s) == dtc::EXIT_VERTEX_PROGRAM_FAILED));
+  REQUIRE(std::chrono::steady_clock::now() - beg >= 150ms);
+}
+
+// Test case: StreamTest.Respawn
+TEST_CASE("StreamTest.Respawn") {
+  test_stream_respawn();
+  test_stream_respawn_exhausted();
+}
+
+// Test case: StreamTest.Drain.Socket
+TEST_CASE("StreamTest.Drain.Socket") {
+  test_stream_drain<dtc::Socket>();
+}
+
+// Test case: StreamTest.Drain.Pipe
+TEST_CASE("StreamTest.Drain.Pipe") {
+  test_stream_drain<dtc::Pipe>();
+}
+
+// Test case: StreamTest.Drain.SharedMemory
+TEST_CASE("StreamTest.Drain.SharedMemory") {
+  test_stream_drain<dtc::SharedMemory>();
+}
+
+// Test case: StreamTest.ReadAhead
+TEST_CASE("StreamTest.ReadAhead") {
+  test_stream_read_ahead();
+}
+
 // Test case: StreamTest.IO.Socket
 TEST_CASE("StreamTest.IO.Socket") {
   test_stream_io<dtc::Socket>();
@@ -426,6 +1588,11 @@ TEST_CASE("StreamTest.IO.Socket") {
 TEST_CASE("StreamTest.IO.Pipe") {
   test_stream_io<dtc::Pipe>();
 }
+
+// Test case: StreamTest.IO.SharedMemory
+TEST_CASE("StreamTest.IO.SharedMemory") {
+  test_stream_io<dtc::SharedMemory>();
+}
 //
 // Test case: StreamTest.Criticality.Socket
 TEST_CASE("StreamTest.Criticality.Socket") {
@@ -437,4 +1604,7 @@ TEST_CASE("StreamTest.Criticality.Pipe") {
   test_stream_criticality<dtc::Pipe>();
 }
 
-
+// Test case: StreamTest.Criticality.SharedMemory
+TEST_CASE("StreamTest.Criticality.SharedMemory") {
+  test_stream_criticality<dtc::SharedMemory>();
+}
@@ -16,6 +16,17 @@
 #include <dtc/unittest/catch.hpp>
 #include <dtc/dtc.hpp>
 
+// Global allocation counter (ReactorTest.ZeroAllocation). We wrap malloc of the C library 
+// rather than replace the global operator new, which allocates through it in every form.
+static std::atomic<size_t> num_allocations {0};
+
+extern "C" void* __libc_malloc(size_t);
+
+extern "C" void* malloc(size_t sz) noexcept {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(sz);
+}
+
 // Unittest: ReactorTest.EventOperation
 TEST_CASE("ReactorTest.EventOperation") {
 
@@ -189,7 +200,7 @@ TEST_CASE("ReactorTest.NotifyInsert") {
         [&] (dtc::Event& e) {
           std::this_thread::sleep_for(100ms);
           uint64_t c = 1;
-          R.promise([&] () { 
+          R.promise([&, c] () { 
             REQUIRE(::write(notifier->fd(), &c, sizeof(c)) == sizeof(c)); 
           });
         }
@@ -407,3 +418,876 @@ TEST_CASE("ReactorTest.Write") {
   }
 }
 
+// ------------------------------------------------------------------------------------------------
+
+// Unittest: ReactorTest.Demux
+TEST_CASE("ReactorTest.Demux") {
+
+  constexpr int num_events = 32;
+  constexpr int num_rounds = 16;
+
+  for(auto type : {dtc::DemuxType::SELECT, dtc::DemuxType::EPOLL, dtc::DemuxType::URING}) {
+    for(size_t w=0; w<=4; ++w) {
+
+      dtc::Reactor R(w, type);
+
+      // io_uring falls back to epoll on kernels without support.
+      if(type == dtc::DemuxType::URING) {
+        REQUIRE((R.demux_type() == type || R.demux_type() == dtc::DemuxType::EPOLL));
+      }
+      else {
+        REQUIRE(R.demux_type() == type);
+      }
+
+      std::atomic<int> counter {0};
+      std::vector<std::shared_ptr<dtc::Notifier>> notifiers;
+
+      // Each read event is re-armed after activation until it has seen all rounds.
+      for(int i=0; i<num_events; ++i) {
+        auto n = dtc::make_notifier();
+        notifiers.push_back(n);
+        R.insert<dtc::ReadEvent>(
+          n,
+          [&, rounds=0] (dtc::Event& e) mutable {
+            uint64_t c;
+            REQUIRE(::read(e.device()->fd(), &c, sizeof(c)) == sizeof(c));
+            ++counter;
+            if(++rounds == num_rounds) {
+              return dtc::Event::REMOVE;
+            }
+            c = 1;
+            REQUIRE(::write(e.device()->fd(), &c, sizeof(c)) == sizeof(c));
+            return dtc::Event::DEFAULT;
+          }
+        );
+      }
+
+      for(auto& n : notifiers) {
+        uint64_t c = 1;
+        REQUIRE(::write(n->fd(), &c, sizeof(c)) == sizeof(c));
+      }
+
+      R.dispatch();
+
+      REQUIRE(counter == num_events * num_rounds);
+      REQUIRE(R.num_events() == 0);
+    }
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Unittest: ReactorTest.Recycle
+// A descriptor whose file is shared (dup) is removed and closed, and its number is recycled by a 
+// new file. The hang-up of the old file must not activate the event of the new one.
+TEST_CASE("ReactorTest.Recycle") {
+
+  for(auto type : {dtc::DemuxType::SELECT, dtc::DemuxType::EPOLL, dtc::DemuxType::URING}) {
+
+    dtc::Reactor R(0, type);
+
+    auto [a0, a1] = dtc::make_socket_pair_raw();
+    auto keep = ::dup(a0);
+    REQUIRE(keep != -1);
+
+    auto d = std::make_shared<dtc::Device>(a0);
+    auto e1 = R.insert<dtc::ReadEvent>(d, [] (dtc::Event&) { return dtc::Event::DEFAULT; }).get();
+    REQUIRE(std::get<0>(R.remove(std::move(e1)).get()));
+
+    // Recycle the number for a new file while the old file lives on through keep.
+    auto [b0, b1] = dtc::make_socket_pair_raw();
+    REQUIRE(::dup2(b0, a0) == a0);
+    ::close(b0);
+    
+    bool data {false};
+
+    R.insert<dtc::ReadEvent>(d, [&] (dtc::Event& e) {
+      char c;
+      data = (::recv(e.device()->fd(), &c, 1, MSG_DONTWAIT) == 1);
+      return dtc::Event::REMOVE;
+    });
+
+    // Hang up the old file first and feed the new one later.
+    ::close(a1);
+    R.insert<dtc::TimeoutEvent>(std::chrono::milliseconds(50), [b1=b1] (dtc::Event&) {
+      REQUIRE(::write(b1, "x", 1) == 1);
+    });
+
+    R.dispatch();
+
+    REQUIRE(data);
+
+    ::close(b1);
+    ::close(keep);
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Unittest: ReactorTest.Shard
+TEST_CASE("ReactorTest.Shard") {
+
+  constexpr int num_events = 32;
+  constexpr int num_rounds = 16;
+
+  for(unsigned N=1; N<=4; ++N) {
+
+    dtc::Reactor R(4);
+
+    R.spawn_shards(N);
+
+    REQUIRE(R.num_shards() == N);
+
+    std::atomic<int> counter {0};
+    std::vector<std::shared_ptr<dtc::Notifier>> notifiers;
+    std::unordered_set<dtc::Reactor*> loops;
+
+    for(int i=0; i<num_events; ++i) {
+      auto n = dtc::make_notifier();
+      notifiers.push_back(n);
+      auto e = R.next_shard().insert<dtc::ReadEvent>(
+        n,
+        [&, rounds=0] (dtc::Event& e) mutable {
+          uint64_t c;
+          REQUIRE(::read(e.device()->fd(), &c, sizeof(c)) == sizeof(c));
+          ++counter;
+          if(++rounds == num_rounds) {
+            return dtc::Event::REMOVE;
+          }
+          c = 1;
+          REQUIRE(::write(e.device()->fd(), &c, sizeof(c)) == sizeof(c));
+          return dtc::Event::DEFAULT;
+        }
+      ).get();
+      loops.insert(e->reactor());
+    }
+
+    REQUIRE(loops.size() == N);
+    REQUIRE(R.num_events() == num_events);
+
+    // The workers of the primary are split among the loops.
+    size_t num_workers {0};
+    for(auto l : loops) {
+      num_workers += l->num_workers();
+    }
+    REQUIRE(num_workers == N * std::max(1u, 4/N));
+
+    for(auto& n : notifiers) {
+      uint64_t c = 1;
+      REQUIRE(::write(n->fd(), &c, sizeof(c)) == sizeof(c));
+    }
+
+    // The primary loop returns once every shard has drained its events.
+    R.dispatch();
+
+    REQUIRE(counter == num_events * num_rounds);
+    REQUIRE(R.num_events() == 0);
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Unittest: ReactorTest.Strand
+// Events on a strand never run concurrently, even across shards and with many workers.
+TEST_CASE("ReactorTest.Strand") {
+
+  using namespace std::chrono_literals;
+
+  constexpr int num_events = 16;
+  constexpr int num_rounds = 32;
+
+  for(unsigned N=1; N<=2; ++N) {
+    for(unsigned w : {1u, 2u, 4u}) {
+
+      dtc::Reactor R(w);
+
+      R.spawn_shards(N);
+
+      auto strand = std::make_shared<dtc::Strand>();
+      auto other = std::make_shared<dtc::Strand>();
+
+      std::atomic<int> running {0};
+      std::atomic<int> overlaps {0};
+      int counter {0};                   // protected by the strand
+      std::atomic<int> unstranded {0};
+
+      std::vector<std::shared_ptr<dtc::Notifier>> notifiers;
+      std::unordered_set<dtc::Reactor*> loops;
+
+      auto critical = [&] () {
+        if(running.fetch_add(1) != 0) {
+          ++overlaps;
+        }
+        ++counter;
+        std::this_thread::yield();
+        running.fetch_sub(1);
+      };
+
+      for(int i=0; i<num_events; ++i) {
+        auto n = dtc::make_notifier();
+        notifiers.push_back(n);
+        auto e = R.next_shard().insert_on<dtc::ReadEvent>(
+          strand,
+          n,
+          [&, rounds=0] (dtc::Event& e) mutable {
+            uint64_t c;
+            if(::read(e.device()->fd(), &c, sizeof(c)) != sizeof(c)) {
+              return dtc::Event::DEFAULT;
+            }
+            critical();
+            if(++rounds == num_rounds) {
+              return dtc::Event::REMOVE;
+            }
+            c = 1;
+            return ::write(e.device()->fd(), &c, sizeof(c)) == sizeof(c) ? 
+                   dtc::Event::DEFAULT : dtc::Event::REMOVE;
+          }
+        ).get();
+        REQUIRE(e->strand() == strand.get());
+        loops.insert(e->reactor());
+      }
+      
+      // Timeout events join the same strand.
+      for(int i=0; i<num_events; ++i) {
+        R.insert_on<dtc::TimeoutEvent>(strand, 0ms, [&] (dtc::Event&) { critical(); });
+      }
+
+      // Events on another strand and without a strand are not affected.
+      for(int i=0; i<num_events; ++i) {
+        R.insert_on<dtc::TimeoutEvent>(other, 0ms, [&] (dtc::Event&) { ++unstranded; });
+        R.insert<dtc::TimeoutEvent>(0ms, [&] (dtc::Event&) { ++unstranded; });
+      }
+
+      // All events of a strand live in the loop the strand is bound to.
+      REQUIRE(loops.size() == 1);
+      REQUIRE(strand->reactor() == *loops.begin());
+      
+      for(auto& n : notifiers) {
+        uint64_t c = 1;
+        REQUIRE(::write(n->fd(), &c, sizeof(c)) == sizeof(c));
+      }
+
+      R.dispatch();
+
+      REQUIRE(overlaps == 0);
+      REQUIRE(counter == num_events * num_rounds + num_events);
+      REQUIRE(unstranded == 2*num_events);
+      REQUIRE(R.num_events() == 0);
+    }
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Unittest: ReactorTest.ShardRemove
+// An event handed to the shard of its strand can be removed from the primary loop right away,
+// before the shard has registered it.
+TEST_CASE("ReactorTest.ShardRemove") {
+
+  using namespace std::chrono_literals;
+
+  constexpr int num_events = 64;
+
+  dtc::Reactor R(2);
+
+  R.spawn_shards(2);
+
+  auto strand = std::make_shared<dtc::Strand>();
+  auto pending = R.shard(1).insert_on<dtc::TimeoutEvent>(strand, 1h, [] (dtc::Event&) {}).get();
+
+  REQUIRE(strand->reactor() == &R.shard(1));
+
+  for(int i=0; i<num_events; ++i) {
+
+    // Keep the shard busy so that the event is still queued when we remove it.
+    R.shard(1).silent_promise([] () { std::this_thread::sleep_for(1ms); });
+
+    auto e = dtc::Reactor::make_event<dtc::TimeoutEvent>(strand, 1h, [] (dtc::Event&) {});
+    R.shard(1).insert_batch({e});
+    
+    auto [removed] = R.remove(e).get();
+    REQUIRE(removed);
+  }
+
+  // The same holds for a batch removed right after it was inserted.
+  std::vector<std::shared_ptr<dtc::Event>> batch;
+  for(int i=0; i<num_events; ++i) {
+    batch.push_back(dtc::Reactor::make_event<dtc::TimeoutEvent>(
+      i % 2 ? strand : nullptr, 1h, [] (dtc::Event&) {}
+    ));
+  }
+
+  R.shard(1).silent_promise([] () { std::this_thread::sleep_for(10ms); });
+  R.insert_batch(batch);
+  R.remove_batch(batch).get();
+
+  R.shard(1).promise([] () {}).get();
+  REQUIRE(R.num_events() == 1);
+
+  R.remove(pending);
+  R.shard(1).promise([] () {}).get();
+  REQUIRE(R.num_events() == 0);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Unittest: ReactorTest.Batch
+// Events registered in bulk land in the loop the batch was issued to (or in the loop of their
+// strand) and can be removed in bulk from the primary loop.
+TEST_CASE("ReactorTest.Batch") {
+
+  using namespace std::chrono_literals;
+
+  constexpr int num_events = 64;
+
+  for(unsigned N=1; N<=4; ++N) {
+
+    dtc::Reactor R(2);
+
+    R.spawn_shards(N);
+
+    std::atomic<int> counter {0};
+    std::vector<std::shared_ptr<dtc::Notifier>> notifiers;
+    std::vector<std::shared_ptr<dtc::Event>> events;
+    std::vector<std::future<void>> futures;
+
+    // One batch of read events per loop.
+    for(size_t i=0; i<R.num_shards(); ++i) {
+      std::vector<std::shared_ptr<dtc::Event>> batch;
+      for(int j=0; j<num_events; ++j) {
+        auto n = dtc::make_notifier();
+        notifiers.push_back(n);
+        batch.push_back(dtc::Reactor::make_event<dtc::ReadEvent>(nullptr, n, [&] (dtc::Event& e) {
+          uint64_t c;
+          REQUIRE(::read(e.device()->fd(), &c, sizeof(c)) == sizeof(c));
+          ++counter;
+        }));
+      }
+      events.insert(events.end(), batch.begin(), batch.end());
+      futures.push_back(R.shard(i).insert_batch(std::move(batch)));
+    }
+
+    for(auto& fu : futures) {
+      fu.get();
+    }
+
+    REQUIRE(R.num_events() == num_events * R.num_shards());
+
+    for(size_t i=0; i<events.size(); ++i) {
+      REQUIRE(events[i]->reactor() == &R.shard(i / num_events));
+    }
+
+    // Stranded events of one batch go to the loop of their strand. 
+    auto strand = std::make_shared<dtc::Strand>();
+    auto pending = R.next_shard().insert_on<dtc::TimeoutEvent>(strand, 1h, [] (dtc::Event&) {}).get();
+
+    std::vector<std::shared_ptr<dtc::Event>> timers;
+    for(int j=0; j<num_events; ++j) {
+      timers.push_back(dtc::Reactor::make_event<dtc::TimeoutEvent>(
+        j % 2 ? strand : nullptr, 0ms, [&] (dtc::Event&) { ++counter; }
+      ));
+    }
+    R.insert_batch(timers).get();
+
+    for(int j=0; j<num_events; ++j) {
+      REQUIRE(timers[j]->reactor() == (j % 2 ? strand->reactor() : &R));
+    }
+
+    for(auto& n : notifiers) {
+      uint64_t c = 1;
+      REQUIRE(::write(n->fd(), &c, sizeof(c)) == sizeof(c));
+    }
+
+    // Remove all read events in one batch once each of them has fired, together with the 
+    // pending timer of the strand.
+    R.insert<dtc::PeriodicEvent>(1ms, false, [&] (dtc::Event&) {
+      if(counter < num_events * static_cast<int>(R.num_shards()) + num_events) {
+        return dtc::Event::DEFAULT;
+      }
+      events.push_back(pending);
+      R.remove_batch(events);
+      return dtc::Event::REMOVE;
+    });
+
+    R.dispatch();
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Unittest: ReactorTest.Histogram
+TEST_CASE("ReactorTest.Histogram") {
+
+  using namespace std::chrono_literals;
+
+  dtc::Histogram h;
+
+  REQUIRE(h.count() == 0);
+  REQUIRE(h.percentile(0.5) == 0ns);
+
+  REQUIRE(dtc::Histogram::bucket_of(0ns) == 0);
+  REQUIRE(dtc::Histogram::bucket_of(1ns) == 1);
+  REQUIRE(dtc::Histogram::bucket_of(2ns) == 2);
+  REQUIRE(dtc::Histogram::bucket_of(3ns) == 2);
+  REQUIRE(dtc::Histogram::bucket_of(1024ns) == 11);
+  REQUIRE(dtc::Histogram::bucket_of(-5ns) == 0);
+  REQUIRE(dtc::Histogram::bucket_of(std::chrono::hours(10000)) == dtc::Histogram::NUM_BUCKETS - 1);
+
+  // 90 fast samples and 10 slow samples.
+  for(int i=0; i<90; ++i) h.insert(100ns);
+  for(int i=0; i<10; ++i) h.insert(1ms);
+
+  REQUIRE(h.count() == 100);
+  REQUIRE(h.max() == 1ms);
+  REQUIRE(h.mean() == (90*100ns + 10*1ms) / 100);
+  REQUIRE(h.percentile(0.5) >= 100ns);
+  REQUIRE(h.percentile(0.5) < 200ns);
+  REQUIRE(h.percentile(0.9) < 200ns);
+  REQUIRE(h.percentile(0.99) == 1ms);
+  REQUIRE(h.percentile(1.0) == 1ms);
+
+  dtc::AtomicHistogram a;
+  a.insert(100ns);
+  a.insert(1ms);
+
+  auto s = a.snapshot();
+  s += h;
+  REQUIRE(s.count() == 102);
+  REQUIRE(s.to_json()["count"] == 102);
+
+  a.clear();
+  REQUIRE(a.snapshot().count() == 0);
+}
+
+// Unittest: ReactorTest.Statistics
+TEST_CASE("ReactorTest.Statistics") {
+
+  using namespace std::chrono_literals;
+
+  // Instruments are off by default.
+  REQUIRE(::unsetenv("DTC_REACTOR_STATISTICS") != -1);
+  {
+    dtc::Reactor R;
+    R.insert<dtc::TimeoutEvent>(1ms, [] (dtc::Event&) {});
+    R.dispatch();
+    REQUIRE(R.statistics().num_iterations == 0);
+  }
+
+  REQUIRE(::setenv("DTC_REACTOR_STATISTICS", "1", 1) != -1);
+
+  constexpr int num_rounds = 64;
+
+  for(unsigned N=1; N<=2; ++N) {
+    for(unsigned w : {0u, 2u}) {
+
+      dtc::Reactor R(w);
+
+      R.spawn_shards(N);
+
+      auto n = dtc::make_notifier();
+
+      R.next_shard().insert<dtc::ReadEvent>(
+        n,
+        [rounds=0] (dtc::Event& e) mutable {
+          uint64_t c;
+          if(::read(e.device()->fd(), &c, sizeof(c)) != sizeof(c)) {
+            return dtc::Event::DEFAULT;
+          }
+          if(++rounds == num_rounds) {
+            return dtc::Event::REMOVE;
+          }
+          c = 1;
+          return ::write(e.device()->fd(), &c, sizeof(c)) == sizeof(c) ? 
+                 dtc::Event::DEFAULT : dtc::Event::REMOVE;
+        }
+      ).get();
+
+      R.insert<dtc::TimeoutEvent>(1ms, [] (dtc::Event&) { std::this_thread::sleep_for(1ms); });
+      R.insert<dtc::PeriodicEvent>(0ms, false, [i=0] (dtc::Event&) mutable { 
+        return ++i == num_rounds ? dtc::Event::REMOVE : dtc::Event::DEFAULT;
+      });
+
+      uint64_t c = 1;
+      REQUIRE(::write(n->fd(), &c, sizeof(c)) == sizeof(c));
+
+      R.dispatch();
+
+      auto s = R.statistics();
+
+      REQUIRE(s.num_loops == N);
+      REQUIRE(s.num_iterations > 0);
+      REQUIRE(s.iteration.count() > 0);
+      REQUIRE(s.io_poll.count() > 0);
+      REQUIRE(s.num_activations[dtc::Event::READ] == num_rounds);
+      REQUIRE(s.num_activations[dtc::Event::PERIODIC] == num_rounds);
+      REQUIRE(s.num_activations[dtc::Event::TIMEOUT] == 1);
+      REQUIRE(s.num_activations[dtc::Event::WRITE] == 0);
+      REQUIRE(s.callback[dtc::Event::READ].count() == num_rounds);
+      REQUIRE(s.callback[dtc::Event::PERIODIC].count() == num_rounds);
+      REQUIRE(s.callback[dtc::Event::TIMEOUT].count() == 1);
+      REQUIRE(s.callback[dtc::Event::TIMEOUT].max() >= 1ms);
+      REQUIRE(s.delay.count() == 2*num_rounds + 1);
+
+      auto j = s.to_json();
+      REQUIRE(j["num_activations"]["read"] == num_rounds);
+      REQUIRE(j["callback"]["timeout"]["count"] == 1);
+
+      R.clear_statistics();
+      REQUIRE(R.statistics().num_iterations == 0);
+      REQUIRE(R.statistics().delay.count() == 0);
+    }
+  }
+
+  REQUIRE(::unsetenv("DTC_REACTOR_STATISTICS") != -1);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Unittest: ReactorTest.TimingWheel
+TEST_CASE("ReactorTest.TimingWheel") {
+
+  constexpr int N = 4096;
+
+  for(auto slack : {std::chrono::microseconds(1), std::chrono::microseconds(1000)}) {
+
+    dtc::TimingWheel wheel(slack);
+
+    REQUIRE(wheel.empty());
+    REQUIRE(wheel.next_expiry() == std::chrono::steady_clock::time_point::max());
+
+    std::default_random_engine gen(0);
+    std::uniform_int_distribution<int> dist(0, 1 << 22);
+
+    std::vector<std::unique_ptr<dtc::TimeoutEvent>> events;
+    std::unordered_set<dtc::Event*> removed;
+
+    for(int i=0; i<N; ++i) {
+      events.push_back(std::make_unique<dtc::TimeoutEvent>(
+        std::chrono::microseconds(dist(gen)), [](dtc::Event&){}
+      ));
+      wheel.insert(events.back().get());
+    }
+
+    REQUIRE(wheel.size() == N);
+
+    // Cancel every third timer.
+    for(int i=0; i<N; i+=3) {
+      wheel.remove(events[i].get());
+      removed.insert(events[i].get());
+    }
+
+    REQUIRE(wheel.size() == N - removed.size());
+
+    // Walk the time forward and check that each timer fires once, not before its timeout, and
+    // no later than one slack after.
+    auto tp = dtc::now();
+    auto deadline = tp + std::chrono::seconds(5);
+    size_t fired {0};
+
+    while(!wheel.empty()) {
+      REQUIRE(tp < deadline);
+      tp += std::chrono::microseconds(dist(gen) % 5000);
+      wheel.expire(tp, [&] (dtc::Event* e) {
+        REQUIRE(removed.find(e) == removed.end());
+        REQUIRE(e->timer().timeout <= tp);
+        REQUIRE(e->timer().timeout + slack + std::chrono::milliseconds(5) >= tp);
+        REQUIRE(e->timer().satellite == -1);
+        ++fired;
+      });
+    }
+
+    REQUIRE(fired == N - removed.size());
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Benchmark: ReactorTest.TimerQueue
+// Compare the timing wheel against the binary heap (hidden; run with "[benchmark]").
+TEST_CASE("ReactorTest.TimerQueue", "[.][benchmark]") {
+
+  std::default_random_engine gen(0);
+  std::uniform_int_distribution<int> dist(0, 1 << 20);
+  std::vector<std::unique_ptr<dtc::TimeoutEvent>> events;
+
+  for(size_t N=1000; N<=1000000; N*=10) {
+
+    while(events.size() < N) {
+      events.push_back(std::make_unique<dtc::TimeoutEvent>(
+        std::chrono::microseconds(dist(gen)), [](dtc::Event&){}
+      ));
+    }
+
+    auto horizon = dtc::now() + std::chrono::seconds(2);
+
+    BENCHMARK("TimeoutEventHeap " + std::to_string(N)) {
+      dtc::TimeoutEventHeap heap;
+      for(size_t i=0; i<N; ++i) heap.insert(events[i].get());
+      for(size_t i=0; i<N; i+=2) heap.remove(events[i].get());
+      while(!heap.empty() && heap.top()->timer().timeout <= horizon) heap.pop();
+    }
+
+    BENCHMARK("TimingWheel " + std::to_string(N)) {
+      dtc::TimingWheel wheel;
+      for(size_t i=0; i<N; ++i) wheel.insert(events[i].get());
+      for(size_t i=0; i<N; i+=2) wheel.remove(events[i].get());
+      wheel.expire(horizon, [] (dtc::Event*) {});
+    }
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Unittest: ReactorTest.ZeroAllocation
+// A read event re-activates itself; once warmed up, the dispatch path must not allocate.
+TEST_CASE("ReactorTest.ZeroAllocation") {
+
+  constexpr size_t num_warmups = 1000;
+  constexpr size_t num_rounds = 10000;
+
+  for(auto type : {dtc::DemuxType::SELECT, dtc::DemuxType::EPOLL, dtc::DemuxType::URING}) {
+    for(unsigned w=0; w<=2; ++w) {
+
+      dtc::Reactor R(w, type);
+
+      size_t count {0};
+      size_t allocs {0};
+
+      auto notifier = dtc::make_notifier();
+
+      R.insert<dtc::ReadEvent>(
+        notifier,
+        [&] (dtc::Event& e) {
+          uint64_t c;
+          if(::read(e.device()->fd(), &c, sizeof(c)) != sizeof(c)) {
+            return dtc::Event::DEFAULT;
+          }
+          if(++count == num_warmups) {
+            allocs = num_allocations.load();
+          }
+          else if(count == num_warmups + num_rounds) {
+            allocs = num_allocations.load() - allocs;
+            return dtc::Event::REMOVE;
+          }
+          c = 1;
+          return ::write(e.device()->fd(), &c, sizeof(c)) == sizeof(c) ? 
+                 dtc::Event::DEFAULT : dtc::Event::REMOVE;
+        }
+      );
+
+      uint64_t c = 1;
+      REQUIRE(::write(notifier->fd(), &c, sizeof(c)) == sizeof(c));
+
+      R.dispatch();
+
+      REQUIRE(count == num_warmups + num_rounds);
+      REQUIRE(allocs == 0);
+    }
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Unittest: ReactorTest.SilentTask
+// Once warmed up, fire-and-forget tasks on the workers (silent_async) and on the event loop 
+// (silent_promise) must not allocate when their closures fit in a Task.
+TEST_CASE("ReactorTest.SilentTask") {
+
+  constexpr size_t num_tasks = 4096;
+
+  for(unsigned w=1; w<=2; ++w) {
+
+    dtc::Reactor R(w);
+
+    std::atomic<size_t> count {0};
+
+    auto object = std::make_shared<size_t>(0);
+
+    // Keep the loop alive with an idle event until the submitter breaks it.
+    R.insert<dtc::ReadEvent>(dtc::make_notifier(), [] (dtc::Event&) {});
+
+    // Tasks are submitted in windows so the number of tasks in flight, and hence the number of
+    // recycled nodes, is bounded. Warm-up rounds use a larger window.
+    auto round = [&] (auto&& submit, size_t num_window) {
+      count = 0;
+      auto allocs = num_allocations.load();
+      for(size_t i=0; i<num_tasks; i+=num_window) {
+        for(size_t j=0; j<num_window; ++j) {
+          submit([&count, object] () { ++count; });
+        }
+        while(count != i + num_window) {
+          std::this_thread::yield();
+        }
+      }
+      return num_allocations.load() - allocs;
+    };
+
+    auto on_worker = [&] (auto&& c) { R.silent_async(std::move(c)); };
+    auto on_loop = [&] (auto&& c) { R.silent_promise(std::move(c)); };
+
+    size_t worker_allocs {0};
+    size_t loop_allocs {0};
+
+    std::thread submitter([&] () {
+      // Warm up the nodes, the inboxes and the promise queue.
+      round(on_worker, 256);
+      round(on_loop, 256);
+      worker_allocs = round(on_worker, 64);
+      loop_allocs = round(on_loop, 64);
+      R.break_loop();
+    });
+
+    R.dispatch();
+    submitter.join();
+
+    REQUIRE(worker_allocs == 0);
+    REQUIRE(loop_allocs == 0);
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Benchmark: ReactorTest.Activation
+// Round-trip cost of one read activation (hidden; run with "[benchmark]").
+TEST_CASE("ReactorTest.Activation", "[.][benchmark]") {
+
+  for(unsigned w : {0u, 1u, 4u}) {
+
+    dtc::Reactor R(w);
+
+    std::atomic<size_t> count {0};
+    size_t target {0};
+
+    auto notifier = dtc::make_notifier();
+
+    auto event = R.insert<dtc::ReadEvent>(
+      notifier,
+      [&] (dtc::Event& e) {
+        uint64_t c;
+        if(::read(e.device()->fd(), &c, sizeof(c)) == sizeof(c) && ++count < target) {
+          c = 1;
+          ::write(e.device()->fd(), &c, sizeof(c));
+        }
+      }
+    ).get();
+
+    // Stop the loop once the target number of activations has been reached.
+    R.threshold(0);
+    R.break_loop_on([&] (dtc::Reactor&) { return count >= target; });
+
+    BENCHMARK("100000 activations, " + std::to_string(w) + " workers") {
+      count = 0;
+      target = 100000;
+      uint64_t c = 1;
+      ::write(notifier->fd(), &c, sizeof(c));
+      R.dispatch();
+    }
+
+    R.remove(event);
+  }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Benchmark: ReactorTest.BatchInsert
+// Startup cost of registering the two sides of many channels over a sharded reactor, one 
+// round trip per event versus one batch per loop (hidden; run with "[benchmark]").
+TEST_CASE("ReactorTest.BatchInsert", "[.][benchmark]") {
+
+  constexpr size_t num_channels = 10000;
+
+  dtc::Reactor R(1);
+
+  R.spawn_shards(4);
+
+  auto device = dtc::make_notifier();
+
+  auto make = [&] () {
+    return dtc::Reactor::make_event<dtc::WriteEvent>(nullptr, device, [] (dtc::Event&) {});
+  };
+
+  BENCHMARK(std::to_string(num_channels) + " channels, one event at a time") {
+    std::vector<std::shared_ptr<dtc::Event>> events;
+    for(size_t i=0; i<num_channels; ++i) {
+      auto& loop = R.next_shard();
+      events.push_back(loop.insert<dtc::WriteEvent>(device, [] (dtc::Event&) {}).get());
+      events.push_back(loop.insert<dtc::WriteEvent>(device, [] (dtc::Event&) {}).get());
+    }
+    R.remove_batch(std::move(events)).get();
+  }
+
+  BENCHMARK(std::to_string(num_channels) + " channels, one batch per loop") {
+    std::vector<std::shared_ptr<dtc::Event>> events;
+    std::unordered_map<dtc::Reactor*, std::vector<std::shared_ptr<dtc::Event>>> batches;
+    for(size_t i=0; i<num_channels; ++i) {
+      auto& batch = batches[&R.next_shard()];
+      batch.push_back(make());
+      batch.push_back(make());
+      events.insert(events.end(), batch.end() - 2, batch.end());
+    }
+    std::vector<std::future<void>> futures;
+    for(auto& [loop, batch] : batches) {
+      futures.push_back(loop->insert_batch(std::move(batch)));
+    }
+    for(auto& fu : futures) {
+      fu.get();
+    }
+    R.remove_batch(std::move(events)).get();
+  }
+
+  REQUIRE(R.num_events() == 0);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+// Benchmark: ReactorTest.TaskAllocation
+// Heap allocations and run time per task of the four ways to hand a closure capturing a 
+// shared_ptr and a pointer to a reactor (hidden; run with "[benchmark]").
+TEST_CASE("ReactorTest.TaskAllocation", "[.][benchmark]") {
+
+  constexpr size_t num_tasks = 100000;
+
+  dtc::Reactor R(2);
+
+  std::atomic<size_t> count {0};
+
+  auto object = std::make_shared<size_t>(0);
+
+  R.insert<dtc::ReadEvent>(dtc::make_notifier(), [] (dtc::Event&) {});
+
+  auto run = [&] (const std::string& name, auto&& submit) {
+    
+    // Warm up.
+    for(size_t k=0; k<2; ++k) {
+      count = 0;
+      auto allocs = num_allocations.load();
+      auto beg = std::chrono::steady_clock::now();
+      for(size_t i=0; i<num_tasks; ++i) {
+        submit([&count, object] () { ++count; });
+      }
+      while(count != num_tasks) {
+        std::this_thread::yield();
+      }
+      auto end = std::chrono::steady_clock::now();
+      allocs = num_allocations.load() - allocs;
+      if(k == 1) {
+        std::cout << std::left << std::setw(16) << name 
+                  << std::fixed << std::setprecision(3)
+                  << double(allocs) / num_tasks << " allocs/task, "
+                  << std::chrono::duration<double, std::nano>(end - beg).count() / num_tasks 
+                  << " ns/task\n";
+      }
+    }
+  };
+
+  std::thread submitter([&] () {
+    run("async", [&] (auto&& c) { R.async(std::move(c)); });
+    run("silent_async", [&] (auto&& c) { R.silent_async(std::move(c)); });
+    run("promise", [&] (auto&& c) { R.promise(std::move(c)); });
+    run("silent_promise", [&] (auto&& c) { R.silent_promise(std::move(c)); });
+    R.break_loop();
+  });
+
+  R.dispatch();
+  submitter.join();
+}
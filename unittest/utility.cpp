@@ -174,3 +174,27 @@ TEST_CASE("Utility.os.descriptor") {
 
 
 
+
+//-------------------------------------------------------------------------------------------------
+
+// Unit test: Utility.os.cpuset
+TEST_CASE("Utility.os.cpuset") {
+
+  auto cpus = dtc::this_cpuset();
+
+  REQUIRE(cpus.size() > 0);
+  REQUIRE(std::set<int>(cpus.begin(), cpus.end()).size() == cpus.size());
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  REQUIRE(::sched_getaffinity(::getpid(), sizeof(set), &set) == 0);
+  REQUIRE(static_cast<size_t>(CPU_COUNT(&set)) == cpus.size());
+
+  for(size_t i=0; i<cpus.size(); ++i) {
+    REQUIRE(CPU_ISSET(cpus[i], &set));
+    // Grouped by NUMA node.
+    if(i) {
+      REQUIRE(dtc::numa_node_of(cpus[i-1]) <= dtc::numa_node_of(cpus[i]));
+    }
+  }
+}